@@ -0,0 +1,98 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#ifndef __JAVACALL_LCD_SHM_H
+#define __JAVACALL_LCD_SHM_H
+
+/*
+ * Layout of the shared memory framebuffer of the headless Linux LCD.
+ * The mapping starts with this header, followed by maxHeight rows of
+ * stride bytes each at pixelOffset.  The header uses fixed size types
+ * only, so a viewer, screenshot tool or test oracle can map the
+ * framebuffer without any other javacall headers.
+ *
+ * Every javacall_lcd_flush* call records the rows it covers in
+ * dirtyTop and dirtyBottom, then increments sequence.  A reader that
+ * wants to wait for the next frame increments waiters, waits with
+ * FUTEX_WAIT (not the private variant) on sequence with the value it
+ * last saw, and decrements waiters again; the LCD only makes the
+ * FUTEX_WAKE call when waiters is non-zero.  The dirty rows are those
+ * of the latest flush, so a reader that sees sequence advance by more
+ * than one should take the union of all rows, or simply all of them.
+ * The pixels are not locked: a frame may be read while the next one is
+ * drawn.
+ *
+ * Since version 2 the mapping may hold several pages of maxHeight rows,
+ * pageSize bytes apart, when the LCD flips pages (lcd.buffers above 1).
+ * The VM then draws on a page that is not shown, and a presenter thread
+ * shows flushed pages at most refreshRate times a second: it sets front
+ * to the page shown before incrementing sequence, and the dirty rows are
+ * those changed since the previous page shown.  Flushes that arrive
+ * faster are merged into the next page shown.  The counters below the
+ * page fields stay zero with a single page.
+ */
+
+#define JAVACALL_LCD_SHM_MAGIC      0x44434c4a  /* "JLCD" little endian */
+#define JAVACALL_LCD_SHM_VERSION    2
+
+/* Pixel formats, as native 16 or 32-bit words */
+#define JAVACALL_LCD_SHM_RGB565     0
+#define JAVACALL_LCD_SHM_ARGB8888   1   /* 0xAARRGGBB */
+#define JAVACALL_LCD_SHM_RGBA8888   2   /* 0xRRGGBBAA */
+#define JAVACALL_LCD_SHM_ABGR8888   3   /* 0xAABBGGRR */
+
+/* Values of state */
+#define JAVACALL_LCD_SHM_ACTIVE     1
+#define JAVACALL_LCD_SHM_CLOSED     2   /* the LCD was finalized */
+
+typedef struct {
+    unsigned int magic;         /* JAVACALL_LCD_SHM_MAGIC */
+    unsigned int version;       /* JAVACALL_LCD_SHM_VERSION */
+    unsigned int pixelOffset;   /* offset of the first row from the header */
+    unsigned int stride;        /* bytes from one row to the next */
+    unsigned int width;         /* pixels per row */
+    unsigned int height;        /* rows on screen in the current mode */
+    unsigned int maxHeight;     /* rows in the mapping, for full screen */
+    unsigned int depth;         /* bits per pixel, 16 or 32 */
+    unsigned int format;        /* JAVACALL_LCD_SHM_* pixel format */
+    volatile unsigned int state;        /* JAVACALL_LCD_SHM_ACTIVE or CLOSED */
+    volatile unsigned int dirtyTop;     /* first row of the latest flush */
+    volatile unsigned int dirtyBottom;  /* row after its last row */
+    volatile unsigned int sequence;     /* number of flushes, futex word */
+    volatile unsigned int waiters;      /* readers waiting on sequence */
+    /* version 2 */
+    unsigned int pages;         /* pages in the mapping */
+    unsigned int pageSize;      /* bytes from one page to the next */
+    unsigned int refreshRate;   /* pages shown per second at most, 0 for any */
+    volatile unsigned int front;        /* page shown, 0 to pages - 1 */
+    volatile unsigned int coalesced;    /* flushes merged into a later one */
+    volatile unsigned int dropped;      /* refreshes missed with a page ready */
+    volatile unsigned int waits;        /* flushes that waited for a page */
+    volatile unsigned int latency;      /* microseconds from the oldest flush
+                                           in the page shown to showing it */
+    volatile unsigned int maxLatency;   /* largest latency so far */
+} javacall_lcd_shm_header;
+
+#endif  /* __JAVACALL_LCD_SHM_H */
@@ -0,0 +1,1031 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+/*
+ * Headless LCD for Linux.  The screen lives in a shared memory object,
+ * a memfd or a named POSIX shared memory object, laid out as described
+ * in javacall_lcd_shm.h.  Other processes map it to view, record or
+ * check the screen without copies, and wait on the frame sequence with
+ * a futex instead of polling.
+ *
+ * The screen size and depth come from the internal properties
+ * lcd.width, lcd.height, lcd.full_height and lcd.depth; lcd.shm.name
+ * names the shared memory object, which is a memfd when it is not set.
+ * When lcd.depth matches javacall_pixel the VM draws directly into the
+ * shared memory; RGB565 and ARGB8888 builds can also publish the other
+ * depth, converting the flushed rows.
+ *
+ * With lcd.buffers set to 2 or 3 the VM draws directly on one of as many
+ * pages in the shared memory, and a flush queues that page and hands out
+ * another instead of publishing it.  A presenter thread shows the queued
+ * page at most lcd.refresh_rate times a second.  Each page remembers the
+ * rows it lacks from newer frames; a page taken off the screen is brought
+ * up to date by the presenter, so the VM thread usually only swaps
+ * pointers.  With two pages a flush waits for the previous one to be
+ * shown; with three, a flush that comes before the queued page is shown
+ * replaces it.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "javacall_lcd.h"
+#include "javacall_logging.h"
+#include "javacall_memory.h"
+#include "javacall_properties.h"
+#include "javautil_pixel.h"
+#include "javacall_lcd_shm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC         0x0001U
+#define MFD_ALLOW_SEALING   0x0002U
+#endif
+
+#define LCD_DEFAULT_WIDTH   240
+#define LCD_DEFAULT_HEIGHT  320
+#define LCD_MAX_SIZE        4096
+#define LCD_MAX_PAGES       3
+#define LCD_DEFAULT_RATE    60
+
+/* the header, padded to cache lines */
+#define LCD_PIXEL_OFFSET    128
+
+#define LCD_NATIVE_DEPTH    ((int)sizeof(javacall_pixel) * 8)
+
+#if ENABLE_RGBA8888_PIXEL_FORMAT
+#define LCD_NATIVE_FORMAT   JAVACALL_LCD_SHM_RGBA8888
+#define LCD_ENCODING        JAVACALL_LCD_COLOR_RGBA
+#elif ENABLE_ABGR8888_PIXEL_FORMAT || ENABLE_DYNAMIC_PIXEL_FORMAT
+#define LCD_NATIVE_FORMAT   JAVACALL_LCD_SHM_ABGR8888
+#define LCD_ENCODING        JAVACALL_LCD_COLOR_OTHER
+#elif ENABLE_32BITS_PIXEL_FORMAT
+#define LCD_NATIVE_FORMAT   JAVACALL_LCD_SHM_ARGB8888
+#define LCD_ENCODING        JAVACALL_LCD_COLOR_ARGB
+#else
+#define LCD_NATIVE_FORMAT   JAVACALL_LCD_SHM_RGB565
+#define LCD_ENCODING        JAVACALL_LCD_COLOR_RGB565
+#endif
+
+/* depths the flushed rows can be converted to */
+#if LCD_NATIVE_FORMAT == JAVACALL_LCD_SHM_RGB565 || \
+    LCD_NATIVE_FORMAT == JAVACALL_LCD_SHM_ARGB8888
+#define LCD_CONVERTS
+#endif
+
+static struct {
+    javacall_lcd_shm_header* shm;
+    unsigned char*  pixels;     /* first row in the shared memory */
+    javacall_pixel* vram;       /* screen the VM draws on */
+    size_t          size;       /* bytes mapped */
+    int             fd;
+    int             width;
+    int             height;
+    int             full_height; /* screen height in full screen mode */
+    char            name[NAME_MAX + 1]; /* shm_open name, empty for a memfd */
+    int             depth;      /* bits per pixel of the shared memory */
+    size_t          stride;     /* bytes per row */
+    size_t          page_size;  /* bytes from one page to the next */
+    int             pages;
+} LCD;
+
+/*
+ * Page flipping state, guarded by lock.  Row ranges are top to bottom - 1
+ * and empty when top >= bottom.  Every page other than back has stale
+ * rows that differ from the newest frame, which is the queued page if
+ * there is one and the front page otherwise.
+ */
+static struct {
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  queue;      /* signalled when a page is queued or on quit */
+    pthread_cond_t  freed;      /* signalled when a page becomes free */
+    int             running;
+    int             quit;
+    int             back;       /* page the VM draws on */
+    int             queued;     /* page flushed and not shown yet, or -1 */
+    int             front;      /* page shown */
+    int             busy;       /* page the presenter is updating, or -1 */
+    int             stale_top[LCD_MAX_PAGES];
+    int             stale_bottom[LCD_MAX_PAGES];
+    int             dirty_top;  /* rows of the queued page changed since front */
+    int             dirty_bottom;
+    javacall_int64  queued_at;  /* time of the oldest flush in the queued page */
+    javacall_int64  shown_at;   /* time the front page was shown, 0 for never */
+    javacall_int64  period;     /* microseconds between refreshes, 0 for any */
+} FLIP;
+
+static javacall_bool isLCDActive = JAVACALL_FALSE;
+static javacall_bool inFullScreenMode;
+
+static int lcd_property(const char* key, int def, int min, int max) {
+    char* value = NULL;
+    int n;
+
+    if (javacall_get_property(key, JAVACALL_INTERNAL_PROPERTY,
+                              &value) != JAVACALL_OK || value == NULL) {
+        return def;
+    }
+    n = atoi(value);
+    return (n >= min && n <= max) ? n : def;
+}
+
+/*
+ * Create the shared memory object.  A memfd is sealed against resizing
+ * so a reader cannot truncate it under the VM.
+ */
+static int lcd_open(size_t size) {
+    int fd;
+
+    if (LCD.name[0] != '\0') {
+        fd = shm_open(LCD.name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    } else {
+#ifdef SYS_memfd_create
+        fd = (int)syscall(SYS_memfd_create, "javacall-lcd",
+                          MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+        fd = -1;
+#endif
+    }
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        if (LCD.name[0] != '\0') {
+            shm_unlink(LCD.name);
+        }
+        return -1;
+    }
+#ifdef F_ADD_SEALS
+    if (LCD.name[0] == '\0') {
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+    }
+#endif
+    return fd;
+}
+
+static void lcd_close(void) {
+    if (LCD.shm != NULL) {
+        munmap(LCD.shm, LCD.size);
+        LCD.shm = NULL;
+    }
+    if (LCD.fd >= 0) {
+        close(LCD.fd);
+        LCD.fd = -1;
+    }
+    if (LCD.name[0] != '\0') {
+        shm_unlink(LCD.name);
+    }
+    if (LCD.vram != NULL && LCD.depth != LCD_NATIVE_DEPTH) {
+        javacall_free(LCD.vram);
+    }
+    LCD.vram = NULL;
+    LCD.pixels = NULL;
+}
+
+/*
+ * Publish rows top to bottom - 1 as the next frame and wake the
+ * readers waiting for it.  The increment of sequence is a full barrier:
+ * the rows and dirty range are visible before the new sequence, and
+ * waiters is read after it, so a reader that registers too late for the
+ * wake sees the new sequence in FUTEX_WAIT instead.
+ */
+static void lcd_publish(int top, int bottom) {
+    javacall_lcd_shm_header* h = LCD.shm;
+
+#ifdef LCD_CONVERTS
+    if (LCD.depth != LCD_NATIVE_DEPTH && bottom > top) {
+        int first = top * LCD.width;
+        int count = (bottom - top) * LCD.width;
+#if LCD_NATIVE_FORMAT == JAVACALL_LCD_SHM_RGB565
+        javautil_pixel_rgb565_to_argb8888(LCD.vram + first, NULL,
+                                          (unsigned int*)LCD.pixels + first,
+                                          count);
+#else
+        javautil_pixel_argb8888_to_rgb565(LCD.vram + first,
+                                          (unsigned short*)LCD.pixels + first,
+                                          NULL, count);
+#endif
+    }
+#endif
+    h->dirtyTop = (unsigned int)top;
+    h->dirtyBottom = (unsigned int)bottom;
+    __sync_fetch_and_add(&h->sequence, 1);
+    if (h->waiters != 0) {
+        syscall(SYS_futex, &h->sequence, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+static javacall_int64 lcd_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (javacall_int64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static javacall_pixel* lcd_page(int page) {
+    return (javacall_pixel*)(LCD.pixels + page * LCD.page_size);
+}
+
+/* Add rows t to b - 1 to the row range *top to *bottom - 1 */
+static void lcd_add_rows(int* top, int* bottom, int t, int b) {
+    if (t >= b) {
+        return;
+    }
+    if (*top >= *bottom) {
+        *top = t;
+        *bottom = b;
+        return;
+    }
+    if (t < *top) {
+        *top = t;
+    }
+    if (b > *bottom) {
+        *bottom = b;
+    }
+}
+
+static void lcd_copy_rows(int dst, int src, int top, int bottom) {
+    if (bottom > top) {
+        memcpy((unsigned char*)lcd_page(dst) + top * LCD.stride,
+               (unsigned char*)lcd_page(src) + top * LCD.stride,
+               (bottom - top) * LCD.stride);
+    }
+}
+
+/*
+ * Show the queued page and bring the page it replaces up to date.  The
+ * copy runs unlocked: the page is marked busy so a flush does not take
+ * it, and the front page it copies from only changes here.  Called by
+ * the presenter with FLIP.lock held.
+ */
+static void lcd_present(void) {
+    javacall_lcd_shm_header* h = LCD.shm;
+    javacall_int64 now = lcd_now();
+    javacall_int64 due;
+    int old = FLIP.front;
+    int top = FLIP.stale_top[old];
+    int bottom = FLIP.stale_bottom[old];
+
+    /* refreshes that passed while a page was ready */
+    if (FLIP.period > 0 && FLIP.shown_at != 0) {
+        due = FLIP.shown_at + FLIP.period;
+        if (due < FLIP.queued_at) {
+            due = FLIP.queued_at;
+        }
+        if (now - due >= FLIP.period) {
+            h->dropped += (unsigned int)((now - due) / FLIP.period);
+        }
+    }
+    h->latency = (unsigned int)(now - FLIP.queued_at);
+    if (h->latency > h->maxLatency) {
+        h->maxLatency = h->latency;
+    }
+
+    FLIP.front = FLIP.queued;
+    FLIP.queued = -1;
+    FLIP.shown_at = now;
+    h->front = (unsigned int)FLIP.front;
+    lcd_publish(FLIP.dirty_top, FLIP.dirty_bottom);
+
+    FLIP.stale_top[old] = 0;
+    FLIP.stale_bottom[old] = 0;
+    if (bottom > top) {
+        FLIP.busy = old;
+        pthread_mutex_unlock(&FLIP.lock);
+        lcd_copy_rows(old, h->front, top, bottom);
+        pthread_mutex_lock(&FLIP.lock);
+        FLIP.busy = -1;
+    }
+    pthread_cond_broadcast(&FLIP.freed);
+}
+
+/*
+ * Presenter thread: show each queued page no sooner than a refresh
+ * period after the previous one.  On quit the queued page, if any, is
+ * shown at once.
+ */
+static void* lcd_presenter(void* arg) {
+    struct timespec ts;
+    javacall_int64 due;
+
+    (void)arg;
+    pthread_mutex_lock(&FLIP.lock);
+    for (;;) {
+        while (FLIP.queued < 0 && !FLIP.quit) {
+            pthread_cond_wait(&FLIP.queue, &FLIP.lock);
+        }
+        if (FLIP.queued < 0) {
+            break;
+        }
+        due = FLIP.shown_at + FLIP.period;
+        if (FLIP.period > 0 && FLIP.shown_at != 0 && !FLIP.quit &&
+            lcd_now() < due) {
+            /* a flush meanwhile only replaces the queued page */
+            pthread_mutex_unlock(&FLIP.lock);
+            ts.tv_sec = (time_t)(due / 1000000);
+            ts.tv_nsec = (long)(due % 1000000) * 1000;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                                   &ts, NULL) == EINTR) {
+            }
+            pthread_mutex_lock(&FLIP.lock);
+        }
+        lcd_present();
+    }
+    pthread_mutex_unlock(&FLIP.lock);
+    return NULL;
+}
+
+/*
+ * Queue the page the VM drew on, with rows top to bottom - 1 changed,
+ * and make a free page the screen, waiting for one if there is none.
+ * The free page is brought up to date from the page just queued.
+ */
+static void lcd_flip(int top, int bottom) {
+    javacall_lcd_shm_header* h = LCD.shm;
+    int newest = FLIP.back;
+    int waited = 0;
+    int page;
+    int t;
+    int b;
+
+    pthread_mutex_lock(&FLIP.lock);
+    for (page = 0; page < LCD.pages; page++) {
+        if (page != newest) {
+            lcd_add_rows(&FLIP.stale_top[page], &FLIP.stale_bottom[page],
+                         top, bottom);
+        }
+    }
+    if (FLIP.queued >= 0) {
+        /* the queued page was not shown, this one replaces it */
+        h->coalesced++;
+        lcd_add_rows(&FLIP.dirty_top, &FLIP.dirty_bottom, top, bottom);
+    } else {
+        FLIP.dirty_top = top;
+        FLIP.dirty_bottom = bottom;
+        FLIP.queued_at = lcd_now();
+    }
+    FLIP.queued = newest;
+    pthread_cond_signal(&FLIP.queue);
+
+    for (;;) {
+        for (page = 0; page < LCD.pages; page++) {
+            if (page != FLIP.front && page != FLIP.queued &&
+                page != FLIP.busy) {
+                break;
+            }
+        }
+        if (page < LCD.pages) {
+            break;
+        }
+        if (!waited) {
+            h->waits++;
+            waited = 1;
+        }
+        pthread_cond_wait(&FLIP.freed, &FLIP.lock);
+    }
+    t = FLIP.stale_top[page];
+    b = FLIP.stale_bottom[page];
+    FLIP.stale_top[page] = 0;
+    FLIP.stale_bottom[page] = 0;
+    FLIP.back = page;
+    pthread_mutex_unlock(&FLIP.lock);
+
+    /* newest stays queued or shown until the next flush */
+    lcd_copy_rows(page, newest, t, b);
+    LCD.vram = lcd_page(page);
+}
+
+/*
+ * Start the presenter with page 0 on the screen and the VM drawing on
+ * page 1.  Returns 0 if the thread cannot be started.
+ */
+static int lcd_start_presenter(int rate) {
+    memset(&FLIP, 0, sizeof(FLIP));
+    FLIP.front = 0;
+    FLIP.back = 1;
+    FLIP.queued = -1;
+    FLIP.busy = -1;
+    FLIP.period = rate > 0 ? 1000000 / rate : 0;
+    pthread_mutex_init(&FLIP.lock, NULL);
+    pthread_cond_init(&FLIP.queue, NULL);
+    pthread_cond_init(&FLIP.freed, NULL);
+    if (pthread_create(&FLIP.thread, NULL, lcd_presenter, NULL) != 0) {
+        pthread_cond_destroy(&FLIP.freed);
+        pthread_cond_destroy(&FLIP.queue);
+        pthread_mutex_destroy(&FLIP.lock);
+        return 0;
+    }
+    FLIP.running = 1;
+    return 1;
+}
+
+/* Stop the presenter once it has shown the queued page */
+static void lcd_stop_presenter(void) {
+    if (!FLIP.running) {
+        return;
+    }
+    pthread_mutex_lock(&FLIP.lock);
+    FLIP.quit = 1;
+    pthread_cond_signal(&FLIP.queue);
+    pthread_mutex_unlock(&FLIP.lock);
+    pthread_join(FLIP.thread, NULL);
+    pthread_cond_destroy(&FLIP.freed);
+    pthread_cond_destroy(&FLIP.queue);
+    pthread_mutex_destroy(&FLIP.lock);
+    FLIP.running = 0;
+}
+
+/* Show rows top to bottom - 1 as changed in the next frame */
+static void lcd_show(int top, int bottom) {
+    if (LCD.pages > 1) {
+        lcd_flip(top, bottom);
+    } else {
+        lcd_publish(top, bottom);
+    }
+}
+
+/**
+ * Initialize the LCD: read the screen properties, create and map the
+ * shared memory and fill in its header.
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_init(void) {
+    javacall_lcd_shm_header* h;
+    char* name = NULL;
+    char msg[NAME_MAX + 128];
+    int depth;
+    int stride;
+    int rate;
+
+    if (isLCDActive) {
+        return JAVACALL_OK;
+    }
+
+    LCD.width = lcd_property("lcd.width", LCD_DEFAULT_WIDTH,
+                             1, LCD_MAX_SIZE);
+    LCD.height = lcd_property("lcd.height", LCD_DEFAULT_HEIGHT,
+                              1, LCD_MAX_SIZE);
+    LCD.full_height = lcd_property("lcd.full_height", LCD.height,
+                                   LCD.height, LCD_MAX_SIZE);
+    depth = lcd_property("lcd.depth", LCD_NATIVE_DEPTH, 16, 32);
+#ifdef LCD_CONVERTS
+    if (depth != 16 && depth != 32) {
+        depth = LCD_NATIVE_DEPTH;
+    }
+#else
+    if (depth != LCD_NATIVE_DEPTH) {
+        javacall_print("lcd: lcd.depth is fixed by the pixel format\n");
+        depth = LCD_NATIVE_DEPTH;
+    }
+#endif
+    stride = LCD.width * (depth / 8);
+    LCD.depth = depth;
+    LCD.stride = (size_t)stride;
+    LCD.pages = lcd_property("lcd.buffers", 1, 1, LCD_MAX_PAGES);
+    if (LCD.pages > 1 && depth != LCD_NATIVE_DEPTH) {
+        javacall_print("lcd: lcd.buffers needs lcd.depth of the pixel format\n");
+        LCD.pages = 1;
+    }
+    rate = lcd_property("lcd.refresh_rate", LCD_DEFAULT_RATE, 0, 1000);
+
+    LCD.name[0] = '\0';
+    if (javacall_get_property("lcd.shm.name", JAVACALL_INTERNAL_PROPERTY,
+                              &name) == JAVACALL_OK && name != NULL) {
+        /* POSIX shared memory names are one component after a slash */
+        snprintf(LCD.name, sizeof(LCD.name), "%s%s",
+                 name[0] == '/' ? "" : "/", name);
+    }
+
+    /* pages start on cache lines */
+    LCD.page_size = ((size_t)stride * LCD.full_height + 63) & ~(size_t)63;
+    LCD.size = LCD_PIXEL_OFFSET + LCD.page_size * LCD.pages;
+    LCD.fd = lcd_open(LCD.size);
+    if (LCD.fd < 0) {
+        javacall_print("lcd: cannot create the shared memory framebuffer\n");
+        LCD.name[0] = '\0';
+        return JAVACALL_FAIL;
+    }
+    h = (javacall_lcd_shm_header*)mmap(NULL, LCD.size,
+                                       PROT_READ | PROT_WRITE, MAP_SHARED,
+                                       LCD.fd, 0);
+    if (h == (javacall_lcd_shm_header*)MAP_FAILED) {
+        LCD.shm = NULL;
+        lcd_close();
+        return JAVACALL_FAIL;
+    }
+    LCD.shm = h;
+    LCD.pixels = (unsigned char*)h + LCD_PIXEL_OFFSET;
+
+    if (depth == LCD_NATIVE_DEPTH) {
+        LCD.vram = (javacall_pixel*)LCD.pixels;
+    } else {
+        LCD.vram = (javacall_pixel*)javacall_malloc(
+            LCD.width * LCD.full_height * sizeof(javacall_pixel));
+        if (LCD.vram == NULL) {
+            lcd_close();
+            return JAVACALL_FAIL;
+        }
+        memset(LCD.vram, 0, LCD.width * LCD.full_height * sizeof(javacall_pixel));
+    }
+
+    h->version = JAVACALL_LCD_SHM_VERSION;
+    h->pixelOffset = LCD_PIXEL_OFFSET;
+    h->stride = (unsigned int)stride;
+    h->width = (unsigned int)LCD.width;
+    h->height = (unsigned int)LCD.height;
+    h->maxHeight = (unsigned int)LCD.full_height;
+    h->depth = (unsigned int)depth;
+#ifdef LCD_CONVERTS
+    h->format = depth == 16 ? JAVACALL_LCD_SHM_RGB565 : JAVACALL_LCD_SHM_ARGB8888;
+#else
+    h->format = LCD_NATIVE_FORMAT;
+#endif
+    h->pageSize = (unsigned int)LCD.page_size;
+    if (LCD.pages > 1 && !lcd_start_presenter(rate)) {
+        javacall_print("lcd: cannot start the presenter, using one page\n");
+        LCD.pages = 1;
+    }
+    if (LCD.pages > 1) {
+        h->refreshRate = (unsigned int)rate;
+        LCD.vram = lcd_page(FLIP.back);
+    }
+    h->pages = (unsigned int)LCD.pages;
+    h->state = JAVACALL_LCD_SHM_ACTIVE;
+    /* readers check the magic last */
+    __sync_synchronize();
+    h->magic = JAVACALL_LCD_SHM_MAGIC;
+
+    if (LCD.name[0] != '\0') {
+        sprintf(msg, "lcd: %dx%dx%d framebuffer at /dev/shm%s",
+                LCD.width, LCD.height, depth, LCD.name);
+    } else {
+        sprintf(msg, "lcd: %dx%dx%d framebuffer at /proc/%d/fd/%d",
+                LCD.width, LCD.height, depth, (int)getpid(), LCD.fd);
+    }
+    if (LCD.pages > 1) {
+        sprintf(msg + strlen(msg), ", %d pages at %d Hz", LCD.pages, rate);
+    }
+    strcat(msg, "\n");
+    javacall_print(msg);
+
+    inFullScreenMode = JAVACALL_FALSE;
+    isLCDActive = JAVACALL_TRUE;
+    return JAVACALL_OK;
+}
+
+/**
+ * Finalize the LCD.  A queued page is shown first, then readers are
+ * woken with the state set to JAVACALL_LCD_SHM_CLOSED; a memfd stays
+ * valid for readers that still map it, a named object is unlinked.
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_finalize(void) {
+    if (isLCDActive) {
+        lcd_stop_presenter();
+        LCD.shm->state = JAVACALL_LCD_SHM_CLOSED;
+        lcd_publish(0, 0);
+        lcd_close();
+        isLCDActive = JAVACALL_FALSE;
+    }
+    return JAVACALL_OK;
+}
+
+/**
+ * Get screen raster pointer
+ *
+ * @param hardwareId unique id of hardware screen
+ * @param screenWidth output parameter to hold width of screen
+ * @param screenHeight output parameter to hold height of screen
+ * @param colorEncoding output parameter to hold color encoding
+ *
+ * @return pointer to the screen of size screenWidth * screenHeight,
+ *         NULL before javacall_lcd_init; with several pages it changes
+ *         with every flush
+ */
+javacall_pixel* javacall_lcd_get_screen(int hardwareId,
+                                        int* screenWidth,
+                                        int* screenHeight,
+                                        javacall_lcd_color_encoding_type* colorEncoding) {
+    (void)hardwareId;
+    if (!isLCDActive) {
+        return NULL;
+    }
+    if (screenWidth != NULL) {
+        *screenWidth = LCD.width;
+    }
+    if (screenHeight != NULL) {
+        *screenHeight = inFullScreenMode ? LCD.full_height : LCD.height;
+    }
+    if (colorEncoding != NULL) {
+        *colorEncoding = LCD_ENCODING;
+    }
+    return LCD.vram;
+}
+
+/**
+ * Publish the whole screen as the next frame.  With several pages the
+ * screen moves to another page, see javacall_lcd_get_screen.
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_flush(int hardwareId) {
+    (void)hardwareId;
+    if (!isLCDActive) {
+        return JAVACALL_FAIL;
+    }
+    lcd_show(0, (int)LCD.shm->height);
+    return JAVACALL_OK;
+}
+
+/**
+ * Publish rows ystart to yend as the next frame; the rest of the
+ * screen is unchanged since the previous one.
+ *
+ * @param ystart first row to publish
+ * @param yend last row to publish
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_flush_partial(int hardwareId, int ystart, int yend) {
+    int height;
+
+    (void)hardwareId;
+    if (!isLCDActive) {
+        return JAVACALL_FAIL;
+    }
+    height = (int)LCD.shm->height;
+    if (ystart < 0) {
+        ystart = 0;
+    }
+    if (yend >= height) {
+        yend = height - 1;
+    }
+    if (ystart > yend) {
+        ystart = yend + 1;
+    }
+    lcd_show(ystart, yend + 1);
+    return JAVACALL_OK;
+}
+
+/*
+ * Clip a rectangle drawn at *x, *y to the screen.  Returns 0 if none of
+ * it is on the screen, otherwise the part on the screen and the number
+ * of columns and rows clipped on the left and at the top.
+ */
+static int lcd_clip(int* x, int* y, int* w, int* h, int* skipx, int* skipy) {
+    int height = (int)LCD.shm->height;
+    int x1 = *x + *w < LCD.width ? *x + *w : LCD.width;
+    int y1 = *y + *h < height ? *y + *h : height;
+
+    *skipx = *x < 0 ? -*x : 0;
+    *skipy = *y < 0 ? -*y : 0;
+    *x += *skipx;
+    *y += *skipy;
+    *w = x1 - *x;
+    *h = y1 - *y;
+    return *w > 0 && *h > 0;
+}
+
+/* Copy rows that may overlap, bottom up when moving them down */
+static void lcd_move_rows(javacall_pixel* dst, int dstStride,
+                          const javacall_pixel* src, int srcStride,
+                          int w, int h) {
+    int y;
+
+    if (dst > src) {
+        for (y = h - 1; y >= 0; y--) {
+            memmove(dst + y * dstStride, src + y * srcStride,
+                    w * sizeof(javacall_pixel));
+        }
+    } else {
+        for (y = 0; y < h; y++) {
+            memmove(dst + y * dstStride, src + y * srcStride,
+                    w * sizeof(javacall_pixel));
+        }
+    }
+}
+
+/**
+ * Fill pixels of the screen with a color.  Pixels past the end of the
+ * screen are ignored.
+ *
+ * @param offsetInVram offset in pixels from the top left pixel
+ * @param numberOfPixels number of pixels to fill
+ * @param color color to fill with
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_set_pixels(int offsetInVram, int numberOfPixels, 
+                                        javacall_pixel color) {
+    int end;
+
+    if (!isLCDActive || offsetInVram < 0 || numberOfPixels < 0) {
+        return JAVACALL_FAIL;
+    }
+    end = LCD.width * (int)LCD.shm->height;
+    if (numberOfPixels < end - offsetInVram) {
+        end = offsetInVram + numberOfPixels;
+    }
+    if (end > offsetInVram) {
+        if (sizeof(javacall_pixel) == 2) {
+            javautil_pixel_fill16((unsigned short*)LCD.vram + offsetInVram,
+                                  end - offsetInVram, (unsigned short)color);
+        } else {
+            javautil_pixel_fill32((unsigned int*)LCD.vram + offsetInVram,
+                                  end - offsetInVram, (unsigned int)color);
+        }
+    }
+    return JAVACALL_OK;
+}
+
+/**
+ * Copy an image to the screen, clipped to the screen.  The image may be
+ * part of the screen itself.
+ *
+ * @param destScreenPtr the screen, as returned by javacall_lcd_get_screen
+ * @param srcImage image of imageWidth * imageHeight pixels
+ * @param x x position on the screen to copy to
+ * @param y y position on the screen to copy to
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_bitblit(javacall_pixel* destScreenPtr, 
+                                     javacall_pixel* srcImage, 
+                                     int imageWidth, int imageHeight, 
+                                     int x, int y) {
+    int w = imageWidth;
+    int h = imageHeight;
+    int skipx, skipy;
+
+    if (!isLCDActive || destScreenPtr != LCD.vram || srcImage == NULL) {
+        return JAVACALL_FAIL;
+    }
+    if (lcd_clip(&x, &y, &w, &h, &skipx, &skipy)) {
+        lcd_move_rows(LCD.vram + y * LCD.width + x, LCD.width,
+                      srcImage + skipy * imageWidth + skipx, imageWidth,
+                      w, h);
+    }
+    return JAVACALL_OK;
+}
+
+/**
+ * Draw an image on the screen, clipped to the screen, converting it to
+ * the screen format and blending it if it has alpha.  Only RGB565 and
+ * ARGB8888 screens are supported.
+ *
+ * @param src top left pixel of the image
+ * @param srcStride distance between the rows of src in bytes
+ * @param format format of the image pixels
+ * @param x x position on the screen to draw at
+ * @param y y position on the screen to draw at
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail, or format not supported
+ */
+javacall_result javacall_lcd_blit(int hardwareId, const void* src, 
+                                  int srcStride, 
+                                  javacall_lcd_blit_format format,
+                                  int width, int height, int x, int y) {
+#ifdef LCD_CONVERTS
+    const unsigned char* s;
+    javacall_pixel* d;
+    int skipx, skipy, row;
+#if LCD_NATIVE_FORMAT == JAVACALL_LCD_SHM_ARGB8888
+    int i;
+#endif
+
+    (void)hardwareId;
+    if (!isLCDActive || src == NULL) {
+        return JAVACALL_FAIL;
+    }
+    if (format != JAVACALL_LCD_BLIT_RGB565 && 
+        format != JAVACALL_LCD_BLIT_XRGB8888 &&
+        format != JAVACALL_LCD_BLIT_ARGB8888) {
+        return JAVACALL_FAIL;
+    }
+    if (!lcd_clip(&x, &y, &width, &height, &skipx, &skipy)) {
+        return JAVACALL_OK;
+    }
+    for (row = 0; row < height; row++) {
+        s = (const unsigned char*)src + (skipy + row) * srcStride;
+        d = LCD.vram + (y + row) * LCD.width + x;
+#if LCD_NATIVE_FORMAT == JAVACALL_LCD_SHM_RGB565
+        if (format == JAVACALL_LCD_BLIT_RGB565) {
+            memcpy(d, s + 2 * skipx, 2 * width);
+        } else if (format == JAVACALL_LCD_BLIT_XRGB8888) {
+            javautil_pixel_argb8888_to_rgb565((const unsigned int*)s + skipx,
+                                              d, NULL, width);
+        } else {
+            javautil_pixel_blend_argb8888_to_rgb565(
+                (const unsigned int*)s + skipx, d, width);
+        }
+#else
+        if (format == JAVACALL_LCD_BLIT_RGB565) {
+            javautil_pixel_rgb565_to_argb8888((const unsigned short*)s + skipx,
+                                              NULL, d, width);
+        } else if (format == JAVACALL_LCD_BLIT_XRGB8888) {
+            for (i = 0; i < width; i++) {
+                d[i] = ((const unsigned int*)s)[skipx + i] | 0xff000000;
+            }
+        } else {
+            javautil_pixel_blend_argb8888_to_argb8888(
+                (const unsigned int*)s + skipx, d, width);
+        }
+#endif
+    }
+    return JAVACALL_OK;
+#else
+    (void)hardwareId;
+    (void)src;
+    (void)srcStride;
+    (void)format;
+    (void)width;
+    (void)height;
+    (void)x;
+    (void)y;
+    return JAVACALL_FAIL;
+#endif
+}
+
+/**
+ * Move an area of the screen, for example to scroll it.  Only the part
+ * of the area on the screen is moved, and only to where it is on the
+ * screen.
+ *
+ * @param x left side of the area
+ * @param y top side of the area
+ * @param dx horizontal distance to move the area by
+ * @param dy vertical distance to move the area by
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_copy_area(int hardwareId, int x, int y, 
+                                       int width, int height, 
+                                       int dx, int dy) {
+    int skipx, skipy;
+
+    (void)hardwareId;
+    if (!isLCDActive) {
+        return JAVACALL_FAIL;
+    }
+    /* the part of the area on the screen, then the part of that moved onto it */
+    if (lcd_clip(&x, &y, &width, &height, &skipx, &skipy)) {
+        x += dx;
+        y += dy;
+        if (lcd_clip(&x, &y, &width, &height, &skipx, &skipy)) {
+            lcd_move_rows(LCD.vram + y * LCD.width + x, LCD.width,
+                          LCD.vram + (y - dy) * LCD.width + x - dx, LCD.width,
+                          width, height);
+        }
+    }
+    return JAVACALL_OK;
+}
+
+/**
+ * Set or unset full screen mode.  The screen keeps its width and
+ * changes to lcd.full_height rows in full screen mode.
+ *
+ * @retval JAVACALL_OK   success
+ * @retval JAVACALL_FAIL failure
+ */
+javacall_result javacall_lcd_set_full_screen_mode(int hardwareId, javacall_bool useFullScreen) {
+    (void)hardwareId;
+    inFullScreenMode = useFullScreen;
+    if (isLCDActive) {
+        LCD.shm->height = (unsigned int)(useFullScreen ? LCD.full_height : LCD.height);
+    }
+    return JAVACALL_OK;
+}
+
+javacall_bool javacall_lcd_get_full_screen_mode(int hardwareId) {
+    (void)hardwareId;
+    return inFullScreenMode;
+}
+
+javacall_bool javacall_lcd_reverse_orientation(int hardwareId) {
+    (void)hardwareId;
+    return JAVACALL_FALSE;
+}
+
+void javacall_lcd_handle_clamshell() {
+    /* no clamshell */
+}
+
+javacall_bool javacall_lcd_get_reverse_orientation(int hardwareId) {
+    (void)hardwareId;
+    return JAVACALL_FALSE;
+}
+
+javacall_bool javacall_lcd_is_native_softbutton_layer_supported() {
+    return JAVACALL_FALSE;
+}
+
+javacall_result javacall_lcd_set_native_softbutton_label(const javacall_utf16* label,
+                                                         int len,
+                                                         int index) {
+    (void)label;
+    (void)len;
+    (void)index;
+    return JAVACALL_FAIL;
+}
+
+int javacall_lcd_get_screen_width(int hardwareId) {
+    (void)hardwareId;
+    return LCD.width;
+}
+
+int javacall_lcd_get_screen_height(int hardwareId) {
+    (void)hardwareId;
+    return inFullScreenMode ? LCD.full_height : LCD.height;
+}
+
+int javacall_lcd_get_current_hardwareId() {
+    return 0;
+}
+
+char* javacall_lcd_get_display_name(int hardwareId) {
+    (void)hardwareId;
+    return NULL;
+}
+
+javacall_bool javacall_lcd_is_display_primary(int hardwareId) {
+    (void)hardwareId;
+    return JAVACALL_TRUE;
+}
+
+javacall_bool javacall_lcd_is_display_buildin(int hardwareId) {
+    (void)hardwareId;
+    return JAVACALL_TRUE;
+}
+
+javacall_bool javacall_lcd_is_display_pen_supported(int hardwareId) {
+    (void)hardwareId;
+    return JAVACALL_TRUE;
+}
+
+javacall_bool javacall_lcd_is_display_pen_motion_supported(int hardwareId) {
+    (void)hardwareId;
+    return JAVACALL_TRUE;
+}
+
+int javacall_lcd_get_display_capabilities(int hardwareId) {
+    (void)hardwareId;
+    return 0;
+}
+
+int* javacall_lcd_get_display_device_ids(int* n) {
+    static int ids[1] = { 0 };
+    *n = 1;
+    return ids;
+}
+
+#ifdef __cplusplus
+} //extern "C"
+#endif
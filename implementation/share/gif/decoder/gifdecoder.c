@@ -0,0 +1,736 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+/**
+ * @file
+ *
+ * GIF decoder.  The header call scans the blocks of all frames, counting
+ * them and sizing the work buffers, which are then allocated once.  Each
+ * frame is decoded into a buffer of color indices and composited onto
+ * the canvas through palette tables in the output pixel format.
+ */
+
+#include <string.h>
+#include "javacall_defs.h"
+#include "javacall_memory.h"
+#include "gifdecoder.h"
+#include "giflzw.h"
+
+#define GIF_HEADER_SIZE     13      /* signature and logical screen */
+#define GIF_EXTENSION       0x21
+#define GIF_IMAGE           0x2C
+#define GIF_GRAPHIC_CONTROL 0xF9
+#define GIF_APPLICATION     0xFF
+
+#define DISPOSE_BACKGROUND  2
+#define DISPOSE_PREVIOUS    3
+
+#define GET16(p)    ((p)[0] | ((p)[1] << 8))
+
+#define ARGB_TO_565(p) \
+    ((unsigned short)((((p) >> 8) & 0xF800) | (((p) >> 5) & 0x07E0) | \
+                      (((p) >> 3) & 0x001F)))
+
+typedef struct {
+    const unsigned char *data;
+    long len;
+    int width;                      /* logical screen */
+    int height;
+    const unsigned char *global;    /* global color table, or NULL */
+    int globalSize;
+    unsigned int background;        /* ARGB of cleared pixels */
+    long firstBlock;
+
+    int frameCount;
+    int loopCount;
+    int hasAlpha;
+    int needBackup;                 /* some frame restores to previous */
+
+    /* work buffers, allocated once per image */
+    unsigned char *indices;
+    long indicesSize;
+    unsigned char *codes;
+    long codesSize;
+    unsigned char *backup;          /* canvas under the previous frame */
+    gif_lzw_state *lzw;
+
+    /* frame iterator */
+    long next;                      /* offset of the next frame's blocks */
+    int frameIndex;
+    int disposal;                   /* of the previous frame */
+    int x0, y0, x1, y1;             /* previous frame on the canvas */
+
+    const unsigned char *table;     /* color table of argb and rgb565 */
+    int tableSize;
+    unsigned int argb[256];
+    unsigned short rgb565[256];
+
+    int ready;
+} GIFDecoder;
+
+typedef struct {
+    unsigned char *pixels;
+    int pixelSize;                  /* 2, 3 or 4 */
+    unsigned char *alpha;           /* NULL if not wanted */
+} GIFCanvas;
+
+/* Offset after the data sub-blocks at pos, adding their sizes to bytes */
+static long skip_sub_blocks(const unsigned char *data, long len, 
+                            long pos, long *bytes) {
+    while (pos < len) {
+        int n = data[pos++];
+        if (n == 0) {
+            return pos;
+        }
+        pos += n;
+        if (bytes != NULL) {
+            *bytes += n;
+        }
+    }
+    return len;
+}
+
+/* Count the frames and find the largest frame and code data */
+static void scan_blocks(GIFDecoder *dec) {
+    const unsigned char *data = dec->data;
+    long len = dec->len;
+    long pos = dec->firstBlock;
+    long maxArea = 0;
+    long maxCodes = 0;
+
+    while (pos < len) {
+        int block = data[pos++];
+
+        if (block == GIF_EXTENSION) {
+            int label;
+            if (pos >= len) {
+                break;
+            }
+            label = data[pos++];
+            if (label == GIF_GRAPHIC_CONTROL && 
+                len - pos >= 5 && data[pos] == 4) {
+                if (((data[pos + 1] >> 2) & 7) == DISPOSE_PREVIOUS) {
+                    dec->needBackup = 1;
+                }
+                if (data[pos + 1] & 1) {
+                    dec->hasAlpha = 1;
+                }
+            } else if (label == GIF_APPLICATION && len - pos >= 16 &&
+                       data[pos] == 11 && 
+                       memcmp(data + pos + 1, "NETSCAPE2.0", 11) == 0 &&
+                       data[pos + 12] == 3 && data[pos + 13] == 1) {
+                dec->loopCount = GET16(data + pos + 14);
+            }
+            pos = skip_sub_blocks(data, len, pos, NULL);
+        } else if (block == GIF_IMAGE) {
+            int x, y, w, h, flags;
+            long codes = 0;
+
+            if (len - pos < 10) {
+                break;
+            }
+            x = GET16(data + pos);
+            y = GET16(data + pos + 2);
+            w = GET16(data + pos + 4);
+            h = GET16(data + pos + 6);
+            flags = data[pos + 8];
+            pos += 9;
+            if (flags & 0x80) {
+                pos += 3 << ((flags & 7) + 1);
+            }
+            if (pos >= len || (w != 0 && h > (0x7fffffff / 4) / w)) {
+                break;
+            }
+            /* LZW minimum code size, then the code data */
+            pos = skip_sub_blocks(data, len, pos + 1, &codes);
+
+            if (x != 0 || y != 0 || w < dec->width || h < dec->height) {
+                dec->hasAlpha = 1;
+            }
+            if ((long)w * h > maxArea) {
+                maxArea = (long)w * h;
+            }
+            if (codes > maxCodes) {
+                maxCodes = codes;
+            }
+            dec->frameCount++;
+        } else {
+            /* trailer, or data that is not a block */
+            break;
+        }
+    }
+    dec->indicesSize = maxArea;
+    dec->codesSize = maxCodes;
+}
+
+/* Make argb and rgb565 the tables of a frame's colors */
+static void set_table(GIFDecoder *dec, const unsigned char *table, int size) {
+    int n;
+
+    if (table == dec->table && size == dec->tableSize) {
+        return;
+    }
+    dec->table = table;
+    dec->tableSize = size;
+    for (n = 0; n < size; n++) {
+        dec->argb[n] = 0xff000000 | ((unsigned int)table[3 * n] << 16) |
+                       ((unsigned int)table[3 * n + 1] << 8) | 
+                       table[3 * n + 2];
+    }
+    /* indices past the table are taken as opaque black */
+    for (; n < 256; n++) {
+        dec->argb[n] = 0xff000000;
+    }
+    for (n = 0; n < 256; n++) {
+        dec->rgb565[n] = ARGB_TO_565(dec->argb[n]);
+    }
+}
+
+/* Clear a canvas rectangle to transparent background */
+static void clear_rect(const GIFDecoder *dec, const GIFCanvas *c,
+                       int x0, int y0, int x1, int y1) {
+    unsigned int bg = dec->background & 0xffffff;
+    int x, y;
+
+    for (y = y0; y < y1; y++) {
+        long off = (long)y * dec->width + x0;
+        unsigned char *p = c->pixels + off * c->pixelSize;
+
+        switch (c->pixelSize) {
+        case 2:
+            for (x = x0; x < x1; x++, p += 2) {
+                *(unsigned short *)p = ARGB_TO_565(bg);
+            }
+            break;
+        case 3:
+            for (x = x0; x < x1; x++, p += 3) {
+                p[0] = (unsigned char)(bg >> 16);
+                p[1] = (unsigned char)(bg >> 8);
+                p[2] = (unsigned char)bg;
+            }
+            break;
+        default:
+            for (x = x0; x < x1; x++, p += 4) {
+                *(unsigned int *)p = bg;
+            }
+            break;
+        }
+        if (c->alpha != NULL) {
+            memset(c->alpha + off, 0, x1 - x0);
+        }
+    }
+}
+
+/* Copy a canvas rectangle to the backup buffer, or back */
+static void backup_rect(const GIFDecoder *dec, const GIFCanvas *c,
+                        int restore) {
+    int rowBytes = (dec->x1 - dec->x0) * c->pixelSize;
+    int alphaBytes = c->alpha != NULL ? dec->x1 - dec->x0 : 0;
+    unsigned char *b = dec->backup;
+    int y;
+
+    for (y = dec->y0; y < dec->y1; y++) {
+        long off = (long)y * dec->width + dec->x0;
+        unsigned char *p = c->pixels + off * c->pixelSize;
+
+        if (restore) {
+            memcpy(p, b, rowBytes);
+            if (alphaBytes != 0) {
+                memcpy(c->alpha + off, b + rowBytes, alphaBytes);
+            }
+        } else {
+            memcpy(b, p, rowBytes);
+            if (alphaBytes != 0) {
+                memcpy(b + rowBytes, c->alpha + off, alphaBytes);
+            }
+        }
+        b += rowBytes + alphaBytes;
+    }
+}
+
+/* Draw count indices of a frame row; trans is -1 without transparency */
+static void draw_row(const GIFDecoder *dec, const GIFCanvas *c, long off,
+                     const unsigned char *row, int count, int trans) {
+    unsigned char *alpha = c->alpha != NULL ? c->alpha + off : NULL;
+    int i;
+
+    if (trans < 0) {
+        switch (c->pixelSize) {
+        case 2: {
+            unsigned short *o = (unsigned short *)c->pixels + off;
+            for (i = 0; i < count; i++) {
+                o[i] = dec->rgb565[row[i]];
+            }
+            break;
+        }
+        case 3: {
+            unsigned char *o = c->pixels + off * 3;
+            for (i = 0; i < count; i++, o += 3) {
+                unsigned int p = dec->argb[row[i]];
+                o[0] = (unsigned char)(p >> 16);
+                o[1] = (unsigned char)(p >> 8);
+                o[2] = (unsigned char)p;
+            }
+            break;
+        }
+        default: {
+            unsigned int *o = (unsigned int *)c->pixels + off;
+            for (i = 0; i < count; i++) {
+                o[i] = dec->argb[row[i]];
+            }
+            break;
+        }
+        }
+        if (alpha != NULL) {
+            memset(alpha, 0xff, count);
+        }
+        return;
+    }
+
+    /* transparent pixels leave the canvas as it is */
+    switch (c->pixelSize) {
+    case 2: {
+        unsigned short *o = (unsigned short *)c->pixels + off;
+        for (i = 0; i < count; i++) {
+            if (row[i] != trans) {
+                o[i] = dec->rgb565[row[i]];
+            }
+        }
+        break;
+    }
+    case 3: {
+        unsigned char *o = c->pixels + off * 3;
+        for (i = 0; i < count; i++, o += 3) {
+            if (row[i] != trans) {
+                unsigned int p = dec->argb[row[i]];
+                o[0] = (unsigned char)(p >> 16);
+                o[1] = (unsigned char)(p >> 8);
+                o[2] = (unsigned char)p;
+            }
+        }
+        break;
+    }
+    default: {
+        unsigned int *o = (unsigned int *)c->pixels + off;
+        for (i = 0; i < count; i++) {
+            if (row[i] != trans) {
+                o[i] = dec->argb[row[i]];
+            }
+        }
+        break;
+    }
+    }
+    if (alpha != NULL) {
+        for (i = 0; i < count; i++) {
+            if (row[i] != trans) {
+                alpha[i] = 0xff;
+            }
+        }
+    }
+}
+
+/* Image row of the r-th row stored in an interlaced frame of h rows */
+static int interlaced_row(int r, int h) {
+    int n = (h + 7) >> 3;           /* every 8th row from 0 */
+    if (r < n) {
+        return r << 3;
+    }
+    r -= n;
+    n = (h + 3) >> 3;               /* every 8th row from 4 */
+    if (r < n) {
+        return (r << 3) + 4;
+    }
+    r -= n;
+    n = (h + 1) >> 2;               /* every 4th row from 2 */
+    if (r < n) {
+        return (r << 2) + 2;
+    }
+    return ((r - n) << 1) + 1;      /* every 2nd row from 1 */
+}
+
+static int next_frame(GIFDecoder *dec, GIFCanvas *c, int *delay) {
+    const unsigned char *data = dec->data;
+    long len = dec->len;
+    long pos = dec->next;
+    int disposal = 0;
+    int trans = -1;
+    int delayCs = 0;
+    int fx, fy, fw, fh, flags, minCode;
+    long codeLen, count;
+    int r;
+
+    if (!dec->ready || dec->frameIndex >= dec->frameCount) {
+        return 0;
+    }
+
+    /* dispose of the previous frame, or start from a clear canvas */
+    if (dec->frameIndex == 0) {
+        clear_rect(dec, c, 0, 0, dec->width, dec->height);
+    } else if (dec->x0 < dec->x1 && dec->y0 < dec->y1) {
+        if (dec->disposal == DISPOSE_BACKGROUND) {
+            clear_rect(dec, c, dec->x0, dec->y0, dec->x1, dec->y1);
+        } else if (dec->disposal == DISPOSE_PREVIOUS) {
+            backup_rect(dec, c, 1);
+        }
+    }
+
+    /* extensions up to the image descriptor, as found by scan_blocks */
+    while (data[pos] == GIF_EXTENSION) {
+        if (data[pos + 1] == GIF_GRAPHIC_CONTROL && 
+            len - pos >= 7 && data[pos + 2] == 4) {
+            disposal = (data[pos + 3] >> 2) & 7;
+            delayCs = GET16(data + pos + 4);
+            if (data[pos + 3] & 1) {
+                trans = data[pos + 6];
+            }
+        }
+        pos = skip_sub_blocks(data, len, pos + 2, NULL);
+    }
+
+    fx = GET16(data + pos + 1);
+    fy = GET16(data + pos + 3);
+    fw = GET16(data + pos + 5);
+    fh = GET16(data + pos + 7);
+    flags = data[pos + 9];
+    pos += 10;
+    if (flags & 0x80) {
+        int size = 2 << (flags & 7);
+        set_table(dec, data + pos, size);
+        pos += 3 * size;
+    } else if (dec->global != NULL) {
+        set_table(dec, dec->global, dec->globalSize);
+    } else {
+        set_table(dec, data, 0);
+    }
+    minCode = data[pos++];
+
+    /* join the code data sub-blocks */
+    codeLen = 0;
+    while (pos < len) {
+        int n = data[pos++];
+        if (n == 0) {
+            break;
+        }
+        if (n > len - pos) {
+            n = (int)(len - pos);
+        }
+        memcpy(dec->codes + codeLen, data + pos, n);
+        codeLen += n;
+        pos += n;
+    }
+    count = 0;
+    if (minCode >= 1 && minCode <= 8) {
+        count = gif_lzw_decode(dec->lzw, minCode, dec->codes, codeLen,
+                               dec->indices, (long)fw * fh);
+    }
+
+    /* the part of the frame on the canvas */
+    dec->x0 = fx < dec->width ? fx : dec->width;
+    dec->y0 = fy < dec->height ? fy : dec->height;
+    dec->x1 = fx + fw < dec->width ? fx + fw : dec->width;
+    dec->y1 = fy + fh < dec->height ? fy + fh : dec->height;
+    dec->disposal = disposal;
+
+    if (disposal == DISPOSE_PREVIOUS && 
+        dec->x0 < dec->x1 && dec->y0 < dec->y1) {
+        if (dec->backup == NULL) {
+            dec->backup = (unsigned char *)javacall_malloc(
+                (long)dec->width * dec->height * 5);
+        }
+        if (dec->backup != NULL) {
+            backup_rect(dec, c, 0);
+        } else {
+            dec->disposal = 0;
+        }
+    }
+
+    for (r = 0; r < fh && (long)r * fw < count; r++) {
+        int y = fy + ((flags & 0x40) ? interlaced_row(r, fh) : r);
+        long rowEnd = count - (long)r * fw;
+        int x1 = rowEnd < fw ? fx + (int)rowEnd : fx + fw;
+
+        if (y >= dec->height) {
+            continue;
+        }
+        if (x1 > dec->x1) {
+            x1 = dec->x1;
+        }
+        if (dec->x0 < x1) {
+            draw_row(dec, c, (long)y * dec->width + dec->x0,
+                     dec->indices + (long)r * fw + (dec->x0 - fx),
+                     x1 - dec->x0, trans);
+        }
+    }
+
+    dec->next = pos;
+    dec->frameIndex++;
+    if (delay != NULL) {
+        *delay = delayCs * 10;
+    }
+    return dec->width * dec->height * c->pixelSize;
+}
+
+/* Decode the first frame and copy a rectangle of it */
+static int decode_rect(GIFDecoder *dec, 
+                       char *outData, 
+                       int outPixelSize,
+                       char *alphaData,
+                       int left, int top, int right, int bottom) {
+    GIFCanvas c;
+    int full;
+    int ok;
+    int y;
+
+    if (!dec->ready || outData == NULL ||
+        left < 0 || top < 0 || left >= right || top >= bottom ||
+        right > dec->width || bottom > dec->height) {
+        return 0;
+    }
+    full = left == 0 && top == 0 && 
+           right == dec->width && bottom == dec->height;
+
+    c.pixelSize = outPixelSize;
+    if (full) {
+        c.pixels = (unsigned char *)outData;
+        c.alpha = (unsigned char *)alphaData;
+    } else {
+        long size = (long)dec->width * dec->height;
+        c.pixels = (unsigned char *)javacall_malloc(size * (outPixelSize + 1));
+        if (c.pixels == NULL) {
+            return 0;
+        }
+        c.alpha = alphaData != NULL ? c.pixels + size * outPixelSize : NULL;
+    }
+
+    GIF_To_RGB_rewind(dec);
+    ok = next_frame(dec, &c, NULL);
+
+    if (!full) {
+        int rowBytes = (right - left) * outPixelSize;
+        for (y = top; ok && y < bottom; y++) {
+            long off = (long)y * dec->width + left;
+            memcpy(outData + (long)(y - top) * rowBytes, 
+                   c.pixels + off * outPixelSize, rowBytes);
+            if (alphaData != NULL) {
+                memcpy(alphaData + (long)(y - top) * (right - left),
+                       c.alpha + off, right - left);
+            }
+        }
+        javacall_free(c.pixels);
+    }
+    return ok ? (right - left) * (bottom - top) * outPixelSize : 0;
+}
+
+static void release_buffers(GIFDecoder *dec) {
+    if (dec->indices != NULL) {
+        javacall_free(dec->indices);
+    }
+    if (dec->codes != NULL) {
+        javacall_free(dec->codes);
+    }
+    if (dec->backup != NULL) {
+        javacall_free(dec->backup);
+    }
+}
+
+void *GIF_To_RGB_init(void) {
+    GIFDecoder *dec;
+
+    dec = (GIFDecoder *)javacall_malloc(sizeof(GIFDecoder));
+    if (dec == NULL) {
+        return NULL;
+    }
+    memset(dec, 0, sizeof(GIFDecoder));
+    dec->loopCount = -1;
+    dec->lzw = gif_lzw_create();
+    if (dec->lzw == NULL) {
+        javacall_free(dec);
+        return NULL;
+    }
+    return dec;
+}
+
+int GIF_To_RGB_decodeHeader(void *info, char *inData, int inDataLen, 
+                            int *width, int *height) {
+    GIFDecoder *dec = (GIFDecoder *)info;
+    gif_lzw_state *lzw = dec->lzw;
+    const unsigned char *data = (const unsigned char *)inData;
+    long pos = GIF_HEADER_SIZE;
+    int flags;
+
+    release_buffers(dec);
+    memset(dec, 0, sizeof(GIFDecoder));
+    dec->lzw = lzw;
+    dec->loopCount = -1;
+
+    if (data == NULL || inDataLen < GIF_HEADER_SIZE ||
+        (memcmp(data, "GIF87a", 6) != 0 && memcmp(data, "GIF89a", 6) != 0)) {
+        return 0;
+    }
+    dec->data = data;
+    dec->len = inDataLen;
+    dec->width = GET16(data + 6);
+    dec->height = GET16(data + 8);
+    flags = data[10];
+    if (dec->width == 0 || dec->height == 0 ||
+        dec->height > (0x7fffffff / 5) / dec->width) {
+        return 0;
+    }
+    if (flags & 0x80) {
+        dec->globalSize = 2 << (flags & 7);
+        if (inDataLen - pos < 3 * dec->globalSize) {
+            return 0;
+        }
+        dec->global = data + pos;
+        if (data[11] < dec->globalSize) {
+            const unsigned char *bg = dec->global + 3 * data[11];
+            dec->background = ((unsigned int)bg[0] << 16) | 
+                              ((unsigned int)bg[1] << 8) | bg[2];
+        }
+        pos += 3 * dec->globalSize;
+    }
+    dec->firstBlock = pos;
+
+    scan_blocks(dec);
+    if (dec->frameCount == 0) {
+        return 0;
+    }
+    dec->indices = (unsigned char *)javacall_malloc(
+        dec->indicesSize + GIF_LZW_SLACK);
+    dec->codes = (unsigned char *)javacall_malloc(dec->codesSize + 1);
+    if (dec->indices == NULL || dec->codes == NULL) {
+        return 0;
+    }
+
+    dec->ready = 1;
+    GIF_To_RGB_rewind(dec);
+    *width = dec->width;
+    *height = dec->height;
+    return 1;
+}
+
+int GIF_To_RGB_getFrameCount(void *info) {
+    GIFDecoder *dec = (GIFDecoder *)info;
+    return dec->ready ? dec->frameCount : 0;
+}
+
+int GIF_To_RGB_getLoopCount(void *info) {
+    return ((GIFDecoder *)info)->loopCount;
+}
+
+int GIF_To_RGB_hasAlpha(void *info) {
+    GIFDecoder *dec = (GIFDecoder *)info;
+    return dec->ready && dec->hasAlpha;
+}
+
+int GIF_To_RGB_decodeData(void *info, char *outData) {
+    GIFDecoder *dec = (GIFDecoder *)info;
+    return decode_rect(dec, outData, 3, NULL, 
+                       0, 0, dec->width, dec->height);
+}
+
+int GIF_To_RGB_decodeData2(void *info, char *outData, int outPixelSize,
+                           int left, int top, int right, int bottom) {
+    return GIF_To_RGB_decodeDataAlpha(info, outData, outPixelSize, NULL,
+                                      left, top, right, bottom);
+}
+
+int GIF_To_RGB_decodeDataAlpha(void *info, char *outData, int outPixelSize,
+                               char *alphaData,
+                               int left, int top, int right, int bottom) {
+    if (outPixelSize != 2 && outPixelSize != 4) {
+        return 0;
+    }
+    return decode_rect((GIFDecoder *)info, outData, outPixelSize, alphaData,
+                       left, top, right, bottom);
+}
+
+int GIF_To_RGB_nextFrame(void *info, char *canvas, int outPixelSize,
+                         char *alphaCanvas, int *delay) {
+    GIFCanvas c;
+
+    if (canvas == NULL || (outPixelSize != 2 && outPixelSize != 4)) {
+        return 0;
+    }
+    c.pixels = (unsigned char *)canvas;
+    c.pixelSize = outPixelSize;
+    c.alpha = (unsigned char *)alphaCanvas;
+    return next_frame((GIFDecoder *)info, &c, delay);
+}
+
+void GIF_To_RGB_rewind(void *info) {
+    GIFDecoder *dec = (GIFDecoder *)info;
+    dec->next = dec->firstBlock;
+    dec->frameIndex = 0;
+    dec->disposal = 0;
+}
+
+char *GIF_To_RGB_decode(void *info, char *inData, int inDataLen,
+                        int *width, int *height) {
+    char *outData;
+
+    if (GIF_To_RGB_decodeHeader(info, inData, inDataLen, width, height) == 0) {
+        return NULL;
+    }
+    outData = (char *)javacall_malloc((*width) * (*height) * 3);
+    if (outData != NULL && GIF_To_RGB_decodeData(info, outData) == 0) {
+        javacall_free(outData);
+        outData = NULL;
+    }
+    return outData;
+}
+
+char *GIF_To_RGB_decode2(void *info, 
+                         char *inData, int inDataLen, int outPixelSize,
+                         int left, int top, int right, int bottom, 
+                         int *width, int *height) {
+    char *outData;
+
+    if (outPixelSize != 2 && outPixelSize != 4) {
+        return NULL;
+    }
+    if (GIF_To_RGB_decodeHeader(info, inData, inDataLen, width, height) == 0) {
+        return NULL;
+    }
+    outData = (char *)javacall_malloc((*width) * (*height) * outPixelSize);
+    if (outData != NULL && 
+        GIF_To_RGB_decodeData2(info, outData, outPixelSize,
+                               left, top, right, bottom) == 0) {
+        javacall_free(outData);
+        outData = NULL;
+    }
+    return outData;
+}
+
+void GIF_To_RGB_free(void *info) {
+    GIFDecoder *dec = (GIFDecoder *)info;
+
+    if (dec == NULL) {
+        return;
+    }
+    release_buffers(dec);
+    gif_lzw_destroy(dec->lzw);
+    javacall_free(dec);
+}
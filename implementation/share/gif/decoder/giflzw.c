@@ -0,0 +1,180 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#include <string.h>
+#include "javacall_defs.h"
+#include "javacall_memory.h"
+#include "giflzw.h"
+
+/* LZW decompressor ********************************************************
+ *
+ * Every string in the table is the previous string plus one byte, and
+ * its bytes are already in the output where it was last written.  A
+ * table entry is therefore just the output offset and length of that
+ * copy, and a code expands with one block copy instead of walking a
+ * chain of prefix links back to front.
+ */
+
+#define MAX_CODE_BITS   12
+#define MAX_CODES       (1 << MAX_CODE_BITS)
+
+struct _gif_lzw_state {
+    long offset[MAX_CODES];             /* output offset of the string */
+    unsigned short length[MAX_CODES];   /* string length */
+};
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || \
+    defined(_M_X64) || (defined(__BYTE_ORDER__) && \
+                        __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+static javacall_uint64 load64(const unsigned char *p) {
+    javacall_uint64 v;
+    memcpy(&v, p, 8);
+    return v;
+}
+#else
+static javacall_uint64 load64(const unsigned char *p) {
+    return (javacall_uint64)p[0] | ((javacall_uint64)p[1] << 8) |
+           ((javacall_uint64)p[2] << 16) | ((javacall_uint64)p[3] << 24) |
+           ((javacall_uint64)p[4] << 32) | ((javacall_uint64)p[5] << 40) |
+           ((javacall_uint64)p[6] << 48) | ((javacall_uint64)p[7] << 56);
+}
+#endif
+
+/*
+ * Copy len bytes of an earlier string.  The source ends at or before
+ * dst, so 8 byte blocks may run past len into the slack.
+ */
+static void copy_string(unsigned char *dst, 
+                        const unsigned char *src, 
+                        long len) {
+    javacall_uint64 v;
+
+    do {
+        memcpy(&v, src, 8);
+        memcpy(dst, &v, 8);
+        dst += 8;
+        src += 8;
+        len -= 8;
+    } while (len > 0);
+}
+
+gif_lzw_state *gif_lzw_create(void) {
+    return (gif_lzw_state *)javacall_malloc(sizeof(gif_lzw_state));
+}
+
+long gif_lzw_decode(gif_lzw_state *s,
+                    int minCodeSize,
+                    const unsigned char *in, 
+                    long inLen,
+                    unsigned char *out, 
+                    long outLen) {
+    const unsigned char *end = in + inLen;
+    const unsigned int clear = 1u << minCodeSize;
+    const unsigned int eoi = clear + 1;
+    javacall_uint64 bb = 0;
+    unsigned int count = 0;
+    unsigned int codeSize = minCodeSize + 1;
+    unsigned int next = clear + 2;
+    long prevOff = -1;          /* no previous string after a clear */
+    long prevLen = 0;
+    long pos = 0;
+
+    while (pos < outLen) {
+        unsigned int code;
+        long len;
+
+        if (count < codeSize) {
+            if (end - in >= 8) {
+                bb |= load64(in) << count;
+                in += (63 - count) >> 3;
+                count |= 56;
+            } else {
+                while (count <= 56 && in < end) {
+                    bb |= (javacall_uint64)*in++ << count;
+                    count += 8;
+                }
+                if (count < codeSize) {
+                    break;
+                }
+            }
+        }
+        code = (unsigned int)bb & ((1u << codeSize) - 1);
+        bb >>= codeSize;
+        count -= codeSize;
+
+        if (code == clear) {
+            codeSize = minCodeSize + 1;
+            next = clear + 2;
+            prevOff = -1;
+            continue;
+        }
+        if (code == eoi) {
+            break;
+        }
+
+        if (code < clear) {
+            out[pos] = (unsigned char)code;
+            len = 1;
+        } else if (code < next && prevOff >= 0) {
+            len = s->length[code];
+            if (len > outLen - pos) {
+                len = outLen - pos;
+            }
+            copy_string(out + pos, out + s->offset[code], len);
+        } else if (code == next && prevOff >= 0) {
+            /* the string being defined: previous one plus its first byte */
+            len = prevLen + 1;
+            if (len > outLen - pos) {
+                len = outLen - pos;
+                copy_string(out + pos, out + prevOff, len);
+            } else {
+                copy_string(out + pos, out + prevOff, prevLen);
+                out[pos + prevLen] = out[prevOff];
+            }
+        } else {
+            break;
+        }
+
+        /* the new string is the previous one plus the first byte here */
+        if (prevOff >= 0 && next < MAX_CODES) {
+            s->offset[next] = prevOff;
+            s->length[next] = (unsigned short)(prevLen + 1);
+            next++;
+            if (next == (1u << codeSize) && codeSize < MAX_CODE_BITS) {
+                codeSize++;
+            }
+        }
+        prevOff = pos;
+        prevLen = len;
+        pos += len;
+    }
+    return pos;
+}
+
+void gif_lzw_destroy(gif_lzw_state *s) {
+    if (s != NULL) {
+        javacall_free(s);
+    }
+}
@@ -0,0 +1,227 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#ifndef __JAVAUTIL_MEDIA_GIF_DECODER_H
+#define __JAVAUTIL_MEDIA_GIF_DECODER_H
+
+/*
+ * GIF decoder with the interface of the JPEG decoder (jpegdecoder.h),
+ * plus a frame iterator for animations.
+ * Frames are composited onto a canvas the size of the logical screen
+ * that starts out transparent.  Before a frame is drawn the previous
+ * one is disposed of as it asks: left in place, cleared to transparent
+ * or restored to the canvas under it.  Cleared pixels keep the color of
+ * the background index in their color bits, for users without alpha.
+ * Output pixels are 24-bit RGB bytes, 16-bit RGB565 (truncated, as the
+ * JPEG decoder does) or 32-bit 0xAARRGGBB; alpha is either kept in the
+ * 32-bit pixels or written to a separate buffer.
+ */
+
+/**
+ * Allocate a decoder
+ * 
+ * @return Decoder handle, NULL if out of memory
+ */
+void *GIF_To_RGB_init(void);
+
+/**
+ * Decodes a gif header and scans the blocks of all frames,
+ * fills all internal fields related to input image.
+ * inData is used by the later decode calls and must stay valid
+ * until then.
+ *
+ * @param info handle returned from GIF_To_RGB_init
+ * @param inData GIF data
+ * @param inDataLen length of inData
+ * @param width pointer where to store the logical screen width
+ * @param height pointer where to store the logical screen height
+ *
+ * @return non-zero on success, zero on failure
+ */
+int GIF_To_RGB_decodeHeader(void *info, char *inData, int inDataLen, 
+                            int *width, int *height);
+
+/**
+ * Number of frames of the image decoded by GIF_To_RGB_decodeHeader
+ *
+ * @param info handle returned from GIF_To_RGB_init
+ *
+ * @return number of frames, 0 if no header was decoded
+ */
+int GIF_To_RGB_getFrameCount(void *info);
+
+/**
+ * Number of times an animation is to be repeated
+ *
+ * @param info handle returned from GIF_To_RGB_init
+ *
+ * @return loop count of the NETSCAPE2.0 extension, 0 to loop forever, 
+ *         -1 if the image has none and is shown once
+ */
+int GIF_To_RGB_getLoopCount(void *info);
+
+/**
+ * Tells whether the image decoded by GIF_To_RGB_decodeHeader
+ * may have pixels that are not opaque: frames with a transparent
+ * color or that do not cover the canvas
+ *
+ * @param info handle returned from GIF_To_RGB_init
+ *
+ * @return non-zero if pixels may be other than opaque
+ */
+int GIF_To_RGB_hasAlpha(void *info);
+
+/**
+ * Decodes the first frame of a gif to the provided buffer.
+ * Assumes that GIF_To_RGB_decodeHeader() has been called before,
+ * and outData contains buffer of a valid size.
+ *
+ * @param info handle returned from GIF_To_RGB_init
+ * @param outData 24 bit RGB image
+ *
+ * @return size of filled outData bytes, 0 when failed
+ */
+int GIF_To_RGB_decodeData(void *info, char *outData);
+
+/**
+ * Decodes the first frame of a gif to the provided buffer.
+ * Assumes that GIF_To_RGB_decodeHeader() has been called before,
+ * and outData contains buffer of a valid size.
+ *
+ * @param info handle returned from GIF_To_RGB_init
+ * @param outData short 16 (5,6,5) or 32 bit ARGB image, 
+ *        (right - left) pixels per row
+ * @param outPixelSize the desired pixel size in bytes, 2 or 4
+ * @param left -
+ * @param top -
+ * @param right -
+ * @param bottom - rectangle in the decoded image that will be copied 
+ *        to outData
+ *
+ * @return size of filled outData bytes, 0 when failed
+ */
+int GIF_To_RGB_decodeData2(void *info, char *outData, int outPixelSize,
+                           int left, int top, int right, int bottom);
+
+/**
+ * Decodes the first frame of a gif to the provided buffers, with the
+ * alpha of each pixel stored separately.  Same as
+ * GIF_To_RGB_decodeData2 otherwise.
+ *
+ * @param info handle returned from GIF_To_RGB_init
+ * @param outData short 16 (5,6,5) or 32 bit ARGB image, 
+ *        (right - left) pixels per row
+ * @param outPixelSize the desired pixel size in bytes, 2 or 4
+ * @param alphaData one alpha byte per pixel of outData, 
+ *        0 for transparent or 0xFF for opaque; NULL if not needed
+ * @param left -
+ * @param top -
+ * @param right -
+ * @param bottom - rectangle in the decoded image that will be copied 
+ *        to outData
+ *
+ * @return size of filled outData bytes, 0 when failed
+ */
+int GIF_To_RGB_decodeDataAlpha(void *info, char *outData, int outPixelSize,
+                               char *alphaData,
+                               int left, int top, int right, int bottom);
+
+/**
+ * Composites the next frame of an animation onto the canvas.
+ * The canvas is the caller's: canvas and alphaCanvas must be the same
+ * buffers, with the same contents, as in the previous call, which
+ * leaves the previous frame in them.  The first call after
+ * GIF_To_RGB_decodeHeader or GIF_To_RGB_rewind clears the canvas and
+ * draws the first frame.  No memory is allocated per frame.
+ *
+ * @param info handle returned from GIF_To_RGB_init
+ * @param canvas image of the logical screen size, 
+ *        pixels as for GIF_To_RGB_decodeDataAlpha
+ * @param outPixelSize the pixel size in bytes of canvas, 2 or 4
+ * @param alphaCanvas one alpha byte per pixel of canvas, 
+ *        NULL if not needed
+ * @param delay pointer where to store how long the frame is shown,
+ *        in milliseconds; may be NULL
+ *
+ * @return size of canvas bytes, 0 after the last frame or when failed
+ */
+int GIF_To_RGB_nextFrame(void *info, char *canvas, int outPixelSize,
+                         char *alphaCanvas, int *delay);
+
+/**
+ * Restart the frame iterator at the first frame
+ *
+ * @param info handle returned from GIF_To_RGB_init
+ */
+void GIF_To_RGB_rewind(void *info);
+
+/**
+ * Decodes the first frame of a gif into a new buffer, to be released 
+ * with javacall_free.
+ *
+ * @param info handle returned from GIF_To_RGB_init
+ * @param inData GIF data
+ * @param inDataLen length of inData
+ * @param width pointer where to store decoded image width
+ * @param height pointer where to store decoded image height
+ *
+ * @return allocated 24 bit RGB image buffer 
+ *         when successful, NULL when failed
+ */
+char *GIF_To_RGB_decode(void *info, char *inData, int inDataLen,
+                        int *width, int *height);
+
+/**
+ * Decodes the first frame of a gif into a new buffer, to be released 
+ * with javacall_free.
+ *
+ * @param info handle returned from GIF_To_RGB_init
+ * @param inData GIF data
+ * @param inDataLen length of inData
+ * @param outPixelSize the desired pixel size in bytes, 2 or 4
+ * @param left -
+ * @param top -
+ * @param right -
+ * @param bottom - rectangle in the decoded image that will be copied 
+ *        to the buffer
+ * @param width pointer where to store decoded image width
+ * @param height pointer where to store decoded image height
+ *
+ * @return allocated short 16 (5,6,5) or 32 bit ARGB image buffer 
+ *         when successful, NULL when failed
+ */
+char *GIF_To_RGB_decode2(void *info, 
+                         char *inData, int inDataLen, int outPixelSize,
+                         int left, int top, int right, int bottom, 
+                         int *width, int *height);
+
+/**
+ * Release a decoder
+ *
+ * @param info handle returned from GIF_To_RGB_init
+ */
+void GIF_To_RGB_free(void *info);
+
+#endif  /* __JAVAUTIL_MEDIA_GIF_DECODER_H */
@@ -0,0 +1,76 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#ifndef __JAVAUTIL_MEDIA_GIF_LZW_H
+#define __JAVAUTIL_MEDIA_GIF_LZW_H
+
+/*
+ * LZW decompressor for GIF image data.  A whole frame is decoded in one
+ * call from its code bytes, with the data sub-block length bytes already
+ * removed, into a buffer of color indices.
+ */
+
+/* Bytes past the end of the output that the decompressor may write */
+#define GIF_LZW_SLACK   8
+
+typedef struct _gif_lzw_state gif_lzw_state;
+
+/**
+ * Allocate decompressor state
+ * 
+ * @return New decompressor, or NULL if out of memory
+ */
+gif_lzw_state *gif_lzw_create(void);
+
+/**
+ * Decompress one frame.  Decompression stops at the end of information
+ * code, at the end of input, when the output is full or at an invalid
+ * code; the indices decoded until then are kept.
+ * 
+ * @param s             Decompressor
+ * @param minCodeSize   LZW minimum code size of the frame, 2 to 8
+ * @param in            Code bytes
+ * @param inLen         Number of bytes in in
+ * @param out           Output indices, with GIF_LZW_SLACK writable bytes
+ *                      after outLen
+ * @param outLen        Number of indices wanted
+ * 
+ * @return Number of indices decoded
+ */
+long gif_lzw_decode(gif_lzw_state *s,
+                    int minCodeSize,
+                    const unsigned char *in, 
+                    long inLen,
+                    unsigned char *out, 
+                    long outLen);
+
+/**
+ * Release decompressor state
+ * 
+ * @param s         Decompressor, may be NULL
+ */
+void gif_lzw_destroy(gif_lzw_state *s);
+
+#endif  /* __JAVAUTIL_MEDIA_GIF_LZW_H */
@@ -0,0 +1,98 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#ifndef __JAVAUTIL_IMAGE_H
+#define __JAVAUTIL_IMAGE_H
+
+/*
+ * Implementation of the javacall_image_* decoder API over the native
+ * JPEG, PNG and GIF decoders, for the platforms to forward to.  The
+ * formats are those whose decoders are built in: ENABLE_JPEG_DECODER,
+ * ENABLE_PNG_DECODER and ENABLE_GIF_DECODER.  With ENABLE_IMAGE_CACHE
+ * decoded images are kept in javautil_image_cache and repeated decodes
+ * of the same bytes are served from it.
+ */
+
+#include "javacall_image.h"
+
+/* Source modes of javautil_image_decode_start */
+#define JAVAUTIL_IMAGE_COPY_SOURCE      0   /* decode from a private copy */
+#define JAVAUTIL_IMAGE_BORROW_SOURCE    1   /* decode from the caller's buffer */
+
+/**
+ * Get image information
+ * 
+ * @param source        Pointer to image data source
+ * @param sourceSize    Size of source in bytes
+ * @param imageInfo     Pointer to javacall_image_info type buffer
+ * 
+ * @return JAVACALL_OK if the format is supported, JAVACALL_FAIL otherwise
+ */
+javacall_result javautil_image_get_info(const void *source, 
+                                        long sourceSize,
+                                        javacall_image_info *imageInfo);
+
+/**
+ * Start decoding an image.  With JAVAUTIL_IMAGE_BORROW_SOURCE the
+ * source is not copied and the caller keeps it unchanged until 
+ * javautil_image_decode_finish, as synchronous decoding does.
+ * 
+ * @param source        Pointer to image data source
+ * @param sourceSize    Size of source in bytes
+ * @param width         Width of the image
+ * @param height        Height of the image
+ * @param mode          JAVAUTIL_IMAGE_COPY_SOURCE or 
+ *                      JAVAUTIL_IMAGE_BORROW_SOURCE
+ * @param handle        Where to store the handle of the decoding
+ * 
+ * @return JAVACALL_OK on success, JAVACALL_FAIL if out of memory
+ */
+javacall_result javautil_image_decode_start(const void *source,
+                                            long sourceSize,
+                                            long width,
+                                            long height,
+                                            int mode,
+                                            javacall_handle *handle);
+
+/**
+ * Decode the image and release the handle, also when decoding fails.
+ * The alpha buffer is written in bulk: by the decoder for formats with
+ * alpha, otherwise set to opaque.
+ * 
+ * @param handle        Handle from javautil_image_decode_start
+ * @param decodeBuf     Pointer to decoding target buffer
+ * @param decodeBufSize Size of decodeBuf in bytes
+ * @param alphaBuf      Pointer to alpha data buffer, may be NULL
+ * @param alphaBufSize  Size of alphaBuf in bytes
+ * 
+ * @return JAVACALL_OK on success, JAVACALL_FAIL otherwise
+ */
+javacall_result javautil_image_decode_finish(javacall_handle handle,
+                                             javacall_pixel *decodeBuf,
+                                             long decodeBufSize,
+                                             char *alphaBuf,
+                                             long alphaBufSize);
+
+#endif  /* __JAVAUTIL_IMAGE_H */
@@ -0,0 +1,369 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+/**
+ * @file
+ *
+ * Image decoding shared by the javacall_image_* implementations.  The
+ * format is recognized from the first bytes and the image is decoded
+ * straight into the caller's pixel and alpha buffers.
+ */
+
+#include <string.h>
+#include "javacall_defs.h"
+#include "javacall_memory.h"
+#include "javautil_image.h"
+#ifdef ENABLE_JPEG_DECODER
+#include "jpegdecoder.h"
+#endif
+#ifdef ENABLE_PNG_DECODER
+#include "pngdecoder.h"
+#endif
+#ifdef ENABLE_GIF_DECODER
+#include "gifdecoder.h"
+#endif
+#ifdef ENABLE_IMAGE_CACHE
+#include "javautil_image_cache.h"
+#endif
+
+#define FORMAT_UNKNOWN  0
+#define FORMAT_JPEG     1
+#define FORMAT_PNG      2
+#define FORMAT_GIF      3
+
+/* PNG signature and the IHDR chunk header that must follow it */
+static const unsigned char png_header[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a,
+    0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52
+};
+
+/* JPEG SOI and APP0 markers */
+static const unsigned char jpeg_header[] = {
+    0xff, 0xd8, 0xff, 0xe0
+};
+
+/* "GIF8", the start of both GIF87a and GIF89a */
+static const unsigned char gif_header[] = {
+    0x47, 0x49, 0x46, 0x38
+};
+
+typedef struct {
+    const unsigned char *source;    /* encoded image */
+    long sourceSize;
+    long width;
+    long height;
+    int format;
+#ifdef ENABLE_IMAGE_CACHE
+    javautil_image_cache_key cacheKey;
+    /* decoded image found in the cache, NULL to decode source */
+    const javautil_image_cache_entry *cached;
+#endif
+} image_decode;
+
+#define HEADER_MATCH(header, data, size) \
+    ((size) >= (long)sizeof(header) && \
+     memcmp((data), (header), sizeof(header)) == 0)
+
+static int image_format(const unsigned char *data, long size) {
+    if (HEADER_MATCH(png_header, data, size)) {
+        return FORMAT_PNG;
+    }
+    if (HEADER_MATCH(jpeg_header, data, size)) {
+        return FORMAT_JPEG;
+    }
+    if (HEADER_MATCH(gif_header, data, size)) {
+        return FORMAT_GIF;
+    }
+    return FORMAT_UNKNOWN;
+}
+
+#ifdef ENABLE_PNG_DECODER
+#define GET32(p) \
+    (((long)(p)[0] << 24) | ((long)(p)[1] << 16) | ((p)[2] << 8) | (p)[3])
+
+static javacall_result png_info(const unsigned char *source, long sourceSize,
+                                javacall_image_info *imageInfo) {
+    long pos = 33;      /* after the IHDR chunk */
+
+    if (sourceSize < pos) {
+        return JAVACALL_FAIL;
+    }
+    imageInfo->width = GET32(source + 16);
+    imageInfo->height = GET32(source + 20);
+    if (imageInfo->width <= 0 || imageInfo->height <= 0) {
+        return JAVACALL_FAIL;
+    }
+
+    /* alpha channel, or a tRNS chunk before the image data */
+    imageInfo->hasAlpha = (source[25] & 4) ? JAVACALL_TRUE : JAVACALL_FALSE;
+    while (!imageInfo->hasAlpha && sourceSize - pos >= 8 &&
+           memcmp(source + pos + 4, "IDAT", 4) != 0) {
+        long len = GET32(source + pos);
+        if (memcmp(source + pos + 4, "tRNS", 4) == 0) {
+            imageInfo->hasAlpha = JAVACALL_TRUE;
+        }
+        if (len < 0 || len > sourceSize - pos - 12) {
+            break;
+        }
+        pos += len + 12;
+    }
+    return JAVACALL_OK;
+}
+#endif
+
+#ifdef ENABLE_JPEG_DECODER
+static javacall_result jpeg_info(const unsigned char *source, long sourceSize,
+                                 javacall_image_info *imageInfo) {
+    long width = 0;
+    long height = 0;
+    long idx = 2;
+
+    while (idx + 8 < sourceSize) {
+        if (source[idx] != 0xff) {
+            break;
+        }
+        /* start of frame, except DHT (C4) and DAC (CC) */
+        if ((source[idx + 1] & 0xf0) == 0xc0 &&
+            source[idx + 1] != 0xc4 && source[idx + 1] != 0xcc) {
+            height = (source[idx + 5] << 8) + source[idx + 6];
+            width = (source[idx + 7] << 8) + source[idx + 8];
+            break;
+        }
+        /* Go to the next marker */
+        idx += ((source[idx + 2] << 8) + source[idx + 3]) + 2;
+    }
+
+    if (width <= 0 || height <= 0) {
+        return JAVACALL_FAIL;
+    }
+    imageInfo->width = width;
+    imageInfo->height = height;
+    imageInfo->hasAlpha = JAVACALL_FALSE;
+    return JAVACALL_OK;
+}
+#endif
+
+#ifdef ENABLE_GIF_DECODER
+static javacall_result gif_info(const unsigned char *source, long sourceSize,
+                                javacall_image_info *imageInfo) {
+    if (sourceSize < 10) {
+        return JAVACALL_FAIL;
+    }
+    /* logical screen size, little endian */
+    imageInfo->width = source[6] + (source[7] << 8);
+    imageInfo->height = source[8] + (source[9] << 8);
+    if (imageInfo->width <= 0 || imageInfo->height <= 0) {
+        return JAVACALL_FAIL;
+    }
+    /* known only after scanning the frames */
+    imageInfo->hasAlpha = JAVACALL_TRUE;
+    return JAVACALL_OK;
+}
+#endif
+
+javacall_result javautil_image_get_info(const void *source, 
+                                        long sourceSize,
+                                        javacall_image_info *imageInfo) {
+    const unsigned char *data = (const unsigned char *)source;
+
+    switch (image_format(data, sourceSize)) {
+#ifdef ENABLE_PNG_DECODER
+    case FORMAT_PNG:
+        return png_info(data, sourceSize, imageInfo);
+#endif
+#ifdef ENABLE_JPEG_DECODER
+    case FORMAT_JPEG:
+        return jpeg_info(data, sourceSize, imageInfo);
+#endif
+#ifdef ENABLE_GIF_DECODER
+    case FORMAT_GIF:
+        return gif_info(data, sourceSize, imageInfo);
+#endif
+    default:
+        return JAVACALL_FAIL;
+    }
+}
+
+javacall_result javautil_image_decode_start(const void *source,
+                                            long sourceSize,
+                                            long width,
+                                            long height,
+                                            int mode,
+                                            javacall_handle *handle) {
+    image_decode *image;
+    long copySize = mode == JAVAUTIL_IMAGE_BORROW_SOURCE ? 0 : sourceSize;
+
+    image = (image_decode *)javacall_malloc(sizeof(image_decode) + copySize);
+    if (image == NULL) {
+        return JAVACALL_FAIL;
+    }
+    image->sourceSize = sourceSize;
+    image->width = width;
+    image->height = height;
+    image->format = image_format((const unsigned char *)source, sourceSize);
+#ifdef ENABLE_IMAGE_CACHE
+    /* the same bytes decoded before need neither a copy nor a decode */
+    javautil_image_cache_key_init(&image->cacheKey, source, sourceSize,
+                                  sizeof(javacall_pixel), width, height);
+    image->cached = javautil_image_cache_lookup(&image->cacheKey);
+    if (image->cached != NULL) {
+        copySize = 0;
+    }
+#endif
+    if (copySize > 0) {
+        memcpy(image + 1, source, copySize);
+        image->source = (const unsigned char *)(image + 1);
+    } else {
+        image->source = (const unsigned char *)source;
+    }
+#ifdef ENABLE_IMAGE_CACHE
+    /* the caller's bytes may be gone when the image is inserted */
+    image->cacheKey.source = image->source;
+#endif
+    *handle = (javacall_handle)image;
+    return JAVACALL_OK;
+}
+
+/*
+ * Decode into the caller's buffers.  Returns 1 on success with alpha
+ * set to 1 if the decoder wrote the alpha of each pixel to alphaBuf.
+ */
+static int decode(const image_decode *image, javacall_pixel *decodeBuf,
+                  char *alphaBuf, int *alpha) {
+    void *info;
+    int width = 0;
+    int height = 0;
+    int ok = 0;
+
+    *alpha = 0;
+    switch (image->format) {
+#ifdef ENABLE_JPEG_DECODER
+    case FORMAT_JPEG:
+        info = JPEG_To_RGB_init();
+        if (info != NULL) {
+            /* the header gives no size before decompression starts */
+            if (JPEG_To_RGB_decodeHeader(info, (char *)image->source,
+                    image->sourceSize, &width, &height) != 0) {
+                ok = JPEG_To_RGB_decodeData2(info, (char *)decodeBuf,
+                    sizeof(javacall_pixel), 0, 0, 
+                    image->width, image->height) != 0;
+            }
+            JPEG_To_RGB_free(info);
+        }
+        break;
+#endif
+#ifdef ENABLE_PNG_DECODER
+    case FORMAT_PNG:
+        info = PNG_To_RGB_init();
+        if (info != NULL) {
+            if (PNG_To_RGB_decodeHeader(info, (char *)image->source,
+                    image->sourceSize, &width, &height) != 0 &&
+                width == image->width && height == image->height) {
+                /* alpha comes from the image, opaque if it has none */
+                ok = PNG_To_RGB_decodeDataAlpha(info, (char *)decodeBuf,
+                    sizeof(javacall_pixel), alphaBuf, 
+                    0, 0, width, height) != 0;
+                *alpha = alphaBuf != NULL;
+            }
+            PNG_To_RGB_free(info);
+        }
+        break;
+#endif
+#ifdef ENABLE_GIF_DECODER
+    case FORMAT_GIF:
+        info = GIF_To_RGB_init();
+        if (info != NULL) {
+            if (GIF_To_RGB_decodeHeader(info, (char *)image->source,
+                    image->sourceSize, &width, &height) != 0 &&
+                width == image->width && height == image->height) {
+                /* first frame only; alpha is 0 where it is transparent */
+                ok = GIF_To_RGB_decodeDataAlpha(info, (char *)decodeBuf,
+                    sizeof(javacall_pixel), alphaBuf,
+                    0, 0, width, height) != 0;
+                *alpha = alphaBuf != NULL;
+            }
+            GIF_To_RGB_free(info);
+        }
+        break;
+#endif
+    default:
+        break;
+    }
+    return ok;
+}
+
+javacall_result javautil_image_decode_finish(javacall_handle handle,
+                                             javacall_pixel *decodeBuf,
+                                             long decodeBufSize,
+                                             char *alphaBuf,
+                                             long alphaBufSize) {
+    image_decode *image = (image_decode *)handle;
+    long pixels = image->width * image->height;
+    /* the decoders take alpha only for the whole image */
+    char *alpha = alphaBufSize >= pixels ? alphaBuf : NULL;
+    int alphaDone = 0;
+    int ok = 0;
+
+    if (decodeBufSize >= pixels * (long)sizeof(javacall_pixel)) {
+#ifdef ENABLE_IMAGE_CACHE
+        const javautil_image_cache_entry *entry = image->cached;
+        if (entry != NULL) {
+            if (decodeBufSize >= entry->pixelsSize) {
+                memcpy(decodeBuf, entry->pixels, entry->pixelsSize);
+                if (entry->alpha != NULL && alpha != NULL) {
+                    memcpy(alpha, entry->alpha, entry->alphaSize);
+                    alphaDone = 1;
+                }
+                ok = 1;
+            }
+        } else
+#endif
+        {
+            ok = decode(image, decodeBuf, alpha, &alphaDone);
+        }
+    }
+
+    if (ok && alphaBuf != NULL) {
+        if (!alphaDone) {
+            memset(alphaBuf, 0xFF, alphaBufSize);
+        } else if (alphaBufSize > pixels) {
+            memset(alphaBuf + pixels, 0xFF, alphaBufSize - pixels);
+        }
+    }
+
+#ifdef ENABLE_IMAGE_CACHE
+    /* cache only complete images: without alpha it is unknown */
+    if (ok && image->cached == NULL && alpha != NULL) {
+        javautil_image_cache_insert(&image->cacheKey, decodeBuf,
+            pixels * sizeof(javacall_pixel),
+            (const unsigned char *)alpha, pixels);
+    }
+    /* whatever the outcome, the handle holds the entry until here */
+    javautil_image_cache_release(image->cached);
+#endif
+
+    javacall_free(image);
+    return ok ? JAVACALL_OK : JAVACALL_FAIL;
+}
@@ -69,7 +69,7 @@
 #include <stdio.h>
 
 /*
- * We need memory copying and zeroing functions, plus strncpy().
+ * We need memory copying, comparing and zeroing functions, plus strncpy().
  * ANSI and System V implementations declare these in <string.h>.
  * BSD doesn't have the mem() functions, but it does have bcopy()/bzero().
  * Some systems may declare memset and memcpy in <memory.h>.
@@ -83,12 +83,14 @@
 #include <strings.h>
 #define MEMZERO(target,size)	bzero((void *)(target), (size_t)(size))
 #define MEMCOPY(dest,src,size)	bcopy((const void *)(src), (void *)(dest), (size_t)(size))
+#define MEMCMP(a,b,size)	bcmp((const void *)(a), (const void *)(b), (size_t)(size))
 
 #else /* not BSD, assume ANSI/SysV string lib */
 
 #include <string.h>
 #define MEMZERO(target,size)	memset((void *)(target), 0, (size_t)(size))
 #define MEMCOPY(dest,src,size)	memcpy((void *)(dest), (const void *)(src), (size_t)(size))
+#define MEMCMP(a,b,size)	memcmp((const void *)(a), (const void *)(b), (size_t)(size))
 
 #endif
 
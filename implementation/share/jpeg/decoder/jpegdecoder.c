@@ -49,6 +49,7 @@
 #include <setjmp.h>
 
 #include "jpegdecoder.h"
+#include "javautil_pixel.h"
 const unsigned char jm_huffmanTable[] =
 {
 /* JPEG DHT Segment for YCrCb omitted from Nielsen's JPEG stream */
@@ -407,8 +408,8 @@ JPEG_To_RGB_decodeHeader(void *info,
     }
     jm_jpeg_read_header(cinfo, TRUE);
     
-    *width = cinfo->output_width;
-    *height = cinfo->output_height;
+    *width = cinfo->image_width;
+    *height = cinfo->image_height;
     
     return 1;
 }
@@ -471,7 +472,7 @@ int JPEG_To_RGB_decodeData2(void *info, char *outData, int outPixelSize,
     /* jmf_src_data *clientData = (jmf_src_data *) cinfo->client_data; */
 
     unsigned char *outDataPtr;
-    unsigned int i;
+    int count;          /* pixels of a line in the rectangle */
     if ((outPixelSize != 2) && (outPixelSize != 4)) {
         return 0;
     }
@@ -499,6 +500,8 @@ int JPEG_To_RGB_decodeData2(void *info, char *outData, int outPixelSize,
     /* JSAMPLEs per row in image_buffer */
     /*rowStride = cinfo->output_width * pixelSize;*/
     rowStride = (right - left) * outPixelSize;
+    count = ((unsigned)right < cinfo->output_width ? 
+             right : (int)cinfo->output_width) - left;
     row_pointer[0] = (unsigned char *)MNI_MALLOC(cinfo->output_width * pixelSize);
 
     /* Establish the setjmp return context for jmf_error_exit to use. */
@@ -519,24 +522,18 @@ int JPEG_To_RGB_decodeData2(void *info, char *outData, int outPixelSize,
 
         if ((cinfo->output_scanline > (unsigned)top) && 
             (cinfo->output_scanline <= (unsigned)bottom)) {
-            /* convert pixels of the line to RGB565 format */
-            for (i = 0; i < cinfo->output_width; i++) {
-                if ((i >= (unsigned)left) && (i < (unsigned)right)) {
-                    unsigned int r = row_pointer[0][i * 3 + 0] & 0xFF;
-                    unsigned int g = row_pointer[0][i * 3 + 1] & 0xFF;
-                    unsigned int b = row_pointer[0][i * 3 + 2] & 0xFF;
-                    if (2 == outPixelSize) {
-                        ((unsigned short*)outDataPtr)[i-(unsigned)left] =
-                            ((b & 0xF8) >> 3) + ((g & 0xFC) << 3) + ((r & 0xF8) << 8);
-                    } else /* if (4 == outPixelSize) */ {
-                        ((unsigned long*)outDataPtr)[i-(unsigned)left] =
-                            (b & 0xFF) + ((g & 0xFF) << 8) + ((r & 0xFF) << 16);
-                    }
+            /* convert the pixels of the line in [left, right) */
+            if (count > 0) {
+                if (2 == outPixelSize) {
+                    javautil_pixel_rgb888_to_rgb565(row_pointer[0] + left * 3,
+                        (unsigned short*)outDataPtr, count);
+                } else /* if (4 == outPixelSize) */ {
+                    javautil_pixel_rgb888_to_xrgb8888(row_pointer[0] + left * 3,
+                        (unsigned int*)outDataPtr, count);
                 }
             }
+            outDataPtr += rowStride;
         }
-
-        outDataPtr += rowStride;
     }
 
     jm_jpeg_finish_decompress(cinfo);
@@ -58,6 +58,60 @@ extern "C" {
 int RGBToJPEG(char *inData, int width, int height, int quality,
             char *outData, 
             JPEG_ENCODER_INPUT_COLOR_FORMAT colorFormat);
+
+/**
+ * Receives the output of a streaming encoder.
+ * @param sinkData the pointer given to RGB_To_JPEG_stream_init
+ * @param data compressed bytes, valid only during the call
+ * @param len number of bytes in data
+ * @return nonzero to continue, 0 to abort the encoding
+ */
+typedef int (*JPEG_ENCODER_SINK)(void *sinkData, const char *data, int len);
+
+/**
+ * Starts a streaming encode: input lines are passed in any number of
+ * RGB_To_JPEG_stream_write calls, and compressed data goes to the sink
+ * as soon as each row of MCUs (16 lines) is encoded, and in between
+ * whenever 4 KB have accumulated.  Only a few MCU rows of the image are
+ * kept in memory.  The JPEG headers are sent to the sink before this
+ * function returns.
+ * @param width Width of the frame
+ * @param height Height of the frame
+ * @param quality Quality is a value between 1 and 100, 100 being highest
+ * @param colorFormat format of pixel color
+ * @param sink function receiving the compressed data
+ * @param sinkData passed to sink
+ * @return encoder handle, NULL on failure
+ */
+void *RGB_To_JPEG_stream_init(int width, int height, int quality,
+                              JPEG_ENCODER_INPUT_COLOR_FORMAT colorFormat,
+                              JPEG_ENCODER_SINK sink, void *sinkData);
+
+/**
+ * Encodes the next lines of the frame, top to bottom.
+ * @param encoder handle returned by RGB_To_JPEG_stream_init
+ * @param inData first line to encode
+ * @param rowStride distance between lines in inData, in bytes
+ * @param numRows number of lines in inData; lines past the frame height
+ *        are ignored
+ * @return 1 on success, 0 on failure, including the sink aborting
+ */
+int RGB_To_JPEG_stream_write(void *encoder, char *inData, int rowStride,
+                             int numRows);
+
+/**
+ * Completes a streaming encode after all lines have been written and
+ * sends the remaining data to the sink.
+ * @param encoder handle returned by RGB_To_JPEG_stream_init
+ * @return total size of the encoded image in bytes, 0 on failure
+ */
+int RGB_To_JPEG_stream_finish(void *encoder);
+
+/**
+ * Releases a streaming encoder, finished or not.
+ * @param encoder handle returned by RGB_To_JPEG_stream_init
+ */
+void RGB_To_JPEG_stream_free(void *encoder);
 #ifdef __cplusplus
 }
 #endif
@@ -38,6 +38,8 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jchuff.h"
+#include "jctblcache.h"		/* Process-wide table cache */
 
 
 /* Private subobject for this module */
@@ -51,8 +53,11 @@ typedef struct {
   /* The actual post-DCT divisors --- not identical to the quant table
    * entries, because of scaling (especially for an unnormalized DCT).
    * Each table is given in normal array order.
+   * An entry may point into the shared table cache, in which case it
+   * must not be written; tables computed here live in private_divisors.
    */
   DCTELEM * divisors[NUM_QUANT_TBLS];
+  DCTELEM * private_divisors[NUM_QUANT_TBLS];
 
 #ifdef DCT_FLOAT_SUPPORTED
   /* Same as above for the floating-point case. */
@@ -64,6 +69,68 @@ typedef struct {
 typedef my_fdct_controller * my_fdct_ptr;
 
 
+#if defined(DCT_ISLOW_SUPPORTED) || defined(DCT_IFAST_SUPPORTED)
+
+GLOBAL(void)
+jm_jpeg_compute_divisors (J_DCT_METHOD dct_method, const UINT16 * quantval,
+			  DCTELEM * dtbl)
+/* Compute the post-DCT divisors of a quantization table for the
+ * JDCT_ISLOW or JDCT_IFAST method.  Also used by the table cache.
+ */
+{
+  int i;
+
+  switch (dct_method) {
+#ifdef DCT_ISLOW_SUPPORTED
+  case JDCT_ISLOW:
+    /* For LL&M IDCT method, divisors are equal to raw quantization
+     * coefficients multiplied by 8 (to counteract scaling).
+     */
+    for (i = 0; i < DCTSIZE2; i++) {
+      dtbl[i] = ((DCTELEM) quantval[i]) << 3;
+    }
+    break;
+#endif
+#ifdef DCT_IFAST_SUPPORTED
+  case JDCT_IFAST:
+    {
+      /* For AA&N IDCT method, divisors are equal to quantization
+       * coefficients scaled by scalefactor[row]*scalefactor[col], where
+       *   scalefactor[0] = 1
+       *   scalefactor[k] = cos(k*PI/16) * sqrt(2)    for k=1..7
+       * We apply a further scale factor of 8.
+       */
+#define CONST_BITS 14
+      static const INT16 aanscales[DCTSIZE2] = {
+	/* precomputed values scaled up by 14 bits */
+	16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+	22725, 31521, 29692, 26722, 22725, 17855, 12299,  6270,
+	21407, 29692, 27969, 25172, 21407, 16819, 11585,  5906,
+	19266, 26722, 25172, 22654, 19266, 15137, 10426,  5315,
+	16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+	12873, 17855, 16819, 15137, 12873, 10114,  6967,  3552,
+	 8867, 12299, 11585, 10426,  8867,  6967,  4799,  2446,
+	 4520,  6270,  5906,  5315,  4520,  3552,  2446,  1247
+      };
+      SHIFT_TEMPS
+
+      for (i = 0; i < DCTSIZE2; i++) {
+	dtbl[i] = (DCTELEM)
+	  DESCALE(MULTIPLY16V16((INT32) quantval[i],
+				(INT32) aanscales[i]),
+		  CONST_BITS-3);
+      }
+    }
+    break;
+#endif
+  default:
+    break;
+  }
+}
+
+#endif /* DCT_ISLOW_SUPPORTED || DCT_IFAST_SUPPORTED */
+
+
 /*
  * Initialize for a processing pass.
  * Verify that all referenced Q-tables are present, and set up
@@ -77,7 +144,7 @@ METHODDEF(void)
 start_pass_fdctmgr (j_compress_ptr cinfo)
 {
   my_fdct_ptr fdct = (my_fdct_ptr) cinfo->fdct;
-  int ci, qtblno, i;
+  int ci, qtblno;
   jpeg_component_info *compptr;
   JQUANT_TBL * qtbl;
   DCTELEM * dtbl;
@@ -90,61 +157,31 @@ start_pass_fdctmgr (j_compress_ptr cinfo)
 	cinfo->quant_tbl_ptrs[qtblno] == NULL)
       ERREXIT1(cinfo, JERR_NO_QUANT_TABLE, qtblno);
     qtbl = cinfo->quant_tbl_ptrs[qtblno];
+#if defined(DCT_ISLOW_SUPPORTED) || defined(DCT_IFAST_SUPPORTED)
+    /* Use the shared divisors if this table was computed before */
+    if (cinfo->dct_method != JDCT_FLOAT &&
+	(dtbl = jm_jpeg_cached_divisors(cinfo, qtbl)) != NULL) {
+      fdct->divisors[qtblno] = dtbl;
+      continue;
+    }
+#endif
     /* Compute divisors for this quant table */
     /* We may do this more than once for same table, but it's not a big deal */
     switch (cinfo->dct_method) {
 #ifdef DCT_ISLOW_SUPPORTED
     case JDCT_ISLOW:
-      /* For LL&M IDCT method, divisors are equal to raw quantization
-       * coefficients multiplied by 8 (to counteract scaling).
-       */
-      if (fdct->divisors[qtblno] == NULL) {
-	fdct->divisors[qtblno] = (DCTELEM *)
-	  (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
-				      DCTSIZE2 * SIZEOF(DCTELEM));
-      }
-      dtbl = fdct->divisors[qtblno];
-      for (i = 0; i < DCTSIZE2; i++) {
-	dtbl[i] = ((DCTELEM) qtbl->quantval[i]) << 3;
-      }
-      break;
 #endif
 #ifdef DCT_IFAST_SUPPORTED
     case JDCT_IFAST:
-      {
-	/* For AA&N IDCT method, divisors are equal to quantization
-	 * coefficients scaled by scalefactor[row]*scalefactor[col], where
-	 *   scalefactor[0] = 1
-	 *   scalefactor[k] = cos(k*PI/16) * sqrt(2)    for k=1..7
-	 * We apply a further scale factor of 8.
-	 */
-#define CONST_BITS 14
-	static const INT16 aanscales[DCTSIZE2] = {
-	  /* precomputed values scaled up by 14 bits */
-	  16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
-	  22725, 31521, 29692, 26722, 22725, 17855, 12299,  6270,
-	  21407, 29692, 27969, 25172, 21407, 16819, 11585,  5906,
-	  19266, 26722, 25172, 22654, 19266, 15137, 10426,  5315,
-	  16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
-	  12873, 17855, 16819, 15137, 12873, 10114,  6967,  3552,
-	   8867, 12299, 11585, 10426,  8867,  6967,  4799,  2446,
-	   4520,  6270,  5906,  5315,  4520,  3552,  2446,  1247
-	};
-	SHIFT_TEMPS
-
-	if (fdct->divisors[qtblno] == NULL) {
-	  fdct->divisors[qtblno] = (DCTELEM *)
-	    (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
-					DCTSIZE2 * SIZEOF(DCTELEM));
-	}
-	dtbl = fdct->divisors[qtblno];
-	for (i = 0; i < DCTSIZE2; i++) {
-	  dtbl[i] = (DCTELEM)
-	    DESCALE(MULTIPLY16V16((INT32) qtbl->quantval[i],
-				  (INT32) aanscales[i]),
-		    CONST_BITS-3);
-	}
+#endif
+#if defined(DCT_ISLOW_SUPPORTED) || defined(DCT_IFAST_SUPPORTED)
+      if (fdct->private_divisors[qtblno] == NULL) {
+	fdct->private_divisors[qtblno] = (DCTELEM *)
+	  (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				      DCTSIZE2 * SIZEOF(DCTELEM));
       }
+      dtbl = fdct->divisors[qtblno] = fdct->private_divisors[qtblno];
+      jm_jpeg_compute_divisors(cinfo->dct_method, qtbl->quantval, dtbl);
       break;
 #endif
 #ifdef DCT_FLOAT_SUPPORTED
@@ -159,7 +196,7 @@ start_pass_fdctmgr (j_compress_ptr cinfo)
 	 * use a multiplication rather than a division.
 	 */
 	FAST_FLOAT * fdtbl;
-	int row, col;
+	int row, col, i;
 	static const double aanscalefactor[DCTSIZE] = {
 	  1.0, 1.387039845, 1.306562965, 1.175875602,
 	  1.0, 0.785694958, 0.541196100, 0.275899379
@@ -403,6 +440,7 @@ jm_jinit_forward_dct (j_compress_ptr cinfo)
   /* Mark divisor tables unallocated */
   for (i = 0; i < NUM_QUANT_TBLS; i++) {
     fdct->divisors[i] = NULL;
+    fdct->private_divisors[i] = NULL;
 #ifdef DCT_FLOAT_SUPPORTED
     fdct->float_divisors[i] = NULL;
 #endif
@@ -41,6 +41,26 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jchuff.h"		/* Declarations shared with jcphuff.c */
+#include "jdct.h"
+#include "jctblcache.h"		/* Process-wide table cache */
+
+
+/* The bit accumulator is 64 bits wide on every platform, so that a
+ * Huffman symbol and its magnitude bits (at most 16 + 15 bits) can be
+ * appended with a single shift and whole bytes flushed in bulk.
+ */
+
+#ifdef _MSC_VER
+typedef unsigned __int64 bit_buf_type;
+#else
+typedef unsigned long long bit_buf_type;
+#endif
+#define BIT_BUF_SIZE  64	/* size of bit_buf_type in bits */
+
+/* Count leading/trailing zero bits, using the compiler builtins if any */
+#if defined(__GNUC__) && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+#define USE_CLZ_BUILTINS
+#endif
 
 
 /* Expanded entropy encoder object for Huffman encoding.
@@ -50,7 +70,7 @@
  */
 
 typedef struct {
-  INT32 put_buffer;		/* current bit-accumulation buffer */
+  bit_buf_type put_buffer;	/* current bit-accumulation buffer */
   int put_bits;			/* # of bits now in it */
   int last_dc_val[MAX_COMPS_IN_SCAN]; /* last DC coef for each component */
 } savable_state;
@@ -84,9 +104,14 @@ typedef struct {
   unsigned int restarts_to_go;	/* MCUs left in this restart interval */
   int next_restart_num;		/* next restart number to write (0-7) */
 
-  /* Pointers to derived tables (these workspaces have image lifespan) */
+  /* Pointers to derived tables in use; these may point into the shared
+   * table cache and so are read-only.  Tables that are not cached are
+   * derived into the private workspaces, which have image lifespan.
+   */
   c_derived_tbl * dc_derived_tbls[NUM_HUFF_TBLS];
   c_derived_tbl * ac_derived_tbls[NUM_HUFF_TBLS];
+  c_derived_tbl * dc_private_tbls[NUM_HUFF_TBLS];
+  c_derived_tbl * ac_private_tbls[NUM_HUFF_TBLS];
 
 #ifdef ENTROPY_OPT_SUPPORTED	/* Statistics tables for optimization */
   long * dc_count_ptrs[NUM_HUFF_TBLS];
@@ -170,12 +195,13 @@ start_pass_huff (j_compress_ptr cinfo, boolean gather_statistics)
       MEMZERO(entropy->ac_count_ptrs[actbl], 257 * SIZEOF(long));
 #endif
     } else {
-      /* Compute derived values for Huffman tables */
-      /* We may do this more than once for a table, but it's not expensive */
-      jm_jpeg_make_c_derived_tbl(cinfo, TRUE, dctbl,
-			      & entropy->dc_derived_tbls[dctbl]);
-      jm_jpeg_make_c_derived_tbl(cinfo, FALSE, actbl,
-			      & entropy->ac_derived_tbls[actbl]);
+      /* Look up (or compute) derived values for Huffman tables */
+      jm_jpeg_cached_c_derived_tbl(cinfo, TRUE, dctbl,
+				   & entropy->dc_derived_tbls[dctbl],
+				   & entropy->dc_private_tbls[dctbl]);
+      jm_jpeg_cached_c_derived_tbl(cinfo, FALSE, actbl,
+				   & entropy->ac_derived_tbls[actbl],
+				   & entropy->ac_private_tbls[actbl]);
     }
     /* Initialize DC predictions to 0 */
     entropy->saved.last_dc_val[ci] = 0;
@@ -266,7 +292,7 @@ jm_jpeg_make_c_derived_tbl (j_compress_ptr cinfo, boolean isDC, int tblno,
 
   /* Set all codeless symbols to have code length 0;
    * this lets us detect duplicate VAL entries here, and later
-   * allows emit_bits to detect any attempt to emit such symbols.
+   * allows PUT_SYMBOL to detect any attempt to emit such symbols.
    */
   MEMZERO(dtbl->ehufsi, SIZEOF(dtbl->ehufsi));
 
@@ -314,55 +340,138 @@ dump_buffer (working_state * state)
 
 /* Outputting bits to the file */
 
-/* Only the right 24 bits of put_buffer are used; the valid bits are
- * left-justified in this part.  At most 16 bits can be passed to emit_bits
- * in one call, and we never retain more than 7 bits in put_buffer
- * between calls, so 24 bits are sufficient.
+/* Only the right put_bits bits of put_buffer are valid; they are
+ * right-justified, and anything above them is stale data that has
+ * already been written out.  New bits are shifted in from the right.
+ * Between calls fewer than 64 bits are retained, and the buffer is
+ * flushed whenever fewer than 32 bits are free, so one Huffman symbol
+ * plus its magnitude bits always fit.
  */
 
-INLINE
-LOCAL(boolean)
-emit_bits (working_state * state, unsigned int code, int size)
-/* Emit some bits; return TRUE if successful, FALSE if must suspend */
+#define BUFFER_LOW_WATER  (BIT_BUF_SIZE - 32)
+
+/* Byte-lane constants for the "does any byte equal 0xFF" test below */
+#define LANE_ONES   ((((bit_buf_type) 0x01010101) << 32) | 0x01010101)
+#define LANE_HIGHS  ((((bit_buf_type) 0x80808080) << 32) | 0x80808080)
+
+
+LOCAL(int)
+flush_bytes (working_state * state, bit_buf_type put_buffer, int put_bits)
+/* Write out all complete bytes held in the bit buffer, stuffing a zero
+ * after each 0xFF.  Returns the number of bits left over (0..7), or -1
+ * if must suspend.
+ */
 {
-  /* This routine is heavily used, so it's worth coding tightly. */
-  register INT32 put_buffer = (INT32) code;
-  register int put_bits = state->cur.put_bits;
+  bit_buf_type c, v;
+  int nbytes = put_bits >> 3;
+  register JOCTET * next;
 
-  /* if size is 0, caller used an invalid Huffman table entry */
-  if (size == 0)
-    ERREXIT(state->cinfo, JERR_HUFF_MISSING_CODE);
+  if (nbytes == 0)
+    return put_bits;
 
-  put_buffer &= (((INT32) 1)<<size) - 1; /* mask off any extra bits in code */
-  
-  put_bits += size;		/* new number of bits in buffer */
-  
-  put_buffer <<= 24 - put_bits; /* align incoming bits */
+  /* The bytes to emit are now the low 8*nbytes bits of c, MSB first */
+  c = put_buffer >> (put_bits & 7);
 
-  put_buffer |= state->cur.put_buffer; /* and merge with old buffer contents */
-  
-  while (put_bits >= 8) {
-    int c = (int) ((put_buffer >> 16) & 0xFF);
-    
-    emit_byte(state, c, return FALSE);
-    if (c == 0xFF) {		/* need to stuff a zero byte? */
-      emit_byte(state, 0, return FALSE);
+  /* Move them to the top of v and complement: an emitted 0xFF byte then
+   * shows up as a zero byte, and the unused low lanes become 0xFF.
+   */
+  v = ~(c << (BIT_BUF_SIZE - (nbytes << 3)));
+
+  if ((((v - LANE_ONES) & ~v & LANE_HIGHS) == 0) &&
+      state->free_in_buffer > (size_t) nbytes) {
+    /* Fast path: no byte stuffing needed and the output buffer cannot
+     * fill up, so copy the bytes without any per-byte checks.
+     */
+    next = state->next_output_byte;
+    switch (nbytes) {
+    case 7: *next++ = (JOCTET) (c >> 48);	/* FALLTHROUGH */
+    case 6: *next++ = (JOCTET) (c >> 40);	/* FALLTHROUGH */
+    case 5: *next++ = (JOCTET) (c >> 32);	/* FALLTHROUGH */
+    case 4: *next++ = (JOCTET) (c >> 24);	/* FALLTHROUGH */
+    case 3: *next++ = (JOCTET) (c >> 16);	/* FALLTHROUGH */
+    case 2: *next++ = (JOCTET) (c >> 8);	/* FALLTHROUGH */
+    default: *next++ = (JOCTET) c;
+    }
+    state->next_output_byte = next;
+    state->free_in_buffer -= nbytes;
+  } else {
+    while (nbytes > 0) {
+      int b = (int) ((c >> ((--nbytes) << 3)) & 0xFF);
+
+      emit_byte(state, b, return -1);
+      if (b == 0xFF) {		/* need to stuff a zero byte? */
+	emit_byte(state, 0, return -1);
+      }
     }
-    put_buffer <<= 8;
-    put_bits -= 8;
   }
 
-  state->cur.put_buffer = put_buffer; /* update state variables */
-  state->cur.put_bits = put_bits;
+  return put_bits & 7;
+}
 
-  return TRUE;
+
+/* Append a Huffman symbol followed by nbits bits of val to the local bit
+ * buffer of encode_one_block.  The caller guarantees there is room.
+ * If size is 0, caller used an invalid Huffman table entry.
+ */
+#define PUT_SYMBOL(tbl,symbol,val,nbits)  \
+	{ int size_ = (tbl)->ehufsi[symbol];  \
+	  if (size_ == 0)  \
+	    ERREXIT(state->cinfo, JERR_HUFF_MISSING_CODE);  \
+	  put_buffer = (put_buffer << size_) | (tbl)->ehufco[symbol];  \
+	  put_buffer = (put_buffer << (nbits)) |  \
+		       ((bit_buf_type) (val) & ((((bit_buf_type) 1) << (nbits)) - 1));  \
+	  put_bits += size_ + (nbits); }
+
+/* Make room for another PUT_SYMBOL, taking 'action' if must suspend */
+#define CHECK_ROOM(action)  \
+	if (put_bits > BUFFER_LOW_WATER) {  \
+	  if ((put_bits = flush_bytes(state, put_buffer, put_bits)) < 0)  \
+	    { action; } }
+
+
+/* Number of bits needed for the magnitude of a nonzero value */
+#ifdef USE_CLZ_BUILTINS
+#define MAGNITUDE_BITS(nbits,temp)  \
+	((nbits) = 32 - __builtin_clz((unsigned int) (temp)))
+#else
+#define MAGNITUDE_BITS(nbits,temp)  \
+	{ register int t_ = (temp) >> 1;  \
+	  (nbits) = 1;  \
+	  while (t_) { (nbits)++; t_ >>= 1; } }
+#endif
+
+/* Index of the lowest set bit of a nonzero mask */
+#ifdef USE_CLZ_BUILTINS
+#define LOWEST_BIT(mask)  __builtin_ctzll(mask)
+#else
+LOCAL(int)
+lowest_bit (bit_buf_type mask)
+{
+  int n = 0;
+
+  if ((mask & 0xFFFFFFFF) == 0) { n += 32; mask >>= 32; }
+  if ((mask & 0xFFFF) == 0) { n += 16; mask >>= 16; }
+  if ((mask & 0xFF) == 0) { n += 8; mask >>= 8; }
+  if ((mask & 0xF) == 0) { n += 4; mask >>= 4; }
+  if ((mask & 0x3) == 0) { n += 2; mask >>= 2; }
+  if ((mask & 0x1) == 0) { n += 1; }
+  return n;
 }
+#define LOWEST_BIT(mask)  lowest_bit(mask)
+#endif
 
 
 LOCAL(boolean)
 flush_bits (working_state * state)
 {
-  if (! emit_bits(state, 0x7F, 7)) /* fill any partial byte with ones */
+  bit_buf_type put_buffer = state->cur.put_buffer;
+  int put_bits = state->cur.put_bits;
+
+  if ((put_bits = flush_bytes(state, put_buffer, put_bits)) < 0)
+    return FALSE;
+  /* fill any partial byte with ones */
+  put_buffer = (put_buffer << 7) | 0x7F;
+  if (flush_bytes(state, put_buffer, put_bits + 7) < 0)
     return FALSE;
   state->cur.put_buffer = 0;	/* and reset bit-buffer to empty */
   state->cur.put_bits = 0;
@@ -378,7 +487,10 @@ encode_one_block (working_state * state, JCOEFPTR block, int last_dc_val,
 {
   register int temp, temp2;
   register int nbits;
-  register int k, r, i;
+  register int k, r;
+  register bit_buf_type put_buffer = state->cur.put_buffer;
+  register int put_bits = state->cur.put_bits;
+  bit_buf_type nonzero;
   
   /* Encode the DC coefficient difference per section F.1.2.1 */
   
@@ -393,74 +505,74 @@ encode_one_block (working_state * state, JCOEFPTR block, int last_dc_val,
   
   /* Find the number of bits needed for the magnitude of the coefficient */
   nbits = 0;
-  while (temp) {
-    nbits++;
-    temp >>= 1;
-  }
+  if (temp)
+    MAGNITUDE_BITS(nbits, temp);
   /* Check for out-of-range coefficient values.
    * Since we're encoding a difference, the range limit is twice as much.
    */
   if (nbits > MAX_COEF_BITS+1)
     ERREXIT(state->cinfo, JERR_BAD_DCT_COEF);
   
-  /* Emit the Huffman-coded symbol for the number of bits */
-  if (! emit_bits(state, dctbl->ehufco[nbits], dctbl->ehufsi[nbits]))
-    return FALSE;
-
-  /* Emit that number of bits of the value, if positive, */
-  /* or the complement of its magnitude, if negative. */
-  if (nbits)			/* emit_bits rejects calls with size 0 */
-    if (! emit_bits(state, (unsigned int) temp2, nbits))
-      return FALSE;
+  /* Emit the Huffman-coded symbol for the number of bits, followed by
+   * that number of bits of the value, if positive,
+   * or the complement of its magnitude, if negative.
+   */
+  CHECK_ROOM(return FALSE);
+  PUT_SYMBOL(dctbl, nbits, temp2, nbits);
 
   /* Encode the AC coefficients per section F.1.2.2 */
+
+  /* Collect a mask of the nonzero AC coefficients, bit k standing for
+   * zigzag position k, so that zero runs can be skipped in one step.
+   */
+  nonzero = 0;
+  for (k = 1; k < DCTSIZE2; k++)
+    nonzero |= ((bit_buf_type) (block[jm_jpeg_natural_order[k]] != 0)) << k;
+
+  k = 0;			/* k = zigzag index of last coded coef */
   
-  r = 0;			/* r = run length of zeros */
-  
-  for (k = 1; k < DCTSIZE2; k++) {
-    if ((temp = block[jm_jpeg_natural_order[k]]) == 0) {
-      r++;
-    } else {
-      /* if run length > 15, must emit special run-length-16 codes (0xF0) */
-      while (r > 15) {
-	if (! emit_bits(state, actbl->ehufco[0xF0], actbl->ehufsi[0xF0]))
-	  return FALSE;
-	r -= 16;
-      }
+  while (nonzero) {
+    temp2 = LOWEST_BIT(nonzero);
+    nonzero &= nonzero - 1;
+    r = temp2 - k - 1;		/* r = run length of zeros */
+    k = temp2;
+
+    /* if run length > 15, must emit special run-length-16 codes (0xF0) */
+    while (r > 15) {
+      CHECK_ROOM(return FALSE);
+      PUT_SYMBOL(actbl, 0xF0, 0, 0);
+      r -= 16;
+    }
 
-      temp2 = temp;
-      if (temp < 0) {
-	temp = -temp;		/* temp is abs value of input */
-	/* This code assumes we are on a two's complement machine */
-	temp2--;
-      }
+    temp = temp2 = block[jm_jpeg_natural_order[k]];
+    if (temp < 0) {
+      temp = -temp;		/* temp is abs value of input */
+      /* This code assumes we are on a two's complement machine */
+      temp2--;
+    }
       
-      /* Find the number of bits needed for the magnitude of the coefficient */
-      nbits = 1;		/* there must be at least one 1 bit */
-      while ((temp >>= 1))
-	nbits++;
-      /* Check for out-of-range coefficient values */
-      if (nbits > MAX_COEF_BITS)
-	ERREXIT(state->cinfo, JERR_BAD_DCT_COEF);
+    /* Find the number of bits needed for the magnitude of the coefficient */
+    MAGNITUDE_BITS(nbits, temp);
+    /* Check for out-of-range coefficient values */
+    if (nbits > MAX_COEF_BITS)
+      ERREXIT(state->cinfo, JERR_BAD_DCT_COEF);
       
-      /* Emit Huffman symbol for run length / number of bits */
-      i = (r << 4) + nbits;
-      if (! emit_bits(state, actbl->ehufco[i], actbl->ehufsi[i]))
-	return FALSE;
-
-      /* Emit that number of bits of the value, if positive, */
-      /* or the complement of its magnitude, if negative. */
-      if (! emit_bits(state, (unsigned int) temp2, nbits))
-	return FALSE;
-      
-      r = 0;
-    }
+    /* Emit Huffman symbol for run length / number of bits, followed by
+     * that number of bits of the value, if positive,
+     * or the complement of its magnitude, if negative.
+     */
+    CHECK_ROOM(return FALSE);
+    PUT_SYMBOL(actbl, (r << 4) + nbits, temp2, nbits);
   }
 
   /* If the last coef(s) were zero, emit an end-of-block code */
-  if (r > 0)
-    if (! emit_bits(state, actbl->ehufco[0], actbl->ehufsi[0]))
-      return FALSE;
+  if (k < DCTSIZE2-1) {
+    CHECK_ROOM(return FALSE);
+    PUT_SYMBOL(actbl, 0, 0, 0);
+  }
+
+  state->cur.put_buffer = put_buffer; /* update state variables */
+  state->cur.put_bits = put_bits;
 
   return TRUE;
 }
@@ -925,6 +1037,7 @@ jm_jinit_huff_encoder (j_compress_ptr cinfo)
   /* Mark tables unallocated */
   for (i = 0; i < NUM_HUFF_TBLS; i++) {
     entropy->dc_derived_tbls[i] = entropy->ac_derived_tbls[i] = NULL;
+    entropy->dc_private_tbls[i] = entropy->ac_private_tbls[i] = NULL;
 #ifdef ENTROPY_OPT_SUPPORTED
     entropy->dc_count_ptrs[i] = entropy->ac_count_ptrs[i] = NULL;
 #endif
@@ -36,6 +36,9 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jdct.h"
+#include "jchuff.h"
+#include "jctblcache.h"		/* Process-wide table cache */
 
 
 /*
@@ -159,11 +162,18 @@ jm_jpeg_set_quality (j_compress_ptr cinfo, int quality, boolean force_baseline)
  * would use the preceding three routines directly.
  */
 {
-  /* Convert user 0-100 rating to percentage scaling */
-  quality = jm_jpeg_quality_scaling(quality);
+  /* Reuse the tables if this quality has been set up before */
+  if (jm_jpeg_cached_quality(cinfo, quality, force_baseline))
+    return;
 
-  /* Set up standard quality tables */
-  jm_jpeg_set_linear_quality(cinfo, quality, force_baseline);
+  /* Convert user 0-100 rating to percentage scaling,
+   * and set up standard quality tables
+   */
+  jm_jpeg_set_linear_quality(cinfo, jm_jpeg_quality_scaling(quality),
+			     force_baseline);
+
+  /* Remember them for the next image at this quality */
+  jm_jpeg_store_quality(cinfo, quality, force_baseline);
 }
 
 
@@ -0,0 +1,322 @@
+/*
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation. 
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt). 
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA 
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */ 
+/*
+ * jctblcache.c
+ *
+ * This file contains a process-wide cache of the tables the compressor
+ * derives from its quality setting: the scaled quantization tables, the
+ * forward-DCT divisors computed from them and the derived Huffman encoding
+ * tables.  Applications that encode many images at the same few quality
+ * settings (burst shots, video snapshots) thereby skip the per-image table
+ * setup done by jm_jpeg_set_quality, start_pass_fdctmgr and start_pass_huff.
+ *
+ * Cache entries are allocated outside the JPEG memory pools and never
+ * freed, so a table handed out to one compression object stays valid for
+ * as long as the process runs.  A quality entry gets its quantization
+ * tables and the divisors of every integer DCT method before it is
+ * published, and no entry is written after it is published.  Publishing
+ * is a release store and lookups load the slots with acquire semantics,
+ * so an encoder on another thread that finds an entry also sees its
+ * contents.  Two threads storing the same slot at once both succeed; the
+ * entry overwritten stays valid for its users and is merely leaked.
+ * Compilers without a known way to order these accesses build without
+ * the cache.
+ *
+ * Lookups are validated against the actual table contents, hence an
+ * application that edits its tables after jm_jpeg_set_quality simply
+ * misses the cache.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jmemsys.h"		/* jm_jpeg_get_small for cache entries */
+#include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jchuff.h"		/* Declarations shared with jcphuff.c */
+#include "jctblcache.h"
+
+
+/* Ordered access to the published entry pointers (see above) */
+
+#if defined(__GNUC__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+#define LOAD_ENTRY(slot)	__atomic_load_n(&(slot), __ATOMIC_ACQUIRE)
+#define PUBLISH_ENTRY(slot, entry) \
+  __atomic_store_n(&(slot), (entry), __ATOMIC_RELEASE)
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+/* x86 keeps stores and loads in order, and MSVC does not move other
+ * accesses across volatile ones on it.
+ */
+#define LOAD_ENTRY(slot)	(*(void * volatile *) &(slot))
+#define PUBLISH_ENTRY(slot, entry) \
+  (*(void * volatile *) &(slot) = (void *) (entry))
+#else
+#define NO_TABLE_CACHE
+#endif
+
+
+/* One entry per distinct (quality, force_baseline) pair.
+ * quantval[0] is the luminance table, quantval[1] the chrominance table,
+ * exactly as jm_jpeg_set_linear_quality installs them in slots 0 and 1.
+ */
+
+#define QUALITY_CACHE_SIZE  101	/* qualities 1..100, index 0 unused */
+
+/* Integer DCT methods with cached divisors */
+#define DIVISOR_ISLOW	0
+#define DIVISOR_IFAST	1
+#define DIVISOR_METHODS	2
+
+typedef struct {
+  UINT16 quantval[2][DCTSIZE2];	/* scaled quantization tables */
+  /* post-DCT divisors per DIVISOR_* method and table, natural order */
+  DCTELEM divisors[DIVISOR_METHODS][2][DCTSIZE2];
+} quality_cache_entry;
+
+static quality_cache_entry * quality_cache[2][QUALITY_CACHE_SIZE];
+
+
+/* Derived Huffman tables are keyed by the table definition itself.
+ * The standard tables are the same for every quality, so in practice
+ * four slots are used; the rest absorb a few custom tables.  Optimal
+ * tables made with optimize_coding are specific to one image and are
+ * never stored.  Once all slots are taken, further tables are derived
+ * per image as before.
+ */
+
+#define HUFF_CACHE_SIZE  8
+
+typedef struct {
+  boolean isDC;
+  UINT8 bits[17];		/* copy of JHUFF_TBL bits[] */
+  UINT8 huffval[256];		/* copy of JHUFF_TBL huffval[] */
+  c_derived_tbl dtbl;		/* derived encoding table */
+} huff_cache_entry;
+
+static huff_cache_entry * huff_cache[HUFF_CACHE_SIZE];
+
+
+LOCAL(int)
+clamp_quality (int quality)
+/* Same safety limits as jm_jpeg_quality_scaling */
+{
+  if (quality <= 0) quality = 1;
+  if (quality > 100) quality = 100;
+  return quality;
+}
+
+
+/*
+ * Quantization tables.
+ */
+
+GLOBAL(boolean)
+jm_jpeg_cached_quality (j_compress_ptr cinfo, int quality,
+			boolean force_baseline)
+/* If tables for this quality have been computed before, install them in
+ * slots 0 and 1 and return TRUE; otherwise leave cinfo alone.
+ */
+{
+  quality_cache_entry * entry;
+  JQUANT_TBL ** qtblptr;
+  int i;
+
+#ifdef NO_TABLE_CACHE
+  return FALSE;
+#else
+  entry = LOAD_ENTRY(quality_cache[force_baseline ? 1 : 0]
+				  [clamp_quality(quality)]);
+  if (entry == NULL)
+    return FALSE;
+
+  /* Safety check to ensure start_compress not called yet. */
+  if (cinfo->global_state != CSTATE_START)
+    ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
+
+  for (i = 0; i < 2; i++) {
+    qtblptr = & cinfo->quant_tbl_ptrs[i];
+    if (*qtblptr == NULL)
+      *qtblptr = jm_jpeg_alloc_quant_table((j_common_ptr) cinfo);
+    MEMCOPY((*qtblptr)->quantval, entry->quantval[i],
+	    SIZEOF((*qtblptr)->quantval));
+    /* Initialize sent_table FALSE so table will be written to JPEG file. */
+    (*qtblptr)->sent_table = FALSE;
+  }
+  return TRUE;
+#endif
+}
+
+
+GLOBAL(void)
+jm_jpeg_store_quality (j_compress_ptr cinfo, int quality,
+		       boolean force_baseline)
+/* Remember the tables jm_jpeg_set_quality has just placed in slots 0/1 */
+{
+#ifndef NO_TABLE_CACHE
+  quality_cache_entry ** slot;
+  quality_cache_entry * entry;
+  int i;
+
+  slot = & quality_cache[force_baseline ? 1 : 0][clamp_quality(quality)];
+  if (LOAD_ENTRY(*slot) != NULL)
+    return;
+
+  entry = (quality_cache_entry *)
+    jm_jpeg_get_small((j_common_ptr) cinfo, SIZEOF(quality_cache_entry));
+  if (entry == NULL)
+    return;			/* no room for the cache is not an error */
+
+  MEMZERO(entry, SIZEOF(quality_cache_entry));
+  for (i = 0; i < 2; i++) {
+    MEMCOPY(entry->quantval[i], cinfo->quant_tbl_ptrs[i]->quantval,
+	    SIZEOF(entry->quantval[i]));
+#ifdef DCT_ISLOW_SUPPORTED
+    jm_jpeg_compute_divisors(JDCT_ISLOW, entry->quantval[i],
+			     entry->divisors[DIVISOR_ISLOW][i]);
+#endif
+#ifdef DCT_IFAST_SUPPORTED
+    jm_jpeg_compute_divisors(JDCT_IFAST, entry->quantval[i],
+			     entry->divisors[DIVISOR_IFAST][i]);
+#endif
+  }
+  PUBLISH_ENTRY(*slot, entry);	/* never written again */
+#endif
+}
+
+
+/*
+ * Forward-DCT divisors.
+ */
+
+GLOBAL(DCTELEM *)
+jm_jpeg_cached_divisors (j_compress_ptr cinfo, JQUANT_TBL * qtbl)
+/* Return the shared divisor table for qtbl, or NULL if there is none.
+ * The result must be treated as read-only.
+ */
+{
+#ifndef NO_TABLE_CACHE
+  quality_cache_entry * entry;
+  int method, b, q, i;
+
+  switch (cinfo->dct_method) {
+#ifdef DCT_ISLOW_SUPPORTED
+  case JDCT_ISLOW:
+    method = DIVISOR_ISLOW;
+    break;
+#endif
+#ifdef DCT_IFAST_SUPPORTED
+  case JDCT_IFAST:
+    method = DIVISOR_IFAST;
+    break;
+#endif
+  default:
+    return NULL;
+  }
+
+  for (b = 0; b < 2; b++) {
+    for (q = 1; q < QUALITY_CACHE_SIZE; q++) {
+      entry = LOAD_ENTRY(quality_cache[b][q]);
+      if (entry == NULL)
+	continue;
+      for (i = 0; i < 2; i++) {
+	if (MEMCMP(entry->quantval[i], qtbl->quantval,
+		   SIZEOF(entry->quantval[i])) == 0)
+	  return entry->divisors[method][i];
+      }
+    }
+  }
+#endif
+  return NULL;
+}
+
+
+/*
+ * Derived Huffman tables.
+ */
+
+GLOBAL(void)
+jm_jpeg_cached_c_derived_tbl (j_compress_ptr cinfo, boolean isDC, int tblno,
+			      c_derived_tbl ** pdtbl,
+			      c_derived_tbl ** pprivate)
+/* Point *pdtbl at the derived form of the given Huffman table.
+ * The shared copy is used when available; otherwise the table is derived
+ * into *pprivate (allocated on first use, image lifespan) exactly as
+ * jm_jpeg_make_c_derived_tbl would do, and added to the cache if there
+ * is a free slot and the table is not an optimal one.  *pdtbl must never
+ * be written through.
+ */
+{
+  JHUFF_TBL *htbl;
+  huff_cache_entry * entry;
+  int i, nsymbols;
+
+  if (tblno < 0 || tblno >= NUM_HUFF_TBLS)
+    ERREXIT1(cinfo, JERR_NO_HUFF_TABLE, tblno);
+  htbl =
+    isDC ? cinfo->dc_huff_tbl_ptrs[tblno] : cinfo->ac_huff_tbl_ptrs[tblno];
+  if (htbl == NULL)
+    ERREXIT1(cinfo, JERR_NO_HUFF_TABLE, tblno);
+
+  nsymbols = 0;
+  for (i = 1; i <= 16; i++)
+    nsymbols += htbl->bits[i];
+  if (nsymbols > 256)		/* let make_c_derived_tbl complain */
+    nsymbols = 256;
+
+#ifndef NO_TABLE_CACHE
+  for (i = 0; i < HUFF_CACHE_SIZE; i++) {
+    entry = LOAD_ENTRY(huff_cache[i]);
+    if (entry == NULL)
+      break;
+    if (entry->isDC == isDC &&
+	MEMCMP(entry->bits, htbl->bits, SIZEOF(entry->bits)) == 0 &&
+	MEMCMP(entry->huffval, htbl->huffval, nsymbols) == 0) {
+      *pdtbl = &entry->dtbl;
+      return;
+    }
+  }
+#else
+  i = HUFF_CACHE_SIZE;
+#endif
+
+  /* Not cached: derive (and validate) the table privately */
+  jm_jpeg_make_c_derived_tbl(cinfo, isDC, tblno, pprivate);
+  *pdtbl = *pprivate;
+
+  if (i >= HUFF_CACHE_SIZE || cinfo->optimize_coding)
+    return;			/* keep the private copy */
+
+  entry = (huff_cache_entry *)
+    jm_jpeg_get_small((j_common_ptr) cinfo, SIZEOF(huff_cache_entry));
+  if (entry == NULL)
+    return;
+  entry->isDC = isDC;
+  MEMCOPY(entry->bits, htbl->bits, SIZEOF(entry->bits));
+  MEMZERO(entry->huffval, SIZEOF(entry->huffval));
+  MEMCOPY(entry->huffval, htbl->huffval, nsymbols);
+  MEMCOPY(&entry->dtbl, *pprivate, SIZEOF(c_derived_tbl));
+#ifndef NO_TABLE_CACHE
+  PUBLISH_ENTRY(huff_cache[i], entry);	/* never written again */
+#endif
+}
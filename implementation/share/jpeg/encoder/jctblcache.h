@@ -0,0 +1,61 @@
+/*
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation. 
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt). 
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA 
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */ 
+/*
+ * jctblcache.h
+ *
+ * This file contains declarations for the process-wide cache of
+ * compression tables (jctblcache.c).  Only the compressor modules that
+ * set up quantization, DCT divisor and Huffman tables need to see these.
+ * Include jdct.h and jchuff.h before this file.
+ */
+
+/* Short forms of external names for systems with brain-damaged linkers. */
+
+#ifdef NEED_SHORT_EXTERNAL_NAMES
+#define jm_jpeg_cached_quality	jCachedQuality
+#define jm_jpeg_store_quality	jStoreQuality
+#define jm_jpeg_cached_divisors	jCachedDivisors
+#define jm_jpeg_compute_divisors	jComputeDivisors
+#define jm_jpeg_cached_c_derived_tbl	jCachedCDerived
+#endif /* NEED_SHORT_EXTERNAL_NAMES */
+
+/* Install the quantization tables of a previously seen quality setting */
+EXTERN(boolean) jm_jpeg_cached_quality
+	JPP((j_compress_ptr cinfo, int quality, boolean force_baseline));
+/* Remember the tables just installed by jm_jpeg_set_quality */
+EXTERN(void) jm_jpeg_store_quality
+	JPP((j_compress_ptr cinfo, int quality, boolean force_baseline));
+
+/* Look up the FDCT divisors derived from a quantization table */
+EXTERN(DCTELEM *) jm_jpeg_cached_divisors
+	JPP((j_compress_ptr cinfo, JQUANT_TBL * qtbl));
+/* Compute JDCT_ISLOW or JDCT_IFAST divisors (jcdctmgr.c) */
+EXTERN(void) jm_jpeg_compute_divisors
+	JPP((J_DCT_METHOD dct_method, const UINT16 * quantval,
+	     DCTELEM * dtbl));
+
+/* Shared replacement for jm_jpeg_make_c_derived_tbl */
+EXTERN(void) jm_jpeg_cached_c_derived_tbl
+	JPP((j_compress_ptr cinfo, boolean isDC, int tblno,
+	     c_derived_tbl ** pdtbl, c_derived_tbl ** pprivate));
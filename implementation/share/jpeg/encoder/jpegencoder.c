@@ -49,6 +49,7 @@ are used only in one (current) file ...
 #include "jpeg_encoder_api.h"
 */
 #include "jpeglib.h"
+#include "jerror.h"
 
 /****************************************************************
  * Structs for JPEG encoder
@@ -142,6 +143,51 @@ jmf_error_exit (j_common_ptr cinfo)
     longjmp(myerr->setjmp_buffer, 1);
 }
 
+/****************************************************************
+ * Input pixel conversion
+ ****************************************************************/
+
+/*
+ * Converts one line of BGR, XRGB or BGRX pixels to the RGB order the
+ * compressor takes.
+ */
+static void
+jmf_swap_line(char *rgbLine, const char *srcLine, int width,
+              JPEG_ENCODER_INPUT_COLOR_FORMAT colorFormat)
+{
+    int i;
+
+    switch(colorFormat) {
+
+    case JPEG_ENCODER_COLOR_BGR:
+        for (i = 0; i < width; i++) {
+            *rgbLine++ = srcLine[2]; /* R */
+            *rgbLine++ = srcLine[1]; /* G */
+            *rgbLine++ = srcLine[0]; /* B */
+            srcLine+=3;
+        }
+        break;
+    case JPEG_ENCODER_COLOR_XRGB:
+        for (i = 0; i < width; i++) {
+            srcLine++; /* A */
+            *rgbLine++ = *srcLine++; /* R */
+            *rgbLine++ = *srcLine++; /* G */
+            *rgbLine++ = *srcLine++; /* B */
+        }
+        break;
+    case JPEG_ENCODER_COLOR_BGRX:
+        for (i = 0; i < width; i++) {
+            *rgbLine++ = srcLine[2]; /* R */
+            *rgbLine++ = srcLine[1]; /* G */
+            *rgbLine++ = srcLine[0]; /* B */
+            srcLine+=4; /* A */
+        }
+        break;
+    default:
+        break;
+    }
+}
+
 /****************************************************************
  * encoder creation, invocation and destruction methods
  ****************************************************************/
@@ -339,41 +385,13 @@ RGB_To_JPEG_encode(struct jpeg_compress_struct *cinfo,
 
         while (cinfo->next_scanline < cinfo->image_height) {
             if (need_swap) {
-                int i;
                 char *rgbLine = tmpLine;
 
                 char *srcLine = (char *) &inData[start +
                              direction * cinfo->next_scanline * rowStride];
 
-                switch(colorFormat) {     
-
-                case JPEG_ENCODER_COLOR_BGR:
-                    for (i = 0; i < (int) cinfo->image_width; i++) {
-                        *rgbLine++ = srcLine[2]; /* R */
-                        *rgbLine++ = srcLine[1]; /* G */ 
-                        *rgbLine++ = srcLine[0]; /* B */
-                        srcLine+=3;
-                    }
-                    break;
-                case JPEG_ENCODER_COLOR_XRGB:
-                    for (i = 0; i < (int) cinfo->image_width; i++) {
-                        srcLine++; /* A */
-                        *rgbLine++ = *srcLine++; /* R */
-                        *rgbLine++ = *srcLine++; /* G */
-                        *rgbLine++ = *srcLine++; /* B */
-                    }
-                    break;
-                case JPEG_ENCODER_COLOR_BGRX:
-                    for (i = 0; i < (int) cinfo->image_width; i++) {
-                        *rgbLine++ = srcLine[2]; /* R */
-                        *rgbLine++ = srcLine[1]; /* G */
-                        *rgbLine++ = srcLine[0]; /* B */
-                        srcLine+=4; /* A */
-                    }
-                    break;
-                default:
-                    break;
-                }
+                jmf_swap_line(rgbLine, srcLine, (int) cinfo->image_width,
+                              colorFormat);
                 row_pointer[0] = tmpLine;
             } else {
                 row_pointer[0] = &inData[start +
@@ -407,3 +425,252 @@ RGBToJPEG(char *inData, int width, int height, int quality, char *outData,
 
     return result;
 }
+
+/****************************************************************
+ * Streaming encoder
+ ****************************************************************/
+
+/* State of a streaming encode, allocated in one piece */
+typedef struct {
+    struct jpeg_compress_struct cinfo;
+    struct jmf_error_mgr jerr;
+    struct jpeg_destination_mgr dest;
+    JPEG_ENCODER_SINK sink;
+    void *sinkData;
+    JPEG_ENCODER_INPUT_COLOR_FORMAT colorFormat;
+    int pixelStride;
+    char *tmpLine;          /* RGB line for formats that need swapping */
+    int length;             /* bytes handed to the sink so far */
+    int failed;
+    JOCTET buffer[JMF_OUTPUT_BUF_SIZE];
+} jmf_stream;
+
+/* Hands the first count bytes of the buffer to the sink and empties it */
+static void
+jmf_stream_send(j_compress_ptr cinfo, int count)
+{
+    jmf_stream *stream = (jmf_stream *) cinfo->client_data;
+
+    if (count > 0) {
+        if (!stream->sink(stream->sinkData, (const char *) stream->buffer,
+                          count)) {
+            ERREXIT(cinfo, JERR_FILE_WRITE);
+        }
+        stream->length += count;
+    }
+    stream->dest.next_output_byte = stream->buffer;
+    stream->dest.free_in_buffer = JMF_OUTPUT_BUF_SIZE;
+}
+
+/* Hands the compressed bytes collected so far to the sink */
+static void
+jmf_stream_flush(j_compress_ptr cinfo)
+{
+    jmf_stream *stream = (jmf_stream *) cinfo->client_data;
+
+    jmf_stream_send(cinfo,
+                    JMF_OUTPUT_BUF_SIZE - (int) stream->dest.free_in_buffer);
+}
+
+METHODDEF(void)
+jmf_stream_init_destination (j_compress_ptr cinfo)
+{
+    jmf_stream *stream = (jmf_stream *) cinfo->client_data;
+
+    stream->dest.next_output_byte = stream->buffer;
+    stream->dest.free_in_buffer = JMF_OUTPUT_BUF_SIZE;
+}
+
+METHODDEF(boolean)
+jmf_stream_empty_output_buffer (j_compress_ptr cinfo)
+{
+    /* The buffer is full; free_in_buffer may not be up to date here */
+    jmf_stream_send(cinfo, JMF_OUTPUT_BUF_SIZE);
+    return TRUE;
+}
+
+METHODDEF(void)
+jmf_stream_term_destination (j_compress_ptr cinfo)
+{
+    jmf_stream_flush(cinfo);
+}
+
+void *
+RGB_To_JPEG_stream_init(int width, int height, int quality,
+                        JPEG_ENCODER_INPUT_COLOR_FORMAT colorFormat,
+                        JPEG_ENCODER_SINK sink, void *sinkData)
+{
+    jmf_stream *stream;
+    struct jpeg_compress_struct *cinfo;
+    int pixelStride, need_swap;
+
+    switch(colorFormat) {
+    case JPEG_ENCODER_COLOR_GRAYSCALE:
+        pixelStride = 1;
+        need_swap = 0;
+        break;
+    case JPEG_ENCODER_COLOR_RGB:
+        pixelStride = 3;
+        need_swap = 0;
+        break;
+    case JPEG_ENCODER_COLOR_BGR:
+        pixelStride = 3;
+        need_swap = 1;
+        break;
+    case JPEG_ENCODER_COLOR_XRGB:
+    case JPEG_ENCODER_COLOR_BGRX:
+        pixelStride = 4;
+        need_swap = 1;
+        break;
+    default:
+        return NULL;
+    }
+    if (width <= 0 || height <= 0 || sink == NULL) {
+        return NULL;
+    }
+
+    stream = (jmf_stream *) MNI_MALLOC(sizeof(jmf_stream));
+    if (stream == NULL) {
+        return NULL;
+    }
+    stream->tmpLine = NULL;
+    if (need_swap) {
+        stream->tmpLine = (char *) MNI_MALLOC(width * 3);
+        if (stream->tmpLine == NULL) {
+            MNI_FREE(stream);
+            return NULL;
+        }
+    }
+    stream->sink = sink;
+    stream->sinkData = sinkData;
+    stream->colorFormat = colorFormat;
+    stream->pixelStride = pixelStride;
+    stream->length = 0;
+    stream->failed = 0;
+
+    cinfo = &stream->cinfo;
+    cinfo->err = jm_jpeg_std_error(&stream->jerr.pub);
+    stream->jerr.pub.error_exit = jmf_error_exit;
+
+    /* Establish the setjmp return context for jmf_error_exit to use. */
+    if (setjmp(stream->jerr.setjmp_buffer)) {
+        /* If we get here, the JPEG code has signaled an error. */
+        jm_jpeg_destroy_compress(cinfo);
+        if (stream->tmpLine != NULL) {
+            MNI_FREE(stream->tmpLine);
+        }
+        MNI_FREE(stream);
+        return NULL;
+    }
+
+    jpeg_create_compress(cinfo);
+
+    stream->dest.init_destination = jmf_stream_init_destination;
+    stream->dest.empty_output_buffer = jmf_stream_empty_output_buffer;
+    stream->dest.term_destination = jmf_stream_term_destination;
+    cinfo->dest = &stream->dest;
+    cinfo->client_data = stream;
+
+    cinfo->image_width = width;
+    cinfo->image_height = height;
+    if (colorFormat == JPEG_ENCODER_COLOR_GRAYSCALE) {
+        cinfo->input_components = 1;
+        cinfo->in_color_space = JCS_GRAYSCALE;
+    } else {
+        cinfo->input_components = 3;
+        cinfo->in_color_space = JCS_RGB;
+    }
+    /* Defaults give YUV 4:2:0 and single-pass Huffman coding, so every
+     * iMCU row is entropy coded as soon as its input lines are complete.
+     */
+    jm_jpeg_set_defaults(cinfo);
+    jm_jpeg_set_quality(cinfo, quality, TRUE);
+
+    /* Emits the headers */
+    jm_jpeg_start_compress(cinfo, TRUE);
+    jmf_stream_flush(cinfo);
+
+    return stream;
+}
+
+/* Compresses rows, flushing each completed iMCU row; may longjmp */
+static void
+jmf_stream_rows(jmf_stream *stream, char *inData, int rowStride,
+                int numRows)
+{
+    struct jpeg_compress_struct *cinfo = &stream->cinfo;
+    JSAMPROW row_pointer[1];	/* pointer to JSAMPLE row[s] */
+    JDIMENSION imcuHeight;
+
+    imcuHeight = (JDIMENSION) (cinfo->max_v_samp_factor * DCTSIZE);
+    while (numRows > 0 && cinfo->next_scanline < cinfo->image_height) {
+        if (stream->tmpLine != NULL) {
+            jmf_swap_line(stream->tmpLine, inData, (int) cinfo->image_width,
+                          stream->colorFormat);
+            row_pointer[0] = (JSAMPROW) stream->tmpLine;
+        } else {
+            row_pointer[0] = (JSAMPROW) inData;
+        }
+        (void) jm_jpeg_write_scanlines(cinfo, row_pointer, 1);
+        /* An iMCU row has just been compressed */
+        if (cinfo->next_scanline % imcuHeight == 0 ||
+            cinfo->next_scanline == cinfo->image_height) {
+            jmf_stream_flush(cinfo);
+        }
+        inData += rowStride;
+        numRows--;
+    }
+}
+
+int
+RGB_To_JPEG_stream_write(void *encoder, char *inData, int rowStride,
+                         int numRows)
+{
+    jmf_stream *stream = (jmf_stream *) encoder;
+
+    if (stream->failed) {
+        return 0;
+    }
+    if (setjmp(stream->jerr.setjmp_buffer)) {
+        /* If we get here, the JPEG code has signaled an error. */
+        stream->failed = 1;
+        return 0;
+    }
+    /* the rows advance in a separate frame, nothing here is clobbered */
+    jmf_stream_rows(stream, inData, rowStride, numRows);
+    return 1;
+}
+
+int
+RGB_To_JPEG_stream_finish(void *encoder)
+{
+    jmf_stream *stream = (jmf_stream *) encoder;
+    struct jpeg_compress_struct *cinfo = &stream->cinfo;
+
+    if (stream->failed) {
+        return 0;
+    }
+    if (setjmp(stream->jerr.setjmp_buffer)) {
+        /* If we get here, the JPEG code has signaled an error. */
+        stream->failed = 1;
+        return 0;
+    }
+    /* Fails if fewer lines than the image height were written */
+    jm_jpeg_finish_compress(cinfo);
+    return stream->length;
+}
+
+void
+RGB_To_JPEG_stream_free(void *encoder)
+{
+    jmf_stream *stream = (jmf_stream *) encoder;
+
+    if (stream == NULL) {
+        return;
+    }
+    jm_jpeg_destroy_compress(&stream->cinfo);
+    if (stream->tmpLine != NULL) {
+        MNI_FREE(stream->tmpLine);
+    }
+    MNI_FREE(stream);
+}
@@ -0,0 +1,118 @@
+/*
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation. 
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt). 
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA 
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */ 
+#ifndef __JPEG_TRANSFORM_H__
+#define __JPEG_TRANSFORM_H__
+
+/*
+ * Lossless transformations applied to the DCT coefficients of a JPEG image.
+ * Rotations are clockwise.
+ */
+typedef enum {
+    JPEG_TRANSFORM_NONE = 0,
+    JPEG_TRANSFORM_FLIP_H,      /* mirror left to right */
+    JPEG_TRANSFORM_FLIP_V,      /* mirror top to bottom */
+    JPEG_TRANSFORM_TRANSPOSE,   /* mirror across the main diagonal */
+    JPEG_TRANSFORM_TRANSVERSE,  /* mirror across the other diagonal */
+    JPEG_TRANSFORM_ROT_90,
+    JPEG_TRANSFORM_ROT_180,
+    JPEG_TRANSFORM_ROT_270
+} JPEG_TRANSFORM_TYPE;
+
+/* Flags for JPEG_FitToSize */
+/* Place the first search steps using a size estimate computed from
+ * coefficient statistics, usually saving half of the trial encodings
+ */
+#define JPEG_FIT_USE_ESTIMATOR      0x01
+/* Reduce the image dimensions when quality alone is not enough */
+#define JPEG_FIT_ALLOW_DOWNSCALE    0x02
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Rotates or flips a JPEG image without decoding it to pixels.
+ * The quantized DCT coefficients are read with jpeg_read_coefficients,
+ * blocks are moved and transposed and coefficient signs adjusted, and
+ * the result is written with jpeg_write_coefficients, so no quality is
+ * lost and no IDCT/FDCT work is done.
+ *
+ * A transformation that mirrors an edge which is not a multiple of the
+ * MCU size (8 or 16 pixels) drops the partial MCU column or row there,
+ * as it cannot be moved losslessly.  Images smaller than one MCU along
+ * such an edge cannot be transformed that way.
+ *
+ * Markers other than the JFIF header are not copied to the output.
+ *
+ * @param inData JPEG data
+ * @param inDataLen length of inData
+ * @param outData buffer where the transformed JPEG data is written
+ * @param outDataLen size of outData; output is normally about the size
+ *        of the input
+ * @param transform transformation to apply
+ * @param width pointer where to store the output image width, may be NULL
+ * @param height pointer where to store the output image height, may be NULL
+ * @return size of transformed image in bytes, 0 on failure
+ *         (including outData being too small)
+ */
+int JPEG_Transform(char *inData, int inDataLen,
+                   char *outData, int outDataLen,
+                   JPEG_TRANSFORM_TYPE transform,
+                   int *width, int *height);
+
+/**
+ * Recompresses a JPEG image so that it takes at most targetSize bytes,
+ * e.g. to meet a message size limit, without going back to pixels.
+ * The quantized DCT coefficients are requantized with the standard tables
+ * of a lower quality (never finer than the tables of the input), and the
+ * highest quality that fits is found by a binary search, each step being
+ * only an entropy encoding.  The output uses optimized Huffman tables.
+ *
+ * If the input already fits it is copied unchanged.  If even minQuality
+ * does not fit and JPEG_FIT_ALLOW_DOWNSCALE is given, the image is
+ * decoded at 1/2, then 1/4 and 1/8 of its size with the reduced-size
+ * IDCT, and the search repeated on the smaller image.
+ *
+ * @param inData JPEG data
+ * @param inDataLen length of inData
+ * @param outData buffer where the recompressed JPEG data is written
+ * @param outDataLen size of outData
+ * @param targetSize maximum size of the result in bytes
+ * @param minQuality lowest quality (1..100) the search may go down to
+ * @param flags combination of JPEG_FIT_* flags
+ * @param width pointer where to store the output image width, may be NULL
+ * @param height pointer where to store the output image height, may be NULL
+ * @return size of the recompressed image in bytes, 0 if the image could
+ *         not be made small enough or on failure
+ */
+int JPEG_FitToSize(char *inData, int inDataLen,
+                   char *outData, int outDataLen,
+                   int targetSize, int minQuality, int flags,
+                   int *width, int *height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __JPEG_TRANSFORM_H__ */
@@ -0,0 +1,1224 @@
+/*
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation. 
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt). 
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA 
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */ 
+/*
+ * jpegtransform.c
+ *
+ * Operations on JPEG images in the DCT domain: lossless rotation and
+ * mirroring, and recompression to a size limit by requantization.
+ *
+ * The quantized coefficient blocks of every component are rearranged
+ * without going back to pixels: each 8x8 block is moved to its new
+ * position, transposed if the operation swaps the axes, and coefficients
+ * of odd horizontal (vertical) frequency change sign when the block is
+ * mirrored horizontally (vertically).  This follows the approach of the
+ * IJG jpegtran utility.
+ */
+
+#include "mni.h"
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jerror.h"
+#include <setjmp.h>
+
+#include "jpegtransform.h"
+
+/****************************************************************
+ * Structs for JPEG transformer
+ ****************************************************************/
+
+typedef struct {
+    struct jpeg_source_mgr pub; /* public fields */
+    char *data;
+    int length;
+} jtr_source_mgr;
+
+typedef jtr_source_mgr * jtr_src_ptr;
+
+#define JTR_SPILL_SIZE  4096	/* scratch for output that does not fit */
+
+typedef struct {
+    struct jpeg_destination_mgr pub; /* public fields */
+    char *data;
+    int length;
+    boolean count_only;     /* measure output that overflows data */
+    boolean overflowed;     /* output has gone past data into spill */
+    long spilled;           /* bytes written to spill before the current fill */
+    JOCTET spill[JTR_SPILL_SIZE];
+} jtr_destination_mgr;
+
+typedef jtr_destination_mgr * jtr_dest_ptr;
+
+struct jtr_error_mgr {
+    struct jpeg_error_mgr pub;	/* "public" fields */
+    jmp_buf setjmp_buffer;	/* for return to caller */
+};
+
+typedef struct jtr_error_mgr * jtr_error_ptr;
+
+/* Destination that grows in memory, for intermediate images */
+typedef struct {
+    struct jpeg_destination_mgr pub; /* public fields */
+    char *data;
+    int length;
+} jtr_grow_destination_mgr;
+
+typedef jtr_grow_destination_mgr * jtr_grow_dest_ptr;
+
+#define JTR_HIST_BINS  17	/* magnitude bit lengths 0..16 */
+
+/* Coefficient statistics of the source image for the size estimator */
+typedef struct {
+    /* Per component and coefficient: how many dequantized values
+     * (DC: differences) need 0, 1, ... 16 bits
+     */
+    long (*hist)[DCTSIZE2][JTR_HIST_BINS];
+    long blocks;            /* total number of blocks */
+    double scale;           /* measured/estimated size ratio */
+} jtr_size_stats;
+
+/* Everything one transformation needs, allocated in one piece */
+typedef struct {
+    struct jpeg_decompress_struct srcinfo;
+    struct jpeg_compress_struct dstinfo;
+    struct jtr_error_mgr jerr;
+    jtr_source_mgr src;
+    jtr_destination_mgr dest;
+    jtr_grow_destination_mgr grow_dest;
+} jtr_context;
+
+/* How a transformation maps destination blocks onto source blocks */
+typedef struct {
+    boolean transpose;  /* destination x comes from source y */
+    boolean flip_x;     /* destination x runs backwards through the source */
+    boolean flip_y;     /* destination y runs backwards through the source */
+} jtr_transform_info;
+
+static const JOCTET jtr_fake_eoi[2] = { (JOCTET) 0xFF, (JOCTET) JPEG_EOI };
+
+/****************************************************************
+ * Source manager implementation for transformer
+ ****************************************************************/
+
+METHODDEF(void)
+jtr_init_source (j_decompress_ptr cinfo)
+{
+    jtr_src_ptr src = (jtr_src_ptr) cinfo->src;
+
+    src->pub.next_input_byte = (JOCTET *) src->data;
+    src->pub.bytes_in_buffer = (size_t) src->length;
+}
+
+METHODDEF(boolean)
+jtr_fill_input_buffer (j_decompress_ptr cinfo)
+{
+    jtr_src_ptr src = (jtr_src_ptr) cinfo->src;
+
+    /* The whole image is in memory: running out means truncated data.
+     * Insert a fake EOI marker so the decoder terminates cleanly.
+     */
+    WARNMS(cinfo, JWRN_JPEG_EOF);
+    src->pub.next_input_byte = jtr_fake_eoi;
+    src->pub.bytes_in_buffer = 2;
+    return TRUE;
+}
+
+METHODDEF(void)
+jtr_skip_input_data (j_decompress_ptr cinfo, long num_bytes)
+{
+    jtr_src_ptr src = (jtr_src_ptr) cinfo->src;
+
+    if (num_bytes <= 0) {
+        return;
+    }
+    if ((size_t) num_bytes > src->pub.bytes_in_buffer) {
+        (void) jtr_fill_input_buffer(cinfo);
+        return;
+    }
+    src->pub.next_input_byte += (size_t) num_bytes;
+    src->pub.bytes_in_buffer -= (size_t) num_bytes;
+}
+
+METHODDEF(void)
+jtr_term_source (j_decompress_ptr cinfo)
+{
+    (void)cinfo;
+}
+
+/****************************************************************
+ * Destination manager implementation for transformer
+ ****************************************************************/
+
+METHODDEF(void)
+jtr_init_destination (j_compress_ptr cinfo)
+{
+    jtr_dest_ptr dest = (jtr_dest_ptr) cinfo->dest;
+
+    dest->pub.next_output_byte = (JOCTET *) dest->data;
+    dest->pub.free_in_buffer = (size_t) dest->length;
+    dest->overflowed = FALSE;
+    dest->spilled = 0;
+}
+
+METHODDEF(boolean)
+jtr_empty_output_buffer (j_compress_ptr cinfo)
+{
+    jtr_dest_ptr dest = (jtr_dest_ptr) cinfo->dest;
+
+    /* Output goes straight into the caller's buffer, which is full */
+    if (!dest->count_only) {
+        ERREXIT(cinfo, JERR_FILE_WRITE);
+    }
+    /* When only the size matters keep going, recycling the spill area */
+    if (dest->overflowed) {
+        dest->spilled += JTR_SPILL_SIZE;
+    }
+    dest->overflowed = TRUE;
+    dest->pub.next_output_byte = dest->spill;
+    dest->pub.free_in_buffer = JTR_SPILL_SIZE;
+    return TRUE;
+}
+
+METHODDEF(void)
+jtr_term_destination (j_compress_ptr cinfo)
+{
+    (void)cinfo;
+}
+
+/*
+ * Number of bytes the last compression produced, including any that did
+ * not fit into the output buffer.
+ */
+LOCAL(long)
+jtr_output_size (jtr_context *ctx)
+{
+    jtr_dest_ptr dest = &ctx->dest;
+
+    if (dest->overflowed) {
+        return (long) dest->length + dest->spilled +
+            (long) (JTR_SPILL_SIZE - dest->pub.free_in_buffer);
+    }
+    return (long) dest->length - (long) dest->pub.free_in_buffer;
+}
+
+METHODDEF(void)
+jtr_init_grow_destination (j_compress_ptr cinfo)
+{
+    jtr_grow_dest_ptr dest = (jtr_grow_dest_ptr) cinfo->dest;
+
+    dest->pub.next_output_byte = (JOCTET *) dest->data;
+    dest->pub.free_in_buffer = (size_t) dest->length;
+}
+
+METHODDEF(boolean)
+jtr_empty_grow_buffer (j_compress_ptr cinfo)
+{
+    jtr_grow_dest_ptr dest = (jtr_grow_dest_ptr) cinfo->dest;
+    char *data;
+    int length;
+
+    /* The buffer is full: double it */
+    length = dest->length * 2;
+    data = (char *) MNI_MALLOC(length);
+    if (data == NULL) {
+        ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+    }
+    MEMCOPY(data, dest->data, dest->length);
+    MNI_FREE(dest->data);
+    dest->pub.next_output_byte = (JOCTET *) (data + dest->length);
+    dest->pub.free_in_buffer = (size_t) (length - dest->length);
+    dest->data = data;
+    dest->length = length;
+    return TRUE;
+}
+
+/****************************************************************
+ * Error Manager implementation for transformer
+ ****************************************************************/
+
+METHODDEF(void)
+jtr_error_exit (j_common_ptr cinfo)
+{
+    jtr_error_ptr myerr = (jtr_error_ptr) cinfo->err;
+
+    (myerr->pub.output_message)(cinfo);
+    longjmp(myerr->setjmp_buffer, 1);
+}
+
+/****************************************************************
+ * Context management
+ ****************************************************************/
+
+/*
+ * Allocates a zeroed context with its error manager installed.  The JPEG
+ * objects are created by jtr_create_objects once the caller has set up
+ * the setjmp context, so that allocation failures there are caught too.
+ */
+LOCAL(jtr_context *)
+jtr_alloc_context (void)
+{
+    jtr_context *ctx;
+
+    ctx = (jtr_context *) MNI_CALLOC(1, sizeof(jtr_context));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    ctx->srcinfo.err = jm_jpeg_std_error(&ctx->jerr.pub);
+    ctx->dstinfo.err = &ctx->jerr.pub;
+    ctx->jerr.pub.error_exit = jtr_error_exit;
+    return ctx;
+}
+
+LOCAL(void)
+jtr_create_objects (jtr_context *ctx)
+{
+    jpeg_create_decompress(&ctx->srcinfo);
+    jpeg_create_compress(&ctx->dstinfo);
+
+    ctx->src.pub.init_source = jtr_init_source;
+    ctx->src.pub.fill_input_buffer = jtr_fill_input_buffer;
+    ctx->src.pub.skip_input_data = jtr_skip_input_data;
+    ctx->src.pub.resync_to_restart = jm_jpeg_resync_to_restart;
+    ctx->src.pub.term_source = jtr_term_source;
+    ctx->srcinfo.src = &ctx->src.pub;
+
+    ctx->dest.pub.init_destination = jtr_init_destination;
+    ctx->dest.pub.empty_output_buffer = jtr_empty_output_buffer;
+    ctx->dest.pub.term_destination = jtr_term_destination;
+    ctx->dstinfo.dest = &ctx->dest.pub;
+
+    ctx->grow_dest.pub.init_destination = jtr_init_grow_destination;
+    ctx->grow_dest.pub.empty_output_buffer = jtr_empty_grow_buffer;
+    ctx->grow_dest.pub.term_destination = jtr_term_destination;
+}
+
+/* Destroying objects that were never created is harmless */
+LOCAL(void)
+jtr_free_context (jtr_context *ctx)
+{
+    jm_jpeg_destroy_compress(&ctx->dstinfo);
+    jm_jpeg_destroy_decompress(&ctx->srcinfo);
+    if (ctx->grow_dest.data != NULL) {
+        MNI_FREE(ctx->grow_dest.data);
+    }
+    MNI_FREE(ctx);
+}
+
+/* Takes effect at the next jpeg_read_header */
+LOCAL(void)
+jtr_set_source (jtr_context *ctx, char *data, int length)
+{
+    ctx->src.data = data;
+    ctx->src.length = length;
+    ctx->src.pub.next_input_byte = NULL;
+    ctx->src.pub.bytes_in_buffer = 0;
+}
+
+LOCAL(void)
+jtr_set_destination (jtr_context *ctx, char *data, int length,
+                     boolean count_only)
+{
+    ctx->dest.data = data;
+    ctx->dest.length = length;
+    ctx->dest.count_only = count_only;
+    ctx->dstinfo.dest = &ctx->dest.pub;
+}
+
+/****************************************************************
+ * Coefficient rearrangement
+ ****************************************************************/
+
+LOCAL(void)
+jtr_get_transform_info (JPEG_TRANSFORM_TYPE transform,
+                        jtr_transform_info *info)
+{
+    info->transpose = FALSE;
+    info->flip_x = FALSE;
+    info->flip_y = FALSE;
+
+    switch (transform) {
+    case JPEG_TRANSFORM_FLIP_H:
+        info->flip_x = TRUE;
+        break;
+    case JPEG_TRANSFORM_FLIP_V:
+        info->flip_y = TRUE;
+        break;
+    case JPEG_TRANSFORM_TRANSPOSE:
+        info->transpose = TRUE;
+        break;
+    case JPEG_TRANSFORM_TRANSVERSE:
+        info->transpose = TRUE;
+        info->flip_x = TRUE;
+        info->flip_y = TRUE;
+        break;
+    case JPEG_TRANSFORM_ROT_90:
+        /* transpose, then mirror horizontally */
+        info->transpose = TRUE;
+        info->flip_y = TRUE;
+        break;
+    case JPEG_TRANSFORM_ROT_180:
+        info->flip_x = TRUE;
+        info->flip_y = TRUE;
+        break;
+    case JPEG_TRANSFORM_ROT_270:
+        /* transpose, then mirror vertically */
+        info->transpose = TRUE;
+        info->flip_x = TRUE;
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Builds the per-coefficient source index and sign mask (0 or -1) of the
+ * block transformation.  flip_x and flip_y refer to the source axes: each
+ * mirroring negates the coefficients of odd frequency along its axis, so
+ * mirroring both ways negates those whose frequencies sum to an odd value.
+ */
+LOCAL(void)
+jtr_build_block_map (const jtr_transform_info *info,
+                     UINT8 src_index[DCTSIZE2], JCOEF sign_mask[DCTSIZE2])
+{
+    int v, u, su, sv;
+
+    for (v = 0; v < DCTSIZE; v++) {
+        for (u = 0; u < DCTSIZE; u++) {
+            if (info->transpose) {
+                sv = u;
+                su = v;
+            } else {
+                sv = v;
+                su = u;
+            }
+            src_index[v * DCTSIZE + u] = (UINT8) (sv * DCTSIZE + su);
+            sign_mask[v * DCTSIZE + u] =
+                (JCOEF) ((((info->flip_x ? su : 0) +
+                           (info->flip_y ? sv : 0)) & 1) ? -1 : 0);
+        }
+    }
+}
+
+/*
+ * Size of the source image in blocks that survives the transformation:
+ * an axis that is traversed backwards must consist of whole iMCUs, so a
+ * partial iMCU on that edge is dropped.
+ */
+LOCAL(boolean)
+jtr_trim_source (j_decompress_ptr srcinfo, const jtr_transform_info *info,
+                 JDIMENSION *width, JDIMENSION *height)
+{
+    JDIMENSION imcu_w = (JDIMENSION) (srcinfo->max_h_samp_factor * DCTSIZE);
+    JDIMENSION imcu_h = (JDIMENSION) (srcinfo->max_v_samp_factor * DCTSIZE);
+
+    *width = srcinfo->image_width;
+    *height = srcinfo->image_height;
+    if (info->flip_x) {
+        *width -= *width % imcu_w;
+    }
+    if (info->flip_y) {
+        *height -= *height % imcu_h;
+    }
+    return (*width > 0 && *height > 0) ? TRUE : FALSE;
+}
+
+LOCAL(void)
+jtr_transpose_quant_tables (j_compress_ptr dstinfo)
+{
+    int tblno, i, k;
+    JQUANT_TBL *qtbl;
+    UINT16 tmp;
+
+    for (tblno = 0; tblno < NUM_QUANT_TBLS; tblno++) {
+        qtbl = dstinfo->quant_tbl_ptrs[tblno];
+        if (qtbl == NULL) {
+            continue;
+        }
+        for (i = 0; i < DCTSIZE; i++) {
+            for (k = 0; k < i; k++) {
+                tmp = qtbl->quantval[i * DCTSIZE + k];
+                qtbl->quantval[i * DCTSIZE + k] =
+                    qtbl->quantval[k * DCTSIZE + i];
+                qtbl->quantval[k * DCTSIZE + i] = tmp;
+            }
+        }
+    }
+}
+
+/*
+ * Fills the destination coefficient arrays of one transformation.
+ * Source and destination arrays are accessed one block row at a time;
+ * destination padding blocks beyond the trimmed image are zeroed.
+ */
+LOCAL(void)
+jtr_execute_transform (j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
+                       const jtr_transform_info *info,
+                       jvirt_barray_ptr *src_coef_arrays,
+                       jvirt_barray_ptr *dst_coef_arrays)
+{
+    UINT8 src_index[DCTSIZE2];
+    JCOEF sign_mask[DCTSIZE2];
+    int ci, i;
+    JDIMENSION dst_w, dst_h, dst_cols, dst_rows, dx, dy, sx, sy;
+    jpeg_component_info *dstcomp;
+    JBLOCKROW dst_row, src_row;
+    JCOEFPTR src_block, dst_block;
+    JCOEF mask;
+
+    jtr_build_block_map(info, src_index, sign_mask);
+
+    for (ci = 0; ci < dstinfo->num_components; ci++) {
+        dstcomp = dstinfo->comp_info + ci;
+        /* Blocks that hold image data in this component */
+        dst_w = (JDIMENSION)
+            ((dstinfo->image_width * (long) dstcomp->h_samp_factor +
+              dstinfo->max_h_samp_factor * DCTSIZE - 1) /
+             (dstinfo->max_h_samp_factor * DCTSIZE));
+        dst_h = (JDIMENSION)
+            ((dstinfo->image_height * (long) dstcomp->v_samp_factor +
+              dstinfo->max_v_samp_factor * DCTSIZE - 1) /
+             (dstinfo->max_v_samp_factor * DCTSIZE));
+        /* The arrays cover whole iMCUs, and the compressor reads them so */
+        dst_cols = ((dstcomp->width_in_blocks + dstcomp->h_samp_factor - 1) /
+                    dstcomp->h_samp_factor) * dstcomp->h_samp_factor;
+        dst_rows = ((dstcomp->height_in_blocks + dstcomp->v_samp_factor - 1) /
+                    dstcomp->v_samp_factor) * dstcomp->v_samp_factor;
+
+        for (dy = 0; dy < dst_rows; dy++) {
+            dst_row = (*srcinfo->mem->access_virt_barray)
+                ((j_common_ptr) srcinfo, dst_coef_arrays[ci], dy,
+                 (JDIMENSION) 1, TRUE)[0];
+            src_row = NULL;
+            if (!info->transpose && dy < dst_h) {
+                sy = info->flip_y ? dst_h - 1 - dy : dy;
+                src_row = (*srcinfo->mem->access_virt_barray)
+                    ((j_common_ptr) srcinfo, src_coef_arrays[ci], sy,
+                     (JDIMENSION) 1, FALSE)[0];
+            }
+            for (dx = 0; dx < dst_cols; dx++) {
+                dst_block = dst_row[dx];
+                if (dx >= dst_w || dy >= dst_h) {
+                    MEMZERO(dst_block, SIZEOF(JBLOCK));
+                    continue;
+                }
+                if (info->transpose) {
+                    /* destination x indexes source rows */
+                    sx = info->flip_x ? dst_h - 1 - dy : dy;
+                    sy = info->flip_y ? dst_w - 1 - dx : dx;
+                    src_block = (*srcinfo->mem->access_virt_barray)
+                        ((j_common_ptr) srcinfo, src_coef_arrays[ci], sy,
+                         (JDIMENSION) 1, FALSE)[0][sx];
+                } else {
+                    sx = info->flip_x ? dst_w - 1 - dx : dx;
+                    src_block = src_row[sx];
+                }
+                for (i = 0; i < DCTSIZE2; i++) {
+                    mask = sign_mask[i];
+                    dst_block[i] = (JCOEF)
+                        ((src_block[src_index[i]] ^ mask) - mask);
+                }
+            }
+        }
+    }
+}
+
+/****************************************************************
+ * Recompression to a size limit
+ ****************************************************************/
+
+#define JTR_MAX_SCALE_DENOM   8   /* smallest downscale tried is 1/8 */
+#define JTR_SCALED_QUALITY   90   /* quality of downscaled intermediates */
+
+/* Size estimator constants, refined by measurement during a search */
+#define JTR_AC_SYMBOL_BITS    4   /* typical run/size Huffman code length */
+#define JTR_BLOCK_BITS        4   /* DC category and end-of-block codes */
+#define JTR_HEADER_BYTES    400   /* markers, tables with optimized coding */
+#define JTR_INITIAL_SCALE   0.8   /* typical measured/estimated ratio */
+
+LOCAL(int)
+jtr_nbits (long value)
+{
+    int nbits = 0;
+
+    while (value != 0) {
+        nbits++;
+        value >>= 1;
+    }
+    return nbits;
+}
+
+/*
+ * Quantization tables of each source component at the given quality: the
+ * standard tables scaled as jpeg_set_quality does, but never finer than
+ * the table the component was coded with, since a finer step could not
+ * bring back precision and would only cost bits.
+ */
+LOCAL(void)
+jtr_quality_tables (jtr_context *ctx, int quality,
+                    UINT16 qtables[MAX_COMPONENTS][DCTSIZE2])
+{
+    j_decompress_ptr srcinfo = &ctx->srcinfo;
+    j_compress_ptr dstinfo = &ctx->dstinfo;
+    jpeg_component_info *compptr;
+    const UINT16 *std_tbl;
+    int ci, k;
+
+    /* Computes the standard tables into slots 0 and 1 */
+    jm_jpeg_set_quality(dstinfo, quality, TRUE);
+
+    for (ci = 0; ci < srcinfo->num_components; ci++) {
+        compptr = srcinfo->comp_info + ci;
+        std_tbl = dstinfo->quant_tbl_ptrs[compptr->quant_tbl_no == 0 ? 0 : 1]
+            ->quantval;
+        for (k = 0; k < DCTSIZE2; k++) {
+            qtables[ci][k] = std_tbl[k];
+            if (compptr->quant_table != NULL &&
+                compptr->quant_table->quantval[k] > std_tbl[k]) {
+                qtables[ci][k] = compptr->quant_table->quantval[k];
+            }
+        }
+    }
+}
+
+/*
+ * Collects per-coefficient histograms of dequantized magnitude bit
+ * lengths; for DC the differences to the previous block are counted, as
+ * that is what gets coded.
+ */
+LOCAL(void)
+jtr_gather_stats (jtr_context *ctx, jvirt_barray_ptr *coef_arrays,
+                  jtr_size_stats *stats)
+{
+    j_decompress_ptr srcinfo = &ctx->srcinfo;
+    jpeg_component_info *compptr;
+    JBLOCKROW row;
+    JCOEFPTR block;
+    JDIMENSION bx, by;
+    long value, last_dc, (*hist)[JTR_HIST_BINS];
+    int ci, k, nbits;
+
+    stats->hist = (long (*)[DCTSIZE2][JTR_HIST_BINS])
+        (*srcinfo->mem->alloc_small) ((j_common_ptr) srcinfo, JPOOL_IMAGE,
+         srcinfo->num_components * SIZEOF(*stats->hist));
+    MEMZERO(stats->hist, srcinfo->num_components * SIZEOF(*stats->hist));
+    stats->blocks = 0;
+    stats->scale = JTR_INITIAL_SCALE;
+
+    for (ci = 0; ci < srcinfo->num_components; ci++) {
+        compptr = srcinfo->comp_info + ci;
+        if (compptr->quant_table == NULL) {
+            continue;           /* never coded, all zero */
+        }
+        hist = stats->hist[ci];
+        last_dc = 0;
+        for (by = 0; by < compptr->height_in_blocks; by++) {
+            row = (*srcinfo->mem->access_virt_barray)
+                ((j_common_ptr) srcinfo, coef_arrays[ci], by,
+                 (JDIMENSION) 1, FALSE)[0];
+            for (bx = 0; bx < compptr->width_in_blocks; bx++) {
+                block = row[bx];
+                value = (long) block[0] * compptr->quant_table->quantval[0];
+                nbits = jtr_nbits(value >= last_dc ? value - last_dc
+                                                   : last_dc - value);
+                hist[0][nbits < JTR_HIST_BINS ? nbits : JTR_HIST_BINS - 1]++;
+                last_dc = value;
+                for (k = 1; k < DCTSIZE2; k++) {
+                    if (block[k] == 0) {
+                        continue;
+                    }
+                    value = (long) block[k] * compptr->quant_table->quantval[k];
+                    nbits = jtr_nbits(value >= 0 ? value : -value);
+                    hist[k][nbits < JTR_HIST_BINS ? nbits : JTR_HIST_BINS - 1]++;
+                }
+            }
+        }
+        stats->blocks += (long) compptr->width_in_blocks *
+                         compptr->height_in_blocks;
+    }
+}
+
+/*
+ * Entropy-coded size in bytes the statistics predict for the given tables,
+ * before calibration: each nonzero requantized coefficient costs its
+ * magnitude bits plus a run/size symbol, each block a fixed overhead.
+ */
+LOCAL(double)
+jtr_estimate_bytes (jtr_context *ctx, const jtr_size_stats *stats,
+                    UINT16 qtables[MAX_COMPONENTS][DCTSIZE2])
+{
+    double bits = (double) stats->blocks * JTR_BLOCK_BITS;
+    long count, magnitude, quant, value;
+    int ci, k, bin;
+
+    for (ci = 0; ci < ctx->srcinfo.num_components; ci++) {
+        for (k = 0; k < DCTSIZE2; k++) {
+            quant = qtables[ci][k];
+            for (bin = 1; bin < JTR_HIST_BINS; bin++) {
+                count = stats->hist[ci][k][bin];
+                if (count == 0) {
+                    continue;
+                }
+                /* middle of the bin's magnitude range */
+                magnitude = bin == 1 ? 1 : 3L << (bin - 2);
+                value = (magnitude + quant / 2) / quant;
+                if (value != 0) {
+                    bits += (double) count *
+                        (jtr_nbits(value) + (k != 0 ? JTR_AC_SYMBOL_BITS : 0));
+                }
+            }
+        }
+    }
+    return bits / 8;
+}
+
+LOCAL(long)
+jtr_estimate_size (jtr_context *ctx, const jtr_size_stats *stats,
+                   int quality)
+{
+    UINT16 qtables[MAX_COMPONENTS][DCTSIZE2];
+
+    jtr_quality_tables(ctx, quality, qtables);
+    return JTR_HEADER_BYTES +
+        (long) (jtr_estimate_bytes(ctx, stats, qtables) * stats->scale);
+}
+
+/* Corrects the estimator scale with the size an encoding really had */
+LOCAL(void)
+jtr_calibrate (jtr_context *ctx, jtr_size_stats *stats, int quality,
+               long size)
+{
+    UINT16 qtables[MAX_COMPONENTS][DCTSIZE2];
+    double estimate;
+
+    jtr_quality_tables(ctx, quality, qtables);
+    estimate = jtr_estimate_bytes(ctx, stats, qtables);
+    if (estimate > 0 && size > JTR_HEADER_BYTES) {
+        stats->scale = (size - JTR_HEADER_BYTES) / estimate;
+        if (stats->scale < 0.25) {
+            stats->scale = 0.25;
+        } else if (stats->scale > 4.0) {
+            stats->scale = 4.0;
+        }
+    }
+}
+
+/* Highest quality in [lo, hi] the estimator expects to fit, else lo */
+LOCAL(int)
+jtr_predict_quality (jtr_context *ctx, const jtr_size_stats *stats,
+                     int lo, int hi, long target)
+{
+    int mid, best = lo;
+
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (jtr_estimate_size(ctx, stats, mid) <= target) {
+            best = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return best;
+}
+
+/*
+ * Requantizes every block of the source to the destination tables:
+ * c' = round(c * Qsrc / Qdst).  Unchanged steps and zeros are copied.
+ */
+LOCAL(void)
+jtr_requantize (jtr_context *ctx, jvirt_barray_ptr *src_coef_arrays,
+                jvirt_barray_ptr *dst_coef_arrays)
+{
+    j_decompress_ptr srcinfo = &ctx->srcinfo;
+    j_compress_ptr dstinfo = &ctx->dstinfo;
+    jpeg_component_info *compptr;
+    const UINT16 *dst_q;
+    long src_q[DCTSIZE2], num, half, quant;
+    JBLOCKROW src_row, dst_row;
+    JCOEFPTR src_block, dst_block;
+    JDIMENSION bx, by, cols, rows;
+    int ci, k;
+
+    for (ci = 0; ci < srcinfo->num_components; ci++) {
+        compptr = srcinfo->comp_info + ci;
+        dst_q = dstinfo->quant_tbl_ptrs
+            [dstinfo->comp_info[ci].quant_tbl_no]->quantval;
+        for (k = 0; k < DCTSIZE2; k++) {
+            src_q[k] = compptr->quant_table != NULL ?
+                compptr->quant_table->quantval[k] : dst_q[k];
+        }
+        /* The arrays cover whole iMCUs */
+        cols = ((compptr->width_in_blocks + compptr->h_samp_factor - 1) /
+                compptr->h_samp_factor) * compptr->h_samp_factor;
+        rows = ((compptr->height_in_blocks + compptr->v_samp_factor - 1) /
+                compptr->v_samp_factor) * compptr->v_samp_factor;
+        for (by = 0; by < rows; by++) {
+            src_row = (*srcinfo->mem->access_virt_barray)
+                ((j_common_ptr) srcinfo, src_coef_arrays[ci], by,
+                 (JDIMENSION) 1, FALSE)[0];
+            dst_row = (*srcinfo->mem->access_virt_barray)
+                ((j_common_ptr) srcinfo, dst_coef_arrays[ci], by,
+                 (JDIMENSION) 1, TRUE)[0];
+            for (bx = 0; bx < cols; bx++) {
+                src_block = src_row[bx];
+                dst_block = dst_row[bx];
+                for (k = 0; k < DCTSIZE2; k++) {
+                    quant = dst_q[k];
+                    if (src_block[k] == 0 || src_q[k] == quant) {
+                        dst_block[k] = src_block[k];
+                        continue;
+                    }
+                    num = (long) src_block[k] * src_q[k];
+                    half = quant >> 1;
+                    dst_block[k] = (JCOEF) (num >= 0 ? (num + half) / quant
+                                                     : -((half - num) / quant));
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Writes the source coefficients requantized for the given quality into
+ * the output buffer and returns the size they take, including bytes that
+ * did not fit.
+ */
+LOCAL(long)
+jtr_encode_at_quality (jtr_context *ctx, int quality,
+                       jvirt_barray_ptr *src_coef_arrays,
+                       jvirt_barray_ptr *dst_coef_arrays)
+{
+    j_decompress_ptr srcinfo = &ctx->srcinfo;
+    j_compress_ptr dstinfo = &ctx->dstinfo;
+    UINT16 qtables[MAX_COMPONENTS][DCTSIZE2];
+    boolean slot_set[NUM_QUANT_TBLS];
+    JQUANT_TBL *qtbl;
+    int ci, k;
+
+    jtr_quality_tables(ctx, quality, qtables);
+    jm_jpeg_copy_critical_parameters(srcinfo, dstinfo);
+
+    /* Components sharing a table slot get the coarser of their steps */
+    MEMZERO(slot_set, SIZEOF(slot_set));
+    for (ci = 0; ci < dstinfo->num_components; ci++) {
+        k = dstinfo->comp_info[ci].quant_tbl_no;
+        qtbl = dstinfo->quant_tbl_ptrs[k];
+        if (!slot_set[k]) {
+            MEMCOPY(qtbl->quantval, qtables[ci], SIZEOF(qtbl->quantval));
+            slot_set[k] = TRUE;
+            continue;
+        }
+        for (k = 0; k < DCTSIZE2; k++) {
+            if (qtables[ci][k] > qtbl->quantval[k]) {
+                qtbl->quantval[k] = qtables[ci][k];
+            }
+        }
+    }
+    dstinfo->optimize_coding = TRUE;
+
+    jtr_requantize(ctx, src_coef_arrays, dst_coef_arrays);
+    jm_jpeg_write_coefficients(dstinfo, dst_coef_arrays);
+    jm_jpeg_finish_compress(dstinfo);
+    return jtr_output_size(ctx);
+}
+
+/*
+ * Searches the highest quality between min_quality and 100 whose
+ * requantized coefficients fit into target bytes and leaves that encoding
+ * in the output buffer.  Sizes grow with quality, so this is a bisection.
+ * With statistics, probes are instead placed where the calibrated
+ * estimator expects the limit and, once the limit is bracketed, by
+ * interpolating the measured sizes, which usually settles it in three or
+ * four encodings instead of seven.  Returns the size, or 0 if nothing fits.
+ */
+LOCAL(long)
+jtr_fit_quality (jtr_context *ctx, jvirt_barray_ptr *src_coef_arrays,
+                 jvirt_barray_ptr *dst_coef_arrays, long target,
+                 int min_quality, jtr_size_stats *stats)
+{
+    int lo = min_quality, hi = 100, quality, best = 0, too_big = 0;
+    int last = 0, prev = 0;
+    long size, best_size = 0, too_big_size = 0, last_size = 0, prev_size = 0;
+
+    while (lo <= hi) {
+        if (stats == NULL) {
+            quality = (lo + hi + 1) / 2;
+        } else if (prev == 0) {
+            quality = jtr_predict_quality(ctx, stats, lo, hi, target);
+        } else {
+            /* Interpolate between the sizes around the limit if known,
+             * otherwise extrapolate from the last two probes
+             */
+            if (best != 0 && too_big != 0) {
+                prev = best;
+                prev_size = best_size;
+                last = too_big;
+                last_size = too_big_size;
+            }
+            if (last_size != prev_size) {
+                quality = last + (int) ((double) (target - last_size) *
+                    (last - prev) / (last_size - prev_size));
+            } else {
+                quality = jtr_predict_quality(ctx, stats, lo, hi, target);
+            }
+            if (quality < lo) {
+                quality = lo;
+            } else if (quality > hi) {
+                quality = hi;
+            }
+        }
+        size = jtr_encode_at_quality(ctx, quality,
+                                     src_coef_arrays, dst_coef_arrays);
+        prev = last;
+        prev_size = last_size;
+        last = quality;
+        last_size = size;
+        if (stats != NULL) {
+            jtr_calibrate(ctx, stats, quality, size);
+        }
+        if (size <= target) {
+            best = quality;
+            best_size = size;
+            lo = quality + 1;
+        } else {
+            too_big = quality;
+            too_big_size = size;
+            hi = quality - 1;
+        }
+    }
+
+    if (best != 0 && last != best) {
+        best_size = jtr_encode_at_quality(ctx, best,
+                                          src_coef_arrays, dst_coef_arrays);
+    }
+    return best_size;
+}
+
+/*
+ * Reads the coefficients of the image whose header has been read and
+ * recompresses them to fit target bytes.  Returns the size, or 0.
+ */
+LOCAL(long)
+jtr_fit_coefficients (jtr_context *ctx, long target, int min_quality,
+                      boolean use_estimator)
+{
+    j_decompress_ptr srcinfo = &ctx->srcinfo;
+    jpeg_component_info *compptr;
+    jvirt_barray_ptr *src_coef_arrays;
+    jvirt_barray_ptr dst_coef_arrays[MAX_COMPONENTS];
+    jtr_size_stats stats;
+    JDIMENSION cols, rows;
+    long size;
+    int ci;
+
+    /* Same geometry as the source arrays; see jtr_execute_transform */
+    for (ci = 0; ci < srcinfo->num_components; ci++) {
+        compptr = srcinfo->comp_info + ci;
+        cols = ((compptr->width_in_blocks + compptr->h_samp_factor - 1) /
+                compptr->h_samp_factor) * compptr->h_samp_factor;
+        rows = ((compptr->height_in_blocks + compptr->v_samp_factor - 1) /
+                compptr->v_samp_factor) * compptr->v_samp_factor;
+        dst_coef_arrays[ci] = (*srcinfo->mem->request_virt_barray)
+            ((j_common_ptr) srcinfo, JPOOL_IMAGE, FALSE, cols, rows,
+             (JDIMENSION) compptr->v_samp_factor);
+    }
+
+    src_coef_arrays = jm_jpeg_read_coefficients(srcinfo);
+    if (use_estimator) {
+        jtr_gather_stats(ctx, src_coef_arrays, &stats);
+    }
+
+    size = jtr_fit_quality(ctx, src_coef_arrays, dst_coef_arrays, target,
+                           min_quality, use_estimator ? &stats : NULL);
+
+    (void) jm_jpeg_finish_decompress(srcinfo);
+    return size;
+}
+
+/*
+ * Decodes the image at 1/denom scale, which the decoder does cheaply in
+ * its reduced-size IDCT, and compresses the result at JTR_SCALED_QUALITY
+ * into the growing destination.  Color conversion is skipped by staying
+ * in the JPEG color space.  Returns the size of the new image.
+ */
+LOCAL(int)
+jtr_downscale (jtr_context *ctx, char *data, int length, int denom)
+{
+    j_decompress_ptr srcinfo = &ctx->srcinfo;
+    j_compress_ptr dstinfo = &ctx->dstinfo;
+    JSAMPARRAY row;
+    int size;
+
+    jtr_set_source(ctx, data, length);
+    (void) jm_jpeg_read_header(srcinfo, TRUE);
+    srcinfo->scale_num = 1;
+    srcinfo->scale_denom = denom;
+    srcinfo->out_color_space = srcinfo->jpeg_color_space;
+    jm_jpeg_start_decompress(srcinfo);
+
+    dstinfo->image_width = srcinfo->output_width;
+    dstinfo->image_height = srcinfo->output_height;
+    dstinfo->input_components = srcinfo->output_components;
+    dstinfo->in_color_space = srcinfo->out_color_space;
+    jm_jpeg_set_defaults(dstinfo);
+    jm_jpeg_set_quality(dstinfo, JTR_SCALED_QUALITY, TRUE);
+
+    if (ctx->grow_dest.data != NULL) {
+        MNI_FREE(ctx->grow_dest.data);
+    }
+    ctx->grow_dest.length = length / denom + JTR_SPILL_SIZE;
+    ctx->grow_dest.data = (char *) MNI_MALLOC(ctx->grow_dest.length);
+    if (ctx->grow_dest.data == NULL) {
+        ERREXIT1(srcinfo, JERR_OUT_OF_MEMORY, 0);
+    }
+    dstinfo->dest = &ctx->grow_dest.pub;
+    jm_jpeg_start_compress(dstinfo, TRUE);
+
+    row = (*srcinfo->mem->alloc_sarray)
+        ((j_common_ptr) srcinfo, JPOOL_IMAGE,
+         srcinfo->output_width * srcinfo->output_components, (JDIMENSION) 1);
+    while (srcinfo->output_scanline < srcinfo->output_height) {
+        (void) jm_jpeg_read_scanlines(srcinfo, row, 1);
+        (void) jm_jpeg_write_scanlines(dstinfo, row, 1);
+    }
+    jm_jpeg_finish_compress(dstinfo);
+    (void) jm_jpeg_finish_decompress(srcinfo);
+
+    size = ctx->grow_dest.length - (int) ctx->grow_dest.pub.free_in_buffer;
+    dstinfo->dest = &ctx->dest.pub;
+    return size;
+}
+
+/****************************************************************
+ * transformer invocation
+ ****************************************************************/
+
+int
+JPEG_Transform(char *inData, int inDataLen,
+               char *outData, int outDataLen,
+               JPEG_TRANSFORM_TYPE transform,
+               int *width, int *height)
+{
+    jtr_context *ctx;
+    j_decompress_ptr srcinfo;
+    j_compress_ptr dstinfo;
+    jtr_transform_info info;
+    jvirt_barray_ptr *src_coef_arrays;
+    jvirt_barray_ptr dst_coef_arrays[MAX_COMPONENTS];
+    jpeg_component_info *compptr;
+    JDIMENSION trim_w, trim_h, imcu_w, imcu_h;
+    int ci, tmp, result;
+
+    if (inData == NULL || inDataLen <= 0 ||
+        outData == NULL || outDataLen <= 0) {
+        return 0;
+    }
+
+    ctx = jtr_alloc_context();
+    if (ctx == NULL) {
+        return 0;
+    }
+    srcinfo = &ctx->srcinfo;
+    dstinfo = &ctx->dstinfo;
+
+    if (setjmp(ctx->jerr.setjmp_buffer)) {
+        /* If we get here, the JPEG code has signaled an error. */
+        jtr_free_context(ctx);
+        return 0;
+    }
+    jtr_create_objects(ctx);
+    jtr_set_source(ctx, inData, inDataLen);
+    jtr_set_destination(ctx, outData, outDataLen, FALSE);
+
+    (void) jm_jpeg_read_header(srcinfo, TRUE);
+
+    jtr_get_transform_info(transform, &info);
+    if (!jtr_trim_source(srcinfo, &info, &trim_w, &trim_h)) {
+        ERREXIT(srcinfo, JERR_EMPTY_IMAGE);
+    }
+
+    /* Destination arrays live in the source object's memory pool and must
+     * be requested before jpeg_read_coefficients realizes the arrays.
+     */
+    imcu_w = (JDIMENSION) (srcinfo->max_h_samp_factor * DCTSIZE);
+    imcu_h = (JDIMENSION) (srcinfo->max_v_samp_factor * DCTSIZE);
+    for (ci = 0; ci < srcinfo->num_components; ci++) {
+        JDIMENSION cols, rows;
+        int h_samp, v_samp;
+
+        compptr = srcinfo->comp_info + ci;
+        if (info.transpose) {
+            h_samp = compptr->v_samp_factor;
+            v_samp = compptr->h_samp_factor;
+            cols = (JDIMENSION) ((trim_h + imcu_h - 1) / imcu_h) * h_samp;
+            rows = (JDIMENSION) ((trim_w + imcu_w - 1) / imcu_w) * v_samp;
+        } else {
+            h_samp = compptr->h_samp_factor;
+            v_samp = compptr->v_samp_factor;
+            cols = (JDIMENSION) ((trim_w + imcu_w - 1) / imcu_w) * h_samp;
+            rows = (JDIMENSION) ((trim_h + imcu_h - 1) / imcu_h) * v_samp;
+        }
+        dst_coef_arrays[ci] = (*srcinfo->mem->request_virt_barray)
+            ((j_common_ptr) srcinfo, JPOOL_IMAGE, FALSE,
+             cols, rows, (JDIMENSION) v_samp);
+    }
+
+    src_coef_arrays = jm_jpeg_read_coefficients(srcinfo);
+
+    jm_jpeg_copy_critical_parameters(srcinfo, dstinfo);
+    if (info.transpose) {
+        dstinfo->image_width = trim_h;
+        dstinfo->image_height = trim_w;
+        for (ci = 0; ci < dstinfo->num_components; ci++) {
+            compptr = dstinfo->comp_info + ci;
+            tmp = compptr->h_samp_factor;
+            compptr->h_samp_factor = compptr->v_samp_factor;
+            compptr->v_samp_factor = tmp;
+        }
+        jtr_transpose_quant_tables(dstinfo);
+    } else {
+        dstinfo->image_width = trim_w;
+        dstinfo->image_height = trim_h;
+    }
+
+    /* Computes the destination component geometry used below */
+    jm_jpeg_write_coefficients(dstinfo, dst_coef_arrays);
+
+    jtr_execute_transform(srcinfo, dstinfo, &info,
+                          src_coef_arrays, dst_coef_arrays);
+
+    jm_jpeg_finish_compress(dstinfo);
+    (void) jm_jpeg_finish_decompress(srcinfo);
+
+    result = (int) jtr_output_size(ctx);
+    if (width != NULL) {
+        *width = (int) dstinfo->image_width;
+    }
+    if (height != NULL) {
+        *height = (int) dstinfo->image_height;
+    }
+
+    jtr_free_context(ctx);
+    return result;
+}
+
+/*
+ * The body of JPEG_FitToSize, called once the error handler is set.
+ * Its locals change between trials, so they live in this frame and
+ * not in the one that called setjmp.
+ */
+LOCAL(int)
+jtr_fit_to_size (jtr_context *ctx, char *inData, int inDataLen,
+                 char *outData, int outDataLen, long target,
+                 int minQuality, int flags, int *width, int *height)
+{
+    j_decompress_ptr srcinfo = &ctx->srcinfo;
+    j_compress_ptr dstinfo = &ctx->dstinfo;
+    char *data;
+    int length, denom;
+    long result;
+
+    jtr_create_objects(ctx);
+    jtr_set_source(ctx, inData, inDataLen);
+    /* Trial encodings may overrun the buffer; only their size counts */
+    jtr_set_destination(ctx, outData, outDataLen, TRUE);
+
+    (void) jm_jpeg_read_header(srcinfo, TRUE);
+    if (inDataLen <= target) {
+        /* Already small enough, keep it untouched */
+        MEMCOPY(outData, inData, inDataLen);
+        if (width != NULL) {
+            *width = (int) srcinfo->image_width;
+        }
+        if (height != NULL) {
+            *height = (int) srcinfo->image_height;
+        }
+        return inDataLen;
+    }
+
+    data = inData;
+    length = inDataLen;
+    denom = 1;
+    for (;;) {
+        result = jtr_fit_coefficients(ctx, target, minQuality,
+            (flags & JPEG_FIT_USE_ESTIMATOR) ? TRUE : FALSE);
+        if (result > 0 || !(flags & JPEG_FIT_ALLOW_DOWNSCALE) ||
+            denom >= JTR_MAX_SCALE_DENOM) {
+            break;
+        }
+        /* Quality alone cannot get there: halve the original's size */
+        denom *= 2;
+        length = jtr_downscale(ctx, inData, inDataLen, denom);
+        data = ctx->grow_dest.data;
+        jtr_set_source(ctx, data, length);
+        (void) jm_jpeg_read_header(srcinfo, TRUE);
+    }
+
+    if (result > 0) {
+        if (width != NULL) {
+            *width = (int) dstinfo->image_width;
+        }
+        if (height != NULL) {
+            *height = (int) dstinfo->image_height;
+        }
+    }
+    return (int) result;
+}
+
+int
+JPEG_FitToSize(char *inData, int inDataLen,
+               char *outData, int outDataLen,
+               int targetSize, int minQuality, int flags,
+               int *width, int *height)
+{
+    jtr_context *ctx;
+    long target;
+    int result;
+
+    if (inData == NULL || inDataLen <= 0 ||
+        outData == NULL || outDataLen <= 0 || targetSize <= 0) {
+        return 0;
+    }
+    target = targetSize < outDataLen ? targetSize : outDataLen;
+    if (minQuality < 1) {
+        minQuality = 1;
+    } else if (minQuality > 100) {
+        minQuality = 100;
+    }
+
+    ctx = jtr_alloc_context();
+    if (ctx == NULL) {
+        return 0;
+    }
+
+    if (setjmp(ctx->jerr.setjmp_buffer)) {
+        /* If we get here, the JPEG code has signaled an error. */
+        jtr_free_context(ctx);
+        return 0;
+    }
+    result = jtr_fit_to_size(ctx, inData, inDataLen, outData, outDataLen,
+                             target, minQuality, flags, width, height);
+
+    jtr_free_context(ctx);
+    return result;
+}
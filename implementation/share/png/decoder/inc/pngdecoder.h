@@ -0,0 +1,172 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#ifndef __JAVAUTIL_MEDIA_PNG_DECODER_H
+#define __JAVAUTIL_MEDIA_PNG_DECODER_H
+
+/*
+ * PNG decoder with the interface of the JPEG decoder (jpegdecoder.h).
+ * All PNG color types, bit depths and Adam7 interlacing are supported.
+ * Output pixels are 24-bit RGB bytes, 16-bit RGB565 (truncated, as the
+ * JPEG decoder does) or 32-bit 0xAARRGGBB; 16-bit samples are reduced to
+ * their high byte.  Alpha comes from the alpha channel or from tRNS and
+ * is either kept in the 32-bit pixels or written to a separate buffer.
+ * Chunk CRCs and the zlib Adler-32 are checked.
+ */
+
+/**
+ * Allocate a decoder
+ * 
+ * @return Decoder handle, NULL if out of memory
+ */
+void *PNG_To_RGB_init(void);
+
+/**
+ * Decodes a png header and checks the chunk structure of the whole
+ * image, fills all internal fields related to input image.
+ * inData is used by the next decodeData call and must stay valid
+ * until then.
+ *
+ * @param info handle returned from PNG_To_RGB_init
+ * @param inData PNG data
+ * @param inDataLen length of inData
+ * @param width pointer where to store decoded image width
+ * @param height pointer where to store decoded image height
+ *
+ * @return non-zero on success, zero on failure
+ */
+int PNG_To_RGB_decodeHeader(void *info, char *inData, int inDataLen, 
+                            int *width, int *height);
+
+/**
+ * Tells whether the image decoded by PNG_To_RGB_decodeHeader has
+ * an alpha channel or transparency (tRNS) information
+ *
+ * @param info handle returned from PNG_To_RGB_init
+ *
+ * @return non-zero if pixels may be other than opaque
+ */
+int PNG_To_RGB_hasAlpha(void *info);
+
+/**
+ * Decodes png data to the provided buffer.
+ * Assumes that PNG_To_RGB_decodeHeader() has been called before,
+ * and outData contains buffer of a valid size.
+ *
+ * @param info handle returned from PNG_To_RGB_init
+ * @param outData 24 bit RGB image
+ *
+ * @return size of filled outData bytes, 0 when failed
+ */
+int PNG_To_RGB_decodeData(void *info, char *outData);
+
+/**
+ * Decodes png data to the provided buffer.
+ * Assumes that PNG_To_RGB_decodeHeader() has been called before,
+ * and outData contains buffer of a valid size.
+ *
+ * @param info handle returned from PNG_To_RGB_init
+ * @param outData short 16 (5,6,5) or 32 bit ARGB image, 
+ *        (right - left) pixels per row
+ * @param outPixelSize the desired pixel size in bytes, 2 or 4
+ * @param left -
+ * @param top -
+ * @param right -
+ * @param bottom - rectangle in the decoded image that will be copied 
+ *        to outData
+ *
+ * @return size of filled outData bytes, 0 when failed
+ */
+int PNG_To_RGB_decodeData2(void *info, char *outData, int outPixelSize,
+                           int left, int top, int right, int bottom);
+
+/**
+ * Decodes png data to the provided buffers, with the alpha of each
+ * pixel stored separately.  Same as PNG_To_RGB_decodeData2 otherwise.
+ *
+ * @param info handle returned from PNG_To_RGB_init
+ * @param outData short 16 (5,6,5) or 32 bit ARGB image, 
+ *        (right - left) pixels per row
+ * @param outPixelSize the desired pixel size in bytes, 2 or 4
+ * @param alphaData one alpha byte per pixel of outData, 
+ *        0 for transparent to 0xFF for opaque; NULL if not needed
+ * @param left -
+ * @param top -
+ * @param right -
+ * @param bottom - rectangle in the decoded image that will be copied 
+ *        to outData
+ *
+ * @return size of filled outData bytes, 0 when failed
+ */
+int PNG_To_RGB_decodeDataAlpha(void *info, char *outData, int outPixelSize,
+                               char *alphaData,
+                               int left, int top, int right, int bottom);
+
+/**
+ * Decodes a png into a new buffer, to be released with javacall_free.
+ *
+ * @param info handle returned from PNG_To_RGB_init
+ * @param inData PNG data
+ * @param inDataLen length of inData
+ * @param width pointer where to store decoded image width
+ * @param height pointer where to store decoded image height
+ *
+ * @return allocated 24 bit RGB image buffer 
+ *         when successful, NULL when failed
+ */
+char *PNG_To_RGB_decode(void *info, char *inData, int inDataLen,
+                        int *width, int *height);
+
+/**
+ * Decodes a png into a new buffer, to be released with javacall_free.
+ *
+ * @param info handle returned from PNG_To_RGB_init
+ * @param inData PNG data
+ * @param inDataLen length of inData
+ * @param outPixelSize the desired pixel size in bytes, 2 or 4
+ * @param left -
+ * @param top -
+ * @param right -
+ * @param bottom - rectangle in the decoded image that will be copied 
+ *        to the buffer
+ * @param width pointer where to store decoded image width
+ * @param height pointer where to store decoded image height
+ *
+ * @return allocated short 16 (5,6,5) or 32 bit ARGB image buffer 
+ *         when successful, NULL when failed
+ */
+char *PNG_To_RGB_decode2(void *info, 
+                         char *inData, int inDataLen, int outPixelSize,
+                         int left, int top, int right, int bottom, 
+                         int *width, int *height);
+
+/**
+ * Release a decoder
+ *
+ * @param info handle returned from PNG_To_RGB_init
+ */
+void PNG_To_RGB_free(void *info);
+
+#endif  /* __JAVAUTIL_MEDIA_PNG_DECODER_H */
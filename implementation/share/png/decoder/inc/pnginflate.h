@@ -0,0 +1,97 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#ifndef __JAVAUTIL_MEDIA_PNG_INFLATE_H
+#define __JAVAUTIL_MEDIA_PNG_INFLATE_H
+
+/*
+ * Inflate (RFC 1951) decompressor used by the PNG decoder.  The whole
+ * raw deflate stream is given up front; output goes to a caller buffer
+ * and decompression stops whenever that is full, so that the caller can
+ * consume the output and make room while keeping the 32K of history
+ * that back references may reach.
+ */
+
+#define PNG_INFLATE_OK      0   /* output buffer full, call again */
+#define PNG_INFLATE_DONE    1   /* end of the last block */
+#define PNG_INFLATE_ERROR   (-1)    /* invalid or truncated data */
+
+/* Longest back reference distance */
+#define PNG_INFLATE_WINDOW  32768
+
+typedef struct _png_inflate_state png_inflate_state;
+
+/**
+ * Allocate decompressor state
+ * 
+ * @return New decompressor, or NULL if out of memory
+ */
+png_inflate_state *png_inflate_create(void);
+
+/**
+ * Start decompressing a raw deflate stream
+ * 
+ * @param s         Decompressor
+ * @param in        Compressed data, kept until decompression ends
+ * @param len       Number of bytes in in
+ */
+void png_inflate_reset(png_inflate_state *s, 
+                       const unsigned char *in, 
+                       long len);
+
+/**
+ * Decompress into out from *pos up to size.  Back references read the
+ * bytes before *pos, so out must keep the last PNG_INFLATE_WINDOW bytes
+ * of output (or all of it, if less) in front of *pos between calls.
+ * 
+ * @param s         Decompressor
+ * @param out       Output buffer
+ * @param pos       Position of the next output byte in out, updated
+ * @param size      Size of out
+ * 
+ * @return PNG_INFLATE_OK, PNG_INFLATE_DONE or PNG_INFLATE_ERROR
+ */
+int png_inflate(png_inflate_state *s, 
+                unsigned char *out, 
+                long *pos, 
+                long size);
+
+/**
+ * Number of input bytes used after png_inflate returned PNG_INFLATE_DONE
+ * 
+ * @param s         Decompressor
+ * 
+ * @return Offset of the first byte after the deflate stream
+ */
+long png_inflate_input_used(png_inflate_state *s);
+
+/**
+ * Release decompressor state
+ * 
+ * @param s         Decompressor, may be NULL
+ */
+void png_inflate_destroy(png_inflate_state *s);
+
+#endif  /* __JAVAUTIL_MEDIA_PNG_INFLATE_H */
@@ -0,0 +1,60 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#ifndef __JAVAUTIL_MEDIA_PNG_UNFILTER_H
+#define __JAVAUTIL_MEDIA_PNG_UNFILTER_H
+
+/*
+ * Reverse of the PNG row filters (filter method 0) used by the PNG
+ * decoder.  Every filter but Up depends on the bytes already decoded to
+ * its left, so the kernels go one pixel at a time.
+ */
+
+#define PNG_UNFILTER_NONE       0
+#define PNG_UNFILTER_SUB        1
+#define PNG_UNFILTER_UP         2
+#define PNG_UNFILTER_AVERAGE    3
+#define PNG_UNFILTER_PAETH      4
+
+/**
+ * Unfilter one row
+ * 
+ * @param type      Filter type byte of the row
+ * @param in        Filtered row, without the filter type byte
+ * @param cur       Unfiltered row
+ * @param prev      Unfiltered previous row, all zero for the first row
+ * @param len       Row length in bytes
+ * @param bpp       Bytes per complete pixel, 1 for less than 8 bits
+ * 
+ * @return 1 on success, 0 if type is not a filter type
+ */
+int png_unfilter_row(int type,
+                     const unsigned char *in,
+                     unsigned char *cur,
+                     const unsigned char *prev,
+                     int len,
+                     int bpp);
+
+#endif  /* __JAVAUTIL_MEDIA_PNG_UNFILTER_H */
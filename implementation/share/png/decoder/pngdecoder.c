@@ -0,0 +1,860 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+/**
+ * @file
+ *
+ * PNG decoder.  The header call walks all chunks, checking their CRCs,
+ * and keeps IHDR, PLTE, tRNS and the location of the image data.  The
+ * data call inflates the image data into a window that holds the
+ * deflate history plus a span of rows: complete rows are unfiltered and
+ * converted to the output as soon as they are inflated, then the window
+ * slides, so memory use does not grow with the image height.
+ */
+
+#include <string.h>
+#include "javacall_defs.h"
+#include "javacall_memory.h"
+#include "javautil_checksum.h"
+#include "javautil_pixel.h"
+#include "pngdecoder.h"
+#include "pnginflate.h"
+#include "pngunfilter.h"
+
+#define PNG_SIGNATURE_SIZE  8
+#define PNG_MAX_DIMENSION   (1 << 24)
+#define PNG_MIN_SPAN        65536   /* window bytes beyond the history */
+
+#define COLOR_GRAY          0
+#define COLOR_RGB           2
+#define COLOR_PALETTE       3
+#define COLOR_GRAY_ALPHA    4
+#define COLOR_RGBA          6
+
+#define GET16(p)    (((unsigned int)(p)[0] << 8) | (p)[1])
+
+#define ARGB_TO_565(p) \
+    ((unsigned short)((((p) >> 8) & 0xF800) | (((p) >> 5) & 0x07E0) | \
+                      (((p) >> 3) & 0x001F)))
+
+static const unsigned char pngSignature[PNG_SIGNATURE_SIZE] = {
+    0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a
+};
+
+/* Adam7 passes: x offset, y offset, x step, y step */
+static const unsigned char adam7[7][4] = {
+    {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4},
+    {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}
+};
+
+typedef struct {
+    int width;
+    int height;
+    int bitDepth;
+    int colorType;
+    int interlace;
+    int bitsPerPixel;
+    int bpp;                        /* bytes per pixel for unfiltering */
+
+    int hasAlpha;
+    int hasTrns;
+    unsigned int trns[3];           /* transparent gray or red, green, blue */
+
+    unsigned int palette[256];      /* ARGB, alpha from tRNS */
+    unsigned short palette565[256];
+    int paletteSize;
+
+    const unsigned char *zdata;     /* zlib stream of all IDAT chunks */
+    long zlen;
+    unsigned char *zcopy;           /* zdata when there are several IDATs */
+
+    png_inflate_state *inflater;
+    int ready;                      /* header decoded */
+} PNGDecoder;
+
+/* Where converted pixels go */
+typedef struct {
+    unsigned char *out;
+    int pixelSize;                  /* 2, 3 or 4 */
+    unsigned char *alpha;           /* NULL if not wanted */
+    int left, top, right, bottom;
+    unsigned int *argb;             /* one row of converted pixels */
+} PNGTarget;
+
+static unsigned long get_uint32(const unsigned char *p) {
+    return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) |
+           ((unsigned long)p[2] << 8) | (unsigned long)p[3];
+}
+
+/* PNG section 11.2.2: allowed bit depths per color type */
+static int check_format(int colorType, int bitDepth) {
+    switch (colorType) {
+    case COLOR_GRAY:
+        return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || 
+               bitDepth == 8 || bitDepth == 16;
+    case COLOR_PALETTE:
+        return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || 
+               bitDepth == 8;
+    case COLOR_RGB:
+    case COLOR_GRAY_ALPHA:
+    case COLOR_RGBA:
+        return bitDepth == 8 || bitDepth == 16;
+    default:
+        return 0;
+    }
+}
+
+static int read_ihdr(PNGDecoder *dec, const unsigned char *data, long len) {
+    static const unsigned char channels[7] = {1, 0, 3, 1, 2, 0, 4};
+    unsigned long width, height;
+
+    if (len != 13) {
+        return 0;
+    }
+    width = get_uint32(data);
+    height = get_uint32(data + 4);
+    dec->bitDepth = data[8];
+    dec->colorType = data[9];
+    /* compression and filter method 0, interlace none or Adam7 */
+    if (width == 0 || height == 0 || 
+        width > PNG_MAX_DIMENSION || height > PNG_MAX_DIMENSION ||
+        height > (0x7fffffff / 4) / width ||
+        !check_format(dec->colorType, dec->bitDepth) ||
+        data[10] != 0 || data[11] != 0 || data[12] > 1) {
+        return 0;
+    }
+    dec->width = (int)width;
+    dec->height = (int)height;
+    dec->interlace = data[12];
+    dec->bitsPerPixel = channels[dec->colorType] * dec->bitDepth;
+    dec->bpp = dec->bitsPerPixel < 8 ? 1 : dec->bitsPerPixel >> 3;
+    return 1;
+}
+
+static int read_plte(PNGDecoder *dec, const unsigned char *data, long len) {
+    int n;
+
+    if (len % 3 != 0 || len == 0 || len > 3 * 256) {
+        return 0;
+    }
+    dec->paletteSize = (int)(len / 3);
+    for (n = 0; n < dec->paletteSize; n++) {
+        dec->palette[n] = 0xff000000 | ((unsigned int)data[3 * n] << 16) |
+                          ((unsigned int)data[3 * n + 1] << 8) | 
+                          data[3 * n + 2];
+    }
+    return 1;
+}
+
+static int read_trns(PNGDecoder *dec, const unsigned char *data, long len) {
+    int n;
+
+    switch (dec->colorType) {
+    case COLOR_GRAY:
+        if (len != 2) {
+            return 0;
+        }
+        dec->trns[0] = GET16(data);
+        break;
+    case COLOR_RGB:
+        if (len != 6) {
+            return 0;
+        }
+        for (n = 0; n < 3; n++) {
+            dec->trns[n] = GET16(data + 2 * n);
+        }
+        break;
+    case COLOR_PALETTE:
+        if (dec->paletteSize == 0 || len > dec->paletteSize) {
+            return 0;
+        }
+        for (n = 0; n < len; n++) {
+            dec->palette[n] = (dec->palette[n] & 0xffffff) | 
+                              ((unsigned int)data[n] << 24);
+        }
+        break;
+    default:
+        /* color types with an alpha channel have no use for tRNS */
+        return 1;
+    }
+    dec->hasTrns = 1;
+    return 1;
+}
+
+/*
+ * Walk the chunks from IHDR to IEND.  Several IDAT chunks are joined
+ * into one buffer; a single one is used in place.
+ */
+static int read_chunks(PNGDecoder *dec, const unsigned char *data, long len) {
+    const unsigned char *firstIdat = NULL;
+    long idatBytes = 0;
+    int idatCount = 0;
+    int seenIhdr = 0;
+    int seenIend = 0;
+    long pos;
+    unsigned char *copy;
+
+    if (len < PNG_SIGNATURE_SIZE ||
+        memcmp(data, pngSignature, PNG_SIGNATURE_SIZE) != 0) {
+        return 0;
+    }
+
+    for (pos = PNG_SIGNATURE_SIZE; !seenIend; ) {
+        const unsigned char *type;
+        const unsigned char *body;
+        unsigned long clen;
+
+        if (len - pos < 12) {
+            return 0;
+        }
+        clen = get_uint32(data + pos);
+        if (clen > (unsigned long)(len - pos - 12)) {
+            return 0;
+        }
+        type = data + pos + 4;
+        body = type + 4;
+        if (javautil_crc32(0, type, (long)clen + 4) != 
+            get_uint32(body + clen)) {
+            return 0;
+        }
+        pos += (long)clen + 12;
+
+        if (!seenIhdr) {
+            if (memcmp(type, "IHDR", 4) != 0 || 
+                !read_ihdr(dec, body, (long)clen)) {
+                return 0;
+            }
+            seenIhdr = 1;
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            if (idatCount++ == 0) {
+                firstIdat = body;
+            }
+            idatBytes += (long)clen;
+        } else if (memcmp(type, "PLTE", 4) == 0) {
+            if (dec->paletteSize != 0 || idatCount != 0 ||
+                !read_plte(dec, body, (long)clen)) {
+                return 0;
+            }
+        } else if (memcmp(type, "tRNS", 4) == 0) {
+            if (dec->hasTrns || idatCount != 0 ||
+                !read_trns(dec, body, (long)clen)) {
+                return 0;
+            }
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            seenIend = 1;
+        } else if ((type[0] & 0x20) == 0 || memcmp(type, "IHDR", 4) == 0) {
+            /* unknown critical chunk, or a second IHDR */
+            return 0;
+        }
+    }
+
+    if (idatCount == 0 ||
+        (dec->colorType == COLOR_PALETTE && dec->paletteSize == 0)) {
+        return 0;
+    }
+
+    dec->zlen = idatBytes;
+    if (idatCount == 1) {
+        dec->zdata = firstIdat;
+        return 1;
+    }
+    copy = (unsigned char *)javacall_malloc(idatBytes);
+    if (copy == NULL) {
+        return 0;
+    }
+    dec->zcopy = copy;
+    dec->zdata = copy;
+    for (pos = firstIdat - 8 - data; ; ) {
+        long clen = (long)get_uint32(data + pos);
+        if (memcmp(data + pos + 4, "IDAT", 4) == 0) {
+            memcpy(copy, data + pos + 8, clen);
+            copy += clen;
+            if (--idatCount == 0) {
+                break;
+            }
+        }
+        pos += clen + 12;
+    }
+    return 1;
+}
+
+/*
+ * Convert pixels [i0, i1) of an unfiltered row to ARGB.  Samples of 16
+ * bits keep their high byte; tRNS matches the full sample value.
+ */
+static void expand_row(const PNGDecoder *dec, 
+                       const unsigned char *row,
+                       unsigned int *argb, 
+                       int i0, 
+                       int i1) {
+    int depth = dec->bitDepth;
+    int i;
+
+    switch (dec->colorType) {
+    case COLOR_PALETTE:
+    case COLOR_GRAY: {
+        /* palette indices and gray levels: 1 to 16 bits per sample */
+        static const unsigned char scale[9] = {0, 255, 85, 0, 17, 0, 0, 0, 1};
+        int isPalette = dec->colorType == COLOR_PALETTE;
+        unsigned int mask = (1u << depth) - 1;
+        unsigned int trns = dec->hasTrns ? dec->trns[0] : 0x10000;
+
+        if (depth == 16) {
+            for (i = i0; i < i1; i++) {
+                unsigned int v = GET16(row + 2 * i);
+                unsigned int g = v >> 8;
+                *argb++ = (v == trns ? 0 : 0xff000000) | 
+                          (g << 16) | (g << 8) | g;
+            }
+        } else if (depth == 8 && isPalette) {
+            for (i = i0; i < i1; i++) {
+                *argb++ = dec->palette[row[i]];
+            }
+        } else {
+            for (i = i0; i < i1; i++) {
+                int bit = i * depth;
+                unsigned int v = row[bit >> 3] >> (8 - depth - (bit & 7));
+                v &= mask;
+                if (isPalette) {
+                    *argb++ = dec->palette[v];
+                } else {
+                    unsigned int g = v * scale[depth];
+                    *argb++ = (v == trns ? 0 : 0xff000000) | 
+                              (g << 16) | (g << 8) | g;
+                }
+            }
+        }
+        break;
+    }
+
+    case COLOR_RGB:
+        if (depth == 8) {
+            const unsigned char *p = row + 3 * i0;
+            if (!dec->hasTrns) {
+                for (i = i0; i < i1; i++, p += 3) {
+                    *argb++ = 0xff000000 | ((unsigned int)p[0] << 16) | 
+                              ((unsigned int)p[1] << 8) | p[2];
+                }
+            } else {
+                for (i = i0; i < i1; i++, p += 3) {
+                    unsigned int a = (p[0] == dec->trns[0] && 
+                                      p[1] == dec->trns[1] && 
+                                      p[2] == dec->trns[2]) ? 0 : 0xff000000;
+                    *argb++ = a | ((unsigned int)p[0] << 16) | 
+                              ((unsigned int)p[1] << 8) | p[2];
+                }
+            }
+        } else {
+            const unsigned char *p = row + 6 * i0;
+            for (i = i0; i < i1; i++, p += 6) {
+                unsigned int a = (dec->hasTrns &&
+                                  GET16(p) == dec->trns[0] &&
+                                  GET16(p + 2) == dec->trns[1] &&
+                                  GET16(p + 4) == dec->trns[2]) ?
+                                 0 : 0xff000000;
+                *argb++ = a | ((unsigned int)p[0] << 16) | 
+                          ((unsigned int)p[2] << 8) | p[4];
+            }
+        }
+        break;
+
+    case COLOR_GRAY_ALPHA: {
+        int step = depth >> 2;
+        const unsigned char *p = row + step * i0;
+        for (i = i0; i < i1; i++, p += step) {
+            unsigned int g = p[0];
+            *argb++ = ((unsigned int)p[step >> 1] << 24) | 
+                      (g << 16) | (g << 8) | g;
+        }
+        break;
+    }
+
+    default: /* COLOR_RGBA */
+        if (depth == 8) {
+            const unsigned char *p = row + 4 * i0;
+            for (i = i0; i < i1; i++, p += 4) {
+                *argb++ = ((unsigned int)p[3] << 24) | 
+                          ((unsigned int)p[0] << 16) | 
+                          ((unsigned int)p[1] << 8) | p[2];
+            }
+        } else {
+            const unsigned char *p = row + 8 * i0;
+            for (i = i0; i < i1; i++, p += 8) {
+                *argb++ = ((unsigned int)p[6] << 24) | 
+                          ((unsigned int)p[0] << 16) | 
+                          ((unsigned int)p[2] << 8) | p[4];
+            }
+        }
+        break;
+    }
+}
+
+/* Store count ARGB pixels every xstep pixels of the output */
+static void store_pixels(const PNGTarget *t, 
+                         const unsigned int *argb, 
+                         int count,
+                         unsigned char *out, 
+                         int xstep) {
+    int i;
+
+    switch (t->pixelSize) {
+    case 2: {
+        unsigned short *o = (unsigned short *)out;
+        for (i = 0; i < count; i++, o += xstep) {
+            *o = ARGB_TO_565(argb[i]);
+        }
+        break;
+    }
+    case 3:
+        for (i = 0; i < count; i++, out += 3 * xstep) {
+            out[0] = (unsigned char)(argb[i] >> 16);
+            out[1] = (unsigned char)(argb[i] >> 8);
+            out[2] = (unsigned char)argb[i];
+        }
+        break;
+    default: {
+        unsigned int *o = (unsigned int *)out;
+        for (i = 0; i < count; i++, o += xstep) {
+            *o = argb[i];
+        }
+        break;
+    }
+    }
+}
+
+/*
+ * Convert pixels [i0, i1) of an unfiltered row to the output at out,
+ * one pixel every xstep; alpha likewise if wanted
+ */
+static void convert_row(const PNGDecoder *dec, 
+                        const PNGTarget *t,
+                        const unsigned char *row,
+                        int i0, 
+                        int i1,
+                        unsigned char *out, 
+                        unsigned char *alpha,
+                        int xstep) {
+    int count = i1 - i0;
+    int i;
+
+    if (xstep == 1 && t->pixelSize == 2 && dec->bitDepth == 8 &&
+        (dec->colorType == COLOR_PALETTE || 
+         (dec->colorType == COLOR_RGB && !dec->hasTrns))) {
+        /* direct paths for the common opaque and indexed images */
+        unsigned short *o = (unsigned short *)out;
+        if (dec->colorType == COLOR_PALETTE) {
+            row += i0;
+            for (i = 0; i < count; i++) {
+                o[i] = dec->palette565[row[i]];
+            }
+            if (alpha != NULL) {
+                for (i = 0; i < count; i++) {
+                    alpha[i] = (unsigned char)(dec->palette[row[i]] >> 24);
+                }
+            }
+        } else {
+            javautil_pixel_rgb888_to_rgb565(row + 3 * i0, o, count);
+            if (alpha != NULL) {
+                memset(alpha, 0xff, count);
+            }
+        }
+        return;
+    }
+
+    if (xstep == 1 && t->pixelSize == 4) {
+        /* the output row is the ARGB row */
+        expand_row(dec, row, (unsigned int *)out, i0, i1);
+        if (alpha != NULL) {
+            javautil_pixel_argb8888_to_alpha((const unsigned int *)out, 
+                                             alpha, count);
+        }
+        return;
+    }
+
+    expand_row(dec, row, t->argb, i0, i1);
+    if (xstep == 1 && t->pixelSize == 2) {
+        /* pixels and alpha in one pass */
+        javautil_pixel_argb8888_to_rgb565(t->argb, (unsigned short *)out, 
+                                          alpha, count);
+        return;
+    }
+    store_pixels(t, t->argb, count, out, xstep);
+    if (alpha != NULL) {
+        for (i = 0; i < count; i++, alpha += xstep) {
+            *alpha = (unsigned char)(t->argb[i] >> 24);
+        }
+    }
+}
+
+/* Convert row y of an Adam7 pass, or of the image if pass is NULL */
+static void emit_row(const PNGDecoder *dec, 
+                     const PNGTarget *t,
+                     const unsigned char *pass,
+                     int passWidth,
+                     int y,
+                     const unsigned char *row) {
+    static const unsigned char whole[4] = {0, 0, 1, 1};
+    int stride = t->right - t->left;
+    int i0, i1, x0;
+    long offset;
+
+    if (pass == NULL) {
+        pass = whole;
+    }
+    y = pass[1] + y * pass[3];
+    if (y < t->top || y >= t->bottom || t->right <= pass[0]) {
+        return;
+    }
+    i0 = t->left <= pass[0] ? 0 : (t->left - pass[0] + pass[2] - 1) / pass[2];
+    i1 = (t->right - pass[0] + pass[2] - 1) / pass[2];
+    if (i1 > passWidth) {
+        i1 = passWidth;
+    }
+    if (i0 >= i1) {
+        return;
+    }
+    x0 = pass[0] + i0 * pass[2] - t->left;
+    offset = (long)(y - t->top) * stride + x0;
+    convert_row(dec, t, row, i0, i1, 
+                t->out + offset * t->pixelSize,
+                t->alpha != NULL ? t->alpha + offset : NULL,
+                pass[2]);
+}
+
+/* Check the zlib stream header: deflate, no preset dictionary */
+static int check_zlib_header(const unsigned char *z, long len) {
+    return len >= 6 && (z[0] & 0x0f) == 8 && (z[0] >> 4) <= 7 &&
+           ((z[0] << 8) | z[1]) % 31 == 0 && (z[1] & 0x20) == 0;
+}
+
+static int decode_image(PNGDecoder *dec, PNGTarget *t) {
+    const unsigned char *passes = NULL;
+    int numPasses = 1;
+    int passWidth[7], passHeight[7];
+    long totalBytes = 0;
+    long maxRow = 0;
+    long bufSize;
+    unsigned char *buf = NULL;
+    unsigned char *rows = NULL;
+    unsigned char *cur, *prev;
+    long pos = 0;
+    long consumed = 0;
+    unsigned long adler = 1;
+    int pass = 0;
+    int y = 0;
+    int lastRow;
+    long rowLen = 0;
+    int result = 0;
+    int r = PNG_INFLATE_OK;
+    int n;
+
+    if (!check_zlib_header(dec->zdata, dec->zlen)) {
+        return 0;
+    }
+
+    if (dec->interlace) {
+        passes = &adam7[0][0];
+        numPasses = 7;
+    }
+    for (n = 0; n < numPasses; n++) {
+        const unsigned char *p = dec->interlace ? adam7[n] : NULL;
+        long rowBytes;
+        passWidth[n] = p == NULL ? dec->width :
+            (dec->width > p[0] ? (dec->width - p[0] + p[2] - 1) / p[2] : 0);
+        passHeight[n] = p == NULL ? dec->height :
+            (dec->height > p[1] ? (dec->height - p[1] + p[3] - 1) / p[3] : 0);
+        if (passWidth[n] == 0) {
+            passHeight[n] = 0;
+        }
+        rowBytes = ((long)passWidth[n] * dec->bitsPerPixel + 7) >> 3;
+        if (rowBytes > maxRow) {
+            maxRow = rowBytes;
+        }
+        totalBytes += (rowBytes + 1) * passHeight[n];
+    }
+
+    /* rows past the rectangle are not needed unless interlaced */
+    lastRow = dec->interlace ? dec->height : t->bottom;
+
+    bufSize = PNG_INFLATE_WINDOW + 2 * (maxRow + 1);
+    if (bufSize < PNG_INFLATE_WINDOW + PNG_MIN_SPAN) {
+        bufSize = PNG_INFLATE_WINDOW + PNG_MIN_SPAN;
+    }
+    if (bufSize > totalBytes) {
+        bufSize = totalBytes;
+    }
+    /* one more byte to look for data past the image */
+    buf = (unsigned char *)javacall_malloc(bufSize + 1);
+    rows = (unsigned char *)javacall_malloc(2 * (maxRow + 16));
+    if (buf == NULL || rows == NULL) {
+        goto done;
+    }
+    cur = rows;
+    prev = rows + maxRow + 16;
+
+    png_inflate_reset(dec->inflater, dec->zdata + 2, dec->zlen - 2);
+    pass = -1;
+    y = 0;
+    for (;;) {
+        /* start the next pass that has any pixels */
+        while (pass < numPasses && (pass < 0 || y == passHeight[pass])) {
+            pass++;
+            y = 0;
+            if (pass < numPasses && passHeight[pass] != 0) {
+                rowLen = (((long)passWidth[pass] * dec->bitsPerPixel + 7)
+                          >> 3) + 1;
+                memset(prev, 0, rowLen);
+            }
+        }
+        if (pass == numPasses) {
+            break;
+        }
+
+        if (pos - consumed < rowLen) {
+            if (r == PNG_INFLATE_DONE) {
+                goto done;      /* not enough image data */
+            }
+            if (pos == bufSize) {
+                long shift = pos - PNG_INFLATE_WINDOW;
+                if (shift > consumed) {
+                    shift = consumed;
+                }
+                if (shift <= 0) {
+                    goto done;
+                }
+                memmove(buf, buf + shift, pos - shift);
+                pos -= shift;
+                consumed -= shift;
+            }
+            r = png_inflate(dec->inflater, buf, &pos, bufSize);
+            if (r == PNG_INFLATE_ERROR) {
+                goto done;
+            }
+            continue;
+        }
+
+        {
+            unsigned char *raw = buf + consumed;
+            unsigned char *tmp;
+
+            adler = javautil_adler32(adler, raw, rowLen);
+            if (!png_unfilter_row(raw[0], raw + 1, cur, prev, 
+                                  (int)rowLen - 1, dec->bpp)) {
+                goto done;
+            }
+            emit_row(dec, t, 
+                     passes == NULL ? NULL : passes + 4 * pass, 
+                     passWidth[pass], y, cur);
+            tmp = cur;
+            cur = prev;
+            prev = tmp;
+            consumed += rowLen;
+            y++;
+        }
+        if (passes == NULL && y >= lastRow) {
+            if (y < dec->height) {
+                result = 1;     /* the rest is not needed */
+                goto done;
+            }
+        }
+    }
+
+    /* the stream must end with the image data, then comes Adler-32 */
+    if (r != PNG_INFLATE_DONE) {
+        r = png_inflate(dec->inflater, buf, &pos, pos + 1);
+    }
+    if (r == PNG_INFLATE_DONE && pos == consumed) {
+        long used = 2 + png_inflate_input_used(dec->inflater);
+        if (dec->zlen - used >= 4 && 
+            get_uint32(dec->zdata + used) == adler) {
+            result = 1;
+        }
+    }
+
+done:
+    if (buf != NULL) {
+        javacall_free(buf);
+    }
+    if (rows != NULL) {
+        javacall_free(rows);
+    }
+    return result;
+}
+
+static int decode_rect(PNGDecoder *dec, 
+                       char *outData, 
+                       int outPixelSize,
+                       char *alphaData,
+                       int left, int top, int right, int bottom) {
+    PNGTarget t;
+    int ok;
+
+    if (!dec->ready || outData == NULL ||
+        left < 0 || top < 0 || left >= right || top >= bottom ||
+        right > dec->width || bottom > dec->height) {
+        return 0;
+    }
+    t.out = (unsigned char *)outData;
+    t.pixelSize = outPixelSize;
+    t.alpha = (unsigned char *)alphaData;
+    t.left = left;
+    t.top = top;
+    t.right = right;
+    t.bottom = bottom;
+    t.argb = (unsigned int *)javacall_malloc(sizeof(unsigned int) * dec->width);
+    if (t.argb == NULL) {
+        return 0;
+    }
+    ok = decode_image(dec, &t);
+    javacall_free(t.argb);
+    return ok ? (right - left) * (bottom - top) * outPixelSize : 0;
+}
+
+void *PNG_To_RGB_init(void) {
+    PNGDecoder *dec;
+
+    dec = (PNGDecoder *)javacall_malloc(sizeof(PNGDecoder));
+    if (dec == NULL) {
+        return NULL;
+    }
+    memset(dec, 0, sizeof(PNGDecoder));
+    dec->inflater = png_inflate_create();
+    if (dec->inflater == NULL) {
+        javacall_free(dec);
+        return NULL;
+    }
+    return dec;
+}
+
+int PNG_To_RGB_decodeHeader(void *info, char *inData, int inDataLen, 
+                            int *width, int *height) {
+    PNGDecoder *dec = (PNGDecoder *)info;
+    png_inflate_state *inflater = dec->inflater;
+    int n;
+
+    if (dec->zcopy != NULL) {
+        javacall_free(dec->zcopy);
+    }
+    memset(dec, 0, sizeof(PNGDecoder));
+    dec->inflater = inflater;
+
+    if (inData == NULL || inDataLen <= 0 ||
+        !read_chunks(dec, (const unsigned char *)inData, inDataLen)) {
+        return 0;
+    }
+
+    /* indices past the palette are taken as opaque black */
+    for (n = dec->paletteSize; n < 256; n++) {
+        dec->palette[n] = 0xff000000;
+    }
+    for (n = 0; n < 256; n++) {
+        dec->palette565[n] = ARGB_TO_565(dec->palette[n]);
+    }
+    dec->hasAlpha = dec->hasTrns || 
+                    dec->colorType == COLOR_GRAY_ALPHA || 
+                    dec->colorType == COLOR_RGBA;
+    dec->ready = 1;
+
+    *width = dec->width;
+    *height = dec->height;
+    return 1;
+}
+
+int PNG_To_RGB_hasAlpha(void *info) {
+    PNGDecoder *dec = (PNGDecoder *)info;
+    return dec->ready && dec->hasAlpha;
+}
+
+int PNG_To_RGB_decodeData(void *info, char *outData) {
+    PNGDecoder *dec = (PNGDecoder *)info;
+    return decode_rect(dec, outData, 3, NULL, 
+                       0, 0, dec->width, dec->height);
+}
+
+int PNG_To_RGB_decodeData2(void *info, char *outData, int outPixelSize,
+                           int left, int top, int right, int bottom) {
+    return PNG_To_RGB_decodeDataAlpha(info, outData, outPixelSize, NULL,
+                                      left, top, right, bottom);
+}
+
+int PNG_To_RGB_decodeDataAlpha(void *info, char *outData, int outPixelSize,
+                               char *alphaData,
+                               int left, int top, int right, int bottom) {
+    if (outPixelSize != 2 && outPixelSize != 4) {
+        return 0;
+    }
+    return decode_rect((PNGDecoder *)info, outData, outPixelSize, alphaData,
+                       left, top, right, bottom);
+}
+
+char *PNG_To_RGB_decode(void *info, char *inData, int inDataLen,
+                        int *width, int *height) {
+    char *outData;
+
+    if (PNG_To_RGB_decodeHeader(info, inData, inDataLen, width, height) == 0) {
+        return NULL;
+    }
+    outData = (char *)javacall_malloc((*width) * (*height) * 3);
+    if (outData != NULL && PNG_To_RGB_decodeData(info, outData) == 0) {
+        javacall_free(outData);
+        outData = NULL;
+    }
+    return outData;
+}
+
+char *PNG_To_RGB_decode2(void *info, 
+                         char *inData, int inDataLen, int outPixelSize,
+                         int left, int top, int right, int bottom, 
+                         int *width, int *height) {
+    char *outData;
+
+    if (outPixelSize != 2 && outPixelSize != 4) {
+        return NULL;
+    }
+    if (PNG_To_RGB_decodeHeader(info, inData, inDataLen, width, height) == 0) {
+        return NULL;
+    }
+    outData = (char *)javacall_malloc((*width) * (*height) * outPixelSize);
+    if (outData != NULL && 
+        PNG_To_RGB_decodeData2(info, outData, outPixelSize,
+                               left, top, right, bottom) == 0) {
+        javacall_free(outData);
+        outData = NULL;
+    }
+    return outData;
+}
+
+void PNG_To_RGB_free(void *info) {
+    PNGDecoder *dec = (PNGDecoder *)info;
+
+    if (dec == NULL) {
+        return;
+    }
+    if (dec->zcopy != NULL) {
+        javacall_free(dec->zcopy);
+    }
+    png_inflate_destroy(dec->inflater);
+    javacall_free(dec);
+}
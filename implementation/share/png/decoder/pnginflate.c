@@ -0,0 +1,709 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#include <string.h>
+#include "javacall_defs.h"
+#include "javacall_memory.h"
+#include "pnginflate.h"
+
+/* Inflate decompressor ****************************************************
+ *
+ * Huffman codes are decoded through one table lookup on the next
+ * LIT_BITS (DIST_BITS) bits of input.  Each entry holds the code length
+ * and what the code means: a literal, a length or distance base with its
+ * extra bit count, or the end of block.  Where two short literal codes
+ * fit in LIT_BITS together the entry holds both, so that runs of
+ * literals take one lookup per two bytes.  The few longer codes are
+ * decoded canonically from the code length counts.
+ * Input is read through a 64 bit buffer, refilled with a single load
+ * while at least 8 input bytes remain; every refill leaves at least 56
+ * bits, enough for a length and distance code with their extra bits.
+ */
+
+#define MAX_BITS        15
+#define LIT_BITS        11
+#define DIST_BITS       9
+#define CLEN_BITS       7
+#define LIT_CODES       288
+#define DIST_CODES      32
+#define CLEN_CODES      19
+#define END_BLOCK       256
+
+/* Table entry fields */
+#define E_BITS(e)       ((e) & 15)              /* code bits to consume */
+#define E_KIND(e)       (((e) >> 4) & 15)
+#define E_LIT(e)        (((e) >> 8) & 0xff)     /* literal, first literal */
+#define E_EXTRA(e)      (((e) >> 8) & 0xff)     /* extra bits of base */
+#define E_LIT2(e)       (((e) >> 16) & 0xff)    /* second literal */
+#define E_BASE(e)       ((e) >> 16)             /* length or distance base */
+#define E_BITS1(e)      (((e) >> 24) & 15)      /* bits of first literal */
+
+#define K_LIT           0
+#define K_LIT2          1       /* two literals */
+#define K_LEN           2
+#define K_END           3
+#define K_DIST          4
+#define K_SLOW          5       /* code longer than the table */
+#define K_BAD           6       /* no such code */
+
+#define ENTRY(kind, value, base) \
+    (((unsigned int)(kind) << 4) | ((unsigned int)(value) << 8) | \
+     ((unsigned int)(base) << 16))
+
+#define MODE_HEADER     0
+#define MODE_STORED     1
+#define MODE_CODES      2
+#define MODE_DONE       3
+#define MODE_ERROR      4
+
+static const unsigned short len_base[29] = {
+    3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,
+    131,163,195,227,258
+};
+
+static const unsigned char len_extra[29] = {
+    0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0
+};
+
+static const unsigned short dist_base[30] = {
+    1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,
+    2049,3073,4097,6145,8193,12289,16385,24577
+};
+
+static const unsigned char dist_extra[30] = {
+    0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13
+};
+
+static const unsigned char clen_order[CLEN_CODES] = {
+    16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15
+};
+
+/* Canonical code description for codes longer than the table */
+typedef struct {
+    unsigned short count[MAX_BITS + 1];     /* codes per length */
+    unsigned short symbol[LIT_CODES];       /* symbols in code order */
+    const unsigned int *entry;              /* table entry per symbol */
+} png_huffman;
+
+struct _png_inflate_state {
+    const unsigned char *in_start;
+    const unsigned char *in;
+    const unsigned char *in_end;
+    javacall_uint64 bit_buf;
+    unsigned int bit_count;
+    unsigned int pad_bits;      /* zero bits past the end of input */
+
+    int mode;
+    int last;                   /* current block is the last one */
+    int fixed;                  /* tables hold the fixed codes */
+    long stored_len;            /* bytes left in stored block */
+    unsigned int copy_len;      /* match bytes left to copy */
+    unsigned int copy_dist;
+
+    unsigned int lit_table[1 << LIT_BITS];
+    unsigned int dist_table[1 << DIST_BITS];
+    png_huffman lit_code;
+    png_huffman dist_code;
+
+    unsigned int lit_entry[LIT_CODES];
+    unsigned int dist_entry[DIST_CODES];
+};
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || \
+    defined(_M_X64) || (defined(__BYTE_ORDER__) && \
+                        __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+static javacall_uint64 load64(const unsigned char *p) {
+    javacall_uint64 v;
+    memcpy(&v, p, 8);
+    return v;
+}
+#else
+static javacall_uint64 load64(const unsigned char *p) {
+    return (javacall_uint64)p[0] | ((javacall_uint64)p[1] << 8) |
+           ((javacall_uint64)p[2] << 16) | ((javacall_uint64)p[3] << 24) |
+           ((javacall_uint64)p[4] << 32) | ((javacall_uint64)p[5] << 40) |
+           ((javacall_uint64)p[6] << 48) | ((javacall_uint64)p[7] << 56);
+}
+#endif
+
+/*
+ * Top up the bit buffer to more than 56 bits.  Near the end of input
+ * the buffer is padded with zero bits; using any of them is an error,
+ * caught on the next refill or when decompression returns.
+ */
+#define REFILL(in, in_end, bb, count, pad)                              \
+    if ((in_end) - (in) >= 8) {                                         \
+        (bb) |= load64(in) << (count);                                  \
+        (in) += (63 - (count)) >> 3;                                    \
+        (count) |= 56;                                                  \
+    } else {                                                            \
+        if ((pad) > (count)) {                                          \
+            goto bad;                                                   \
+        }                                                               \
+        while ((count) <= 56) {                                         \
+            if ((in) < (in_end)) {                                      \
+                (bb) |= (javacall_uint64)*(in)++ << (count);            \
+            } else {                                                    \
+                (pad) += 8;                                             \
+            }                                                           \
+            (count) += 8;                                               \
+        }                                                               \
+    }
+
+static int fill_bits(png_inflate_state *s) {
+    REFILL(s->in, s->in_end, s->bit_buf, s->bit_count, s->pad_bits);
+    return 1;
+bad:
+    return 0;
+}
+
+/* Take n <= 32 bits from the buffer, which must hold them */
+static unsigned int get_bits(png_inflate_state *s, unsigned int n) {
+    unsigned int v = (unsigned int)(s->bit_buf & ((1u << n) - 1));
+    s->bit_buf >>= n;
+    s->bit_count -= n;
+    return v;
+}
+
+static void init_entries(png_inflate_state *s) {
+    int n;
+
+    for (n = 0; n < 256; n++) {
+        s->lit_entry[n] = ENTRY(K_LIT, n, 0);
+    }
+    s->lit_entry[END_BLOCK] = ENTRY(K_END, 0, 0);
+    for (n = 0; n < 29; n++) {
+        s->lit_entry[257 + n] = ENTRY(K_LEN, len_extra[n], len_base[n]);
+    }
+    s->lit_entry[286] = s->lit_entry[287] = ENTRY(K_BAD, 0, 0);
+    for (n = 0; n < 30; n++) {
+        s->dist_entry[n] = ENTRY(K_DIST, dist_extra[n], dist_base[n]);
+    }
+    s->dist_entry[30] = s->dist_entry[31] = ENTRY(K_BAD, 0, 0);
+}
+
+/*
+ * Build the lookup table of a code from its code lengths.  Incomplete
+ * codes are accepted, their unused bit patterns decode as K_BAD.
+ * 
+ * @return 1 on success, 0 if the code is over-subscribed
+ */
+static int build_table(unsigned int *table, 
+                       int bits,
+                       png_huffman *h,
+                       const unsigned char *lens, 
+                       int n) {
+    unsigned short offs[MAX_BITS + 2];
+    unsigned int next[MAX_BITS + 1];
+    unsigned int code;
+    int size = 1 << bits;
+    int left;
+    int len;
+    int sym;
+
+    for (len = 0; len <= MAX_BITS; len++) {
+        h->count[len] = 0;
+    }
+    for (sym = 0; sym < n; sym++) {
+        h->count[lens[sym]]++;
+    }
+    h->count[0] = 0;
+
+    left = 1;
+    for (len = 1; len <= MAX_BITS; len++) {
+        left = (left << 1) - h->count[len];
+        if (left < 0) {
+            return 0;
+        }
+    }
+
+    offs[1] = 0;
+    code = 0;
+    for (len = 1; len <= MAX_BITS; len++) {
+        offs[len + 1] = (unsigned short)(offs[len] + h->count[len]);
+        next[len] = code;
+        code = (code + h->count[len]) << 1;
+    }
+    for (sym = 0; sym < n; sym++) {
+        if (lens[sym] != 0) {
+            h->symbol[offs[lens[sym]]++] = (unsigned short)sym;
+        }
+    }
+
+    for (sym = 0; sym < size; sym++) {
+        table[sym] = ENTRY(K_BAD, 0, 0);
+    }
+    for (sym = 0; sym < n; sym++) {
+        unsigned int rev = 0;
+        unsigned int c;
+        int i;
+
+        len = lens[sym];
+        if (len == 0) {
+            continue;
+        }
+        /* codes are stored most significant bit first */
+        c = next[len]++;
+        for (i = 0; i < len; i++) {
+            rev = (rev << 1) | ((c >> i) & 1);
+        }
+        if (len <= bits) {
+            unsigned int e = h->entry[sym] | (unsigned int)len;
+            for (i = (int)rev; i < size; i += 1 << len) {
+                table[i] = e;
+            }
+        } else {
+            table[rev & (size - 1)] = ENTRY(K_SLOW, 0, 0);
+        }
+    }
+    return 1;
+}
+
+/*
+ * Combine pairs of literal codes that fit in the table bits.  Entries
+ * are visited from the top so that table[i >> len] still holds a single
+ * literal when it is read.
+ */
+static void pair_literals(unsigned int *table, int bits) {
+    int i;
+
+    for (i = (1 << bits) - 1; i >= 0; i--) {
+        unsigned int e = table[i];
+        unsigned int len = E_BITS(e);
+        unsigned int e2;
+
+        if (E_KIND(e) != K_LIT || len >= (unsigned int)bits) {
+            continue;
+        }
+        e2 = table[i >> len];
+        if (E_KIND(e2) == K_LIT && E_BITS(e2) <= bits - len) {
+            table[i] = (len + E_BITS(e2)) | (K_LIT2 << 4) | 
+                       (E_LIT(e) << 8) | (E_LIT(e2) << 16) | (len << 24);
+        }
+    }
+}
+
+/* Decode a code longer than the table bits, canonically bit by bit */
+static unsigned int decode_slow(const png_huffman *h, javacall_uint64 bb) {
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    int len;
+
+    for (len = 1; len <= MAX_BITS; len++) {
+        int count = h->count[len];
+
+        code |= (int)(bb & 1);
+        bb >>= 1;
+        if (code - count < first) {
+            return h->entry[h->symbol[index + (code - first)]] | 
+                   (unsigned int)len;
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return ENTRY(K_BAD, 0, 0);
+}
+
+static int build_fixed(png_inflate_state *s) {
+    unsigned char lens[LIT_CODES];
+
+    memset(lens, 8, 144);
+    memset(lens + 144, 9, 112);
+    memset(lens + 256, 7, 24);
+    memset(lens + 280, 8, 8);
+    build_table(s->lit_table, LIT_BITS, &s->lit_code, lens, LIT_CODES);
+    pair_literals(s->lit_table, LIT_BITS);
+    memset(lens, 5, DIST_CODES);
+    build_table(s->dist_table, DIST_BITS, &s->dist_code, lens, DIST_CODES);
+    s->fixed = 1;
+    return 1;
+}
+
+static int build_dynamic(png_inflate_state *s) {
+    unsigned char lens[LIT_CODES + DIST_CODES];
+    unsigned int clen_table[1 << CLEN_BITS];
+    png_huffman clen_code;
+    int nlen, ndist, ncode;
+    int n;
+
+    if (!fill_bits(s)) {
+        return 0;
+    }
+    nlen = (int)get_bits(s, 5) + 257;
+    ndist = (int)get_bits(s, 5) + 1;
+    ncode = (int)get_bits(s, 4) + 4;
+    if (nlen > 286 || ndist > 30) {
+        return 0;
+    }
+
+    memset(lens, 0, CLEN_CODES);
+    for (n = 0; n < ncode; n++) {
+        if (s->bit_count < 3 && !fill_bits(s)) {
+            return 0;
+        }
+        lens[clen_order[n]] = (unsigned char)get_bits(s, 3);
+    }
+    /* code length symbols are literals 0..18 */
+    clen_code.entry = s->lit_entry;
+    if (!build_table(clen_table, CLEN_BITS, &clen_code, lens, CLEN_CODES)) {
+        return 0;
+    }
+
+    n = 0;
+    while (n < nlen + ndist) {
+        unsigned int e;
+        int sym, rep, val;
+
+        if (!fill_bits(s)) {
+            return 0;
+        }
+        e = clen_table[s->bit_buf & ((1 << CLEN_BITS) - 1)];
+        if (E_KIND(e) != K_LIT) {
+            return 0;
+        }
+        get_bits(s, E_BITS(e));
+        sym = (int)E_LIT(e);
+        if (sym < 16) {
+            lens[n++] = (unsigned char)sym;
+            continue;
+        }
+        if (sym == 16) {
+            if (n == 0) {
+                return 0;
+            }
+            val = lens[n - 1];
+            rep = 3 + (int)get_bits(s, 2);
+        } else if (sym == 17) {
+            val = 0;
+            rep = 3 + (int)get_bits(s, 3);
+        } else {
+            val = 0;
+            rep = 11 + (int)get_bits(s, 7);
+        }
+        if (n + rep > nlen + ndist) {
+            return 0;
+        }
+        memset(lens + n, val, rep);
+        n += rep;
+    }
+
+    /* without an end of block code the block cannot end */
+    if (lens[END_BLOCK] == 0) {
+        return 0;
+    }
+    if (!build_table(s->lit_table, LIT_BITS, &s->lit_code, lens, nlen) ||
+        !build_table(s->dist_table, DIST_BITS, &s->dist_code, 
+                     lens + nlen, ndist)) {
+        return 0;
+    }
+    pair_literals(s->lit_table, LIT_BITS);
+    s->fixed = 0;
+    return 1;
+}
+
+/*
+ * Copy a match of len bytes from dist bytes back.  Non-overlapping
+ * matches go 8 bytes at a time when there is room for the overrun.
+ */
+static void copy_match(unsigned char *dst, 
+                       unsigned int dist, 
+                       long len, 
+                       const unsigned char *limit) {
+    const unsigned char *src = dst - dist;
+
+    if (dist >= 8 && limit - dst >= len + 8) {
+        do {
+            memcpy(dst, src, 8);
+            dst += 8;
+            src += 8;
+            len -= 8;
+        } while (len > 0);
+    } else if (dist == 1) {
+        memset(dst, *src, len);
+    } else {
+        while (len-- > 0) {
+            *dst++ = *src++;
+        }
+    }
+}
+
+/*
+ * Decode the symbols of a compressed block until its end or until the
+ * output is full
+ */
+static int inflate_codes(png_inflate_state *s, 
+                         unsigned char *out, 
+                         long *out_pos, 
+                         long size) {
+    const unsigned char *in = s->in;
+    const unsigned char *in_end = s->in_end;
+    const unsigned int *lit_table = s->lit_table;
+    const unsigned int *dist_table = s->dist_table;
+    javacall_uint64 bb = s->bit_buf;
+    unsigned int count = s->bit_count;
+    unsigned int pad = s->pad_bits;
+    long pos = *out_pos;
+
+    if (s->copy_len != 0) {
+        long len = s->copy_len;
+        if (len > size - pos) {
+            len = size - pos;
+        }
+        copy_match(out + pos, s->copy_dist, len, out + size);
+        pos += len;
+        s->copy_len -= (unsigned int)len;
+    }
+
+    while (pos < size) {
+        unsigned int e;
+        unsigned int n;
+        long len;
+        unsigned int dist;
+
+        REFILL(in, in_end, bb, count, pad);
+        e = lit_table[bb & ((1 << LIT_BITS) - 1)];
+
+        if (E_KIND(e) == K_LIT2) {
+            out[pos++] = (unsigned char)E_LIT(e);
+            if (pos < size) {
+                out[pos++] = (unsigned char)E_LIT2(e);
+                n = E_BITS(e);
+            } else {
+                n = E_BITS1(e);
+            }
+            bb >>= n;
+            count -= n;
+            continue;
+        }
+        if (E_KIND(e) == K_SLOW) {
+            e = decode_slow(&s->lit_code, bb);
+        }
+        n = E_BITS(e);
+        bb >>= n;
+        count -= n;
+
+        if (E_KIND(e) == K_LIT) {
+            out[pos++] = (unsigned char)E_LIT(e);
+            continue;
+        }
+        if (E_KIND(e) == K_END) {
+            s->mode = s->last ? MODE_DONE : MODE_HEADER;
+            break;
+        }
+        if (E_KIND(e) != K_LEN) {
+            goto bad;
+        }
+        n = E_EXTRA(e);
+        len = (long)(E_BASE(e) + (unsigned int)(bb & ((1u << n) - 1)));
+        bb >>= n;
+        count -= n;
+
+        e = dist_table[bb & ((1 << DIST_BITS) - 1)];
+        if (E_KIND(e) == K_SLOW) {
+            e = decode_slow(&s->dist_code, bb);
+        }
+        if (E_KIND(e) != K_DIST) {
+            goto bad;
+        }
+        n = E_BITS(e);
+        bb >>= n;
+        count -= n;
+        n = E_EXTRA(e);
+        dist = E_BASE(e) + (unsigned int)(bb & ((1u << n) - 1));
+        bb >>= n;
+        count -= n;
+        if ((long)dist > pos) {
+            goto bad;
+        }
+
+        if (len > size - pos) {
+            s->copy_len = (unsigned int)(len - (size - pos));
+            s->copy_dist = dist;
+            len = size - pos;
+        }
+        copy_match(out + pos, dist, len, out + size);
+        pos += len;
+    }
+
+    if (pad > count) {
+        goto bad;
+    }
+    s->in = in;
+    s->bit_buf = bb;
+    s->bit_count = count;
+    s->pad_bits = pad;
+    *out_pos = pos;
+    return PNG_INFLATE_OK;
+
+bad:
+    s->mode = MODE_ERROR;
+    *out_pos = pos;
+    return PNG_INFLATE_ERROR;
+}
+
+/* Give whole bytes left in the bit buffer back to the input */
+static void align_input(png_inflate_state *s) {
+    get_bits(s, s->bit_count & 7);
+    s->in -= (s->bit_count - s->pad_bits) >> 3;
+    s->bit_buf = 0;
+    s->bit_count = 0;
+    s->pad_bits = 0;
+}
+
+static int read_header(png_inflate_state *s) {
+    unsigned int type;
+
+    if (!fill_bits(s)) {
+        return 0;
+    }
+    s->last = (int)get_bits(s, 1);
+    type = get_bits(s, 2);
+    if (type == 0) {
+        const unsigned char *p;
+        unsigned int len;
+
+        if (s->pad_bits > s->bit_count) {
+            return 0;
+        }
+        align_input(s);
+        p = s->in;
+        if (s->in_end - p < 4) {
+            return 0;
+        }
+        len = p[0] | (p[1] << 8);
+        if ((len ^ (p[2] | (p[3] << 8))) != 0xffff) {
+            return 0;
+        }
+        s->in += 4;
+        s->stored_len = (long)len;
+        s->mode = MODE_STORED;
+        return 1;
+    }
+    if (type == 1) {
+        if (!s->fixed && !build_fixed(s)) {
+            return 0;
+        }
+    } else if (type != 2 || !build_dynamic(s)) {
+        return 0;
+    }
+    s->mode = MODE_CODES;
+    return 1;
+}
+
+png_inflate_state *png_inflate_create(void) {
+    png_inflate_state *s;
+
+    s = (png_inflate_state *)javacall_malloc(sizeof(png_inflate_state));
+    if (s == NULL) {
+        return NULL;
+    }
+    memset(s, 0, sizeof(png_inflate_state));
+    init_entries(s);
+    s->lit_code.entry = s->lit_entry;
+    s->dist_code.entry = s->dist_entry;
+    s->mode = MODE_ERROR;
+    return s;
+}
+
+void png_inflate_reset(png_inflate_state *s, 
+                       const unsigned char *in, 
+                       long len) {
+    s->in_start = in;
+    s->in = in;
+    s->in_end = in + len;
+    s->bit_buf = 0;
+    s->bit_count = 0;
+    s->pad_bits = 0;
+    s->mode = MODE_HEADER;
+    s->last = 0;
+    s->stored_len = 0;
+    s->copy_len = 0;
+    s->copy_dist = 0;
+}
+
+int png_inflate(png_inflate_state *s, 
+                unsigned char *out, 
+                long *pos, 
+                long size) {
+    for (;;) {
+        switch (s->mode) {
+        case MODE_HEADER:
+            if (!read_header(s)) {
+                s->mode = MODE_ERROR;
+                return PNG_INFLATE_ERROR;
+            }
+            break;
+
+        case MODE_STORED: {
+            long n = s->stored_len;
+
+            if (n > size - *pos) {
+                n = size - *pos;
+            }
+            if (n > s->in_end - s->in) {
+                s->mode = MODE_ERROR;
+                return PNG_INFLATE_ERROR;
+            }
+            memcpy(out + *pos, s->in, n);
+            s->in += n;
+            *pos += n;
+            s->stored_len -= n;
+            if (s->stored_len != 0) {
+                return PNG_INFLATE_OK;
+            }
+            s->mode = s->last ? MODE_DONE : MODE_HEADER;
+            break;
+        }
+
+        case MODE_CODES:
+            if (inflate_codes(s, out, pos, size) == PNG_INFLATE_ERROR) {
+                return PNG_INFLATE_ERROR;
+            }
+            if (s->mode == MODE_CODES) {
+                return PNG_INFLATE_OK;
+            }
+            break;
+
+        case MODE_DONE:
+            return PNG_INFLATE_DONE;
+
+        default:
+            return PNG_INFLATE_ERROR;
+        }
+    }
+}
+
+long png_inflate_input_used(png_inflate_state *s) {
+    return (long)(s->in - s->in_start) - 
+           (long)((s->bit_count - s->pad_bits) >> 3);
+}
+
+void png_inflate_destroy(png_inflate_state *s) {
+    if (s != NULL) {
+        javacall_free(s);
+    }
+}
@@ -0,0 +1,225 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#include <string.h>
+#include "javacall_defs.h"
+#include "pngunfilter.h"
+
+/*
+ * SSE2 kernels for 3 and 4 byte pixels, the common RGB and RGBA cases,
+ * where SSE2 is part of the compilation target.  A pixel depends on the
+ * one decoded before it, so the vectors hold one pixel; the predictors
+ * are computed on 16-bit lanes.
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNG_UNFILTER_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef PNG_UNFILTER_SSE2
+
+#define LOAD(p)     _mm_loadu_si128((const __m128i *)(p))
+#define STORE(p, v) _mm_storeu_si128((__m128i *)(p), v)
+
+/* 3 byte pixels are put together in a register, never through memory */
+static __m128i load_pixel(const unsigned char *p, int bpp) {
+    int v;
+    if (bpp == 4) {
+        memcpy(&v, p, 4);
+    } else {
+        v = p[0] | (p[1] << 8) | (p[2] << 16);
+    }
+    return _mm_cvtsi32_si128(v);
+}
+
+static void store_pixel(unsigned char *p, __m128i v, int bpp) {
+    int x = _mm_cvtsi128_si32(v);
+    if (bpp == 4) {
+        memcpy(p, &x, 4);
+    } else {
+        p[0] = (unsigned char)x;
+        p[1] = (unsigned char)(x >> 8);
+        p[2] = (unsigned char)(x >> 16);
+    }
+}
+
+static int up_sse2(const unsigned char *in, unsigned char *cur,
+                   const unsigned char *prev, int len) {
+    int i;
+    for (i = 0; i + 16 <= len; i += 16) {
+        STORE(cur + i, _mm_add_epi8(LOAD(in + i), LOAD(prev + i)));
+    }
+    return i;
+}
+
+static void sub_sse2(const unsigned char *in, unsigned char *cur,
+                     int len, int bpp) {
+    __m128i a = _mm_setzero_si128();
+    int i;
+    for (i = 0; i < len; i += bpp) {
+        a = _mm_add_epi8(a, load_pixel(in + i, bpp));
+        store_pixel(cur + i, a, bpp);
+    }
+}
+
+static void average_sse2(const unsigned char *in, unsigned char *cur,
+                         const unsigned char *prev, int len, int bpp) {
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i a = _mm_setzero_si128();
+    int i;
+    for (i = 0; i < len; i += bpp) {
+        __m128i b = load_pixel(prev + i, bpp);
+        /* pavgb rounds up; take the carry back off to get (a + b) >> 1 */
+        __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b),
+                                   _mm_and_si128(_mm_xor_si128(a, b), one));
+        a = _mm_add_epi8(avg, load_pixel(in + i, bpp));
+        store_pixel(cur + i, a, bpp);
+    }
+}
+
+static __m128i abs_epi16(__m128i v) {
+    return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+static void paeth_sse2(const unsigned char *in, unsigned char *cur,
+                       const unsigned char *prev, int len, int bpp) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = zero;
+    __m128i c = zero;
+    int i;
+    for (i = 0; i < len; i += bpp) {
+        __m128i b = _mm_unpacklo_epi8(load_pixel(prev + i, bpp), zero);
+        __m128i pa = _mm_sub_epi16(b, c);
+        __m128i pb = _mm_sub_epi16(a, c);
+        __m128i pc = _mm_add_epi16(pa, pb);
+        __m128i min, use_a, use_b, p;
+
+        pa = abs_epi16(pa);
+        pb = abs_epi16(pb);
+        pc = abs_epi16(pc);
+        min = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+        /* ties go to a, then b, as in the PNG specification */
+        use_a = _mm_cmpeq_epi16(pa, min);
+        use_b = _mm_cmpeq_epi16(pb, min);
+        p = _mm_or_si128(_mm_and_si128(use_b, b), _mm_andnot_si128(use_b, c));
+        p = _mm_or_si128(_mm_and_si128(use_a, a), _mm_andnot_si128(use_a, p));
+
+        p = _mm_add_epi8(_mm_packus_epi16(p, p), load_pixel(in + i, bpp));
+        store_pixel(cur + i, p, bpp);
+        a = _mm_unpacklo_epi8(p, zero);
+        c = b;
+    }
+}
+
+#endif /* PNG_UNFILTER_SSE2 */
+
+int png_unfilter_row(int type,
+                     const unsigned char *in,
+                     unsigned char *cur,
+                     const unsigned char *prev,
+                     int len,
+                     int bpp) {
+    int i = 0;
+    int a, b, c, p, pa, pb, pc;
+
+#ifdef PNG_UNFILTER_SSE2
+    int pixels = (bpp == 3 || bpp == 4) && len % bpp == 0;
+#endif
+
+    switch (type) {
+    case PNG_UNFILTER_NONE:
+        memcpy(cur, in, len);
+        break;
+
+    case PNG_UNFILTER_SUB:
+#ifdef PNG_UNFILTER_SSE2
+        if (pixels) {
+            sub_sse2(in, cur, len, bpp);
+            break;
+        }
+#endif
+        for (; i < bpp && i < len; i++) {
+            cur[i] = in[i];
+        }
+        for (; i < len; i++) {
+            cur[i] = (unsigned char)(in[i] + cur[i - bpp]);
+        }
+        break;
+
+    case PNG_UNFILTER_UP:
+#ifdef PNG_UNFILTER_SSE2
+        i = up_sse2(in, cur, prev, len);
+#endif
+        for (; i < len; i++) {
+            cur[i] = (unsigned char)(in[i] + prev[i]);
+        }
+        break;
+
+    case PNG_UNFILTER_AVERAGE:
+#ifdef PNG_UNFILTER_SSE2
+        if (pixels) {
+            average_sse2(in, cur, prev, len, bpp);
+            break;
+        }
+#endif
+        for (; i < bpp && i < len; i++) {
+            cur[i] = (unsigned char)(in[i] + (prev[i] >> 1));
+        }
+        for (; i < len; i++) {
+            cur[i] = (unsigned char)(in[i] + ((cur[i - bpp] + prev[i]) >> 1));
+        }
+        break;
+
+    case PNG_UNFILTER_PAETH:
+#ifdef PNG_UNFILTER_SSE2
+        if (pixels) {
+            paeth_sse2(in, cur, prev, len, bpp);
+            break;
+        }
+#endif
+        /* left and upper left are zero: the predictor is the byte above */
+        for (; i < bpp && i < len; i++) {
+            cur[i] = (unsigned char)(in[i] + prev[i]);
+        }
+        for (; i < len; i++) {
+            a = cur[i - bpp];
+            b = prev[i];
+            c = prev[i - bpp];
+            p = b - c;
+            pc = a - c;
+            pa = p < 0 ? -p : p;
+            pb = pc < 0 ? -pc : pc;
+            pc = (p + pc) < 0 ? -(p + pc) : p + pc;
+            p = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            cur[i] = (unsigned char)(in[i] + p);
+        }
+        break;
+
+    default:
+        return 0;
+    }
+    return 1;
+}
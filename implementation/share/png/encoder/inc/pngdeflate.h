@@ -0,0 +1,189 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#ifndef __JAVAUTIL_MEDIA_PNG_DEFLATE_H
+#define __JAVAUTIL_MEDIA_PNG_DEFLATE_H
+
+/*
+ * Small self-contained deflate (RFC 1951) compressor used by the PNG
+ * encoder.  It produces a raw deflate stream; the zlib header and the
+ * Adler-32 trailer are written by the caller.
+ */
+
+#define PNG_DEFLATE_STORE       0   /* stored blocks, no compression */
+#define PNG_DEFLATE_FAST        1   /* greedy matching, short hash chains */
+#define PNG_DEFLATE_DEFAULT     2   /* lazy matching, zlib level 6 like */
+#define PNG_DEFLATE_BEST        3   /* lazy matching, long hash chains */
+
+/* Flush modes of png_deflate_write */
+#define PNG_DEFLATE_NO_FLUSH    0   /* more input follows */
+#define PNG_DEFLATE_FINISH      1   /* last input, end the stream */
+#define PNG_DEFLATE_SYNC_FLUSH  2   /* end on a byte boundary, not last */
+
+/* Longest useful preset dictionary */
+#define PNG_DEFLATE_DICT_SIZE   32768
+
+typedef struct _png_deflate_state png_deflate_state;
+
+/**
+ * Receives the output buffer when it is full, see png_deflate_set_flush
+ * 
+ * @param data      Pointer given to png_deflate_set_flush
+ * @param out       Compressed data, the start of the output buffer
+ * @param len       Number of bytes in out
+ * 
+ * @return Non-zero to continue, 0 to fail the compression
+ */
+typedef int (*png_deflate_flush_func)(void *data, 
+                                      unsigned char *out, 
+                                      long len);
+
+/**
+ * Worst case size of the raw deflate stream for len input bytes
+ * 
+ * @param len       Number of uncompressed bytes
+ * 
+ * @return Maximum number of bytes png_deflate_write can produce
+ */
+long png_deflate_bound(long len);
+
+/**
+ * Allocate compressor state
+ * 
+ * @param level     One of PNG_DEFLATE_STORE, PNG_DEFLATE_FAST,
+ *                  PNG_DEFLATE_DEFAULT or PNG_DEFLATE_BEST
+ * 
+ * @return New compressor, or NULL if out of memory
+ */
+png_deflate_state *png_deflate_create(int level);
+
+/**
+ * Start a new independent stream with the same level, dropping all
+ * history and pending output
+ * 
+ * @param s         Compressor
+ */
+void png_deflate_reset(png_deflate_state *s);
+
+/**
+ * Preset the history with data that precedes the input, for a stream
+ * continuing another one.  Only valid before the first png_deflate_write
+ * after png_deflate_create or png_deflate_reset.
+ * 
+ * @param s         Compressor
+ * @param dict      Data preceding the input
+ * @param len       Size of dict; at most the last PNG_DEFLATE_DICT_SIZE
+ *                  bytes are used
+ */
+void png_deflate_set_dictionary(png_deflate_state *s, 
+                                const unsigned char *dict, 
+                                long len);
+
+/**
+ * Release compressor state
+ * 
+ * @param s         Compressor returned by png_deflate_create
+ */
+void png_deflate_destroy(png_deflate_state *s);
+
+/**
+ * Set the buffer compressed data is written to
+ * 
+ * @param s         Compressor
+ * @param out       Output buffer
+ * @param size      Size of output buffer in bytes
+ */
+void png_deflate_set_output(png_deflate_state *s, 
+                            unsigned char *out, 
+                            long size);
+
+/**
+ * Stream the output: whenever the output buffer is full it is passed
+ * to flush and then reused from its start.  Without a flush function a
+ * full output buffer fails the compression.
+ * 
+ * @param s         Compressor
+ * @param flush     Function receiving the full output buffer, or NULL
+ * @param data      Passed to flush
+ */
+void png_deflate_set_flush(png_deflate_state *s, 
+                           png_deflate_flush_func flush, 
+                           void *data);
+
+/**
+ * Compress next part of the input
+ * 
+ * @param s         Compressor
+ * @param in        Uncompressed data
+ * @param len       Size of uncompressed data in bytes
+ * @param flush     PNG_DEFLATE_NO_FLUSH, or PNG_DEFLATE_FINISH for the 
+ *                  last part of the input, or PNG_DEFLATE_SYNC_FLUSH to
+ *                  compress all input so far and end the output with an
+ *                  empty stored block, so that it can be followed by an 
+ *                  independently compressed stream
+ * 
+ * @return 0 on success, -1 if the output buffer is too small
+ *         or the flush function failed
+ */
+int png_deflate_write(png_deflate_state *s, 
+                      const unsigned char *in, 
+                      long len, 
+                      int flush);
+
+/**
+ * Append bytes to the output as they are, for the zlib header before
+ * the first png_deflate_write and the trailer after the finishing one
+ * 
+ * @param s         Compressor
+ * @param buf       Bytes to append
+ * @param len       Number of bytes
+ * 
+ * @return 0 on success, -1 if the output buffer is too small
+ *         or the flush function failed
+ */
+int png_deflate_write_raw(png_deflate_state *s, 
+                          const unsigned char *buf, 
+                          long len);
+
+/**
+ * Pass the data still held in the output buffer to the flush function
+ * 
+ * @param s         Compressor
+ * 
+ * @return 0 on success, -1 if the flush function failed
+ */
+int png_deflate_flush_output(png_deflate_state *s);
+
+/**
+ * Get number of compressed bytes written since png_deflate_set_output,
+ * including the bytes already passed to the flush function
+ * 
+ * @param s         Compressor
+ * 
+ * @return Byte size of compressed data
+ */
+long png_deflate_total_out(png_deflate_state *s);
+
+#endif  /* __JAVAUTIL_MEDIA_PNG_DEFLATE_H */
@@ -26,6 +26,47 @@
 #ifndef __JAVAUTIL_MEDIA_PNG_ENCODER_H
 #define __JAVAUTIL_MEDIA_PNG_ENCODER_H
 
+/* Compression levels of javautil_media_*_to_png_level */
+#define JAVAUTIL_PNG_LEVEL_NONE     0   /* stored blocks only */
+#define JAVAUTIL_PNG_LEVEL_FAST     1   /* greedy matching */
+#define JAVAUTIL_PNG_LEVEL_DEFAULT  2   /* used by javautil_media_*_to_png */
+#define JAVAUTIL_PNG_LEVEL_BEST     3   /* slowest, smallest output */
+
+/*
+ * Row filter strategies.  A single PNG filter type can be forced, or
+ * chosen per row: flat rows stay unfiltered, other rows take the filter
+ * with the minimum sum of absolute differences.  The default is per row
+ * for truecolor and unfiltered for indexed color.
+ * Filters only apply to compressed output; JAVAUTIL_PNG_LEVEL_NONE
+ * always writes unfiltered rows.
+ */
+#define JAVAUTIL_PNG_FILTER_DEFAULT  -1  /* encoder's choice */
+#define JAVAUTIL_PNG_FILTER_NONE      0  /* fastest */
+#define JAVAUTIL_PNG_FILTER_SUB       1
+#define JAVAUTIL_PNG_FILTER_UP        2
+#define JAVAUTIL_PNG_FILTER_AVERAGE   3
+#define JAVAUTIL_PNG_FILTER_PAETH     4
+#define JAVAUTIL_PNG_FILTER_ADAPTIVE  5  /* best of the above per row */
+
+/*
+ * Parameters of javautil_media_*_to_png_params.  With threads above 1,
+ * images of more than 256K of pixel data are compressed in segments on
+ * up to that many threads; the output is the same for any such number
+ * of threads but differs slightly from the single stream output.
+ * Threads are only used if the encoder is built with 
+ * USE_JC_PNG_THREADS=true, otherwise segments are compressed in turn.
+ * Images of at most 256 colors are written as indexed color at 1, 2, 4
+ * or 8 bits per pixel unless truecolor is set; JAVAUTIL_PNG_LEVEL_NONE
+ * always writes truecolor.
+ * Streaming encodes ignore threads and always write truecolor.
+ */
+typedef struct {
+    int level;      /* JAVAUTIL_PNG_LEVEL_* */
+    int filter;     /* JAVAUTIL_PNG_FILTER_* */
+    int threads;    /* compressor threads, 0 or 1 for the caller only */
+    int truecolor;  /* non-zero to never write indexed color */
+} javautil_png_params;
+
 /**
  * Get PNG buffer size for image that has width and height
  * 
@@ -37,7 +78,7 @@
 int javautil_media_get_png_size(int width, int height);
 
 /**
- * Encode rgb888 format data to PNG data format (there is no compression)
+ * Encode rgb888 format data to PNG data format
  * 
  * @param input     Pointer to rgb888 data
  * @param output    Pointer to PNG encode buffer
@@ -52,7 +93,7 @@ int javautil_media_rgb_to_png(unsigned char *input,
                               int height);
 
 /**
- * Encode rgbX888 format data to PNG data format (there is no compression)
+ * Encode rgbX888 format data to PNG data format
  * 
  * @param input     Pointer to rgbX888 data
  * @param output    Pointer to PNG encode buffer
@@ -66,4 +107,202 @@ int javautil_media_rgbX888_to_png(unsigned char *input,
                                   int width, 
                                   int height);
 
+/**
+ * Encode rgb888 format data to PNG data format with given compression
+ * 
+ * @param input     Pointer to rgb888 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param level     Compression level, one of JAVAUTIL_PNG_LEVEL_*
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgb_to_png_level(unsigned char *input, 
+                                    unsigned char *output,
+                                    int width, 
+                                    int height,
+                                    int level);
+
+/**
+ * Encode rgbX888 format data to PNG data format with given compression
+ * 
+ * @param input     Pointer to rgbX888 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param level     Compression level, one of JAVAUTIL_PNG_LEVEL_*
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgbX888_to_png_level(unsigned char *input, 
+                                        unsigned char *output,
+                                        int width, 
+                                        int height,
+                                        int level);
+
+/**
+ * Encode rgb888 format data to PNG data format with given parameters
+ * 
+ * @param input     Pointer to rgb888 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param params    Compression level and row filter strategy
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgb_to_png_params(unsigned char *input, 
+                                     unsigned char *output,
+                                     int width, 
+                                     int height,
+                                     const javautil_png_params *params);
+
+/**
+ * Encode rgbX888 format data to PNG data format with given parameters
+ * 
+ * @param input     Pointer to rgbX888 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param params    Compression level and row filter strategy
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgbX888_to_png_params(unsigned char *input, 
+                                         unsigned char *output,
+                                         int width, 
+                                         int height,
+                                         const javautil_png_params *params);
+
+/**
+ * Encode rgb565 format data to PNG data format
+ * 
+ * @param input     Pointer to rgb565 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgb565_to_png(unsigned short *input, 
+                                 unsigned char *output,
+                                 int width, 
+                                 int height);
+
+/**
+ * Encode rgb565 format data to PNG data format with given compression
+ * 
+ * @param input     Pointer to rgb565 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param level     Compression level, one of JAVAUTIL_PNG_LEVEL_*
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgb565_to_png_level(unsigned short *input, 
+                                       unsigned char *output,
+                                       int width, 
+                                       int height,
+                                       int level);
+
+/**
+ * Encode rgb565 format data to PNG data format with given parameters
+ * 
+ * @param input     Pointer to rgb565 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param params    Compression level and row filter strategy
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgb565_to_png_params(unsigned short *input, 
+                                        unsigned char *output,
+                                        int width, 
+                                        int height,
+                                        const javautil_png_params *params);
+
+/* Input formats of javautil_media_png_stream_init, value is pixel bytes */
+#define JAVAUTIL_PNG_FORMAT_RGB565      2   /* native 16-bit pixels */
+#define JAVAUTIL_PNG_FORMAT_RGB888      3
+#define JAVAUTIL_PNG_FORMAT_RGBX888     4
+
+/**
+ * Receives the output of a streaming encoder
+ * 
+ * @param sinkData  Pointer given to javautil_media_png_stream_init
+ * @param data      Encoded bytes, valid only during the call
+ * @param len       Number of bytes in data
+ * 
+ * @return Non-zero to continue, 0 to abort the encoding
+ */
+typedef int (*javautil_png_sink)(void *sinkData, 
+                                 const unsigned char *data, 
+                                 int len);
+
+typedef struct _javautil_png_stream javautil_png_stream;
+
+/**
+ * Start a streaming PNG encode.  Rows are passed in any number of
+ * javautil_media_png_stream_write calls and the PNG goes to the sink
+ * as it is produced: signature and IHDR from this call, then one call
+ * per complete IDAT chunk of chunkSize data bytes, then the last IDAT
+ * and IEND from javautil_media_png_stream_finish.  Neither the whole
+ * input nor the whole output is held; the encoder keeps the compressor
+ * window, about 16K of rows and one IDAT chunk.
+ * 
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param format    One of JAVAUTIL_PNG_FORMAT_*
+ * @param params    Compression level and row filter strategy, 
+ *                  NULL for the defaults
+ * @param chunkSize Data bytes per IDAT chunk, 0 for the default of 8K
+ * @param sink      Function receiving the encoded data
+ * @param sinkData  Passed to sink
+ * 
+ * @return Encoder handle, NULL on failure
+ */
+javautil_png_stream *javautil_media_png_stream_init(int width, 
+                                                    int height,
+                                                    int format,
+                                                    const javautil_png_params *params,
+                                                    int chunkSize,
+                                                    javautil_png_sink sink,
+                                                    void *sinkData);
+
+/**
+ * Encode the next rows of the image, top to bottom
+ * 
+ * @param stream    Handle returned by javautil_media_png_stream_init
+ * @param input     First row to encode
+ * @param rowStride Distance between rows in input, in bytes
+ * @param numRows   Number of rows in input; rows past the image height
+ *                  are ignored
+ * 
+ * @return 1 on success, 0 on failure, including the sink failing
+ */
+int javautil_media_png_stream_write(javautil_png_stream *stream,
+                                    const unsigned char *input,
+                                    int rowStride,
+                                    int numRows);
+
+/**
+ * Complete a streaming encode after all rows have been written, and
+ * send the remaining IDAT data and IEND to the sink
+ * 
+ * @param stream    Handle returned by javautil_media_png_stream_init
+ * 
+ * @return Byte size of encoded PNG data, 0 on failure
+ */
+int javautil_media_png_stream_finish(javautil_png_stream *stream);
+
+/**
+ * Release a streaming encoder, finished or not
+ * 
+ * @param stream    Handle returned by javautil_media_png_stream_init
+ */
+void javautil_media_png_stream_free(javautil_png_stream *stream);
+
 #endif  /* __JAVAUTIL_MEDIA_PNG_ENCODER_H */
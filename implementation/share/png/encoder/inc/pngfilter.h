@@ -0,0 +1,90 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#ifndef __JAVAUTIL_MEDIA_PNG_FILTER_H
+#define __JAVAUTIL_MEDIA_PNG_FILTER_H
+
+/*
+ * PNG row filters (filter method 0) used by the PNG encoder.
+ * Filters read unfiltered rows only, so every kernel is a plain
+ * element-wise operation.
+ */
+
+#define PNG_FILTER_NONE     0
+#define PNG_FILTER_SUB      1
+#define PNG_FILTER_UP       2
+#define PNG_FILTER_AVERAGE  3
+#define PNG_FILTER_PAETH    4
+
+/**
+ * Filter one row
+ * 
+ * @param type      One of PNG_FILTER_*
+ * @param cur       Unfiltered current row
+ * @param prev      Unfiltered previous row, all zero for the first row
+ * @param out       Filtered row
+ * @param len       Row length in bytes, without the filter type byte
+ * @param bpp       Bytes per complete pixel
+ */
+void png_filter_row(int type,
+                    const unsigned char *cur,
+                    const unsigned char *prev,
+                    unsigned char *out,
+                    int len,
+                    int bpp);
+
+/**
+ * Minimum sum of absolute differences heuristic: sum of the filtered
+ * bytes taken as signed values
+ * 
+ * @param row       Filtered row
+ * @param len       Row length in bytes
+ * 
+ * @return Cost of the row, lower is expected to compress better
+ */
+unsigned long png_filter_cost(const unsigned char *row, int len);
+
+/**
+ * Filter one row adaptively.  Rows where at least half of the bytes
+ * repeat the byte to the left or above are left unfiltered; other rows
+ * use the filter type of lowest png_filter_cost.
+ * 
+ * @param cur       Unfiltered current row
+ * @param prev      Unfiltered previous row, all zero for the first row
+ * @param out       Filtered row
+ * @param scratch   Work buffer of len bytes
+ * @param len       Row length in bytes, without the filter type byte
+ * @param bpp       Bytes per complete pixel
+ * 
+ * @return Filter type used, one of PNG_FILTER_*
+ */
+int png_filter_adaptive(const unsigned char *cur,
+                        const unsigned char *prev,
+                        unsigned char *out,
+                        unsigned char *scratch,
+                        int len,
+                        int bpp);
+
+#endif  /* __JAVAUTIL_MEDIA_PNG_FILTER_H */
@@ -0,0 +1,49 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#ifndef __JAVAUTIL_MEDIA_PNG_THREAD_H
+#define __JAVAUTIL_MEDIA_PNG_THREAD_H
+
+/*
+ * Minimal fork/join used by the parallel PNG compressor.  Threads are
+ * only created when the encoder is built with ENABLE_PNG_THREADS
+ * (USE_JC_PNG_THREADS=true); otherwise all work runs in the caller.
+ */
+
+typedef void (*png_thread_func)(void *arg, int index);
+
+/**
+ * Call func(arg, index) for every index in 0..count-1 and wait for all
+ * calls to return.  Index 0 runs on the calling thread and the others
+ * on new threads where possible; an index whose thread cannot be
+ * started runs on the calling thread instead.
+ * 
+ * @param func      Function to run
+ * @param arg       Passed to func
+ * @param count     Number of calls
+ */
+void png_run_threads(png_thread_func func, void *arg, int count);
+
+#endif  /* __JAVAUTIL_MEDIA_PNG_THREAD_H */
@@ -0,0 +1,1010 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+#include <string.h>
+#include "javacall_defs.h"
+#include "javacall_memory.h"
+#include "pngdeflate.h"
+
+/* Deflate compressor ******************************************************
+ *
+ * LZ77 over a 32K sliding window with hash chains, followed by a choice
+ * per block between stored, fixed Huffman and dynamic Huffman coding.
+ * The structure follows the classic zlib design (2*WSIZE window which is
+ * slid by WSIZE, lazy match evaluation) in a much smaller form.
+ */
+
+#define WSIZE           32768
+#define WMASK           (WSIZE - 1)
+#define HASH_BITS       15
+#define HASH_SIZE       (1 << HASH_BITS)
+#define MIN_MATCH       3
+#define MAX_MATCH       258
+#define MIN_LOOKAHEAD   (MAX_MATCH + MIN_MATCH + 1)
+#define MAX_DIST        (WSIZE - MIN_LOOKAHEAD)
+#define TOO_FAR         4096
+#define NIL             0
+
+#define LIT_BUFSIZE     16384   /* symbols per block */
+#define MAX_STORED      65535   /* largest stored block */
+
+#define LITERALS        256
+#define END_BLOCK       256
+#define LENGTH_CODES    29
+#define L_CODES         (LITERALS + 1 + LENGTH_CODES)
+#define D_CODES         30
+#define BL_CODES        19
+#define MAX_BITS        15
+#define MAX_BL_BITS     7
+
+#define STORED_BLOCK    0
+#define STATIC_TREES    1
+#define DYN_TREES       2
+
+#define REP_3_6         16  /* repeat previous length 3-6 times */
+#define REPZ_3_10       17  /* repeat zero length 3-10 times */
+#define REPZ_11_138     18  /* repeat zero length 11-138 times */
+
+static const int extra_lbits[LENGTH_CODES] = {
+    0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0
+};
+
+static const int extra_dbits[D_CODES] = {
+    0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13
+};
+
+static const unsigned char bl_order[BL_CODES] = {
+    16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15
+};
+
+/*
+ * Matching parameters per level.  For the greedy (non lazy) level
+ * max_lazy is the longest match whose strings are still inserted into
+ * the hash table.
+ */
+typedef struct {
+    unsigned int good_length;   /* reduce chain search above this length */
+    unsigned int max_lazy;      /* do not try lazy match above this length */
+    unsigned int nice_length;   /* stop searching above this length */
+    unsigned int max_chain;     /* hash chain entries to follow */
+    int lazy;                   /* use lazy match evaluation */
+} png_deflate_config;
+
+static const png_deflate_config configs[] = {
+    /* PNG_DEFLATE_FAST */    {4,   4,  16,    8, 0},
+    /* PNG_DEFLATE_DEFAULT */ {8,  16, 128,  128, 1},
+    /* PNG_DEFLATE_BEST */    {32, 258, 258, 4096, 1}
+};
+
+struct _png_deflate_state {
+    const png_deflate_config *config;   /* NULL for PNG_DEFLATE_STORE */
+
+    /* sliding window and hash chains */
+    unsigned char window[2 * WSIZE];
+    unsigned short head[HASH_SIZE];
+    unsigned short prev[WSIZE];
+
+    long block_start;           /* window position of current block */
+    unsigned int strstart;      /* start of string to insert */
+    unsigned int lookahead;     /* valid bytes ahead of strstart */
+    unsigned int match_start;   /* start of best match */
+    unsigned int match_length;  /* length of best match */
+    unsigned int prev_length;   /* best match at previous step */
+    unsigned int prev_match;    /* previous match start */
+    int match_available;        /* previous byte still to be coded */
+
+    /* pending input */
+    const unsigned char *next_in;
+    long avail_in;
+
+    /* symbols of the current block */
+    unsigned char sym_lc[LIT_BUFSIZE];      /* literal or length - 3 */
+    unsigned short sym_dist[LIT_BUFSIZE];   /* distance or 0 */
+    unsigned int sym_next;
+    unsigned int lit_freq[L_CODES];
+    unsigned int dist_freq[D_CODES];
+
+    /* output */
+    unsigned char *out;
+    long out_size;
+    long out_pos;
+    long out_flushed;           /* bytes handed to flush before out_pos */
+    png_deflate_flush_func flush;
+    void *flush_data;
+    unsigned long bit_buf;
+    int bit_count;
+    int overflow;
+
+    /* code tables */
+    unsigned char length_code[MAX_MATCH - MIN_MATCH + 1];
+    unsigned char dist_code[512];
+    int base_length[LENGTH_CODES];
+    int base_dist[D_CODES];
+    unsigned short static_lcode[L_CODES + 2];
+    unsigned char static_llen[L_CODES + 2];
+    unsigned short static_dcode[D_CODES];
+    unsigned char static_dlen[D_CODES];
+};
+
+#define UPDATE_HASH(p) \
+    ((((unsigned int)(p)[0] << 16 | (unsigned int)(p)[1] << 8 | (p)[2]) \
+      * 2654435761U & 0xffffffffU) >> (32 - HASH_BITS))
+
+#define D_CODE(s, dist) \
+    ((dist) < 256 ? (s)->dist_code[dist] : (s)->dist_code[256 + ((dist) >> 7)])
+
+/****************************************************************
+ * Bit output
+ ****************************************************************/
+
+/*
+ * Hand the output buffer to the flush function and start over at its
+ * beginning.  Once flush has failed, output is discarded.
+ */
+static void flush_out(png_deflate_state *s) {
+    if (s->out_pos > 0 && !s->overflow &&
+        !s->flush(s->flush_data, s->out, s->out_pos)) {
+        s->overflow = 1;
+    }
+    s->out_flushed += s->out_pos;
+    s->out_pos = 0;
+}
+
+static void put_byte(png_deflate_state *s, unsigned char c) {
+    if (s->out_pos == s->out_size && s->flush != NULL) {
+        flush_out(s);
+    }
+    if (s->out_pos < s->out_size) {
+        s->out[s->out_pos++] = c;
+    } else {
+        s->overflow = 1;
+    }
+}
+
+static void put_bytes(png_deflate_state *s, const unsigned char *buf, long len) {
+    long n;
+
+    while (len > 0) {
+        if (s->out_pos == s->out_size) {
+            if (s->flush == NULL) {
+                s->overflow = 1;
+                return;
+            }
+            flush_out(s);
+        }
+        n = s->out_size - s->out_pos;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(s->out + s->out_pos, buf, n);
+        s->out_pos += n;
+        buf += n;
+        len -= n;
+    }
+}
+
+static void send_bits(png_deflate_state *s, unsigned int value, int length) {
+    s->bit_buf |= (unsigned long)value << s->bit_count;
+    s->bit_count += length;
+    while (s->bit_count >= 8) {
+        put_byte(s, (unsigned char)(s->bit_buf & 0xff));
+        s->bit_buf >>= 8;
+        s->bit_count -= 8;
+    }
+}
+
+static void align_bits(png_deflate_state *s) {
+    if (s->bit_count > 0) {
+        put_byte(s, (unsigned char)(s->bit_buf & 0xff));
+    }
+    s->bit_buf = 0;
+    s->bit_count = 0;
+}
+
+/****************************************************************
+ * Huffman trees
+ ****************************************************************/
+
+static unsigned int bi_reverse(unsigned int code, int len) {
+    unsigned int res = 0;
+    do {
+        res = (res << 1) | (code & 1);
+        code >>= 1;
+    } while (--len > 0);
+    return res;
+}
+
+/*
+ * Assign canonical codes, bit reversed for LSB first output.
+ */
+static void gen_codes(const unsigned char *len, int n, unsigned short *code) {
+    unsigned int next_code[MAX_BITS + 1];
+    int bl_count[MAX_BITS + 1];
+    unsigned int c = 0;
+    int i, bits;
+
+    memset(bl_count, 0, sizeof(bl_count));
+    for (i = 0; i < n; i++) {
+        bl_count[len[i]]++;
+    }
+    bl_count[0] = 0;
+    for (bits = 1; bits <= MAX_BITS; bits++) {
+        c = (c + bl_count[bits - 1]) << 1;
+        next_code[bits] = c;
+    }
+    for (i = 0; i < n; i++) {
+        if (len[i] != 0) {
+            code[i] = (unsigned short)bi_reverse(next_code[len[i]]++, len[i]);
+        }
+    }
+}
+
+/*
+ * Compute Huffman code lengths no longer than max_bits.  Leaves are
+ * sorted by frequency and merged with the two queue method; if the tree
+ * gets too deep the frequencies are flattened and the tree is rebuilt.
+ */
+static void build_lengths(const unsigned int *freq, int n, int max_bits,
+                          unsigned char *len) {
+    unsigned int weight[2 * L_CODES];
+    int parent[2 * L_CODES];
+    int depth[2 * L_CODES];
+    int leaf[L_CODES];
+    int count = 0;
+    int i, j, max_len;
+
+    memset(len, 0, n);
+    for (i = 0; i < n; i++) {
+        if (freq[i] != 0) {
+            leaf[count] = i;
+            weight[count++] = freq[i];
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+    if (count == 1) {
+        len[leaf[0]] = 1;
+        return;
+    }
+
+    /* insertion sort of the leaves by weight */
+    for (i = 1; i < count; i++) {
+        unsigned int w = weight[i];
+        int sym = leaf[i];
+        for (j = i; j > 0 && weight[j - 1] > w; j--) {
+            weight[j] = weight[j - 1];
+            leaf[j] = leaf[j - 1];
+        }
+        weight[j] = w;
+        leaf[j] = sym;
+    }
+
+    for (;;) {
+        int next_leaf = 0;
+        int next_node = count;
+        int nodes = count;
+
+        /* internal nodes are created in non decreasing weight order */
+        while (nodes < 2 * count - 1) {
+            int pick[2];
+            int k;
+            for (k = 0; k < 2; k++) {
+                if (next_leaf < count &&
+                    (next_node >= nodes || weight[next_leaf] <= weight[next_node])) {
+                    pick[k] = next_leaf++;
+                } else {
+                    pick[k] = next_node++;
+                }
+            }
+            weight[nodes] = weight[pick[0]] + weight[pick[1]];
+            parent[pick[0]] = nodes;
+            parent[pick[1]] = nodes;
+            nodes++;
+        }
+
+        depth[nodes - 1] = 0;
+        for (i = nodes - 2; i >= 0; i--) {
+            depth[i] = depth[parent[i]] + 1;
+        }
+
+        max_len = 0;
+        for (i = 0; i < count; i++) {
+            if (depth[i] > max_len) {
+                max_len = depth[i];
+            }
+        }
+        if (max_len <= max_bits) {
+            break;
+        }
+
+        /* flatten the distribution; the order of the leaves is kept */
+        for (i = 0; i < count; i++) {
+            weight[i] = (weight[i] >> 1) | 1;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        len[leaf[i]] = (unsigned char)depth[i];
+    }
+}
+
+static void init_tables(png_deflate_state *s) {
+    int code, n;
+    int length = 0;
+    int dist = 0;
+
+    for (code = 0; code < LENGTH_CODES - 1; code++) {
+        s->base_length[code] = length;
+        for (n = 0; n < (1 << extra_lbits[code]); n++) {
+            s->length_code[length++] = (unsigned char)code;
+        }
+    }
+    /* length 258 has its own code */
+    s->length_code[length - 1] = (unsigned char)code;
+    s->base_length[code] = MAX_MATCH - MIN_MATCH;
+
+    for (code = 0; code < 16; code++) {
+        s->base_dist[code] = dist;
+        for (n = 0; n < (1 << extra_dbits[code]); n++) {
+            s->dist_code[dist++] = (unsigned char)code;
+        }
+    }
+    dist >>= 7;
+    for (; code < D_CODES; code++) {
+        s->base_dist[code] = dist << 7;
+        for (n = 0; n < (1 << (extra_dbits[code] - 7)); n++) {
+            s->dist_code[256 + dist++] = (unsigned char)code;
+        }
+    }
+
+    for (n = 0; n < L_CODES + 2; n++) {
+        s->static_llen[n] = (unsigned char)
+            (n < 144 ? 8 : n < 256 ? 9 : n < 280 ? 7 : 8);
+    }
+    gen_codes(s->static_llen, L_CODES + 2, s->static_lcode);
+    for (n = 0; n < D_CODES; n++) {
+        s->static_dlen[n] = 5;
+    }
+    gen_codes(s->static_dlen, D_CODES, s->static_dcode);
+}
+
+/****************************************************************
+ * Block output
+ ****************************************************************/
+
+/*
+ * Bits needed for the symbols of the current block with given trees
+ */
+static unsigned long data_bits(png_deflate_state *s,
+                               const unsigned char *llen,
+                               const unsigned char *dlen) {
+    unsigned long bits = 0;
+    int i;
+
+    for (i = 0; i < L_CODES; i++) {
+        bits += (unsigned long)s->lit_freq[i] * llen[i];
+    }
+    for (i = 0; i < LENGTH_CODES; i++) {
+        bits += (unsigned long)s->lit_freq[LITERALS + 1 + i] * extra_lbits[i];
+    }
+    for (i = 0; i < D_CODES; i++) {
+        bits += (unsigned long)s->dist_freq[i] * (dlen[i] + extra_dbits[i]);
+    }
+    return bits;
+}
+
+static void compress_block(png_deflate_state *s,
+                           const unsigned short *lcode,
+                           const unsigned char *llen,
+                           const unsigned short *dcode,
+                           const unsigned char *dlen) {
+    unsigned int i;
+
+    for (i = 0; i < s->sym_next; i++) {
+        unsigned int dist = s->sym_dist[i];
+        unsigned int lc = s->sym_lc[i];
+
+        if (dist == 0) {
+            send_bits(s, lcode[lc], llen[lc]);
+        } else {
+            int code = s->length_code[lc];
+            send_bits(s, lcode[code + LITERALS + 1], llen[code + LITERALS + 1]);
+            if (extra_lbits[code] != 0) {
+                send_bits(s, lc - s->base_length[code], extra_lbits[code]);
+            }
+            dist--;
+            code = D_CODE(s, dist);
+            send_bits(s, dcode[code], dlen[code]);
+            if (extra_dbits[code] != 0) {
+                send_bits(s, dist - s->base_dist[code], extra_dbits[code]);
+            }
+        }
+    }
+    send_bits(s, lcode[END_BLOCK], llen[END_BLOCK]);
+}
+
+static void stored_block(png_deflate_state *s, const unsigned char *buf,
+                         long len, int last) {
+    do {
+        unsigned int n = len > MAX_STORED ? MAX_STORED : (unsigned int)len;
+        len -= n;
+        send_bits(s, (STORED_BLOCK << 1) + (last && len == 0), 3);
+        align_bits(s);
+        put_byte(s, (unsigned char)(n & 0xff));
+        put_byte(s, (unsigned char)(n >> 8));
+        put_byte(s, (unsigned char)(~n & 0xff));
+        put_byte(s, (unsigned char)((~n >> 8) & 0xff));
+        put_bytes(s, buf, n);
+        buf += n;
+    } while (len > 0);
+}
+
+/*
+ * Emit symbols tallied since block_start, which cover the window
+ * up to end, as the cheapest of stored, fixed and dynamic blocks.
+ */
+static void flush_block(png_deflate_state *s, long end, int last) {
+    unsigned int lfreq[L_CODES];
+    unsigned int dfreq[D_CODES];
+    unsigned int blfreq[BL_CODES];
+    unsigned char llen[L_CODES];
+    unsigned char dlen[D_CODES];
+    unsigned char bllen[BL_CODES];
+    unsigned short lcode[L_CODES];
+    unsigned short dcode[D_CODES];
+    unsigned short blcode[BL_CODES];
+    unsigned char lens[L_CODES + D_CODES];
+    unsigned char rle_sym[L_CODES + D_CODES];
+    unsigned char rle_extra[L_CODES + D_CODES];
+    int nrle = 0;
+    int hlit, hdist, hclen, nlens;
+    int i, used;
+    long stored_len = end - s->block_start;
+    unsigned long stored_bits, fixed_bits, dyn_bits;
+
+    s->lit_freq[END_BLOCK]++;
+
+    /* dynamic trees; force at least two codes in each tree */
+    memcpy(lfreq, s->lit_freq, sizeof(lfreq));
+    memcpy(dfreq, s->dist_freq, sizeof(dfreq));
+    for (i = 0, used = 0; i < L_CODES; i++) {
+        used += lfreq[i] != 0;
+    }
+    if (used < 2) {
+        lfreq[0] = 1;
+    }
+    for (i = 0, used = 0; i < D_CODES; i++) {
+        used += dfreq[i] != 0;
+    }
+    if (used < 2) {
+        dfreq[dfreq[0] != 0 ? 1 : 0] = 1;
+        if (used == 0) {
+            dfreq[1] = 1;
+        }
+    }
+    build_lengths(lfreq, L_CODES, MAX_BITS, llen);
+    build_lengths(dfreq, D_CODES, MAX_BITS, dlen);
+
+    for (hlit = L_CODES; hlit > LITERALS + 1 && llen[hlit - 1] == 0; hlit--)
+        ;
+    for (hdist = D_CODES; hdist > 1 && dlen[hdist - 1] == 0; hdist--)
+        ;
+    memcpy(lens, llen, hlit);
+    memcpy(lens + hlit, dlen, hdist);
+    nlens = hlit + hdist;
+
+    /* run length encode the code lengths */
+    memset(blfreq, 0, sizeof(blfreq));
+    for (i = 0; i < nlens;) {
+        int cur = lens[i];
+        int run = 1;
+        while (i + run < nlens && lens[i + run] == cur) {
+            run++;
+        }
+        i += run;
+        if (cur == 0) {
+            while (run >= 11) {
+                int r = run > 138 ? 138 : run;
+                rle_sym[nrle] = REPZ_11_138;
+                rle_extra[nrle++] = (unsigned char)(r - 11);
+                run -= r;
+            }
+            if (run >= 3) {
+                rle_sym[nrle] = REPZ_3_10;
+                rle_extra[nrle++] = (unsigned char)(run - 3);
+                run = 0;
+            }
+        } else {
+            rle_sym[nrle] = (unsigned char)cur;
+            rle_extra[nrle++] = 0;
+            run--;
+            while (run >= 3) {
+                int r = run > 6 ? 6 : run;
+                rle_sym[nrle] = REP_3_6;
+                rle_extra[nrle++] = (unsigned char)(r - 3);
+                run -= r;
+            }
+        }
+        while (run-- > 0) {
+            rle_sym[nrle] = (unsigned char)cur;
+            rle_extra[nrle++] = 0;
+        }
+    }
+    for (i = 0; i < nrle; i++) {
+        blfreq[rle_sym[i]]++;
+    }
+    build_lengths(blfreq, BL_CODES, MAX_BL_BITS, bllen);
+    for (hclen = BL_CODES; hclen > 4 && bllen[bl_order[hclen - 1]] == 0; hclen--)
+        ;
+
+    dyn_bits = 3 + 5 + 5 + 4 + 3 * hclen;
+    for (i = 0; i < nrle; i++) {
+        dyn_bits += bllen[rle_sym[i]];
+        dyn_bits += rle_sym[i] == REP_3_6 ? 2 :
+                    rle_sym[i] == REPZ_3_10 ? 3 :
+                    rle_sym[i] == REPZ_11_138 ? 7 : 0;
+    }
+    dyn_bits += data_bits(s, llen, dlen);
+    fixed_bits = 3 + data_bits(s, s->static_llen, s->static_dlen);
+
+    /*
+     * Stored blocks are only possible while the block data is still in
+     * the window; fill_window flushes before sliding it out, so this
+     * always holds and the output never exceeds the stored size.
+     */
+    stored_bits = (unsigned long)-1;
+    if (s->block_start >= 0) {
+        long chunks = stored_len == 0 ? 1 : (stored_len + MAX_STORED - 1) / MAX_STORED;
+        stored_bits = 3 + ((8 - ((s->bit_count + 3) & 7)) & 7) + 32
+                      + (chunks - 1) * (8 + 32) + 8 * (unsigned long)stored_len;
+    }
+
+    if (stored_bits <= fixed_bits && stored_bits <= dyn_bits) {
+        stored_block(s, s->window + s->block_start, stored_len, last);
+    } else if (fixed_bits <= dyn_bits) {
+        send_bits(s, (STATIC_TREES << 1) + last, 3);
+        compress_block(s, s->static_lcode, s->static_llen,
+                       s->static_dcode, s->static_dlen);
+    } else {
+        gen_codes(llen, L_CODES, lcode);
+        gen_codes(dlen, D_CODES, dcode);
+        gen_codes(bllen, BL_CODES, blcode);
+        send_bits(s, (DYN_TREES << 1) + last, 3);
+        send_bits(s, hlit - 257, 5);
+        send_bits(s, hdist - 1, 5);
+        send_bits(s, hclen - 4, 4);
+        for (i = 0; i < hclen; i++) {
+            send_bits(s, bllen[bl_order[i]], 3);
+        }
+        for (i = 0; i < nrle; i++) {
+            int sym = rle_sym[i];
+            send_bits(s, blcode[sym], bllen[sym]);
+            if (sym == REP_3_6) {
+                send_bits(s, rle_extra[i], 2);
+            } else if (sym == REPZ_3_10) {
+                send_bits(s, rle_extra[i], 3);
+            } else if (sym == REPZ_11_138) {
+                send_bits(s, rle_extra[i], 7);
+            }
+        }
+        compress_block(s, lcode, llen, dcode, dlen);
+    }
+
+    memset(s->lit_freq, 0, sizeof(s->lit_freq));
+    memset(s->dist_freq, 0, sizeof(s->dist_freq));
+    s->sym_next = 0;
+    s->block_start = end;
+}
+
+/****************************************************************
+ * LZ77
+ ****************************************************************/
+
+static int tally(png_deflate_state *s, unsigned int dist, unsigned int lc) {
+    s->sym_dist[s->sym_next] = (unsigned short)dist;
+    s->sym_lc[s->sym_next++] = (unsigned char)lc;
+    if (dist == 0) {
+        s->lit_freq[lc]++;
+    } else {
+        dist--;
+        s->lit_freq[s->length_code[lc] + LITERALS + 1]++;
+        s->dist_freq[D_CODE(s, dist)]++;
+    }
+    return s->sym_next == LIT_BUFSIZE - 1;
+}
+
+static unsigned int insert_string(png_deflate_state *s, unsigned int pos) {
+    unsigned int h = UPDATE_HASH(s->window + pos);
+    unsigned int match_head = s->head[h];
+    s->prev[pos & WMASK] = (unsigned short)match_head;
+    s->head[h] = (unsigned short)pos;
+    return match_head;
+}
+
+static void fill_window(png_deflate_state *s) {
+    unsigned long more;
+
+    if (s->strstart >= WSIZE + MAX_DIST) {
+        unsigned short *p;
+        int n;
+
+        /* keep the current block stored-able after the slide */
+        if (s->block_start < WSIZE) {
+            flush_block(s, s->strstart - s->match_available, 0);
+        }
+        memcpy(s->window, s->window + WSIZE, WSIZE);
+        s->match_start -= WSIZE;
+        s->strstart -= WSIZE;
+        s->block_start -= WSIZE;
+        for (p = s->head, n = HASH_SIZE; n > 0; n--, p++) {
+            *p = (unsigned short)(*p >= WSIZE ? *p - WSIZE : NIL);
+        }
+        for (p = s->prev, n = WSIZE; n > 0; n--, p++) {
+            *p = (unsigned short)(*p >= WSIZE ? *p - WSIZE : NIL);
+        }
+    }
+
+    more = 2 * WSIZE - s->strstart - s->lookahead;
+    if (more > (unsigned long)s->avail_in) {
+        more = s->avail_in;
+    }
+    if (more > 0) {
+        memcpy(s->window + s->strstart + s->lookahead, s->next_in, more);
+        s->next_in += more;
+        s->avail_in -= more;
+        s->lookahead += more;
+    }
+}
+
+static unsigned int longest_match(png_deflate_state *s, unsigned int cur_match) {
+    unsigned int chain_length = s->config->max_chain;
+    unsigned char *scan = s->window + s->strstart;
+    unsigned char *strend = scan + MAX_MATCH;
+    unsigned char *match;
+    unsigned int len;
+    unsigned int best_len = s->prev_length;
+    unsigned int nice_match = s->config->nice_length;
+    unsigned int limit = s->strstart > MAX_DIST ? s->strstart - MAX_DIST : NIL;
+    unsigned char scan_end1 = scan[best_len - 1];
+    unsigned char scan_end = scan[best_len];
+
+    if (s->prev_length >= s->config->good_length) {
+        chain_length >>= 2;
+    }
+    if (nice_match > s->lookahead) {
+        nice_match = s->lookahead;
+    }
+
+    do {
+        match = s->window + cur_match;
+        if (match[best_len] != scan_end || match[best_len - 1] != scan_end1 ||
+            match[0] != scan[0] || match[1] != scan[1]) {
+            continue;
+        }
+
+        /* the hash guarantees nothing, so compare from the third byte on */
+        scan += 2;
+        match += 2;
+        do {
+        } while (*++scan == *++match && *++scan == *++match &&
+                 *++scan == *++match && *++scan == *++match &&
+                 *++scan == *++match && *++scan == *++match &&
+                 *++scan == *++match && *++scan == *++match &&
+                 scan < strend);
+
+        len = MAX_MATCH - (unsigned int)(strend - scan);
+        scan = strend - MAX_MATCH;
+
+        if (len > best_len) {
+            s->match_start = cur_match;
+            best_len = len;
+            if (len >= nice_match) {
+                break;
+            }
+            scan_end1 = scan[best_len - 1];
+            scan_end = scan[best_len];
+        }
+    } while ((cur_match = s->prev[cur_match & WMASK]) > limit &&
+             --chain_length != 0);
+
+    return best_len <= s->lookahead ? best_len : s->lookahead;
+}
+
+/*
+ * Greedy matching: take the longest match at each position.
+ */
+static void deflate_fast(png_deflate_state *s, int flush) {
+    unsigned int hash_head;
+    int bflush;
+
+    for (;;) {
+        if (s->lookahead < MIN_LOOKAHEAD) {
+            fill_window(s);
+            if (s->lookahead < MIN_LOOKAHEAD && flush == PNG_DEFLATE_NO_FLUSH) {
+                return;
+            }
+            if (s->lookahead == 0) {
+                break;
+            }
+        }
+
+        hash_head = NIL;
+        if (s->lookahead >= MIN_MATCH) {
+            hash_head = insert_string(s, s->strstart);
+        }
+        s->match_length = MIN_MATCH - 1;
+        if (hash_head != NIL && s->strstart - hash_head <= MAX_DIST) {
+            s->match_length = longest_match(s, hash_head);
+        }
+
+        if (s->match_length >= MIN_MATCH) {
+            bflush = tally(s, s->strstart - s->match_start,
+                           s->match_length - MIN_MATCH);
+            s->lookahead -= s->match_length;
+            if (s->match_length <= s->config->max_lazy &&
+                s->lookahead >= MIN_MATCH) {
+                s->match_length--;
+                do {
+                    s->strstart++;
+                    insert_string(s, s->strstart);
+                } while (--s->match_length != 0);
+                s->strstart++;
+            } else {
+                s->strstart += s->match_length;
+                s->match_length = 0;
+            }
+        } else {
+            bflush = tally(s, 0, s->window[s->strstart]);
+            s->lookahead--;
+            s->strstart++;
+        }
+        if (bflush) {
+            flush_block(s, s->strstart, 0);
+        }
+    }
+    flush_block(s, s->strstart, flush == PNG_DEFLATE_FINISH);
+}
+
+/*
+ * Lazy matching: a match is only taken if the next position does not
+ * start a longer one.
+ */
+static void deflate_slow(png_deflate_state *s, int flush) {
+    unsigned int hash_head;
+    int bflush;
+
+    for (;;) {
+        if (s->lookahead < MIN_LOOKAHEAD) {
+            fill_window(s);
+            if (s->lookahead < MIN_LOOKAHEAD && flush == PNG_DEFLATE_NO_FLUSH) {
+                return;
+            }
+            if (s->lookahead == 0) {
+                break;
+            }
+        }
+
+        hash_head = NIL;
+        if (s->lookahead >= MIN_MATCH) {
+            hash_head = insert_string(s, s->strstart);
+        }
+
+        s->prev_length = s->match_length;
+        s->prev_match = s->match_start;
+        s->match_length = MIN_MATCH - 1;
+
+        if (hash_head != NIL && s->prev_length < s->config->max_lazy &&
+            s->strstart - hash_head <= MAX_DIST) {
+            s->match_length = longest_match(s, hash_head);
+            if (s->match_length == MIN_MATCH &&
+                s->strstart - s->match_start > TOO_FAR) {
+                /* a far away match of 3 is not worth the distance code */
+                s->match_length = MIN_MATCH - 1;
+            }
+        }
+
+        if (s->prev_length >= MIN_MATCH && s->match_length <= s->prev_length) {
+            unsigned int max_insert = s->strstart + s->lookahead - MIN_MATCH;
+
+            bflush = tally(s, s->strstart - 1 - s->prev_match,
+                           s->prev_length - MIN_MATCH);
+            s->lookahead -= s->prev_length - 1;
+            s->prev_length -= 2;
+            do {
+                if (++s->strstart <= max_insert) {
+                    insert_string(s, s->strstart);
+                }
+            } while (--s->prev_length != 0);
+            s->match_available = 0;
+            s->match_length = MIN_MATCH - 1;
+            s->strstart++;
+            if (bflush) {
+                flush_block(s, s->strstart, 0);
+            }
+        } else if (s->match_available) {
+            if (tally(s, 0, s->window[s->strstart - 1])) {
+                flush_block(s, s->strstart, 0);
+            }
+            s->strstart++;
+            s->lookahead--;
+        } else {
+            s->match_available = 1;
+            s->strstart++;
+            s->lookahead--;
+        }
+    }
+
+    if (s->match_available) {
+        tally(s, 0, s->window[s->strstart - 1]);
+        s->match_available = 0;
+    }
+    flush_block(s, s->strstart, flush == PNG_DEFLATE_FINISH);
+}
+
+/****************************************************************
+ * Interface
+ ****************************************************************/
+
+/**
+ * Worst case size of the raw deflate stream for len input bytes
+ * 
+ * Each block is emitted as the cheapest of its stored and Huffman forms,
+ * so the stream is never larger than the input split into stored blocks.
+ * Blocks end after at least LIT_BUFSIZE - 1 input bytes or at a window
+ * slide, and a stored block costs at most 5 bytes per 64K.
+ */
+long png_deflate_bound(long len) {
+    return len + (len >> 10) + 32;
+}
+
+png_deflate_state *png_deflate_create(int level) {
+    png_deflate_state *s;
+
+    if (level < PNG_DEFLATE_STORE) {
+        level = PNG_DEFLATE_STORE;
+    } else if (level > PNG_DEFLATE_BEST) {
+        level = PNG_DEFLATE_BEST;
+    }
+
+    s = (png_deflate_state *)javacall_malloc(sizeof(png_deflate_state));
+    if (s == NULL) {
+        return NULL;
+    }
+    memset(s, 0, sizeof(png_deflate_state));
+
+    s->config = level == PNG_DEFLATE_STORE ? NULL :
+                &configs[level - PNG_DEFLATE_FAST];
+    s->match_length = MIN_MATCH - 1;
+    s->prev_length = MIN_MATCH - 1;
+    init_tables(s);
+
+    return s;
+}
+
+void png_deflate_reset(png_deflate_state *s) {
+    /* stale prev entries are unreachable once head is cleared */
+    memset(s->head, 0, sizeof(s->head));
+    s->block_start = 0;
+    s->strstart = 0;
+    s->lookahead = 0;
+    s->match_start = 0;
+    s->match_length = MIN_MATCH - 1;
+    s->prev_length = MIN_MATCH - 1;
+    s->prev_match = 0;
+    s->match_available = 0;
+    s->sym_next = 0;
+    memset(s->lit_freq, 0, sizeof(s->lit_freq));
+    memset(s->dist_freq, 0, sizeof(s->dist_freq));
+    s->out_pos = 0;
+    s->out_flushed = 0;
+    s->bit_buf = 0;
+    s->bit_count = 0;
+    s->overflow = 0;
+}
+
+void png_deflate_set_dictionary(png_deflate_state *s, 
+                                const unsigned char *dict, 
+                                long len) {
+    unsigned int n;
+
+    /* older data is out of reach of the first string anyway */
+    if (len > MAX_DIST) {
+        dict += len - MAX_DIST;
+        len = MAX_DIST;
+    }
+    memcpy(s->window, dict, len);
+    for (n = 0; n + MIN_MATCH <= (unsigned int)len; n++) {
+        insert_string(s, n);
+    }
+    s->strstart = (unsigned int)len;
+    s->block_start = len;
+}
+
+void png_deflate_destroy(png_deflate_state *s) {
+    if (s != NULL) {
+        javacall_free(s);
+    }
+}
+
+void png_deflate_set_output(png_deflate_state *s, 
+                            unsigned char *out, 
+                            long size) {
+    s->out = out;
+    s->out_size = size;
+    s->out_pos = 0;
+    s->out_flushed = 0;
+}
+
+void png_deflate_set_flush(png_deflate_state *s, 
+                           png_deflate_flush_func flush, 
+                           void *data) {
+    s->flush = flush;
+    s->flush_data = data;
+}
+
+int png_deflate_write(png_deflate_state *s, 
+                      const unsigned char *in, 
+                      long len, 
+                      int flush) {
+    s->next_in = in;
+    s->avail_in = len;
+
+    if (s->config == NULL) {
+        if (len > 0 || flush == PNG_DEFLATE_FINISH) {
+            stored_block(s, in, len, flush == PNG_DEFLATE_FINISH);
+        }
+    } else if (s->config->lazy) {
+        deflate_slow(s, flush);
+    } else {
+        deflate_fast(s, flush);
+    }
+    if (flush == PNG_DEFLATE_SYNC_FLUSH) {
+        /* empty stored block, which ends on a byte boundary */
+        stored_block(s, NULL, 0, 0);
+    } else if (flush == PNG_DEFLATE_FINISH) {
+        align_bits(s);
+    }
+
+    return s->overflow ? -1 : 0;
+}
+
+int png_deflate_write_raw(png_deflate_state *s, 
+                          const unsigned char *buf, 
+                          long len) {
+    put_bytes(s, buf, len);
+    return s->overflow ? -1 : 0;
+}
+
+int png_deflate_flush_output(png_deflate_state *s) {
+    if (s->flush != NULL) {
+        flush_out(s);
+    }
+    return s->overflow ? -1 : 0;
+}
+
+long png_deflate_total_out(png_deflate_state *s) {
+    return s->out_flushed + s->out_pos;
+}
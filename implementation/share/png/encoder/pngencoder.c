@@ -36,12 +36,20 @@
  */
  
 
+#include <string.h>
 #include "javacall_defs.h"
+#include "javacall_memory.h"
+#include "javautil_checksum.h"
+#include "javautil_pixel.h"
+#include "pngencoder.h"
+#include "pngdeflate.h"
+#include "pngfilter.h"
+#include "pngthread.h"
 
 /* Very Simple PNG Encoder *************************************************/
  
 typedef struct _PNGenc {
-    int crc;
+    unsigned long crc;
     int offset;
     unsigned char *outBuf;   
 } PNGEnc;
@@ -52,122 +60,27 @@ static const int le_one = 1;
 static char *littleEndian = (char *) &le_one;
 
 #define BITS            8
-#define ROWS_PER_GROUP  1
-
-/* 
- * Table of CRC-32's of all single-byte values
- */
-static unsigned long crc_table[256] = {
-    0x00000000L, 0x77073096L, 0xee0e612cL, 0x990951baL, 0x076dc419L,
-    0x706af48fL, 0xe963a535L, 0x9e6495a3L, 0x0edb8832L, 0x79dcb8a4L,
-    0xe0d5e91eL, 0x97d2d988L, 0x09b64c2bL, 0x7eb17cbdL, 0xe7b82d07L,
-    0x90bf1d91L, 0x1db71064L, 0x6ab020f2L, 0xf3b97148L, 0x84be41deL,
-    0x1adad47dL, 0x6ddde4ebL, 0xf4d4b551L, 0x83d385c7L, 0x136c9856L,
-    0x646ba8c0L, 0xfd62f97aL, 0x8a65c9ecL, 0x14015c4fL, 0x63066cd9L,
-    0xfa0f3d63L, 0x8d080df5L, 0x3b6e20c8L, 0x4c69105eL, 0xd56041e4L,
-    0xa2677172L, 0x3c03e4d1L, 0x4b04d447L, 0xd20d85fdL, 0xa50ab56bL,
-    0x35b5a8faL, 0x42b2986cL, 0xdbbbc9d6L, 0xacbcf940L, 0x32d86ce3L,
-    0x45df5c75L, 0xdcd60dcfL, 0xabd13d59L, 0x26d930acL, 0x51de003aL,
-    0xc8d75180L, 0xbfd06116L, 0x21b4f4b5L, 0x56b3c423L, 0xcfba9599L,
-    0xb8bda50fL, 0x2802b89eL, 0x5f058808L, 0xc60cd9b2L, 0xb10be924L,
-    0x2f6f7c87L, 0x58684c11L, 0xc1611dabL, 0xb6662d3dL, 0x76dc4190L,
-    0x01db7106L, 0x98d220bcL, 0xefd5102aL, 0x71b18589L, 0x06b6b51fL,
-    0x9fbfe4a5L, 0xe8b8d433L, 0x7807c9a2L, 0x0f00f934L, 0x9609a88eL,
-    0xe10e9818L, 0x7f6a0dbbL, 0x086d3d2dL, 0x91646c97L, 0xe6635c01L,
-    0x6b6b51f4L, 0x1c6c6162L, 0x856530d8L, 0xf262004eL, 0x6c0695edL,
-    0x1b01a57bL, 0x8208f4c1L, 0xf50fc457L, 0x65b0d9c6L, 0x12b7e950L,
-    0x8bbeb8eaL, 0xfcb9887cL, 0x62dd1ddfL, 0x15da2d49L, 0x8cd37cf3L,
-    0xfbd44c65L, 0x4db26158L, 0x3ab551ceL, 0xa3bc0074L, 0xd4bb30e2L,
-    0x4adfa541L, 0x3dd895d7L, 0xa4d1c46dL, 0xd3d6f4fbL, 0x4369e96aL,
-    0x346ed9fcL, 0xad678846L, 0xda60b8d0L, 0x44042d73L, 0x33031de5L,
-    0xaa0a4c5fL, 0xdd0d7cc9L, 0x5005713cL, 0x270241aaL, 0xbe0b1010L,
-    0xc90c2086L, 0x5768b525L, 0x206f85b3L, 0xb966d409L, 0xce61e49fL,
-    0x5edef90eL, 0x29d9c998L, 0xb0d09822L, 0xc7d7a8b4L, 0x59b33d17L,
-    0x2eb40d81L, 0xb7bd5c3bL, 0xc0ba6cadL, 0xedb88320L, 0x9abfb3b6L,
-    0x03b6e20cL, 0x74b1d29aL, 0xead54739L, 0x9dd277afL, 0x04db2615L,
-    0x73dc1683L, 0xe3630b12L, 0x94643b84L, 0x0d6d6a3eL, 0x7a6a5aa8L,
-    0xe40ecf0bL, 0x9309ff9dL, 0x0a00ae27L, 0x7d079eb1L, 0xf00f9344L,
-    0x8708a3d2L, 0x1e01f268L, 0x6906c2feL, 0xf762575dL, 0x806567cbL,
-    0x196c3671L, 0x6e6b06e7L, 0xfed41b76L, 0x89d32be0L, 0x10da7a5aL,
-    0x67dd4accL, 0xf9b9df6fL, 0x8ebeeff9L, 0x17b7be43L, 0x60b08ed5L,
-    0xd6d6a3e8L, 0xa1d1937eL, 0x38d8c2c4L, 0x4fdff252L, 0xd1bb67f1L,
-    0xa6bc5767L, 0x3fb506ddL, 0x48b2364bL, 0xd80d2bdaL, 0xaf0a1b4cL,
-    0x36034af6L, 0x41047a60L, 0xdf60efc3L, 0xa867df55L, 0x316e8eefL,
-    0x4669be79L, 0xcb61b38cL, 0xbc66831aL, 0x256fd2a0L, 0x5268e236L,
-    0xcc0c7795L, 0xbb0b4703L, 0x220216b9L, 0x5505262fL, 0xc5ba3bbeL,
-    0xb2bd0b28L, 0x2bb45a92L, 0x5cb36a04L, 0xc2d7ffa7L, 0xb5d0cf31L,
-    0x2cd99e8bL, 0x5bdeae1dL, 0x9b64c2b0L, 0xec63f226L, 0x756aa39cL,
-    0x026d930aL, 0x9c0906a9L, 0xeb0e363fL, 0x72076785L, 0x05005713L,
-    0x95bf4a82L, 0xe2b87a14L, 0x7bb12baeL, 0x0cb61b38L, 0x92d28e9bL,
-    0xe5d5be0dL, 0x7cdcefb7L, 0x0bdbdf21L, 0x86d3d2d4L, 0xf1d4e242L,
-    0x68ddb3f8L, 0x1fda836eL, 0x81be16cdL, 0xf6b9265bL, 0x6fb077e1L,
-    0x18b74777L, 0x88085ae6L, 0xff0f6a70L, 0x66063bcaL, 0x11010b5cL,
-    0x8f659effL, 0xf862ae69L, 0x616bffd3L, 0x166ccf45L, 0xa00ae278L,
-    0xd70dd2eeL, 0x4e048354L, 0x3903b3c2L, 0xa7672661L, 0xd06016f7L,
-    0x4969474dL, 0x3e6e77dbL, 0xaed16a4aL, 0xd9d65adcL, 0x40df0b66L,
-    0x37d83bf0L, 0xa9bcae53L, 0xdebb9ec5L, 0x47b2cf7fL, 0x30b5ffe9L,
-    0xbdbdf21cL, 0xcabac28aL, 0x53b39330L, 0x24b4a3a6L, 0xbad03605L,
-    0xcdd70693L, 0x54de5729L, 0x23d967bfL, 0xb3667a2eL, 0xc4614ab8L,
-    0x5d681b02L, 0x2a6f2b94L, 0xb40bbe37L, 0xc30c8ea1L, 0x5a05df1bL,
-    0x2d02ef8dL
-};
-
-#define DOCRC1(buf) crc = crc_table[((int)crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
-#define DOCRC2(buf)  DOCRC1(buf); DOCRC1(buf);
-#define DOCRC4(buf)  DOCRC2(buf); DOCRC2(buf);
-#define DOCRC8(buf)  DOCRC4(buf); DOCRC4(buf);
-
-static unsigned long crc32(unsigned long crc, unsigned char *buf,
-            int len)
-{
-    if (buf == NULL)
-    return 0L;
-    
-    crc = crc ^ 0xFFFFFFFFL;
-    
-    while (len >= 8) {
-    DOCRC8(buf);
-    len -= 8;
-    }
-    
-    if (len) do {
-    DOCRC1(buf);
-    } while (--len);
-    
-    return crc ^ 0xFFFFFFFFL;
-}
+#define ROWS_PER_GROUP  1       /* rows per stored block */
 
+#define DEFLATE_GROUP_BYTES 16384   /* rows packed per compressor call */
 
-/****************************************************************
- * ADLER32
- ****************************************************************/
+#define PNG_DEFAULT_FILTER  JAVAUTIL_PNG_FILTER_ADAPTIVE
 
-#define BASE 65521L /* largest prime smaller than 65536 */
+#define PNG_HEADER_BYTES    33      /* signature and IHDR chunk */
+#define PNG_IEND_BYTES      12
 
-#define DO1(buf,i)  {s1 += buf[i]; s2 += s1;}
-#define DO2(buf,i)  DO1(buf,i); DO1(buf,i+1);
-#define DO4(buf,i)  DO2(buf,i); DO2(buf,i+2);
-#define DO8(buf,i)  DO4(buf,i); DO4(buf,i+4);
-#define DO16(buf)   DO8(buf,0); DO8(buf,8);
+#define PNG_STREAM_CHUNK_SIZE   8192    /* default streamed IDAT size */
 
-static unsigned long adler32(unsigned long adler, 
-                             const unsigned char *buf, 
-                             int len){
+#define PNG_SEGMENT_BYTES   (256 * 1024)    /* parallel segment size */
+#define PNG_SEGMENT_OVERHEAD    40  /* deflate bound slack and sync flush */
+#define PNG_MAX_THREADS     64
 
-    unsigned long s1 = adler & 0xffff;
-    unsigned long s2 = (adler >> 16) & 0xffff;
-    
-    if (buf == NULL) return 1L;
-    
-    while (len > 0) {
-    s1 += *buf++;
-    s2 += s1;
-    len--;
-    s1 %= BASE;
-    s2 %= BASE;
-    }
-    return (s2 << 16) | s1;
-}
+#define PNG_PALETTE_MAX     256
+#define PNG_PALETTE_BITS    10      /* log2 of color hash slots */
+#define PNG_PALETTE_SLOTS   (1 << PNG_PALETTE_BITS)
+#define PNG_PALETTE_EMPTY   0xffffffffU     /* free slot, not an RGB key */
+#define PNG_PLTE_MAX_BYTES  (12 + PNG_PALETTE_MAX * 3)
+#define PNG_KEY_BLOCK       64      /* pixels keyed per call */
 
 static void resetcrc(PNGEnc *enc){
     enc->crc = 0;
@@ -196,63 +109,29 @@ static void writelongcrc(PNGEnc *enc, int num) {
     c = (unsigned char *)&num;
 
     if (*littleEndian) {
-    enc->crc = crc32(enc->crc, c+3, 1);
+    enc->crc = javautil_crc32(enc->crc, c+3, 1);
     enc->outBuf[enc->offset++] = *(c+3);
-    enc->crc = crc32(enc->crc, c+2, 1);
+    enc->crc = javautil_crc32(enc->crc, c+2, 1);
     enc->outBuf[enc->offset++] = *(c+2);
-    enc->crc = crc32(enc->crc, c+1, 1);
+    enc->crc = javautil_crc32(enc->crc, c+1, 1);
     enc->outBuf[enc->offset++] = *(c+1);
-    enc->crc = crc32(enc->crc, c+0, 1);
+    enc->crc = javautil_crc32(enc->crc, c+0, 1);
     enc->outBuf[enc->offset++] = *(c+0);
     } else {
-    enc->crc = crc32(enc->crc, c+0, 1);
+    enc->crc = javautil_crc32(enc->crc, c+0, 1);
     enc->outBuf[enc->offset++] = *(c+0);
-    enc->crc = crc32(enc->crc, c+1, 1);
+    enc->crc = javautil_crc32(enc->crc, c+1, 1);
     enc->outBuf[enc->offset++] = *(c+1);
-    enc->crc = crc32(enc->crc, c+2, 1);
+    enc->crc = javautil_crc32(enc->crc, c+2, 1);
     enc->outBuf[enc->offset++] = *(c+2);
-    enc->crc = crc32(enc->crc, c+3, 1);
+    enc->crc = javautil_crc32(enc->crc, c+3, 1);
     enc->outBuf[enc->offset++] = *(c+3);
     }
 }
 
 
-static void writewordrevcrc(PNGEnc *enc, short num){
-    unsigned char *c;
-    c = (unsigned char *)&num;
-    
-    if (*littleEndian) {
-    enc->crc = crc32(enc->crc, c+0, 1);
-    enc->outBuf[enc->offset++] = *(c+0);
-    enc->crc = crc32(enc->crc, c+1, 1);
-    enc->outBuf[enc->offset++] = *(c+1);
-    } else {
-    enc->crc = crc32(enc->crc, c+1, 1);
-    enc->outBuf[enc->offset++] = *(c+1);
-    enc->crc = crc32(enc->crc, c+0, 1);
-    enc->outBuf[enc->offset++] = *(c+0);
-    }
-}
-
-static void writewordcrc(PNGEnc *enc, short s){
-    unsigned char *c;
-    c = (unsigned char *)&s;
-    if (*littleEndian) {
-    enc->crc = crc32(enc->crc, c+1, 1);
-    enc->outBuf[enc->offset++] = *(c+1);
-    enc->crc = crc32(enc->crc, c+0, 1);
-    enc->outBuf[enc->offset++] = *(c+0);
-    } else {
-    enc->crc = crc32(enc->crc, c+0, 1);
-    enc->outBuf[enc->offset++] = *(c+0);
-    enc->crc = crc32(enc->crc, c+1, 1);
-    enc->outBuf[enc->offset++] = *(c+1);
-    }
-}
-
-
 static void writebytecrc(PNGEnc *enc, unsigned char c){
-    enc->crc = crc32(enc->crc, &c, 1);
+    enc->crc = javautil_crc32(enc->crc, &c, 1);
     enc->outBuf[enc->offset++] = c;
 }
 
@@ -261,7 +140,7 @@ static void beginchunk(PNGEnc *enc, char *name, int len) {
     l = len;
     writelong(enc, l);
     resetcrc(enc);
-    enc->crc = crc32(enc->crc, (unsigned char *)name, 4);
+    enc->crc = javautil_crc32(enc->crc, (unsigned char *)name, 4);
     enc->outBuf[enc->offset++] = name[0];
     enc->outBuf[enc->offset++] = name[1];
     enc->outBuf[enc->offset++] = name[2];
@@ -272,9 +151,33 @@ static void endchunk(PNGEnc *enc){
     writelong(enc, enc->crc);
 }
 
+/*
+ * End a chunk written without CRC updates; the CRC is computed in one
+ * pass over the type and data starting at typeOffset.
+ */
+static void endchunkdata(PNGEnc *enc, int typeOffset){
+    enc->crc = javautil_crc32(0, enc->outBuf + typeOffset,
+                              enc->offset - typeOffset);
+    endchunk(enc);
+}
+
+/*
+ * Rows per parallel compression segment
+ */
+static int segment_rows(int rowBytes) {
+    int rows = PNG_SEGMENT_BYTES / rowBytes;
+
+    return rows > 0 ? rows : 1;
+}
+
 /**
  * Get PNG buffer size for image that has width and height
  * 
+ * The size covers the worst case of every compression level: the stored
+ * layout and the deflate bound of the filtered image data, compressed
+ * as one stream or in parallel segments.  Indexed color output has less
+ * image data than truecolor and a palette of at most PNG_PLTE_MAX_BYTES.
+ * 
  * @param width     Width of image
  * @param height    Height of image
  * 
@@ -282,102 +185,906 @@ static void endchunk(PNGEnc *enc){
  */
 int javautil_media_get_png_size(int width, int height){
     int overhead = (height * 6) + 100;  /* PNG overhead bytes */
+    long raw = (long)(width * 3 + 1) * height;
+    long segments = height / segment_rows(width * 3 + 1) + 1;
+    long deflated = png_deflate_bound(raw) + 
+                    segments * PNG_SEGMENT_OVERHEAD + PNG_PLTE_MAX_BYTES + 100;
+    long stored = (width * height * 3) + overhead;
 
-    return ((width * height * 3) + overhead);
+    return (int)(deflated > stored ? deflated : stored);
 }
 
-/**
- * Encode rgb888 format data to PNG data format (there is no compression)
- * 
- * @param input     Pointer to rgb888 data
- * @param output    Pointer to PNG encode buffer
- * @param width     Width of image
- * @param height    Height of image
+/*
+ * Row packers convert one row of input pixels to PNG scanline RGB
+ * triplets.  They are chosen once per image for the pixel format and
+ * byte order.
+ */
+typedef void (*png_pack_row)(const unsigned char *input, 
+                             unsigned char *row,
+                             int width);
+
+/*
+ * rgb888 on little endian: bytes B, G, R per pixel
+ */
+static void pack_rgb_le(const unsigned char *input, 
+                        unsigned char *row,
+                        int width) {
+    int k;
+
+    for (k = width; k > 0; k--) {
+        row[0] = input[2];
+        row[1] = input[1];
+        row[2] = input[0];
+        input += 3;
+        row += 3;
+    }
+}
+
+/*
+ * rgb888 on big endian: already R, G, B in memory order
+ */
+static void pack_rgb_be(const unsigned char *input, 
+                        unsigned char *row,
+                        int width) {
+    memcpy(row, input, width * 3);
+}
+
+/*
+ * rgbX888 in native 32-bit pixels, either byte order
+ */
+static void pack_xrgb(const unsigned char *input, 
+                      unsigned char *row,
+                      int width) {
+    javautil_pixel_xrgb8888_to_rgb888((const unsigned int *)input, row, width);
+}
+
+/*
+ * rgb565 components widened to 8 bits, the top bits repeated below so
+ * that full intensity stays 0xff
+ */
+#define RGB565_R(p)     ((((p) >> 8) & 0xf8) | (((p) >> 13) & 0x07))
+#define RGB565_G(p)     ((((p) >> 3) & 0xfc) | (((p) >> 9) & 0x03))
+#define RGB565_B(p)     ((((p) << 3) & 0xf8) | (((p) >> 2) & 0x07))
+
+/*
+ * rgb565 in native 16-bit pixels, either byte order
+ */
+static void pack_rgb565(const unsigned char *input, 
+                        unsigned char *row,
+                        int width) {
+    javautil_pixel_rgb565_to_rgb888((const unsigned short *)input, row, width);
+}
+
+/*
+ * Indexed color.  Images of at most PNG_PALETTE_MAX distinct colors are
+ * written with a palette, which takes a third or less of the truecolor
+ * data and compresses faster and smaller.  Colors are counted in an
+ * open addressing hash table of pixel keys, 0xRRGGBB or the rgb565
+ * value; runs of one color only cost a compare, and counting stops at
+ * the first color too many.  Key rows convert input pixels to keys for
+ * the counter and the index packer alike.
+ */
+typedef void (*png_key_row)(const unsigned char *input,
+                            unsigned int *keys,
+                            int width);
+
+typedef struct {
+    png_key_row keyRow;
+    int pixelBytes;
+    int count;
+    int bitDepth;               /* 1, 2, 4 or 8 bits per index */
+    unsigned int slotKey[PNG_PALETTE_SLOTS];    /* PNG_PALETTE_EMPTY if free */
+    unsigned char slotIndex[PNG_PALETTE_SLOTS];
+    unsigned int color[PNG_PALETTE_MAX];        /* key of each index */
+} PNGPalette;
+
+#define PALETTE_HASH(key) \
+    ((unsigned int)((key) * 2654435761U) >> (32 - PNG_PALETTE_BITS))
+
+static void key_rgb_le(const unsigned char *input, unsigned int *keys, 
+                       int width) {
+    int k;
+
+    for (k = 0; k < width; k++, input += 3) {
+        keys[k] = ((unsigned int)input[2] << 16) | (input[1] << 8) | input[0];
+    }
+}
+
+static void key_rgb_be(const unsigned char *input, unsigned int *keys, 
+                       int width) {
+    int k;
+
+    for (k = 0; k < width; k++, input += 3) {
+        keys[k] = ((unsigned int)input[0] << 16) | (input[1] << 8) | input[2];
+    }
+}
+
+static void key_xrgb_le(const unsigned char *input, unsigned int *keys, 
+                        int width) {
+    int k;
+
+    for (k = 0; k < width; k++, input += 4) {
+        keys[k] = ((unsigned int)input[2] << 16) | (input[1] << 8) | input[0];
+    }
+}
+
+static void key_xrgb_be(const unsigned char *input, unsigned int *keys, 
+                        int width) {
+    int k;
+
+    for (k = 0; k < width; k++, input += 4) {
+        keys[k] = ((unsigned int)input[1] << 16) | (input[2] << 8) | input[3];
+    }
+}
+
+static void key_rgb565(const unsigned char *input, unsigned int *keys, 
+                       int width) {
+    const unsigned short *in = (const unsigned short *)input;
+    int k;
+
+    for (k = 0; k < width; k++) {
+        keys[k] = in[k];
+    }
+}
+
+/*
+ * Slot of key, or of the free slot where it belongs
+ */
+static int palette_slot(const PNGPalette *palette, unsigned int key) {
+    int slot = PALETTE_HASH(key);
+
+    while (palette->slotKey[slot] != key && 
+           palette->slotKey[slot] != PNG_PALETTE_EMPTY) {
+        slot = (slot + 1) & (PNG_PALETTE_SLOTS - 1);
+    }
+    return slot;
+}
+
+/*
+ * Collect the colors of the image into palette
  * 
- * @return Byte size of encoded PNG data
+ * @return 1 if the image has at most PNG_PALETTE_MAX colors, 0 if not
  */
-int javautil_media_rgb_to_png(unsigned char *input, 
-                              unsigned char *output,
-                              int width, 
-                              int height) {
-    int i,j,k;
+static int find_palette(PNGPalette *palette, const unsigned char *input,
+                        int width, int height) {
+    unsigned int keys[PNG_KEY_BLOCK];
+    unsigned int last = PNG_PALETTE_EMPTY;
+    int stride = width * palette->pixelBytes;
+    int x, n, k, slot;
+
+    memset(palette->slotKey, 0xff, sizeof(palette->slotKey));
+    palette->count = 0;
+
+    for (; height > 0; height--, input += stride) {
+        for (x = 0; x < width; x += n) {
+            n = width - x < PNG_KEY_BLOCK ? width - x : PNG_KEY_BLOCK;
+            palette->keyRow(input + x * palette->pixelBytes, keys, n);
+            for (k = 0; k < n; k++) {
+                if (keys[k] == last) {
+                    continue;
+                }
+                last = keys[k];
+                slot = palette_slot(palette, last);
+                if (palette->slotKey[slot] == PNG_PALETTE_EMPTY) {
+                    if (palette->count == PNG_PALETTE_MAX) {
+                        return 0;
+                    }
+                    palette->slotKey[slot] = last;
+                    palette->slotIndex[slot] = (unsigned char)palette->count;
+                    palette->color[palette->count++] = last;
+                }
+            }
+        }
+    }
+
+    palette->bitDepth = palette->count <= 2 ? 1 : 
+                        palette->count <= 4 ? 2 : 
+                        palette->count <= 16 ? 4 : 8;
+    return 1;
+}
+
+/*
+ * Palette indices, packed most significant bits first
+ */
+static void pack_index(const PNGPalette *palette,
+                       const unsigned char *input, 
+                       unsigned char *row,
+                       int width) {
+    unsigned int keys[PNG_KEY_BLOCK];
+    unsigned int last = PNG_PALETTE_EMPTY;
+    unsigned int index = 0;
+    unsigned int acc = 0;
+    int depth = palette->bitDepth;
+    int perByte = 8 / depth;
+    int x, n, k;
+    int pending = 0;
+
+    for (x = 0; x < width; x += n) {
+        n = width - x < PNG_KEY_BLOCK ? width - x : PNG_KEY_BLOCK;
+        palette->keyRow(input + x * palette->pixelBytes, keys, n);
+        if (depth == 8) {
+            for (k = 0; k < n; k++) {
+                if (keys[k] != last) {
+                    last = keys[k];
+                    index = palette->slotIndex[palette_slot(palette, last)];
+                }
+                *row++ = (unsigned char)index;
+            }
+            continue;
+        }
+        for (k = 0; k < n; k++) {
+            if (keys[k] != last) {
+                last = keys[k];
+                index = palette->slotIndex[palette_slot(palette, last)];
+            }
+            acc = (acc << depth) | index;
+            if (++pending == perByte) {
+                *row++ = (unsigned char)acc;
+                acc = 0;
+                pending = 0;
+            }
+        }
+    }
+    if (pending > 0) {
+        *row = (unsigned char)(acc << (depth * (perByte - pending)));
+    }
+}
+
+/*
+ * How input rows become PNG scanlines
+ */
+typedef struct {
+    png_pack_row pack;          /* for truecolor */
+    const PNGPalette *palette;  /* for indexed color, NULL for truecolor */
+    int width;
+    int pixelBytes;             /* per input pixel */
+    int lineBytes;              /* per scanline, without filter type */
+    int bpp;                    /* filter distance */
+    int filter;
+} PNGLayout;
+
+/*
+ * Pack one input row into scanline bytes
+ */
+static void pack_row(const PNGLayout *layout, const unsigned char *input,
+                     unsigned char *row) {
+    if (layout->palette != NULL) {
+        pack_index(layout->palette, input, row, layout->width);
+    } else {
+        layout->pack(input, row, layout->width);
+    }
+}
+
+/*
+ * Write IDAT as one stored block per group of rows.  Rows are packed
+ * straight into the output and both checksums run once over each
+ * completed block while it is still in cache.
+ */
+static void write_stored_idat(PNGEnc *enc,
+                              unsigned char *input,
+                              int height,
+                              const PNGLayout *layout) {
+    int i,j;
     unsigned int zcrc;
-    unsigned char zero = 0xF1;
-    unsigned char color = 0;
-    unsigned char filter = 0;
     int GROUPS = height / ROWS_PER_GROUP;
-    int GROUP_BYTES = (width * 3 + 1) * ROWS_PER_GROUP;
-    PNGEnc enc;
-
-    enc.offset = 0;
-    enc.outBuf = output;
-    resetcrc(&enc);
-    /* Write the magic number */
-    for (i = 0; i < sizeof(png_magic); i++)
-    enc.outBuf[enc.offset++] = png_magic[i];
-
-    beginchunk(&enc, "IHDR", 0x0d);
-    writelongcrc(&enc, width);  /* width */
-    writelongcrc(&enc, height); /* height */
-    writebytecrc(&enc, BITS);   /* bit depth */
-    writebytecrc(&enc, 2);      /* color type : true color*/
-    writebytecrc(&enc, 0);      /* compression */
-    writebytecrc(&enc, 0);      /* filter */
-    writebytecrc(&enc, 0);      /* interlace */
-    endchunk(&enc);
+    int GROUP_BYTES = (layout->lineBytes + 1) * ROWS_PER_GROUP;
+    unsigned short header = ((0x0800 + 30) / 31) * 31; /* compression method */
+    unsigned char *block;
+    unsigned char *row;
 
-    beginchunk(&enc, "IDAT", (GROUPS * (GROUP_BYTES + 4 + 1)) + 4 + 2);
-    writewordcrc(&enc, ((0x0800 + 30) / 31) * 31 ); /* compression method */
+    beginchunk(enc, "IDAT", (GROUPS * (GROUP_BYTES + 4 + 1)) + 4 + 2);
+    enc->outBuf[enc->offset++] = (unsigned char)(header >> 8);
+    enc->outBuf[enc->offset++] = (unsigned char)(header & 0xff);
+    enc->crc = javautil_crc32(enc->crc, enc->outBuf + enc->offset - 2, 2);
 
     zcrc = 1L;
     for (i = 0; i < GROUPS; i++) {
-    writebytecrc(&enc, (unsigned char)(i == (GROUPS-1) ? 0x01 : 0)); 
-    /* not compressed */
-    writewordrevcrc(&enc, (short) GROUP_BYTES);
-    writewordrevcrc(&enc, (short) ~GROUP_BYTES);
-
-    for (j = 0; j < ROWS_PER_GROUP; j++) {
-        /* write PNG row filter - 0 = unfiltered */
-        zcrc = adler32(zcrc, &filter, 1);
-        writebytecrc(&enc, filter);
-        
-        /* write pixels */
-        for (k = 0; k < width; k++) {
-            if (*littleEndian) {
-                zcrc = adler32(zcrc, &(input[2]), 1);
-                writebytecrc(&enc, input[2]);
-                zcrc = adler32(zcrc, &(input[1]), 1);
-                writebytecrc(&enc, input[1]);
-                zcrc = adler32(zcrc, &(input[0]), 1);
-                writebytecrc(&enc, input[0]);
+        /* stored block header: final flag, LEN and NLEN little endian */
+        block = enc->outBuf + enc->offset;
+        block[0] = (unsigned char)(i == (GROUPS-1) ? 0x01 : 0);
+        block[1] = (unsigned char)(GROUP_BYTES & 0xff);
+        block[2] = (unsigned char)((GROUP_BYTES >> 8) & 0xff);
+        block[3] = (unsigned char)(~GROUP_BYTES & 0xff);
+        block[4] = (unsigned char)((~GROUP_BYTES >> 8) & 0xff);
+
+        row = block + 5;
+        for (j = 0; j < ROWS_PER_GROUP; j++) {
+            row[0] = 0;     /* PNG row filter - 0 = unfiltered */
+            pack_row(layout, input, row + 1);
+            input += layout->width * layout->pixelBytes;
+            row += layout->lineBytes + 1;
+        }
+        zcrc = javautil_adler32(zcrc, block + 5, GROUP_BYTES);
+        enc->crc = javautil_crc32(enc->crc, block, 5 + GROUP_BYTES);
+        enc->offset += 5 + GROUP_BYTES;
+    }
+    
+    writelongcrc(enc, zcrc);
+
+    endchunk(enc);
+}
+
+/*
+ * Row preparation shared by the one-shot and the streaming encoder:
+ * rows are packed and filtered into PNG scanlines, each with its filter
+ * type byte.  Filtering needs the unfiltered previous row, so filtered
+ * rows are packed into separate lines first.
+ */
+typedef struct {
+    const PNGLayout *layout;
+    unsigned char *cur;         /* unfiltered current line */
+    unsigned char *prev;        /* unfiltered previous line */
+    unsigned char *scratch;     /* adaptive filter work line */
+} PNGRows;
+
+/*
+ * Bytes of line buffers needed by init_rows after the row buffer
+ */
+static int rows_extra_bytes(const PNGLayout *layout) {
+    return layout->filter != JAVAUTIL_PNG_FILTER_NONE ? 
+           3 * layout->lineBytes : 0;
+}
+
+static void init_rows(PNGRows *r, const PNGLayout *layout, 
+                      unsigned char *lines) {
+    r->layout = layout;
+    if (layout->filter != JAVAUTIL_PNG_FILTER_NONE) {
+        r->cur = lines;
+        r->prev = lines + layout->lineBytes;
+        r->scratch = lines + 2 * layout->lineBytes;
+        memset(r->prev, 0, layout->lineBytes);
+    }
+}
+
+/*
+ * Pack and filter rows input lines, stride bytes apart, into out
+ */
+static void filter_rows(PNGRows *r, const unsigned char *input, int stride,
+                        unsigned char *out, int rows) {
+    const PNGLayout *l = r->layout;
+    unsigned char *t;
+
+    for (; rows > 0; rows--) {
+        if (l->filter == JAVAUTIL_PNG_FILTER_NONE) {
+            out[0] = PNG_FILTER_NONE;
+            pack_row(l, input, out + 1);
+        } else {
+            pack_row(l, input, r->cur);
+            if (l->filter == JAVAUTIL_PNG_FILTER_ADAPTIVE) {
+                out[0] = (unsigned char)png_filter_adaptive(r->cur, r->prev, 
+                             out + 1, r->scratch, l->lineBytes, l->bpp);
             } else {
-                zcrc = adler32(zcrc, &(input[0]), 1);
-                writebytecrc(&enc, input[0]);
-                zcrc = adler32(zcrc, &(input[1]), 1);
-                writebytecrc(&enc, input[1]);
-                zcrc = adler32(zcrc, &(input[2]), 1);
-                writebytecrc(&enc, input[2]);
+                out[0] = (unsigned char)l->filter;
+                png_filter_row(l->filter, r->cur, r->prev, out + 1, 
+                               l->lineBytes, l->bpp);
             }
-            input += 3;
+            t = r->prev;
+            r->prev = r->cur;
+            r->cur = t;
         }
+        input += stride;
+        out += l->lineBytes + 1;
     }
+}
+
+/*
+ * Continue filtering below row, for rows not filtered from the top
+ */
+static void prime_rows(PNGRows *r, const unsigned char *row) {
+    const PNGLayout *l = r->layout;
+
+    if (l->filter != JAVAUTIL_PNG_FILTER_NONE) {
+        pack_row(l, row, r->prev);
     }
-    
-    writelongcrc(&enc, zcrc);
+}
 
-    endchunk(&enc);
+/*
+ * zlib header: deflate with 32K window, FLEVEL from level.  Stored data
+ * keeps the header of the original encoder.
+ */
+static void zlib_header(int level, unsigned char *out) {
+    unsigned short header;
+
+    if (level == JAVAUTIL_PNG_LEVEL_NONE) {
+        header = ((0x0800 + 30) / 31) * 31;
+    } else {
+        header = (unsigned short)(0x7800 | 
+            ((level == JAVAUTIL_PNG_LEVEL_FAST ? 1 : 
+              level == JAVAUTIL_PNG_LEVEL_DEFAULT ? 2 : 3) << 6));
+        header = (unsigned short)(header + 31 - (header % 31));
+    }
+    out[0] = (unsigned char)(header >> 8);
+    out[1] = (unsigned char)(header & 0xff);
+}
+
+/*
+ * Rows per compressor call for rows of rowBytes bytes
+ */
+static int rows_per_group(int rowBytes, int height) {
+    int rowsPerGroup = DEFLATE_GROUP_BYTES / rowBytes;
+
+    if (rowsPerGroup < 1) {
+        rowsPerGroup = 1;
+    } else if (rowsPerGroup > height) {
+        rowsPerGroup = height > 0 ? height : 1;
+    }
+    return rowsPerGroup;
+}
+
+/*
+ * Write IDAT as a compressed zlib stream.  The chunk length is only
+ * known at the end, so it is patched and the CRC is computed afterwards.
+ * Rows are packed in groups of about DEFLATE_GROUP_BYTES so that the
+ * checksum and the compressor see large buffers.
+ * 
+ * @return 0 on success, -1 if compressor memory cannot be allocated or
+ *         the data does not fit, in which case nothing is written
+ */
+static int write_deflated_idat(PNGEnc *enc,
+                               unsigned char *input,
+                               int height,
+                               const PNGLayout *layout,
+                               int level) {
+    int i;
+    unsigned int zcrc;
+    int rowBytes = layout->lineBytes + 1;
+    int stride = layout->width * layout->pixelBytes;
+    int rowsPerGroup = rows_per_group(rowBytes, height);
+    int rows;
+    int chunkStart = enc->offset;
+    int typeOffset;
+    int dataLength;
+    int status = 0;
+    unsigned char *group;
+    PNGRows r;
+    png_deflate_state *stream;
+
+    stream = png_deflate_create(level);
+    group = (unsigned char *)javacall_malloc(rowBytes * rowsPerGroup + 
+                                             rows_extra_bytes(layout));
+    if (stream == NULL || group == NULL) {
+        png_deflate_destroy(stream);
+        if (group != NULL) {
+            javacall_free(group);
+        }
+        return -1;
+    }
+    init_rows(&r, layout, group + rowBytes * rowsPerGroup);
+
+    beginchunk(enc, "IDAT", 0);
+    typeOffset = enc->offset - 4;
+
+    zlib_header(level, enc->outBuf + enc->offset);
+    enc->offset += 2;
+
+    png_deflate_set_output(stream, enc->outBuf + enc->offset, 
+                           png_deflate_bound((long)rowBytes * height));
+    zcrc = 1L;
+    for (i = 0; i < height; i += rows) {
+        rows = height - i < rowsPerGroup ? height - i : rowsPerGroup;
+        filter_rows(&r, input, stride, group, rows);
+        input += rows * stride;
+        zcrc = javautil_adler32(zcrc, group, rowBytes * rows);
+        status |= png_deflate_write(stream, group, rowBytes * rows, 
+                                    i + rows == height ? PNG_DEFLATE_FINISH :
+                                    PNG_DEFLATE_NO_FLUSH);
+    }
+    if (height == 0) {
+        status |= png_deflate_write(stream, group, 0, PNG_DEFLATE_FINISH);
+    }
+    enc->offset += png_deflate_total_out(stream);
+
+    png_deflate_destroy(stream);
+    javacall_free(group);
+
+    if (status != 0) {
+        enc->offset = chunkStart;
+        return -1;
+    }
+
+    writelong(enc, zcrc);
+
+    /* patch chunk length */
+    dataLength = enc->offset - typeOffset - 4;
+    i = enc->offset;
+    enc->offset = typeOffset - 4;
+    writelong(enc, dataLength);
+    enc->offset = i;
+
+    endchunkdata(enc, typeOffset);
+
+    return 0;
+}
+
+/*
+ * Parallel compression.  The image is cut into segments of whole rows
+ * of about PNG_SEGMENT_BYTES filtered bytes, compressed independently
+ * and concatenated into one zlib stream.  Every segment but the last
+ * ends with a sync flush so that the next one starts on a byte boundary,
+ * and is preset with the filtered tail of the rows before it so that
+ * matches can reach across the cut, just as in a single stream.  The
+ * filtered rows are the same as in a single stream, so the Adler-32
+ * of the segments is combined rather than recomputed.  The layout only
+ * depends on the image size, not on the number of threads.
+ */
+typedef struct {
+    unsigned char *out;         /* compressed data, NULL on failure */
+    long outLen;
+    unsigned long adler;        /* of the filtered rows */
+    long rawLen;
+} PNGSegment;
+
+typedef struct {
+    const unsigned char *input;
+    int height;
+    const PNGLayout *layout;
+    int level;
+    int rowsPerSegment;
+    int segments;
+    int threads;
+    PNGSegment *seg;
+} PNGParallel;
+
+/*
+ * png_thread_func compressing the segments index, index + threads, ...
+ */
+static void compress_segments(void *arg, int index) {
+    PNGParallel *job = (PNGParallel *)arg;
+    int rowBytes = job->layout->lineBytes + 1;
+    int stride = job->layout->width * job->layout->pixelBytes;
+    int dictRows = (PNG_DEFLATE_DICT_SIZE + rowBytes - 1) / rowBytes;
+    long outSize = png_deflate_bound((long)rowBytes * job->rowsPerSegment) + 
+                   PNG_SEGMENT_OVERHEAD;
+    int k, first, rows, dict;
+    long dictBytes;
+    unsigned char *buf;
+    unsigned char *data;
+    unsigned char *out;
+    PNGRows r;
+    PNGSegment *seg;
+    png_deflate_state *stream;
+
+    if (dictRows > job->rowsPerSegment) {
+        dictRows = job->rowsPerSegment;
+    }
+
+    stream = png_deflate_create(job->level);
+    /* rows of the preceding dictionary and of the segment, then lines */
+    buf = (unsigned char *)javacall_malloc(
+        rowBytes * (dictRows + job->rowsPerSegment) + 
+        rows_extra_bytes(job->layout));
+    out = (unsigned char *)javacall_malloc(outSize);
+    if (stream == NULL || buf == NULL || out == NULL) {
+        /* the segments stay NULL and the caller falls back */
+        png_deflate_destroy(stream);
+        if (buf != NULL) {
+            javacall_free(buf);
+        }
+        if (out != NULL) {
+            javacall_free(out);
+        }
+        return;
+    }
+
+    for (k = index; k < job->segments; k += job->threads) {
+        seg = &job->seg[k];
+        first = k * job->rowsPerSegment;
+        rows = job->height - first < job->rowsPerSegment ? 
+               job->height - first : job->rowsPerSegment;
+        dict = first < dictRows ? first : dictRows;
+
+        /* filter the dictionary rows again, from the row above them */
+        init_rows(&r, job->layout, 
+                  buf + rowBytes * (dictRows + job->rowsPerSegment));
+        if (first - dict > 0) {
+            prime_rows(&r, job->input + (long)(first - dict - 1) * stride);
+        }
+        filter_rows(&r, job->input + (long)(first - dict) * stride, stride,
+                    buf, dict + rows);
+        data = buf + rowBytes * dict;
+        dictBytes = (long)rowBytes * dict;
+        seg->rawLen = (long)rowBytes * rows;
+        seg->adler = javautil_adler32(1L, data, seg->rawLen);
+
+        png_deflate_reset(stream);
+        png_deflate_set_output(stream, out, outSize);
+        if (dict > 0) {
+            png_deflate_set_dictionary(stream, data - dictBytes, dictBytes);
+        }
+        if (png_deflate_write(stream, data, seg->rawLen,
+                              k == job->segments - 1 ? PNG_DEFLATE_FINISH :
+                              PNG_DEFLATE_SYNC_FLUSH) != 0) {
+            break;
+        }
+        seg->outLen = png_deflate_total_out(stream);
+        seg->out = (unsigned char *)javacall_malloc(seg->outLen);
+        if (seg->out == NULL) {
+            break;
+        }
+        memcpy(seg->out, out, seg->outLen);
+    }
+
+    png_deflate_destroy(stream);
+    javacall_free(buf);
+    javacall_free(out);
+}
+
+/*
+ * Write IDAT as a zlib stream compressed in segments on up to threads
+ * threads.
+ * 
+ * @return 0 on success, -1 if the image is too small to be split, or
+ *         memory cannot be allocated, in which case nothing is written
+ */
+static int write_parallel_idat(PNGEnc *enc,
+                               unsigned char *input,
+                               int height,
+                               const PNGLayout *layout,
+                               int level,
+                               int threads) {
+    int k;
+    int status = 0;
+    int typeOffset;
+    int dataLength;
+    unsigned long adler = 1L;
+    PNGParallel job;
+
+    job.rowsPerSegment = segment_rows(layout->lineBytes + 1);
+    job.segments = (height + job.rowsPerSegment - 1) / job.rowsPerSegment;
+    if (job.segments < 2) {
+        return -1;
+    }
+    job.seg = (PNGSegment *)javacall_malloc(sizeof(PNGSegment) * job.segments);
+    if (job.seg == NULL) {
+        return -1;
+    }
+    memset(job.seg, 0, sizeof(PNGSegment) * job.segments);
+    job.input = input;
+    job.height = height;
+    job.layout = layout;
+    job.level = level;
+    job.threads = threads < job.segments ? threads : job.segments;
+    if (job.threads > PNG_MAX_THREADS) {
+        job.threads = PNG_MAX_THREADS;
+    }
+
+    png_run_threads(compress_segments, &job, job.threads);
+
+    for (k = 0; k < job.segments; k++) {
+        if (job.seg[k].out == NULL) {
+            status = -1;
+        }
+    }
+
+    if (status == 0) {
+        beginchunk(enc, "IDAT", 0);
+        typeOffset = enc->offset - 4;
+        zlib_header(level, enc->outBuf + enc->offset);
+        enc->offset += 2;
+        for (k = 0; k < job.segments; k++) {
+            memcpy(enc->outBuf + enc->offset, job.seg[k].out, job.seg[k].outLen);
+            enc->offset += job.seg[k].outLen;
+            adler = javautil_adler32_combine(adler, job.seg[k].adler, 
+                                             job.seg[k].rawLen);
+        }
+        writelong(enc, adler);
+
+        /* patch chunk length */
+        dataLength = enc->offset - typeOffset - 4;
+        k = enc->offset;
+        enc->offset = typeOffset - 4;
+        writelong(enc, dataLength);
+        enc->offset = k;
+
+        endchunkdata(enc, typeOffset);
+    }
+
+    for (k = 0; k < job.segments; k++) {
+        if (job.seg[k].out != NULL) {
+            javacall_free(job.seg[k].out);
+        }
+    }
+    javacall_free(job.seg);
+
+    return status;
+}
+
+/*
+ * Write the PNG signature and the IHDR chunk, PNG_HEADER_BYTES in total
+ */
+static void write_header(PNGEnc *enc, int width, int height, 
+                         const PNGLayout *layout) {
+    int i;
+
+    /* Write the magic number */
+    for (i = 0; i < sizeof(png_magic); i++)
+    enc->outBuf[enc->offset++] = png_magic[i];
+
+    beginchunk(enc, "IHDR", 0x0d);
+    writelongcrc(enc, width);   /* width */
+    writelongcrc(enc, height);  /* height */
+    if (layout->palette != NULL) {
+        writebytecrc(enc, (unsigned char)layout->palette->bitDepth);
+        writebytecrc(enc, 3);   /* color type : indexed color */
+    } else {
+        writebytecrc(enc, BITS);    /* bit depth */
+        writebytecrc(enc, 2);       /* color type : true color*/
+    }
+    writebytecrc(enc, 0);       /* compression */
+    writebytecrc(enc, 0);       /* filter */
+    writebytecrc(enc, 0);       /* interlace */
+    endchunk(enc);
+}
+
+/*
+ * Write the PLTE chunk.  Input pixels are opaque, so no tRNS is needed.
+ */
+static void write_palette(PNGEnc *enc, const PNGPalette *palette) {
+    unsigned int c;
+    int typeOffset;
+    int i;
+
+    beginchunk(enc, "PLTE", palette->count * 3);
+    typeOffset = enc->offset - 4;
+    for (i = 0; i < palette->count; i++) {
+        c = palette->color[i];
+        if (palette->pixelBytes == JAVAUTIL_PNG_FORMAT_RGB565) {
+            c = (RGB565_R(c) << 16) | (RGB565_G(c) << 8) | RGB565_B(c);
+        }
+        enc->outBuf[enc->offset++] = (unsigned char)(c >> 16);
+        enc->outBuf[enc->offset++] = (unsigned char)(c >> 8);
+        enc->outBuf[enc->offset++] = (unsigned char)c;
+    }
+    endchunkdata(enc, typeOffset);
+}
+
+static png_pack_row select_packer(int format) {
+    if (format == JAVAUTIL_PNG_FORMAT_RGB565) {
+        return pack_rgb565;
+    } else if (format == JAVAUTIL_PNG_FORMAT_RGBX888) {
+        return pack_xrgb;
+    } else {
+        return *littleEndian ? pack_rgb_le : pack_rgb_be;
+    }
+}
+
+static png_key_row select_key_row(int format) {
+    if (format == JAVAUTIL_PNG_FORMAT_RGB565) {
+        return key_rgb565;
+    } else if (*littleEndian) {
+        return format == JAVAUTIL_PNG_FORMAT_RGBX888 ? key_xrgb_le : key_rgb_le;
+    } else {
+        return format == JAVAUTIL_PNG_FORMAT_RGBX888 ? key_xrgb_be : key_rgb_be;
+    }
+}
+
+/*
+ * Set up the scanline layout of truecolor, or of indexed color if 
+ * palette is not NULL.  Palette indices carry no gradients to predict,
+ * so indexed rows stay unfiltered unless a filter is asked for.
+ */
+static void init_layout(PNGLayout *layout, int width, int format, 
+                        const PNGPalette *palette, int filter) {
+    layout->palette = palette;
+    layout->width = width;
+    layout->pixelBytes = format;
+    if (palette != NULL) {
+        layout->pack = NULL;
+        layout->lineBytes = (width * palette->bitDepth + 7) / 8;
+        layout->bpp = 1;
+        layout->filter = filter == JAVAUTIL_PNG_FILTER_DEFAULT ? 
+                         JAVAUTIL_PNG_FILTER_NONE : filter;
+    } else {
+        layout->pack = select_packer(format);
+        layout->lineBytes = width * 3;
+        layout->bpp = 3;
+        layout->filter = filter == JAVAUTIL_PNG_FILTER_DEFAULT ? 
+                         PNG_DEFAULT_FILTER : filter;
+    }
+}
+
+/*
+ * Clamp the level and check the filter
+ */
+static void check_params(const javautil_png_params *params, 
+                         int *level, int *filter) {
+    *level = params->level;
+    *filter = params->filter;
+    if (*level < JAVAUTIL_PNG_LEVEL_NONE) {
+        *level = JAVAUTIL_PNG_LEVEL_NONE;
+    } else if (*level > JAVAUTIL_PNG_LEVEL_BEST) {
+        *level = JAVAUTIL_PNG_LEVEL_BEST;
+    }
+    if (*filter < JAVAUTIL_PNG_FILTER_NONE || 
+        *filter > JAVAUTIL_PNG_FILTER_ADAPTIVE) {
+        *filter = JAVAUTIL_PNG_FILTER_DEFAULT;
+    }
+}
+
+static int png_encode(unsigned char *input, 
+                      unsigned char *output,
+                      int width, 
+                      int height,
+                      int format,
+                      const javautil_png_params *params) {
+    PNGEnc enc;
+    PNGLayout layout;
+    PNGPalette *palette = NULL;
+    int level;
+    int filter;
+    int status = -1;
+
+    check_params(params, &level, &filter);
+
+    /* stored output is a plain copy, other levels look for a palette */
+    if (level != JAVAUTIL_PNG_LEVEL_NONE && !params->truecolor) {
+        palette = (PNGPalette *)javacall_malloc(sizeof(PNGPalette));
+        if (palette != NULL) {
+            palette->keyRow = select_key_row(format);
+            palette->pixelBytes = format;
+            if (!find_palette(palette, input, width, height)) {
+                javacall_free(palette);
+                palette = NULL;
+            }
+        }
+    }
+    init_layout(&layout, width, format, palette, filter);
+
+    enc.offset = 0;
+    enc.outBuf = output;
+    resetcrc(&enc);
+    write_header(&enc, width, height, &layout);
+    if (palette != NULL) {
+        write_palette(&enc, palette);
+    }
+
+    /* 
+     * fall back to a single stream if the image is too small to split,
+     * and to stored blocks if the compressor cannot be allocated
+     */
+    if (level != JAVAUTIL_PNG_LEVEL_NONE && params->threads > 1) {
+        status = write_parallel_idat(&enc, input, height, &layout, level,
+                                     params->threads);
+    }
+    if (level != JAVAUTIL_PNG_LEVEL_NONE && status != 0) {
+        status = write_deflated_idat(&enc, input, height, &layout, level);
+    }
+    if (status != 0) {
+        write_stored_idat(&enc, input, height, &layout);
+    }
 
     beginchunk(&enc, "IEND", 0);
     endchunk(&enc);
 
+    if (palette != NULL) {
+        javacall_free(palette);
+    }
+
     /* Return the length of data written into output buffer */
 
     return enc.offset;
 }
- 
 
 /**
- * Encode rgbX888 format data to PNG data format (there is no compression)
+ * Encode rgb888 format data to PNG data format
+ * 
+ * @param input     Pointer to rgb888 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgb_to_png(unsigned char *input, 
+                              unsigned char *output,
+                              int width, 
+                              int height) {
+    return javautil_media_rgb_to_png_level(input, output, width, height,
+                                           JAVAUTIL_PNG_LEVEL_DEFAULT);
+}
+
+/**
+ * Encode rgbX888 format data to PNG data format
  * 
  * @param input     Pointer to rgbX888 data
  * @param output    Pointer to PNG encode buffer
@@ -390,77 +1097,403 @@ int javautil_media_rgbX888_to_png(unsigned char *input,
                                   unsigned char *output,
                                   int width, 
                                   int height) {
-    int i,j,k;
-    unsigned int zcrc;
-    unsigned char zero = 0xF1;
-    unsigned char color = 0;
-    unsigned char filter = 0;
-    int GROUPS = height / ROWS_PER_GROUP;
-    int GROUP_BYTES = (width * 3 + 1) * ROWS_PER_GROUP;
+    return javautil_media_rgbX888_to_png_level(input, output, width, height,
+                                               JAVAUTIL_PNG_LEVEL_DEFAULT);
+}
+
+/**
+ * Encode rgb888 format data to PNG data format with given compression
+ * 
+ * @param input     Pointer to rgb888 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param level     Compression level, one of JAVAUTIL_PNG_LEVEL_*
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgb_to_png_level(unsigned char *input, 
+                                    unsigned char *output,
+                                    int width, 
+                                    int height,
+                                    int level) {
+    javautil_png_params params;
+
+    params.level = level;
+    params.filter = JAVAUTIL_PNG_FILTER_DEFAULT;
+    params.threads = 0;
+    params.truecolor = 0;
+    return png_encode(input, output, width, height, 
+                      JAVAUTIL_PNG_FORMAT_RGB888, &params);
+}
+
+/**
+ * Encode rgbX888 format data to PNG data format with given compression
+ * 
+ * @param input     Pointer to rgbX888 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param level     Compression level, one of JAVAUTIL_PNG_LEVEL_*
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgbX888_to_png_level(unsigned char *input, 
+                                        unsigned char *output,
+                                        int width, 
+                                        int height,
+                                        int level) {
+    javautil_png_params params;
+
+    params.level = level;
+    params.filter = JAVAUTIL_PNG_FILTER_DEFAULT;
+    params.threads = 0;
+    params.truecolor = 0;
+    return png_encode(input, output, width, height, 
+                      JAVAUTIL_PNG_FORMAT_RGBX888, &params);
+}
+
+/**
+ * Encode rgb888 format data to PNG data format with given parameters
+ * 
+ * @param input     Pointer to rgb888 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param params    Compression level and row filter strategy
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgb_to_png_params(unsigned char *input, 
+                                     unsigned char *output,
+                                     int width, 
+                                     int height,
+                                     const javautil_png_params *params) {
+    return png_encode(input, output, width, height, 
+                      JAVAUTIL_PNG_FORMAT_RGB888, params);
+}
+
+/**
+ * Encode rgbX888 format data to PNG data format with given parameters
+ * 
+ * @param input     Pointer to rgbX888 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param params    Compression level and row filter strategy
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgbX888_to_png_params(unsigned char *input, 
+                                         unsigned char *output,
+                                         int width, 
+                                         int height,
+                                         const javautil_png_params *params) {
+    return png_encode(input, output, width, height, 
+                      JAVAUTIL_PNG_FORMAT_RGBX888, params);
+}
+
+/**
+ * Encode rgb565 format data to PNG data format
+ * 
+ * @param input     Pointer to rgb565 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgb565_to_png(unsigned short *input, 
+                                 unsigned char *output,
+                                 int width, 
+                                 int height) {
+    return javautil_media_rgb565_to_png_level(input, output, width, height,
+                                              JAVAUTIL_PNG_LEVEL_DEFAULT);
+}
+
+/**
+ * Encode rgb565 format data to PNG data format with given compression
+ * 
+ * @param input     Pointer to rgb565 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param level     Compression level, one of JAVAUTIL_PNG_LEVEL_*
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgb565_to_png_level(unsigned short *input, 
+                                       unsigned char *output,
+                                       int width, 
+                                       int height,
+                                       int level) {
+    javautil_png_params params;
+
+    params.level = level;
+    params.filter = JAVAUTIL_PNG_FILTER_DEFAULT;
+    params.threads = 0;
+    params.truecolor = 0;
+    return png_encode((unsigned char *)input, output, width, height, 
+                      JAVAUTIL_PNG_FORMAT_RGB565, &params);
+}
+
+/**
+ * Encode rgb565 format data to PNG data format with given parameters
+ * 
+ * @param input     Pointer to rgb565 data
+ * @param output    Pointer to PNG encode buffer
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param params    Compression level and row filter strategy
+ * 
+ * @return Byte size of encoded PNG data
+ */
+int javautil_media_rgb565_to_png_params(unsigned short *input, 
+                                        unsigned char *output,
+                                        int width, 
+                                        int height,
+                                        const javautil_png_params *params) {
+    return png_encode((unsigned char *)input, output, width, height, 
+                      JAVAUTIL_PNG_FORMAT_RGB565, params);
+}
+
+/* Streaming encoder *******************************************************/
+
+/*
+ * IDAT chunks are assembled in place: the compressor writes into the
+ * data part of chunk, and whenever that is full the length, type and
+ * CRC are filled in around it and the whole chunk goes to the sink.
+ */
+struct _javautil_png_stream {
+    javautil_png_sink sink;
+    void *sinkData;
+    png_deflate_state *deflate;
+    PNGLayout layout;
+    PNGRows rows;
+    int height;
+    int rowsWritten;
+    int rowsPerGroup;
+    unsigned char *group;       /* rows of one compressor call, lines */
+    unsigned int adler;
+    unsigned char *chunk;       /* length, type, chunkSize bytes, CRC */
+    long total;                 /* bytes passed to sink */
+    int failed;
+    int finished;
+};
+
+static int stream_sink(javautil_png_stream *stream, 
+                       const unsigned char *data, 
+                       int len) {
+    if (stream->failed || !stream->sink(stream->sinkData, data, len)) {
+        stream->failed = 1;
+        return 0;
+    }
+    stream->total += len;
+    return 1;
+}
+
+/*
+ * png_deflate_flush_func completing an IDAT chunk of len data bytes
+ */
+static int stream_flush_idat(void *data, unsigned char *out, long len) {
+    javautil_png_stream *stream = (javautil_png_stream *)data;
     PNGEnc enc;
 
+    enc.outBuf = stream->chunk;
+    enc.offset = 0;
+    beginchunk(&enc, "IDAT", (int)len);
+    enc.offset += (int)len;
+    endchunkdata(&enc, 4);
+
+    return stream_sink(stream, stream->chunk, enc.offset);
+}
+
+/**
+ * Start a streaming PNG encode
+ * 
+ * @param width     Width of image
+ * @param height    Height of image
+ * @param format    One of JAVAUTIL_PNG_FORMAT_*
+ * @param params    Compression level and row filter strategy, 
+ *                  NULL for the defaults
+ * @param chunkSize Data bytes per IDAT chunk, 0 for the default
+ * @param sink      Function receiving the encoded data
+ * @param sinkData  Passed to sink
+ * 
+ * @return Encoder handle, NULL on failure
+ */
+javautil_png_stream *javautil_media_png_stream_init(int width, 
+                                                    int height,
+                                                    int format,
+                                                    const javautil_png_params *params,
+                                                    int chunkSize,
+                                                    javautil_png_sink sink,
+                                                    void *sinkData) {
+    javautil_png_stream *stream;
+    javautil_png_params defaults;
+    unsigned char header[PNG_HEADER_BYTES];
+    unsigned char zhead[2];
+    PNGEnc enc;
+    int rowBytes = width * 3 + 1;
+    int level;
+    int filter;
+
+    if (width <= 0 || height <= 0 || sink == NULL ||
+        (format != JAVAUTIL_PNG_FORMAT_RGB565 && 
+         format != JAVAUTIL_PNG_FORMAT_RGB888 && 
+         format != JAVAUTIL_PNG_FORMAT_RGBX888)) {
+        return NULL;
+    }
+    if (params == NULL) {
+        defaults.level = JAVAUTIL_PNG_LEVEL_DEFAULT;
+        defaults.filter = JAVAUTIL_PNG_FILTER_DEFAULT;
+        defaults.threads = 0;
+        defaults.truecolor = 0;
+        params = &defaults;
+    }
+    check_params(params, &level, &filter);
+    if (level == JAVAUTIL_PNG_LEVEL_NONE) {
+        filter = JAVAUTIL_PNG_FILTER_NONE;
+    }
+    if (chunkSize <= 0) {
+        chunkSize = PNG_STREAM_CHUNK_SIZE;
+    }
+
+    stream = (javautil_png_stream *)javacall_malloc(sizeof(javautil_png_stream));
+    if (stream == NULL) {
+        return NULL;
+    }
+    memset(stream, 0, sizeof(javautil_png_stream));
+    stream->sink = sink;
+    stream->sinkData = sinkData;
+    init_layout(&stream->layout, width, format, NULL, filter);
+    stream->height = height;
+    stream->rowsPerGroup = rows_per_group(rowBytes, height);
+    stream->adler = 1L;
+
+    stream->deflate = png_deflate_create(level);
+    stream->group = (unsigned char *)javacall_malloc(
+        rowBytes * stream->rowsPerGroup + rows_extra_bytes(&stream->layout));
+    stream->chunk = (unsigned char *)javacall_malloc(chunkSize + 12);
+    if (stream->deflate == NULL || stream->group == NULL || 
+        stream->chunk == NULL) {
+        javautil_media_png_stream_free(stream);
+        return NULL;
+    }
+    init_rows(&stream->rows, &stream->layout,
+              stream->group + rowBytes * stream->rowsPerGroup);
+    png_deflate_set_output(stream->deflate, stream->chunk + 8, chunkSize);
+    png_deflate_set_flush(stream->deflate, stream_flush_idat, stream);
+
+    enc.outBuf = header;
     enc.offset = 0;
-    enc.outBuf = output;
     resetcrc(&enc);
-    /* Write the magic number */
-    for (i = 0; i < sizeof(png_magic); i++)
-    enc.outBuf[enc.offset++] = png_magic[i];
-
-    beginchunk(&enc, "IHDR", 0x0d);
-    writelongcrc(&enc, width);  /* width */
-    writelongcrc(&enc, height); /* height */
-    writebytecrc(&enc, BITS);   /* bit depth */
-    writebytecrc(&enc, 2);      /* color type : true color*/
-    writebytecrc(&enc, 0);      /* compression */
-    writebytecrc(&enc, 0);      /* filter */
-    writebytecrc(&enc, 0);      /* interlace */
-    endchunk(&enc);
+    write_header(&enc, width, height, &stream->layout);
+    zlib_header(level, zhead);
+    if (!stream_sink(stream, header, enc.offset) ||
+        png_deflate_write_raw(stream->deflate, zhead, 2) != 0) {
+        javautil_media_png_stream_free(stream);
+        return NULL;
+    }
 
-    beginchunk(&enc, "IDAT", (GROUPS * (GROUP_BYTES + 4 + 1)) + 4 + 2);
-    writewordcrc(&enc, ((0x0800 + 30) / 31) * 31 ); /* compression method */
+    return stream;
+}
 
-    zcrc = 1L;
-    for (i = 0; i < GROUPS; i++) {
-    writebytecrc(&enc, (unsigned char)(i == (GROUPS-1) ? 0x01 : 0)); 
-    /* not compressed */
-    writewordrevcrc(&enc, (short) GROUP_BYTES);
-    writewordrevcrc(&enc, (short) ~GROUP_BYTES);
-
-    for (j = 0; j < ROWS_PER_GROUP; j++) {
-        /* write PNG row filter - 0 = unfiltered */
-        zcrc = adler32(zcrc, &filter, 1);
-        writebytecrc(&enc, filter);
-        
-        /* write pixels */
-        for (k = 0; k < width; k++) {
-            if (*littleEndian) {
-                zcrc = adler32(zcrc, &(input[2]), 1);
-                writebytecrc(&enc, input[2]);
-                zcrc = adler32(zcrc, &(input[1]), 1);
-                writebytecrc(&enc, input[1]);
-                zcrc = adler32(zcrc, &(input[0]), 1);
-                writebytecrc(&enc, input[0]);
-            } else {
-                zcrc = adler32(zcrc, &(input[1]), 1);
-                writebytecrc(&enc, input[1]);
-                zcrc = adler32(zcrc, &(input[2]), 1);
-                writebytecrc(&enc, input[2]);
-                zcrc = adler32(zcrc, &(input[3]), 1);
-                writebytecrc(&enc, input[3]);
-            }
-            input += 4;
+/**
+ * Encode the next rows of the image, top to bottom
+ * 
+ * @param stream    Handle returned by javautil_media_png_stream_init
+ * @param input     First row to encode
+ * @param rowStride Distance between rows in input, in bytes
+ * @param numRows   Number of rows in input; rows past the image height
+ *                  are ignored
+ * 
+ * @return 1 on success, 0 on failure, including the sink failing
+ */
+int javautil_media_png_stream_write(javautil_png_stream *stream,
+                                    const unsigned char *input,
+                                    int rowStride,
+                                    int numRows) {
+    int rowBytes = stream->layout.lineBytes + 1;
+    int rows;
+
+    if (stream->failed || stream->finished) {
+        return 0;
+    }
+    if (numRows > stream->height - stream->rowsWritten) {
+        numRows = stream->height - stream->rowsWritten;
+    }
+    while (numRows > 0) {
+        rows = numRows < stream->rowsPerGroup ? numRows : stream->rowsPerGroup;
+        filter_rows(&stream->rows, input, rowStride, stream->group, rows);
+        stream->adler = javautil_adler32(stream->adler, stream->group, 
+                                         rowBytes * rows);
+        if (png_deflate_write(stream->deflate, stream->group, 
+                              rowBytes * rows, PNG_DEFLATE_NO_FLUSH) != 0) {
+            stream->failed = 1;
+            return 0;
         }
+        input += rows * rowStride;
+        numRows -= rows;
+        stream->rowsWritten += rows;
     }
+
+    return 1;
+}
+
+/**
+ * Complete a streaming encode after all rows have been written, and
+ * send the remaining IDAT data and IEND to the sink
+ * 
+ * @param stream    Handle returned by javautil_media_png_stream_init
+ * 
+ * @return Byte size of encoded PNG data, 0 on failure
+ */
+int javautil_media_png_stream_finish(javautil_png_stream *stream) {
+    unsigned char buf[PNG_IEND_BYTES];
+    PNGEnc enc;
+
+    if (stream->failed || stream->finished || 
+        stream->rowsWritten < stream->height) {
+        return 0;
     }
-    
-    writelongcrc(&enc, zcrc);
+    stream->finished = 1;
 
-    endchunk(&enc);
+    enc.outBuf = buf;
+    enc.offset = 0;
+    writelong(&enc, stream->adler);
+    if (png_deflate_write(stream->deflate, NULL, 0, PNG_DEFLATE_FINISH) != 0 ||
+        png_deflate_write_raw(stream->deflate, buf, 4) != 0 ||
+        png_deflate_flush_output(stream->deflate) != 0) {
+        stream->failed = 1;
+        return 0;
+    }
 
+    enc.offset = 0;
     beginchunk(&enc, "IEND", 0);
     endchunk(&enc);
+    if (!stream_sink(stream, buf, enc.offset)) {
+        return 0;
+    }
 
-    /* Return the length of data written into output buffer */
+    return (int)stream->total;
+}
 
-    return enc.offset;
+/**
+ * Release a streaming encoder, finished or not
+ * 
+ * @param stream    Handle returned by javautil_media_png_stream_init
+ */
+void javautil_media_png_stream_free(javautil_png_stream *stream) {
+    if (stream == NULL) {
+        return;
+    }
+    png_deflate_destroy(stream->deflate);
+    if (stream->group != NULL) {
+        javacall_free(stream->group);
+    }
+    if (stream->chunk != NULL) {
+        javacall_free(stream->chunk);
+    }
+    javacall_free(stream);
 }
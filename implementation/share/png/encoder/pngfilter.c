@@ -0,0 +1,292 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+#include <string.h>
+#include "javacall_defs.h"
+#include "pngfilter.h"
+
+/*
+ * SSE2 kernels where SSE2 is part of the compilation target.  Each
+ * kernel handles 16 byte blocks and leaves the tail to the C code.
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNG_FILTER_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef PNG_FILTER_SSE2
+
+#define LOAD(p)     _mm_loadu_si128((const __m128i *)(p))
+#define STORE(p, v) _mm_storeu_si128((__m128i *)(p), v)
+
+static int sub_sse2(const unsigned char *cur, unsigned char *out,
+                    int i, int len, int bpp) {
+    for (; i + 16 <= len; i += 16) {
+        STORE(out + i, _mm_sub_epi8(LOAD(cur + i), LOAD(cur + i - bpp)));
+    }
+    return i;
+}
+
+static int up_sse2(const unsigned char *cur, const unsigned char *prev,
+                   unsigned char *out, int i, int len) {
+    for (; i + 16 <= len; i += 16) {
+        STORE(out + i, _mm_sub_epi8(LOAD(cur + i), LOAD(prev + i)));
+    }
+    return i;
+}
+
+static int average_sse2(const unsigned char *cur, const unsigned char *prev,
+                        unsigned char *out, int i, int len, int bpp) {
+    const __m128i one = _mm_set1_epi8(1);
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = LOAD(cur + i - bpp);
+        __m128i b = LOAD(prev + i);
+        /* pavgb rounds up; take the carry back off to get (a + b) >> 1 */
+        __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b),
+                                   _mm_and_si128(_mm_xor_si128(a, b), one));
+        STORE(out + i, _mm_sub_epi8(LOAD(cur + i), avg));
+    }
+    return i;
+}
+
+/*
+ * Paeth predictor on 8 16-bit lanes: with p = a + b - c,
+ * pa = |b - c|, pb = |a - c| and pc = |(b - c) + (a - c)|.
+ */
+static __m128i paeth_epi16(__m128i a, __m128i b, __m128i c) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i pa = _mm_sub_epi16(b, c);
+    __m128i pb = _mm_sub_epi16(a, c);
+    __m128i pc = _mm_add_epi16(pa, pb);
+    __m128i not_a, use_c;
+
+    pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+    pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+    pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+
+    not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+    use_c = _mm_cmpgt_epi16(pb, pc);
+    b = _mm_or_si128(_mm_andnot_si128(use_c, b), _mm_and_si128(use_c, c));
+    return _mm_or_si128(_mm_andnot_si128(not_a, a), _mm_and_si128(not_a, b));
+}
+
+static int paeth_sse2(const unsigned char *cur, const unsigned char *prev,
+                      unsigned char *out, int i, int len, int bpp) {
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = LOAD(cur + i - bpp);
+        __m128i b = LOAD(prev + i);
+        __m128i c = LOAD(prev + i - bpp);
+        __m128i lo = paeth_epi16(_mm_unpacklo_epi8(a, zero),
+                                 _mm_unpacklo_epi8(b, zero),
+                                 _mm_unpacklo_epi8(c, zero));
+        __m128i hi = paeth_epi16(_mm_unpackhi_epi8(a, zero),
+                                 _mm_unpackhi_epi8(b, zero),
+                                 _mm_unpackhi_epi8(c, zero));
+        STORE(out + i, _mm_sub_epi8(LOAD(cur + i), _mm_packus_epi16(lo, hi)));
+    }
+    return i;
+}
+
+static unsigned long cost_sse2(const unsigned char *row, int *n) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    int i;
+
+    /* min(v, -v) as unsigned bytes is |v| for v taken as signed */
+    for (i = 0; i + 16 <= *n; i += 16) {
+        __m128i v = LOAD(row + i);
+        v = _mm_min_epu8(v, _mm_sub_epi8(zero, v));
+        sum = _mm_add_epi32(sum, _mm_sad_epu8(v, zero));
+    }
+    *n = i;
+    return (unsigned long)_mm_cvtsi128_si32(sum) +
+           (unsigned long)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+}
+
+static int repeats_sse2(const unsigned char *cur, const unsigned char *prev,
+                        int *i, int len, int bpp) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i sum = zero;
+
+    for (; *i + 16 <= len; *i += 16) {
+        __m128i v = LOAD(cur + *i);
+        __m128i eq = _mm_or_si128(_mm_cmpeq_epi8(v, LOAD(cur + *i - bpp)),
+                                  _mm_cmpeq_epi8(v, LOAD(prev + *i)));
+        sum = _mm_add_epi32(sum, _mm_sad_epu8(_mm_and_si128(eq, one), zero));
+    }
+    return _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+}
+
+#endif /* PNG_FILTER_SSE2 */
+
+/*
+ * Number of bytes equal to the byte to the left or the byte above.
+ * Rows of flat, synthetic content (text, UI, screenshots) repeat most
+ * of their bytes; deflate matches those directly and filtering only
+ * breaks the matches up.
+ */
+static int filter_repeats(const unsigned char *cur, const unsigned char *prev,
+                          int len, int bpp) {
+    int n = 0;
+    int i = bpp;
+
+#ifdef PNG_FILTER_SSE2
+    n = repeats_sse2(cur, prev, &i, len, bpp);
+#endif
+    for (; i < len; i++) {
+        n += (cur[i] == cur[i - bpp]) | (cur[i] == prev[i]);
+    }
+    return n;
+}
+
+void png_filter_row(int type,
+                    const unsigned char *cur,
+                    const unsigned char *prev,
+                    unsigned char *out,
+                    int len,
+                    int bpp) {
+    int i = 0;
+    int a, b, c, p, pa, pb, pc;
+
+    switch (type) {
+    case PNG_FILTER_SUB:
+        for (; i < bpp && i < len; i++) {
+            out[i] = cur[i];
+        }
+#ifdef PNG_FILTER_SSE2
+        i = sub_sse2(cur, out, i, len, bpp);
+#endif
+        for (; i < len; i++) {
+            out[i] = (unsigned char)(cur[i] - cur[i - bpp]);
+        }
+        break;
+
+    case PNG_FILTER_UP:
+#ifdef PNG_FILTER_SSE2
+        i = up_sse2(cur, prev, out, i, len);
+#endif
+        for (; i < len; i++) {
+            out[i] = (unsigned char)(cur[i] - prev[i]);
+        }
+        break;
+
+    case PNG_FILTER_AVERAGE:
+        for (; i < bpp && i < len; i++) {
+            out[i] = (unsigned char)(cur[i] - (prev[i] >> 1));
+        }
+#ifdef PNG_FILTER_SSE2
+        i = average_sse2(cur, prev, out, i, len, bpp);
+#endif
+        for (; i < len; i++) {
+            out[i] = (unsigned char)(cur[i] - ((cur[i - bpp] + prev[i]) >> 1));
+        }
+        break;
+
+    case PNG_FILTER_PAETH:
+        /* left and upper left are zero: the predictor is the byte above */
+        for (; i < bpp && i < len; i++) {
+            out[i] = (unsigned char)(cur[i] - prev[i]);
+        }
+#ifdef PNG_FILTER_SSE2
+        i = paeth_sse2(cur, prev, out, i, len, bpp);
+#endif
+        for (; i < len; i++) {
+            a = cur[i - bpp];
+            b = prev[i];
+            c = prev[i - bpp];
+            p = b - c;
+            pc = a - c;
+            pa = p < 0 ? -p : p;
+            pb = pc < 0 ? -pc : pc;
+            pc = (p + pc) < 0 ? -(p + pc) : p + pc;
+            p = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            out[i] = (unsigned char)(cur[i] - p);
+        }
+        break;
+
+    default:
+        memcpy(out, cur, len);
+        break;
+    }
+}
+
+unsigned long png_filter_cost(const unsigned char *row, int len) {
+    unsigned long sum = 0;
+    int i = len;
+
+#ifdef PNG_FILTER_SSE2
+    sum = cost_sse2(row, &i);
+#else
+    i = 0;
+#endif
+    for (; i < len; i++) {
+        sum += row[i] < 128 ? row[i] : 256 - row[i];
+    }
+    return sum;
+}
+
+int png_filter_adaptive(const unsigned char *cur,
+                        const unsigned char *prev,
+                        unsigned char *out,
+                        unsigned char *scratch,
+                        int len,
+                        int bpp) {
+    unsigned char *best = out;
+    unsigned char *trial = scratch;
+    unsigned char *t;
+    unsigned long cost;
+    unsigned long bestCost;
+    int bestType = PNG_FILTER_NONE;
+    int type;
+
+    /* synthetic rows compress best unfiltered */
+    if (2 * filter_repeats(cur, prev, len, bpp) >= len) {
+        memcpy(out, cur, len);
+        return PNG_FILTER_NONE;
+    }
+
+    /* None needs no output until it is known to win */
+    bestCost = png_filter_cost(cur, len);
+    for (type = PNG_FILTER_SUB; type <= PNG_FILTER_PAETH; type++) {
+        png_filter_row(type, cur, prev, trial, len, bpp);
+        cost = png_filter_cost(trial, len);
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestType = type;
+            t = best;
+            best = trial;
+            trial = t;
+        }
+    }
+
+    if (bestType == PNG_FILTER_NONE) {
+        memcpy(out, cur, len);
+    } else if (best != out) {
+        memcpy(out, best, len);
+    }
+    return bestType;
+}
@@ -0,0 +1,119 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+#include "javacall_defs.h"
+#include "javacall_memory.h"
+#include "pngthread.h"
+
+#ifdef ENABLE_PNG_THREADS
+
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#define PNG_THREADS_WIN32
+#else
+#include <pthread.h>
+#endif
+
+typedef struct {
+    png_thread_func func;
+    void *arg;
+    int index;
+    int started;
+#ifdef PNG_THREADS_WIN32
+    HANDLE handle;
+#else
+    pthread_t id;
+#endif
+} png_thread;
+
+#ifdef PNG_THREADS_WIN32
+static DWORD WINAPI thread_main(LPVOID param) {
+    png_thread *t = (png_thread *)param;
+    t->func(t->arg, t->index);
+    return 0;
+}
+#else
+static void *thread_main(void *param) {
+    png_thread *t = (png_thread *)param;
+    t->func(t->arg, t->index);
+    return NULL;
+}
+#endif
+
+static void start_thread(png_thread *t) {
+#ifdef PNG_THREADS_WIN32
+    t->handle = CreateThread(NULL, 0, thread_main, t, 0, NULL);
+    t->started = t->handle != NULL;
+#else
+    t->started = pthread_create(&t->id, NULL, thread_main, t) == 0;
+#endif
+}
+
+static void join_thread(png_thread *t) {
+#ifdef PNG_THREADS_WIN32
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+#else
+    pthread_join(t->id, NULL);
+#endif
+}
+
+#endif /* ENABLE_PNG_THREADS */
+
+void png_run_threads(png_thread_func func, void *arg, int count) {
+    int i;
+#ifdef ENABLE_PNG_THREADS
+    png_thread *threads = NULL;
+
+    if (count > 1) {
+        threads = (png_thread *)javacall_malloc(sizeof(png_thread) * (count - 1));
+    }
+    if (threads != NULL) {
+        for (i = 1; i < count; i++) {
+            threads[i - 1].func = func;
+            threads[i - 1].arg = arg;
+            threads[i - 1].index = i;
+            start_thread(&threads[i - 1]);
+        }
+    }
+
+    func(arg, 0);
+
+    for (i = 1; i < count; i++) {
+        if (threads != NULL && threads[i - 1].started) {
+            join_thread(&threads[i - 1]);
+        } else {
+            func(arg, i);
+        }
+    }
+    if (threads != NULL) {
+        javacall_free(threads);
+    }
+#else
+    for (i = 0; i < count; i++) {
+        func(arg, i);
+    }
+#endif
+}
@@ -0,0 +1,123 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#ifndef __JAVAUTIL_SCALE_H
+#define __JAVAUTIL_SCALE_H
+
+/*
+ * Image scaler for thumbnails and sprites.  Scaling is separable: rows
+ * are filtered horizontally, then columns vertically, with the filter
+ * weights for both directions computed once per scaler.  Downscales by
+ * 4 or more first average blocks of pixels to about twice the target
+ * size, so the filter cost follows the target size and not the source.
+ */
+
+#include "javacall_defs.h"
+
+/* Resampling filters */
+#define JAVAUTIL_SCALE_NEAREST      0   /* pixel replication, fastest */
+#define JAVAUTIL_SCALE_BILINEAR     1   /* triangle filter */
+#define JAVAUTIL_SCALE_BOX          2   /* area average */
+#define JAVAUTIL_SCALE_LANCZOS3     3   /* sharpest, slowest */
+
+/*
+ * Pixel formats.  ARGB8888 is 0xAARRGGBB per 32-bit word with straight
+ * alpha, as javacall_image_* and the Java side use it; it is filtered
+ * premultiplied so transparent pixels do not bleed into their opaque
+ * neighbours.  ARGB8888_PRE is already premultiplied.  ALPHA8 is one
+ * byte per pixel, as the alpha planes of the image decoders.
+ */
+#define JAVAUTIL_SCALE_RGB565       0
+#define JAVAUTIL_SCALE_ARGB8888     1
+#define JAVAUTIL_SCALE_ARGB8888_PRE 2
+#define JAVAUTIL_SCALE_ALPHA8       3
+
+typedef struct _javautil_scaler javautil_scaler;
+
+/**
+ * Create a scaler for images of one size and format, with its weights
+ * and working buffers.  A scaler can be run any number of times, e.g.
+ * for every frame of a sprite.  Sizes are limited to 32767.
+ * 
+ * @param srcWidth      Width of the source images
+ * @param srcHeight     Height of the source images
+ * @param dstWidth      Width of the scaled images
+ * @param dstHeight     Height of the scaled images
+ * @param format        One of JAVAUTIL_SCALE_RGB565 .. ALPHA8
+ * @param filter        One of JAVAUTIL_SCALE_NEAREST .. LANCZOS3
+ * 
+ * @return Scaler handle, NULL on bad arguments or out of memory
+ */
+javautil_scaler *javautil_scaler_create(int srcWidth, 
+                                        int srcHeight,
+                                        int dstWidth, 
+                                        int dstHeight,
+                                        int format,
+                                        int filter);
+
+/**
+ * Scale one image.  Source and destination must not overlap.
+ * 
+ * @param scaler        Handle returned by javautil_scaler_create
+ * @param src           First source row
+ * @param srcStride     Distance between source rows in bytes
+ * @param dst           First destination row
+ * @param dstStride     Distance between destination rows in bytes
+ * 
+ * @return JAVACALL_OK on success, JAVACALL_INVALID_ARGUMENT if a 
+ *         pointer is NULL
+ */
+javacall_result javautil_scaler_run(javautil_scaler *scaler,
+                                    const void *src, 
+                                    int srcStride,
+                                    void *dst, 
+                                    int dstStride);
+
+/**
+ * Release a scaler
+ * 
+ * @param scaler        Handle returned by javautil_scaler_create
+ */
+void javautil_scaler_destroy(javautil_scaler *scaler);
+
+/**
+ * Scale one image with a scaler used only for it
+ * 
+ * @return JAVACALL_OK on success, JAVACALL_INVALID_ARGUMENT if a 
+ *         pointer is NULL, JAVACALL_FAIL if the sizes or format are not
+ *         supported or out of memory
+ */
+javacall_result javautil_scale_image(const void *src, 
+                                     int srcWidth, 
+                                     int srcHeight,
+                                     int srcStride,
+                                     void *dst, 
+                                     int dstWidth, 
+                                     int dstHeight,
+                                     int dstStride,
+                                     int format,
+                                     int filter);
+
+#endif  /* __JAVAUTIL_SCALE_H */
@@ -0,0 +1,738 @@
+/*
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+ 
+#include <string.h>
+#include "javacall_defs.h"
+#include "javacall_memory.h"
+#include "javautil_pixel.h"
+#include "javautil_scale.h"
+
+/*
+ * SSE2 kernels where SSE2 is part of the compilation target.  Each
+ * kernel handles the bulk of a row and leaves the tail to the C code.
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCALE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define MAX_SIZE        0x7FFF
+
+/* filter weights are fixed point with 14 fraction bits */
+#define WEIGHT_BITS     14
+#define WEIGHT_ONE      (1 << WEIGHT_BITS)
+#define WEIGHT_ROUND    (1 << (WEIGHT_BITS - 1))
+
+/* downscales by this much or more average blocks of pixels first */
+#define REDUCE_MIN      4
+#define REDUCE_MAX      256     /* keeps the row sums in 16 bits */
+
+#define CLAMP255(s)     ((unsigned int)(s) > 255 ? ((s) < 0 ? 0 : 255) : (s))
+
+/* Filter weights of one direction */
+typedef struct {
+    int *start;         /* first input pixel of each output pixel */
+    short *weights;     /* taps weights of each output pixel */
+    int taps;
+    int identity;       /* input and output are the same size */
+} scale_axis;
+
+struct _javautil_scaler {
+    int srcWidth;
+    int srcHeight;
+    int dstWidth;
+    int dstHeight;
+    int format;
+    int filter;
+    int bpp;            /* bytes per pixel of the working rows, 1 or 4 */
+
+    /* NEAREST */
+    int *nearestX;
+    int *nearestY;
+
+    /* first pass: block averages of reduceX by reduceY pixels */
+    int reduceX;
+    int reduceY;
+    int inWidth;        /* size after the first pass */
+    int inHeight;
+    unsigned short *sums;
+    unsigned char *reduced;
+
+    /* second pass: separable filter */
+    scale_axis h;
+    scale_axis v;
+    unsigned char *rowBuf;      /* a source row in the working format */
+    unsigned char *ring;        /* the last v.taps filtered rows */
+    const unsigned char **rows;
+    unsigned char *outRow;      /* a scaled row before conversion */
+};
+
+static const double filter_support[] = { 0.0, 1.0, 0.5, 3.0 };
+
+/*
+ * The weights need only floor and a sine over a few periods, computed
+ * here so that the porting layer does not have to link the math library.
+ */
+#define SCALE_PI    3.14159265358979323846
+
+static int scale_floor(double x) {
+    int i = (int)x;
+    return x < i ? i - 1 : i;
+}
+
+/* sin(x) for 0 <= x <= 3 pi, to about 1e-11 */
+static double scale_sin(double x) {
+    int n = scale_floor(x / SCALE_PI + 0.5);
+    double r = x - n * SCALE_PI;        /* in [-pi/2, pi/2] */
+    double r2 = r * r;
+    double s = r * (1.0 + r2 / -6.0 * (1.0 + r2 / -20.0 *
+                   (1.0 + r2 / -42.0 * (1.0 + r2 / -72.0 *
+                   (1.0 + r2 / -110.0 * (1.0 + r2 / -156.0 *
+                   (1.0 + r2 / -210.0 * (1.0 + r2 / -272.0))))))));
+    return (n & 1) ? -s : s;
+}
+
+static double sinc(double x) {
+    if (x == 0.0) {
+        return 1.0;
+    }
+    x *= SCALE_PI;
+    return scale_sin(x) / x;
+}
+
+static double filter_value(int filter, double x) {
+    if (x < 0.0) {
+        x = -x;
+    }
+    switch (filter) {
+    case JAVAUTIL_SCALE_BILINEAR:
+        return x < 1.0 ? 1.0 - x : 0.0;
+    case JAVAUTIL_SCALE_BOX:
+        return x <= 0.5 ? 1.0 : 0.0;
+    case JAVAUTIL_SCALE_LANCZOS3:
+        return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    default:
+        return 0.0;
+    }
+}
+
+static int axis_taps(int inSize, double scale, int filter) {
+    double support = filter_support[filter] * (scale < 1.0 ? 1.0 : scale);
+    int taps = -scale_floor(-support) * 2 + 1;
+
+    return taps < inSize ? taps : inSize;
+}
+
+/*
+ * Weights of outSize output pixels, each scale input pixels wide.  The
+ * filter is stretched by the scale when downscaling.  Taps outside the
+ * input are dropped and the rest renormalized, and every output pixel
+ * gets the same number of taps so the kernels have no edge cases.
+ */
+static void axis_init(scale_axis *a, int inSize, int outSize,
+                      double scale, int filter) {
+    double fscale = scale < 1.0 ? 1.0 : scale;
+    double support = filter_support[filter] * fscale;
+    int i, j;
+
+    a->taps = axis_taps(inSize, scale, filter);
+    a->identity = inSize == outSize && scale == 1.0;
+
+    for (i = 0; i < outSize; i++) {
+        double center = (i + 0.5) * scale;
+        double sum = 0.0;
+        int lo = scale_floor(center - support + 0.5);
+        int hi = scale_floor(center + support + 0.5);
+        int start;
+        int total = 0;
+        int best = 0;
+        short *out = a->weights + i * a->taps;
+
+        if (lo < 0) {
+            lo = 0;
+        }
+        if (hi > inSize) {
+            hi = inSize;
+        }
+        if (hi - lo > a->taps) {
+            hi = lo + a->taps;
+        }
+        start = lo < inSize - a->taps ? lo : inSize - a->taps;
+        a->start[i] = start;
+
+        memset(out, 0, a->taps * sizeof(short));
+        for (j = lo; j < hi; j++) {
+            sum += filter_value(filter, (j - center + 0.5) / fscale);
+        }
+        if (sum == 0.0) {
+            /* no input under the filter: take the nearest pixel */
+            j = (int)center;
+            out[(j < inSize ? j : inSize - 1) - start] = WEIGHT_ONE;
+            continue;
+        }
+        for (j = lo; j < hi; j++) {
+            double w = filter_value(filter, (j - center + 0.5) / fscale);
+            short v = (short)scale_floor(w / sum * WEIGHT_ONE + 0.5);
+            out[j - start] = v;
+            total += v;
+            if (v > out[best]) {
+                best = j - start;
+            }
+        }
+        /* the weights must sum to exactly one */
+        out[best] = (short)(out[best] + WEIGHT_ONE - total);
+    }
+}
+
+/* Horizontal pass ********************************************************/
+
+#ifdef SCALE_SSE2
+
+static int load32(const unsigned char *p) {
+    int v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static void filter_row4_sse2(const unsigned char *in, unsigned char *out,
+                             const scale_axis *a, int outWidth) {
+    const __m128i zero = _mm_setzero_si128();
+    const int taps = a->taps;
+    int x, k;
+
+    for (x = 0; x < outWidth; x++) {
+        const unsigned char *p = in + a->start[x] * 4;
+        const short *w = a->weights + x * taps;
+        __m128i sum = _mm_set1_epi32(WEIGHT_ROUND);
+        __m128i px;
+
+        /* two pixels channel by channel against their weight pair */
+        for (k = 0; k + 2 <= taps; k += 2, p += 8) {
+            px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(load32(p)),
+                                   _mm_cvtsi32_si128(load32(p + 4)));
+            px = _mm_unpacklo_epi8(px, zero);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(px, 
+                                    _mm_set1_epi32(load32((const unsigned char *)(w + k)))));
+        }
+        if (k < taps) {
+            px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(load32(p)), zero);
+            px = _mm_unpacklo_epi16(px, zero);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(px, 
+                                    _mm_set1_epi32((unsigned short)w[k])));
+        }
+        sum = _mm_srai_epi32(sum, WEIGHT_BITS);
+        sum = _mm_packs_epi32(sum, sum);
+        sum = _mm_packus_epi16(sum, sum);
+        k = _mm_cvtsi128_si32(sum);
+        memcpy(out + x * 4, &k, 4);
+    }
+}
+
+#endif /* SCALE_SSE2 */
+
+static void filter_row4(const unsigned char *in, unsigned char *out,
+                        const scale_axis *a, int outWidth) {
+    const int taps = a->taps;
+    int x, k;
+
+    if (a->identity) {
+        memcpy(out, in, outWidth * 4);
+        return;
+    }
+#ifdef SCALE_SSE2
+    filter_row4_sse2(in, out, a, outWidth);
+    return;
+#endif
+    for (x = 0; x < outWidth; x++) {
+        const unsigned char *p = in + a->start[x] * 4;
+        const short *w = a->weights + x * taps;
+        int s0 = WEIGHT_ROUND;
+        int s1 = WEIGHT_ROUND;
+        int s2 = WEIGHT_ROUND;
+        int s3 = WEIGHT_ROUND;
+
+        for (k = 0; k < taps; k++, p += 4) {
+            s0 += p[0] * w[k];
+            s1 += p[1] * w[k];
+            s2 += p[2] * w[k];
+            s3 += p[3] * w[k];
+        }
+        s0 >>= WEIGHT_BITS;
+        s1 >>= WEIGHT_BITS;
+        s2 >>= WEIGHT_BITS;
+        s3 >>= WEIGHT_BITS;
+        out[0] = (unsigned char)CLAMP255(s0);
+        out[1] = (unsigned char)CLAMP255(s1);
+        out[2] = (unsigned char)CLAMP255(s2);
+        out[3] = (unsigned char)CLAMP255(s3);
+        out += 4;
+    }
+}
+
+static void filter_row1(const unsigned char *in, unsigned char *out,
+                        const scale_axis *a, int outWidth) {
+    const int taps = a->taps;
+    int x, k;
+
+    if (a->identity) {
+        memcpy(out, in, outWidth);
+        return;
+    }
+    for (x = 0; x < outWidth; x++) {
+        const unsigned char *p = in + a->start[x];
+        const short *w = a->weights + x * taps;
+        int s = WEIGHT_ROUND;
+
+        k = 0;
+#ifdef SCALE_SSE2
+        if (taps >= 8) {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i sum = zero;
+            for (; k + 8 <= taps; k += 8) {
+                __m128i px = _mm_unpacklo_epi8(
+                    _mm_loadl_epi64((const __m128i *)(p + k)), zero);
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(px, 
+                                   _mm_loadu_si128((const __m128i *)(w + k))));
+            }
+            sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+            sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 4));
+            s += _mm_cvtsi128_si32(sum);
+        }
+#endif
+        for (; k < taps; k++) {
+            s += p[k] * w[k];
+        }
+        s >>= WEIGHT_BITS;
+        out[x] = (unsigned char)CLAMP255(s);
+    }
+}
+
+/* Vertical pass **********************************************************/
+
+#ifdef SCALE_SSE2
+
+static int filter_column_sse2(const unsigned char **rows, const short *w,
+                              int taps, unsigned char *out, int len) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(WEIGHT_ROUND);
+    int i, k;
+
+    for (i = 0; i + 16 <= len; i += 16) {
+        __m128i s0 = round;
+        __m128i s1 = round;
+        __m128i s2 = round;
+        __m128i s3 = round;
+
+        /* bytes of two rows interleaved against their weight pair */
+        for (k = 0; k < taps; k += 2) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(rows[k] + i));
+            __m128i b;
+            __m128i wt;
+            __m128i lo, hi;
+
+            if (k + 1 < taps) {
+                b = _mm_loadu_si128((const __m128i *)(rows[k + 1] + i));
+                wt = _mm_set1_epi32(load32((const unsigned char *)(w + k)));
+            } else {
+                b = zero;
+                wt = _mm_set1_epi32((unsigned short)w[k]);
+            }
+            lo = _mm_unpacklo_epi8(a, b);
+            hi = _mm_unpackhi_epi8(a, b);
+            s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), wt));
+            s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), wt));
+            s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), wt));
+            s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), wt));
+        }
+        s0 = _mm_packs_epi32(_mm_srai_epi32(s0, WEIGHT_BITS), 
+                             _mm_srai_epi32(s1, WEIGHT_BITS));
+        s2 = _mm_packs_epi32(_mm_srai_epi32(s2, WEIGHT_BITS), 
+                             _mm_srai_epi32(s3, WEIGHT_BITS));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(s0, s2));
+    }
+    return i;
+}
+
+#endif /* SCALE_SSE2 */
+
+static void filter_column(const unsigned char **rows, const short *w,
+                          int taps, unsigned char *out, int len) {
+    int i = 0;
+    int k;
+
+    if (taps == 1) {
+        memcpy(out, rows[0], len);
+        return;
+    }
+#ifdef SCALE_SSE2
+    i = filter_column_sse2(rows, w, taps, out, len);
+#endif
+    for (; i < len; i++) {
+        int s = WEIGHT_ROUND;
+        for (k = 0; k < taps; k++) {
+            s += rows[k][i] * w[k];
+        }
+        s >>= WEIGHT_BITS;
+        out[i] = (unsigned char)CLAMP255(s);
+    }
+}
+
+/* Pixel conversion *******************************************************/
+
+/* 
+ * Source row y in the working format: 32-bit premultiplied ARGB, or
+ * alpha bytes.  Formats that are already in it are used in place.
+ */
+static const unsigned char *load_row(javautil_scaler *s, 
+                                     const unsigned char *src,
+                                     int srcStride, int y) {
+    const unsigned char *row = src + (long)y * srcStride;
+    unsigned int *out = (unsigned int *)s->rowBuf;
+
+    switch (s->format) {
+    case JAVAUTIL_SCALE_RGB565:
+        javautil_pixel_rgb565_to_argb8888((const unsigned short *)row, NULL,
+                                          out, s->srcWidth);
+        return s->rowBuf;
+    case JAVAUTIL_SCALE_ARGB8888:
+        javautil_pixel_premultiply((const unsigned int *)row, out, 
+                                   s->srcWidth);
+        return s->rowBuf;
+    default:
+        return row;
+    }
+}
+
+/* Store a scaled row of working pixels in the destination format */
+static void store_row(javautil_scaler *s, const unsigned char *in,
+                      unsigned char *dst) {
+    if (s->format == JAVAUTIL_SCALE_RGB565) {
+        javautil_pixel_argb8888_to_rgb565((const unsigned int *)in, 
+                                          (unsigned short *)dst, NULL, 
+                                          s->dstWidth);
+    } else {
+        /* filtered colors can exceed alpha, unpremultiply clamps them */
+        javautil_pixel_unpremultiply((const unsigned int *)in, 
+                                     (unsigned int *)dst, s->dstWidth);
+    }
+}
+
+/* First pass *************************************************************/
+
+static void add_row(unsigned short *sums, const unsigned char *row, int len) {
+    int i = 0;
+
+#ifdef SCALE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(row + i));
+        __m128i *s = (__m128i *)(sums + i);
+        _mm_storeu_si128(s, _mm_add_epi16(_mm_loadu_si128(s), 
+                                          _mm_unpacklo_epi8(v, zero)));
+        _mm_storeu_si128(s + 1, _mm_add_epi16(_mm_loadu_si128(s + 1), 
+                                              _mm_unpackhi_epi8(v, zero)));
+    }
+#endif
+    for (; i < len; i++) {
+        sums[i] = (unsigned short)(sums[i] + row[i]);
+    }
+}
+
+/* Average blocks of reduceX by reduceY source pixels */
+static void reduce(javautil_scaler *s, const unsigned char *src, 
+                   int srcStride) {
+    const int bpp = s->bpp;
+    const int len = s->srcWidth * bpp;
+    unsigned char *out = s->reduced;
+    int y, ry, x, c;
+
+    for (ry = 0; ry < s->inHeight; ry++) {
+        int y0 = ry * s->reduceY;
+        int y1 = y0 + s->reduceY < s->srcHeight ? y0 + s->reduceY : s->srcHeight;
+
+        memset(s->sums, 0, len * sizeof(unsigned short));
+        for (y = y0; y < y1; y++) {
+            add_row(s->sums, load_row(s, (const unsigned char *)src, 
+                                      srcStride, y), len);
+        }
+        for (x = 0; x < s->srcWidth; x += s->reduceX) {
+            int n = s->srcWidth - x < s->reduceX ? s->srcWidth - x : s->reduceX;
+            unsigned int count = n * (y1 - y0);
+            const unsigned short *p = s->sums + x * bpp;
+            for (c = 0; c < bpp; c++) {
+                unsigned int sum = count / 2;
+                int i;
+                for (i = 0; i < n * bpp; i += bpp) {
+                    sum += p[i + c];
+                }
+                *out++ = (unsigned char)(sum / count);
+            }
+        }
+    }
+}
+
+/* Scaler *****************************************************************/
+
+static void scale_nearest(javautil_scaler *s, const unsigned char *src,
+                          int srcStride, unsigned char *dst, int dstStride) {
+    int x, y;
+
+    for (y = 0; y < s->dstHeight; y++, dst += dstStride) {
+        const unsigned char *row = src + (long)s->nearestY[y] * srcStride;
+        switch (s->format) {
+        case JAVAUTIL_SCALE_RGB565:
+            for (x = 0; x < s->dstWidth; x++) {
+                ((unsigned short *)dst)[x] = 
+                    ((const unsigned short *)row)[s->nearestX[x]];
+            }
+            break;
+        case JAVAUTIL_SCALE_ALPHA8:
+            for (x = 0; x < s->dstWidth; x++) {
+                dst[x] = row[s->nearestX[x]];
+            }
+            break;
+        default:
+            for (x = 0; x < s->dstWidth; x++) {
+                ((unsigned int *)dst)[x] = 
+                    ((const unsigned int *)row)[s->nearestX[x]];
+            }
+            break;
+        }
+    }
+}
+
+static void scale_filtered(javautil_scaler *s, const unsigned char *src,
+                           int srcStride, unsigned char *dst, int dstStride) {
+    const int taps = s->v.taps;
+    const int rowLen = s->dstWidth * s->bpp;
+    int next = 0;       /* next input row to filter horizontally */
+    int y, k;
+
+    if (s->reduced != NULL) {
+        reduce(s, src, srcStride);
+        src = s->reduced;
+        srcStride = s->inWidth * s->bpp;
+    }
+
+    for (y = 0; y < s->dstHeight; y++, dst += dstStride) {
+        int start = s->v.start[y];
+        int r = next > start ? next : start;
+        unsigned char *out = s->outRow != NULL ? s->outRow : dst;
+
+        /* the row starts only increase, the ring keeps the last taps */
+        for (; r < start + taps; r++) {
+            const unsigned char *in = s->reduced != NULL ? 
+                src + (long)r * srcStride : load_row(s, src, srcStride, r);
+            unsigned char *ring = s->ring + (r % taps) * rowLen;
+            if (s->bpp == 4) {
+                filter_row4(in, ring, &s->h, s->dstWidth);
+            } else {
+                filter_row1(in, ring, &s->h, s->dstWidth);
+            }
+        }
+        next = start + taps;
+
+        for (k = 0; k < taps; k++) {
+            s->rows[k] = s->ring + ((start + k) % taps) * rowLen;
+        }
+        filter_column(s->rows, s->v.weights + y * taps, taps, out, rowLen);
+        if (out != dst) {
+            store_row(s, out, dst);
+        }
+    }
+}
+
+static int reduce_factor(int inSize, int outSize) {
+    int f = inSize / outSize;
+
+    if (f < REDUCE_MIN) {
+        return 1;
+    }
+    f /= 2;
+    return f < REDUCE_MAX ? f : REDUCE_MAX;
+}
+
+#define ALIGN8(n)   (((n) + 7) & ~7)
+
+javautil_scaler *javautil_scaler_create(int srcWidth, 
+                                        int srcHeight,
+                                        int dstWidth, 
+                                        int dstHeight,
+                                        int format,
+                                        int filter) {
+    javautil_scaler *s;
+    unsigned char *p;
+    long size;
+    int bpp = format == JAVAUTIL_SCALE_ALPHA8 ? 1 : 4;
+    int convert = format == JAVAUTIL_SCALE_RGB565 || 
+                  format == JAVAUTIL_SCALE_ARGB8888;
+    int reduceX = 1;
+    int reduceY = 1;
+    int inWidth = srcWidth;
+    int inHeight = srcHeight;
+    int hTaps = 0;
+    int vTaps = 0;
+    int i;
+
+    if (srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0 ||
+        srcWidth > MAX_SIZE || srcHeight > MAX_SIZE || 
+        dstWidth > MAX_SIZE || dstHeight > MAX_SIZE ||
+        format < JAVAUTIL_SCALE_RGB565 || format > JAVAUTIL_SCALE_ALPHA8 ||
+        filter < JAVAUTIL_SCALE_NEAREST || filter > JAVAUTIL_SCALE_LANCZOS3) {
+        return NULL;
+    }
+
+    size = ALIGN8(sizeof(javautil_scaler));
+    if (filter == JAVAUTIL_SCALE_NEAREST) {
+        size += ALIGN8((dstWidth + dstHeight) * sizeof(int));
+    } else {
+        reduceX = reduce_factor(srcWidth, dstWidth);
+        reduceY = reduce_factor(srcHeight, dstHeight);
+        inWidth = (srcWidth + reduceX - 1) / reduceX;
+        inHeight = (srcHeight + reduceY - 1) / reduceY;
+        hTaps = axis_taps(inWidth, (double)srcWidth / reduceX / dstWidth, filter);
+        vTaps = axis_taps(inHeight, (double)srcHeight / reduceY / dstHeight, filter);
+        size += ALIGN8((dstWidth + dstHeight) * sizeof(int));
+        size += ALIGN8((dstWidth * hTaps + dstHeight * vTaps) * sizeof(short));
+        size += ALIGN8(vTaps * sizeof(unsigned char *));
+        size += ALIGN8((long)vTaps * dstWidth * bpp);
+        if (convert) {
+            size += ALIGN8((long)srcWidth * bpp) + ALIGN8((long)dstWidth * bpp);
+        }
+        if (reduceX > 1 || reduceY > 1) {
+            size += ALIGN8((long)srcWidth * bpp * sizeof(unsigned short));
+            size += ALIGN8((long)inWidth * inHeight * bpp);
+        }
+    }
+
+    p = (unsigned char *)javacall_malloc(size);
+    if (p == NULL) {
+        return NULL;
+    }
+    s = (javautil_scaler *)p;
+    memset(s, 0, sizeof(javautil_scaler));
+    p += ALIGN8(sizeof(javautil_scaler));
+    s->srcWidth = srcWidth;
+    s->srcHeight = srcHeight;
+    s->dstWidth = dstWidth;
+    s->dstHeight = dstHeight;
+    s->format = format;
+    s->filter = filter;
+    s->bpp = bpp;
+    s->reduceX = reduceX;
+    s->reduceY = reduceY;
+    s->inWidth = inWidth;
+    s->inHeight = inHeight;
+
+    if (filter == JAVAUTIL_SCALE_NEAREST) {
+        s->nearestX = (int *)p;
+        s->nearestY = s->nearestX + dstWidth;
+        for (i = 0; i < dstWidth; i++) {
+            s->nearestX[i] = (int)(((long)i * 2 + 1) * srcWidth / (dstWidth * 2));
+        }
+        for (i = 0; i < dstHeight; i++) {
+            s->nearestY[i] = (int)(((long)i * 2 + 1) * srcHeight / (dstHeight * 2));
+        }
+        return s;
+    }
+
+    s->h.start = (int *)p;
+    s->v.start = s->h.start + dstWidth;
+    p += ALIGN8((dstWidth + dstHeight) * sizeof(int));
+    s->h.weights = (short *)p;
+    s->v.weights = s->h.weights + dstWidth * hTaps;
+    p += ALIGN8((dstWidth * hTaps + dstHeight * vTaps) * sizeof(short));
+    s->rows = (const unsigned char **)p;
+    p += ALIGN8(vTaps * sizeof(unsigned char *));
+    s->ring = p;
+    p += ALIGN8((long)vTaps * dstWidth * bpp);
+    if (convert) {
+        s->rowBuf = p;
+        p += ALIGN8((long)srcWidth * bpp);
+        s->outRow = p;
+        p += ALIGN8((long)dstWidth * bpp);
+    }
+    if (reduceX > 1 || reduceY > 1) {
+        s->sums = (unsigned short *)p;
+        p += ALIGN8((long)srcWidth * bpp * sizeof(unsigned short));
+        s->reduced = p;
+    }
+
+    axis_init(&s->h, inWidth, dstWidth, 
+              (double)srcWidth / reduceX / dstWidth, filter);
+    axis_init(&s->v, inHeight, dstHeight, 
+              (double)srcHeight / reduceY / dstHeight, filter);
+    return s;
+}
+
+javacall_result javautil_scaler_run(javautil_scaler *scaler,
+                                    const void *src, 
+                                    int srcStride,
+                                    void *dst, 
+                                    int dstStride) {
+    if (scaler == NULL || src == NULL || dst == NULL) {
+        return JAVACALL_INVALID_ARGUMENT;
+    }
+    if (scaler->filter == JAVAUTIL_SCALE_NEAREST) {
+        scale_nearest(scaler, (const unsigned char *)src, srcStride,
+                      (unsigned char *)dst, dstStride);
+    } else {
+        scale_filtered(scaler, (const unsigned char *)src, srcStride,
+                       (unsigned char *)dst, dstStride);
+    }
+    return JAVACALL_OK;
+}
+
+void javautil_scaler_destroy(javautil_scaler *scaler) {
+    if (scaler != NULL) {
+        javacall_free(scaler);
+    }
+}
+
+javacall_result javautil_scale_image(const void *src, 
+                                     int srcWidth, 
+                                     int srcHeight,
+                                     int srcStride,
+                                     void *dst, 
+                                     int dstWidth, 
+                                     int dstHeight,
+                                     int dstStride,
+                                     int format,
+                                     int filter) {
+    javautil_scaler *s;
+    javacall_result res;
+
+    if (src == NULL || dst == NULL) {
+        return JAVACALL_INVALID_ARGUMENT;
+    }
+    s = javautil_scaler_create(srcWidth, srcHeight, dstWidth, dstHeight,
+                               format, filter);
+    if (s == NULL) {
+        return JAVACALL_FAIL;
+    }
+    res = javautil_scaler_run(s, src, srcStride, dst, dstStride);
+    javautil_scaler_destroy(s);
+    return res;
+}
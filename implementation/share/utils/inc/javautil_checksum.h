@@ -0,0 +1,85 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * Interface for CRC-32 and Adler-32 checksums.
+ */
+
+#ifndef _JAVAUTIL_CHECKSUM_H_
+#define _JAVAUTIL_CHECKSUM_H_
+
+#include "javacall_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif 
+
+/**
+ * Updates a CRC-32 (ISO 3309, as used by PNG and zip) with a buffer.
+ * The initial value is 0; the result of one call may be passed to the
+ * next to checksum data given in parts.
+ *
+ * Uses carry-less multiply (x86 PCLMULQDQ) or CRC instructions
+ * (ARMv8) when the CPU provides them, slice-by-8 tables otherwise.
+ *
+ * @param crc running CRC value, 0 to start a new checksum
+ * @param buf data to add
+ * @param len number of bytes in <param>buf</param>
+ * @return updated CRC value
+ */
+unsigned long javautil_crc32(unsigned long crc,
+                             const unsigned char* buf, long len);
+
+/**
+ * Updates an Adler-32 (RFC 1950, as used by zlib streams) with a buffer.
+ * The initial value is 1; the result of one call may be passed to the
+ * next to checksum data given in parts.
+ *
+ * @param adler running Adler-32 value, 1 to start a new checksum
+ * @param buf data to add
+ * @param len number of bytes in <param>buf</param>
+ * @return updated Adler-32 value
+ */
+unsigned long javautil_adler32(unsigned long adler,
+                               const unsigned char* buf, long len);
+
+/**
+ * Combines the Adler-32 of two consecutive buffers, so that parts of
+ * the data can be checksummed separately, for example in parallel.
+ *
+ * @param adler1 Adler-32 of the first buffer
+ * @param adler2 Adler-32 of the second buffer
+ * @param len2 length of the second buffer
+ * @return Adler-32 of both buffers in sequence
+ */
+unsigned long javautil_adler32_combine(unsigned long adler1,
+                                       unsigned long adler2, long len2);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _JAVAUTIL_CHECKSUM_H_ */
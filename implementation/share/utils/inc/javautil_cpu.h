@@ -0,0 +1,95 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * Interface for CPU feature detection.
+ *
+ * Kernels for instruction sets beyond the baseline of the target are
+ * compiled into the same library as the plain C code and must only
+ * run when the CPU supports them.  The features are probed once, by
+ * javautil_cpu_init from javacall_os_initialize or on first use, and
+ * modules check them when they select their kernels.
+ *
+ * Setting the environment variable JAVACALL_CPU caps the features, for
+ * example to test the plain C code on a CPU with AVX2:
+ *   none     no optional instruction sets
+ *   sse2     SSE2
+ *   sse4.2   SSE2 to SSE4.2 and PCLMULQDQ
+ *   avx2     everything up to AVX2
+ *   neon     NEON and the ARMv8 CRC instructions
+ * Features the CPU lacks are never reported.  Code fixed at compile
+ * time for the baseline of the target, such as the SSE2 code of the
+ * image scaler on x86-64, is not affected.
+ */
+
+#ifndef _JAVAUTIL_CPU_H_
+#define _JAVAUTIL_CPU_H_
+
+#include "javacall_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif 
+
+/** CPU features */
+#define JAVAUTIL_CPU_SSE2       0x0001
+#define JAVAUTIL_CPU_SSSE3      0x0002
+#define JAVAUTIL_CPU_SSE41      0x0004
+#define JAVAUTIL_CPU_SSE42      0x0008
+#define JAVAUTIL_CPU_PCLMUL     0x0010  /* carry-less multiply */
+#define JAVAUTIL_CPU_AVX        0x0020  /* includes OS support */
+#define JAVAUTIL_CPU_AVX2       0x0040
+#define JAVAUTIL_CPU_NEON       0x0100
+#define JAVAUTIL_CPU_ARM_CRC32  0x0200  /* ARMv8 CRC32 instructions */
+
+/**
+ * Probes the CPU and applies the JAVACALL_CPU environment variable.
+ * Called from javacall_os_initialize; calling it again probes again.
+ */
+void javautil_cpu_init(void);
+
+/**
+ * Returns the features of the CPU, probing it on the first call if
+ * javautil_cpu_init was not called.
+ *
+ * @return JAVAUTIL_CPU_* flags
+ */
+unsigned int javautil_cpu_features(void);
+
+/**
+ * Checks for CPU features.
+ *
+ * @param features JAVAUTIL_CPU_* flags
+ * @return <tt>JAVACALL_TRUE</tt> if the CPU has all of
+ *         <param>features</param>, <tt>JAVACALL_FALSE</tt> otherwise
+ */
+javacall_bool javautil_cpu_has(unsigned int features);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _JAVAUTIL_CPU_H_ */
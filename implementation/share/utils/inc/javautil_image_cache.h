@@ -0,0 +1,177 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * Interface for a cache of decoded images.
+ *
+ * Images are keyed by their encoded bytes together with the target
+ * pixel format and the image size, so that decoding the same bytes again
+ * finds the pixels of the first decode.  A 64-bit hash of the bytes
+ * selects the candidates, and a hit also compares the bytes with a copy
+ * kept in the cache: the bytes come from applications, and a crafted
+ * hash collision must not return the pixels of another application's
+ * image.  The cache holds at most a memory budget of pixel data and
+ * encoded copies, and evicts the least recently used images to stay
+ * within it.  Entries are shared: a lookup returns the cached pixels
+ * themselves, which stay valid until the entry is released.
+ *
+ * The cache is not synchronized: the buckets, the LRU list and the
+ * counters have no locking, so all functions must be called from a
+ * single thread, normally the one that calls the image decoder.
+ */
+
+#ifndef _JAVAUTIL_IMAGE_CACHE_H_
+#define _JAVAUTIL_IMAGE_CACHE_H_
+
+#include "javacall_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif 
+
+/** Budget of a cache that was never given one, in bytes */
+#define JAVAUTIL_IMAGE_CACHE_DEFAULT_BUDGET (2 * 1024 * 1024)
+
+/** Target pixel formats, the value is the pixel size in bytes */
+#define JAVAUTIL_IMAGE_CACHE_RGB565     2
+#define JAVAUTIL_IMAGE_CACHE_ARGB8888   4
+
+/**
+ * Identity of a decoded image
+ */
+typedef struct {
+    javacall_uint64 hash;   /* hash of the encoded bytes */
+    const void* source;     /* the encoded bytes, not copied */
+    long sourceSize;        /* number of encoded bytes */
+    int format;             /* JAVAUTIL_IMAGE_CACHE_* */
+    long width;
+    long height;
+} javautil_image_cache_key;
+
+/**
+ * A cached image.  The fields are read only.
+ */
+typedef struct {
+    /** Decoded pixels */
+    const void* pixels;
+    /** Size of pixels in bytes */
+    long pixelsSize;
+    /** One alpha byte per pixel, NULL if the image is opaque */
+    const unsigned char* alpha;
+    /** Size of alpha in bytes, 0 if the image is opaque */
+    long alphaSize;
+} javautil_image_cache_entry;
+
+/**
+ * Counters of the cache
+ */
+typedef struct {
+    unsigned long hits;         /* lookups that found an image */
+    unsigned long misses;       /* lookups that did not */
+    unsigned long evictions;    /* images dropped to stay in budget */
+    long entries;               /* images in the cache */
+    long bytes;                 /* memory they use */
+    long budget;                /* the most memory they may use */
+} javautil_image_cache_stats;
+
+/**
+ * Fills in the key of an image.  Hashing reads the encoded bytes at
+ * several gigabytes per second.  The key refers to the encoded bytes,
+ * which must stay valid while the key is used; the caller may point
+ * <code>key->source</code> at an identical copy of them.
+ *
+ * @param key key to fill in
+ * @param source encoded image
+ * @param sourceSize number of bytes in <param>source</param>
+ * @param format target pixel format, JAVAUTIL_IMAGE_CACHE_*
+ * @param width width of the decoded image
+ * @param height height of the decoded image
+ */
+void javautil_image_cache_key_init(javautil_image_cache_key* key,
+                                   const void* source, long sourceSize,
+                                   int format, long width, long height);
+
+/**
+ * Looks up a decoded image and makes it the most recently used.
+ * A found entry is not evicted until it is released with
+ * javautil_image_cache_release.
+ *
+ * @param key key of the image
+ * @return the cached image, NULL if it is not in the cache
+ */
+const javautil_image_cache_entry* javautil_image_cache_lookup(
+        const javautil_image_cache_key* key);
+
+/**
+ * Releases an entry returned by javautil_image_cache_lookup.
+ *
+ * @param entry the entry, may be NULL
+ */
+void javautil_image_cache_release(const javautil_image_cache_entry* entry);
+
+/**
+ * Adds a copy of a decoded image and of its encoded bytes to the cache,
+ * evicting the least recently used images that are not in use to make
+ * room.  Alpha that is opaque everywhere is not stored.
+ *
+ * @param key key of the image
+ * @param pixels decoded pixels
+ * @param pixelsSize size of <param>pixels</param> in bytes
+ * @param alpha one alpha byte per pixel, NULL if the image is opaque
+ * @param alphaSize size of <param>alpha</param> in bytes
+ * @return JAVACALL_OK if the image was added or was already cached,
+ *         JAVACALL_FAIL if it does not fit in the budget or memory
+ */
+javacall_result javautil_image_cache_insert(
+        const javautil_image_cache_key* key,
+        const void* pixels, long pixelsSize,
+        const unsigned char* alpha, long alphaSize);
+
+/**
+ * Sets the memory budget, evicting images that are not in use until
+ * the cache is within it.  A budget of 0 disables the cache.
+ *
+ * @param bytes the most memory cached images may use
+ */
+void javautil_image_cache_set_budget(long bytes);
+
+/**
+ * Removes all images that are not in use and resets the counters.
+ */
+void javautil_image_cache_clear(void);
+
+/**
+ * Reads the counters of the cache.
+ *
+ * @param stats where to store the counters
+ */
+void javautil_image_cache_get_stats(javautil_image_cache_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _JAVAUTIL_IMAGE_CACHE_H_ */
@@ -0,0 +1,314 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * Interface for pixel format conversions.
+ *
+ * RGB888 is three bytes R, G, B per pixel.  RGB565 is a native 16-bit
+ * pixel.  XRGB8888 and ARGB8888 are native 32-bit pixels 0xAARRGGBB,
+ * XRGB8888 with an unused top byte.  Alpha planes are one byte per
+ * pixel.  Widening RGB565 repeats the top bits of each component below
+ * so that full intensity stays 0xff; narrowing to RGB565 truncates.
+ *
+ * The conversions use SSE2, AVX2 or NEON where the build includes
+ * them and javautil_cpu_has reports the CPU supports them.  All
+ * implementations give the same results.
+ *
+ * javacall_os_initialize selects the implementation with
+ * javautil_pixel_init, before the image worker threads and the LCD
+ * presenter start, so that the conversions only read shared state.
+ * Without it the first conversion selects the implementation, which is
+ * safe only while a single thread converts pixels.
+ */
+
+#ifndef _JAVAUTIL_PIXEL_H_
+#define _JAVAUTIL_PIXEL_H_
+
+#include "javacall_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif 
+
+/** Implementations of the conversions */
+#define JAVAUTIL_PIXEL_IMPL_C       0
+#define JAVAUTIL_PIXEL_IMPL_SSE2    1
+#define JAVAUTIL_PIXEL_IMPL_AVX2    2
+#define JAVAUTIL_PIXEL_IMPL_NEON    3
+
+/**
+ * Selects the best implementation this build and CPU support.  Called
+ * from javacall_os_initialize after javautil_cpu_init, before other
+ * threads convert pixels.
+ */
+void javautil_pixel_init(void);
+
+/**
+ * Returns the implementation in use, the best one this build and CPU
+ * support unless set otherwise.
+ *
+ * @return one of JAVAUTIL_PIXEL_IMPL_*
+ */
+int javautil_pixel_get_impl(void);
+
+/**
+ * Selects the implementation to use, for example to compare them or
+ * to work around a CPU problem.  JAVAUTIL_PIXEL_IMPL_C is always
+ * available.  No other thread may convert pixels meanwhile.
+ *
+ * @param impl one of JAVAUTIL_PIXEL_IMPL_*
+ * @return the implementation in use, unchanged if <param>impl</param>
+ *         is not supported by this build or CPU
+ */
+int javautil_pixel_set_impl(int impl);
+
+/**
+ * Converts RGB888 to RGB565.
+ *
+ * @param src pixels to convert
+ * @param dst converted pixels
+ * @param count number of pixels
+ */
+void javautil_pixel_rgb888_to_rgb565(const unsigned char* src,
+                                     unsigned short* dst, int count);
+
+/**
+ * Converts RGB888 to XRGB8888 with a zero top byte.
+ *
+ * @param src pixels to convert
+ * @param dst converted pixels
+ * @param count number of pixels
+ */
+void javautil_pixel_rgb888_to_xrgb8888(const unsigned char* src,
+                                       unsigned int* dst, int count);
+
+/**
+ * Converts XRGB8888 or ARGB8888 to RGB888, dropping the top byte.
+ *
+ * @param src pixels to convert
+ * @param dst converted pixels
+ * @param count number of pixels
+ */
+void javautil_pixel_xrgb8888_to_rgb888(const unsigned int* src,
+                                       unsigned char* dst, int count);
+
+/**
+ * Converts RGB565 to RGB888.
+ *
+ * @param src pixels to convert
+ * @param dst converted pixels
+ * @param count number of pixels
+ */
+void javautil_pixel_rgb565_to_rgb888(const unsigned short* src,
+                                     unsigned char* dst, int count);
+
+/**
+ * Converts RGB565 and an alpha plane to ARGB8888.
+ *
+ * @param src pixels to convert
+ * @param alpha alpha of the pixels, NULL for opaque pixels
+ * @param dst converted pixels
+ * @param count number of pixels
+ */
+void javautil_pixel_rgb565_to_argb8888(const unsigned short* src,
+                                       const unsigned char* alpha,
+                                       unsigned int* dst, int count);
+
+/**
+ * Converts ARGB8888 to RGB565 and an alpha plane.
+ *
+ * @param src pixels to convert
+ * @param dst converted pixels
+ * @param alpha where to store the alpha of the pixels, may be NULL
+ * @param count number of pixels
+ */
+void javautil_pixel_argb8888_to_rgb565(const unsigned int* src,
+                                       unsigned short* dst,
+                                       unsigned char* alpha, int count);
+
+/**
+ * Extracts the alpha plane of ARGB8888 pixels.
+ *
+ * @param src pixels
+ * @param alpha where to store the alpha of the pixels
+ * @param count number of pixels
+ */
+void javautil_pixel_argb8888_to_alpha(const unsigned int* src,
+                                      unsigned char* alpha, int count);
+
+/**
+ * Premultiplies ARGB8888 colors by their alpha, rounding to nearest.
+ * <param>src</param> and <param>dst</param> may be the same.
+ *
+ * @param src pixels with straight alpha
+ * @param dst premultiplied pixels
+ * @param count number of pixels
+ */
+void javautil_pixel_premultiply(const unsigned int* src,
+                                unsigned int* dst, int count);
+
+/**
+ * Divides premultiplied ARGB8888 colors by their alpha, limiting them
+ * to 0xff.  Pixels with zero alpha become 0.
+ * <param>src</param> and <param>dst</param> may be the same.
+ *
+ * @param src premultiplied pixels
+ * @param dst pixels with straight alpha
+ * @param count number of pixels
+ */
+void javautil_pixel_unpremultiply(const unsigned int* src,
+                                  unsigned int* dst, int count);
+
+/**
+ * Swaps the bytes of 16-bit values in place.
+ *
+ * @param data values to swap, need not be aligned
+ * @param count number of values
+ */
+void javautil_pixel_byteswap16(void* data, int count);
+
+/**
+ * Swaps the bytes of 32-bit values in place.
+ *
+ * @param data values to swap, need not be aligned
+ * @param count number of values
+ */
+void javautil_pixel_byteswap32(void* data, int count);
+
+/**
+ * Computes a color keying mask: 0xff where a pixel has the key color,
+ * 0 elsewhere.
+ *
+ * @param src 16-bit pixels
+ * @param mask where to store one mask byte per pixel
+ * @param count number of pixels
+ * @param key the key color
+ */
+void javautil_pixel_key_mask16(const unsigned short* src,
+                               unsigned char* mask, int count,
+                               unsigned short key);
+
+/**
+ * Computes a color keying mask for 32-bit pixels, see
+ * javautil_pixel_key_mask16.
+ */
+void javautil_pixel_key_mask32(const unsigned int* src,
+                               unsigned char* mask, int count,
+                               unsigned int key);
+
+/**
+ * Copies the pixels whose mask byte is not 0, for example those where
+ * a color keying mask found the key color.
+ *
+ * @param src 16-bit pixels to copy
+ * @param mask one byte per pixel
+ * @param dst where to copy the pixels
+ * @param count number of pixels
+ */
+void javautil_pixel_copy_masked16(const unsigned short* src,
+                                  const unsigned char* mask,
+                                  unsigned short* dst, int count);
+
+/**
+ * Copies the 32-bit pixels whose mask byte is not 0, see
+ * javautil_pixel_copy_masked16.
+ */
+void javautil_pixel_copy_masked32(const unsigned int* src,
+                                  const unsigned char* mask,
+                                  unsigned int* dst, int count);
+
+/**
+ * Fills 16-bit pixels with a color.
+ *
+ * @param dst pixels to fill
+ * @param count number of pixels
+ * @param color the color
+ */
+void javautil_pixel_fill16(unsigned short* dst, int count,
+                           unsigned short color);
+
+/**
+ * Fills 32-bit pixels with a color, see javautil_pixel_fill16.
+ */
+void javautil_pixel_fill32(unsigned int* dst, int count, unsigned int color);
+
+/**
+ * Draws ARGB8888 pixels over RGB565 ones.  With a the source alpha,
+ * each component becomes (s * a + d * (255 - a)) / 255 rounded, d
+ * being the widened destination component, and is then narrowed.
+ *
+ * @param src ARGB8888 pixels, not premultiplied
+ * @param dst RGB565 pixels to draw over
+ * @param count number of pixels
+ */
+void javautil_pixel_blend_argb8888_to_rgb565(const unsigned int* src,
+                                             unsigned short* dst, int count);
+
+/**
+ * Draws ARGB8888 pixels over ARGB8888 ones, see
+ * javautil_pixel_blend_argb8888_to_rgb565.  The alpha becomes
+ * a + da * (255 - a) / 255 rounded, da being the destination alpha.
+ */
+void javautil_pixel_blend_argb8888_to_argb8888(const unsigned int* src,
+                                               unsigned int* dst, int count);
+
+/** Clockwise angles of javautil_pixel_rotate16 and rotate32 */
+#define JAVAUTIL_PIXEL_ROTATE_90    90
+#define JAVAUTIL_PIXEL_ROTATE_180   180
+#define JAVAUTIL_PIXEL_ROTATE_270   270
+
+/**
+ * Rotates a rectangle of 16-bit pixels clockwise.  The rectangle is
+ * rotated in square tiles, so that the reads and the writes across the
+ * rows of the destination both stay within a few cache lines.
+ *
+ * @param src top left pixel of the rectangle
+ * @param srcStride distance between the rows of src in pixels
+ * @param dst where the top left pixel of the rotated rectangle goes,
+ *            must not overlap src
+ * @param dstStride distance between the rows of dst in pixels
+ * @param width width of the rectangle in src
+ * @param height height of the rectangle in src; the rotated rectangle
+ *               is height pixels wide and width high for 90 and 270
+ * @param angle one of JAVAUTIL_PIXEL_ROTATE_*
+ */
+void javautil_pixel_rotate16(const unsigned short* src, int srcStride,
+                             unsigned short* dst, int dstStride,
+                             int width, int height, int angle);
+
+/**
+ * Rotates a rectangle of 32-bit pixels clockwise, see
+ * javautil_pixel_rotate16.
+ */
+void javautil_pixel_rotate32(const unsigned int* src, int srcStride,
+                             unsigned int* dst, int dstStride,
+                             int width, int height, int angle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _JAVAUTIL_PIXEL_H_ */
@@ -0,0 +1,417 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * Implementation of CRC-32 and Adler-32 checksums.
+ */
+
+#include "javautil_checksum.h"
+#include "javautil_cpu.h"
+
+/*
+ * CRC-32 implementations.  The table driven one is always available;
+ * the instruction based ones are compiled where the compiler can target
+ * them and are selected at runtime when the CPU supports them.
+ */
+#define CRC_IMPL_UNKNOWN    -1
+#define CRC_IMPL_TABLE      0
+#define CRC_IMPL_PCLMUL     1
+#define CRC_IMPL_ARMV8      2
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define CRC_PCLMUL
+#define CRC_PCLMUL_TARGET __attribute__((target("pclmul,sse4.1")))
+#include <wmmintrin.h>
+#include <smmintrin.h>
+#elif (defined(_M_X64) || defined(_M_IX86)) && defined(_MSC_VER) && _MSC_VER >= 1600
+#define CRC_PCLMUL
+#define CRC_PCLMUL_TARGET
+#include <wmmintrin.h>
+#include <smmintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define CRC_ARMV8
+#define CRC_ARMV8_TARGET
+#include <arm_acle.h>
+#elif defined(__aarch64__) && defined(__linux__) && !defined(__clang__) && __GNUC__ >= 6
+#define CRC_ARMV8
+#define CRC_ARMV8_TARGET __attribute__((target("+crc")))
+#include <arm_acle.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ADLER_SSE2
+#include <emmintrin.h>
+#endif
+
+static int crc_impl = CRC_IMPL_UNKNOWN;
+
+/* slice-by-8 tables; crc_table[0] is the classic byte-wise table */
+static unsigned int crc_table[8][256];
+static int crc_table_ready = 0;
+
+static void crc32_make_tables(void) {
+    unsigned int c;
+    int n, k;
+
+    for (n = 0; n < 256; n++) {
+        c = (unsigned int)n;
+        for (k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xedb88320U ^ (c >> 1) : c >> 1;
+        }
+        crc_table[0][n] = c;
+    }
+    for (n = 0; n < 256; n++) {
+        c = crc_table[0][n];
+        for (k = 1; k < 8; k++) {
+            c = crc_table[0][c & 0xff] ^ (c >> 8);
+            crc_table[k][n] = c;
+        }
+    }
+    crc_table_ready = 1;
+}
+
+static unsigned int crc32_slice8(unsigned int c,
+                                 const unsigned char* buf, long len) {
+    if (!crc_table_ready) {
+        crc32_make_tables();
+    }
+
+    while (len >= 8) {
+        c ^= (unsigned int)buf[0] | ((unsigned int)buf[1] << 8) |
+             ((unsigned int)buf[2] << 16) | ((unsigned int)buf[3] << 24);
+        c = crc_table[7][c & 0xff] ^ crc_table[6][(c >> 8) & 0xff] ^
+            crc_table[5][(c >> 16) & 0xff] ^ crc_table[4][c >> 24] ^
+            crc_table[3][buf[4]] ^ crc_table[2][buf[5]] ^
+            crc_table[1][buf[6]] ^ crc_table[0][buf[7]];
+        buf += 8;
+        len -= 8;
+    }
+    while (len-- > 0) {
+        c = crc_table[0][(c ^ *buf++) & 0xff] ^ (c >> 8);
+    }
+    return c;
+}
+
+#ifdef CRC_PCLMUL
+/*
+ * Folding with carry-less multiplication, after Intel's "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ * len must be at least 64 and a multiple of 16.
+ */
+CRC_PCLMUL_TARGET
+static unsigned int crc32_pclmul(unsigned int c,
+                                 const unsigned char* buf, long len) {
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+    const __m128i k1k2 = _mm_set_epi32(0x00000001, 0xc6e41596, 0x00000001, 0x54442bd4);
+    const __m128i k3k4 = _mm_set_epi32(0x00000000, 0xccaa009e, 0x00000001, 0x751997d0);
+    const __m128i k5k0 = _mm_set_epi32(0x00000000, 0x00000000, 0x00000001, 0x63cd6124);
+    const __m128i poly = _mm_set_epi32(0x00000001, 0xf7011641, 0x00000001, 0xdb710641);
+
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)c));
+    x0 = k1k2;
+    buf += 64;
+    len -= 64;
+
+    /* fold 4 x 128 bits in parallel */
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        buf += 64;
+        len -= 64;
+    }
+
+    /* fold into 128 bits */
+    x0 = k3k4;
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    /* fold 128 bits to 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = k5k0;
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = poly;
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (unsigned int)_mm_extract_epi32(x1, 1);
+}
+#endif /* CRC_PCLMUL */
+
+#ifdef CRC_ARMV8
+CRC_ARMV8_TARGET
+static unsigned int crc32_armv8(unsigned int c,
+                                const unsigned char* buf, long len) {
+    while (len > 0 && ((unsigned long)buf & 7) != 0) {
+        c = __crc32b(c, *buf++);
+        len--;
+    }
+    while (len >= 8) {
+        c = __crc32d(c, *(const unsigned long long*)buf);
+        buf += 8;
+        len -= 8;
+    }
+    while (len-- > 0) {
+        c = __crc32b(c, *buf++);
+    }
+    return c;
+}
+#endif /* CRC_ARMV8 */
+
+static int crc32_select(void) {
+#ifdef CRC_PCLMUL
+    if (javautil_cpu_has(JAVAUTIL_CPU_PCLMUL | JAVAUTIL_CPU_SSE41)) {
+        return CRC_IMPL_PCLMUL;
+    }
+#endif
+#ifdef CRC_ARMV8
+    if (javautil_cpu_has(JAVAUTIL_CPU_ARM_CRC32)) {
+        return CRC_IMPL_ARMV8;
+    }
+#endif
+    return CRC_IMPL_TABLE;
+}
+
+/**
+ * Updates a CRC-32 (ISO 3309, as used by PNG and zip) with a buffer.
+ *
+ * @param crc running CRC value, 0 to start a new checksum
+ * @param buf data to add
+ * @param len number of bytes in <param>buf</param>
+ * @return updated CRC value
+ */
+unsigned long javautil_crc32(unsigned long crc,
+                             const unsigned char* buf, long len) {
+    unsigned int c;
+
+    if (buf == NULL) {
+        return 0L;
+    }
+    if (crc_impl == CRC_IMPL_UNKNOWN) {
+        crc_impl = crc32_select();
+    }
+
+    c = (unsigned int)crc ^ 0xffffffffU;
+#ifdef CRC_PCLMUL
+    if (crc_impl == CRC_IMPL_PCLMUL && len >= 64) {
+        long n = len & ~15L;
+        c = crc32_pclmul(c, buf, n);
+        buf += n;
+        len -= n;
+    }
+#endif
+#ifdef CRC_ARMV8
+    if (crc_impl == CRC_IMPL_ARMV8) {
+        c = crc32_armv8(c, buf, len);
+        len = 0;
+    }
+#endif
+    c = crc32_slice8(c, buf, len);
+
+    return c ^ 0xffffffffU;
+}
+
+/*
+ * Adler-32.  The sums are reduced modulo BASE only every NMAX bytes,
+ * the largest n such that 255n(n+1)/2 + (n+1)(BASE-1) fits in 32 bits.
+ */
+#define BASE 65521UL    /* largest prime smaller than 65536 */
+#define NMAX 5552
+
+#define DO1(buf,i)  {s1 += buf[i]; s2 += s1;}
+#define DO2(buf,i)  DO1(buf,i); DO1(buf,i+1);
+#define DO4(buf,i)  DO2(buf,i); DO2(buf,i+2);
+#define DO8(buf,i)  DO4(buf,i); DO4(buf,i+4);
+#define DO16(buf)   DO8(buf,0); DO8(buf,8);
+
+#ifdef ADLER_SSE2
+static unsigned long adler32_hsum(__m128i v) {
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (unsigned int)_mm_cvtsi128_si32(v);
+}
+
+/*
+ * Add len bytes, a multiple of 16 and at most NMAX, to the unreduced
+ * sums.  Within a 16 byte chunk byte i weighs 16 - i in s2; each chunk
+ * also adds 16 times the byte sum of all chunks before it.
+ */
+static void adler32_sse2(unsigned long* a1, unsigned long* a2,
+                         const unsigned char* buf, long len) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w_lo = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+    const __m128i w_hi = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+    __m128i v_s1 = zero;
+    __m128i v_ps = zero;
+    __m128i v_s2 = zero;
+
+    *a2 += *a1 * (unsigned long)len;
+    while (len > 0) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)buf);
+        v_ps = _mm_add_epi32(v_ps, v_s1);
+        v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes, zero));
+        v_s2 = _mm_add_epi32(v_s2,
+                   _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), w_lo));
+        v_s2 = _mm_add_epi32(v_s2,
+                   _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), w_hi));
+        buf += 16;
+        len -= 16;
+    }
+    *a1 += adler32_hsum(v_s1);
+    *a2 += (adler32_hsum(v_ps) << 4) + adler32_hsum(v_s2);
+}
+#endif /* ADLER_SSE2 */
+
+/**
+ * Updates an Adler-32 (RFC 1950, as used by zlib streams) with a buffer.
+ *
+ * @param adler running Adler-32 value, 1 to start a new checksum
+ * @param buf data to add
+ * @param len number of bytes in <param>buf</param>
+ * @return updated Adler-32 value
+ */
+unsigned long javautil_adler32(unsigned long adler,
+                               const unsigned char* buf, long len) {
+    unsigned long s1 = adler & 0xffff;
+    unsigned long s2 = (adler >> 16) & 0xffff;
+    long n;
+#ifdef ADLER_SSE2
+    javacall_bool sse2 = javautil_cpu_has(JAVAUTIL_CPU_SSE2);
+#endif
+
+    if (buf == NULL) {
+        return 1L;
+    }
+
+    while (len > 0) {
+        n = len < NMAX ? len : NMAX;
+        len -= n;
+#ifdef ADLER_SSE2
+        if (sse2 && n >= 16) {
+            long m = n & ~15L;
+            adler32_sse2(&s1, &s2, buf, m);
+            buf += m;
+            n -= m;
+        }
+#endif
+        while (n >= 16) {
+            DO16(buf);
+            buf += 16;
+            n -= 16;
+        }
+        while (n-- > 0) {
+            s1 += *buf++;
+            s2 += s1;
+        }
+        s1 %= BASE;
+        s2 %= BASE;
+    }
+
+    return (s2 << 16) | s1;
+}
+
+/**
+ * Combines the Adler-32 of two consecutive buffers.
+ *
+ * @param adler1 Adler-32 of the first buffer
+ * @param adler2 Adler-32 of the second buffer
+ * @param len2 length of the second buffer
+ * @return Adler-32 of both buffers in sequence
+ */
+unsigned long javautil_adler32_combine(unsigned long adler1,
+                                       unsigned long adler2, long len2) {
+    /*
+     * Appending len2 bytes adds len2 * s1 of the first buffer to s2;
+     * the -1 and BASE terms drop the initial 1 of the second sum.
+     */
+    unsigned long rem = (unsigned long)(len2 % (long)BASE);
+    unsigned long s1 = adler1 & 0xffff;
+    unsigned long s2 = (rem * s1) % BASE;
+
+    s1 += (adler2 & 0xffff) + BASE - 1;
+    s2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + BASE - rem;
+    if (s1 >= BASE) {
+        s1 -= BASE;
+    }
+    if (s1 >= BASE) {
+        s1 -= BASE;
+    }
+    if (s2 >= (BASE << 1)) {
+        s2 -= (BASE << 1);
+    }
+    if (s2 >= BASE) {
+        s2 -= BASE;
+    }
+
+    return (s2 << 16) | s1;
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * Implementation of CPU feature detection.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "javautil_cpu.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_X86
+#include <cpuid.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#define CPU_X86
+#include <intrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+#define CPU_ARM_HWCAP
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
+/* environment variable capping the features */
+#define CPU_ENV "JAVACALL_CPU"
+
+#define CPU_LEVEL_SSE42 (JAVAUTIL_CPU_SSE2 | JAVAUTIL_CPU_SSSE3 | \
+                         JAVAUTIL_CPU_SSE41 | JAVAUTIL_CPU_SSE42 | \
+                         JAVAUTIL_CPU_PCLMUL)
+
+static const struct {
+    const char* name;
+    unsigned int features;
+} cpu_levels[] = {
+    { "none",   0 },
+    { "sse2",   JAVAUTIL_CPU_SSE2 },
+    { "sse4.2", CPU_LEVEL_SSE42 },
+    { "avx2",   CPU_LEVEL_SSE42 | JAVAUTIL_CPU_AVX | JAVAUTIL_CPU_AVX2 },
+    { "neon",   JAVAUTIL_CPU_NEON | JAVAUTIL_CPU_ARM_CRC32 }
+};
+
+/*
+ * Set once, normally before any thread uses them.  A thread racing the
+ * first probe sees no features at worst and runs the C code.
+ */
+static unsigned int cpu_features = 0;
+static int cpu_ready = 0;
+
+#ifdef CPU_X86
+
+static void cpu_id(unsigned int leaf, unsigned int* r) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, (int)leaf, 0);
+    r[0] = (unsigned int)info[0];
+    r[1] = (unsigned int)info[1];
+    r[2] = (unsigned int)info[2];
+    r[3] = (unsigned int)info[3];
+#else
+    __cpuid_count(leaf, 0, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+/* The register state the OS saves on context switches */
+static unsigned int cpu_xcr0(void) {
+#if defined(_MSC_VER) && _MSC_FULL_VER >= 160040219
+    return (unsigned int)_xgetbv(0);
+#elif defined(_MSC_VER)
+    return 0;
+#else
+    unsigned int eax, edx;
+    __asm__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+    return eax;
+#endif
+}
+
+static unsigned int cpu_probe(void) {
+    unsigned int r[4];
+    unsigned int max;
+    unsigned int f = 0;
+
+    cpu_id(0, r);
+    max = r[0];
+    if (max < 1) {
+        return 0;
+    }
+    cpu_id(1, r);
+    if (r[3] & (1u << 26)) {
+        f |= JAVAUTIL_CPU_SSE2;
+    }
+    if (r[2] & (1u << 9)) {
+        f |= JAVAUTIL_CPU_SSSE3;
+    }
+    if (r[2] & (1u << 19)) {
+        f |= JAVAUTIL_CPU_SSE41;
+    }
+    if (r[2] & (1u << 20)) {
+        f |= JAVAUTIL_CPU_SSE42;
+    }
+    if (r[2] & (1u << 1)) {
+        f |= JAVAUTIL_CPU_PCLMUL;
+    }
+    /* AVX needs OSXSAVE and the OS saving the SSE and AVX registers */
+    if ((r[2] & (1u << 27)) && (r[2] & (1u << 28)) &&
+        (cpu_xcr0() & 6) == 6) {
+        f |= JAVAUTIL_CPU_AVX;
+        if (max >= 7) {
+            cpu_id(7, r);
+            if (r[1] & (1u << 5)) {
+                f |= JAVAUTIL_CPU_AVX2;
+            }
+        }
+    }
+    return f;
+}
+
+#else /* !CPU_X86 */
+
+static unsigned int cpu_probe(void) {
+    unsigned int f = 0;
+
+#if defined(__aarch64__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+    f |= JAVAUTIL_CPU_NEON;
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+    f |= JAVAUTIL_CPU_ARM_CRC32;
+#elif defined(CPU_ARM_HWCAP)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        f |= JAVAUTIL_CPU_ARM_CRC32;
+    }
+#endif
+    return f;
+}
+
+#endif /* CPU_X86 */
+
+/* Features allowed by the environment, all if it does not say */
+static unsigned int cpu_allowed(void) {
+#if !defined(UNDER_CE) && !defined(_WIN32_WCE)
+    const char* level = getenv(CPU_ENV);
+    unsigned int i;
+
+    if (level != NULL) {
+        for (i = 0; i < sizeof(cpu_levels) / sizeof(cpu_levels[0]); i++) {
+            if (strcmp(level, cpu_levels[i].name) == 0) {
+                return cpu_levels[i].features;
+            }
+        }
+    }
+#endif
+    return ~0u;
+}
+
+/**
+ * Probes the CPU and applies the JAVACALL_CPU environment variable.
+ */
+void javautil_cpu_init(void) {
+    cpu_features = cpu_probe() & cpu_allowed();
+    cpu_ready = 1;
+}
+
+/**
+ * Returns the features of the CPU.
+ *
+ * @return JAVAUTIL_CPU_* flags
+ */
+unsigned int javautil_cpu_features(void) {
+    if (!cpu_ready) {
+        javautil_cpu_init();
+    }
+    return cpu_features;
+}
+
+/**
+ * Checks for CPU features.
+ *
+ * @param features JAVAUTIL_CPU_* flags
+ * @return <tt>JAVACALL_TRUE</tt> if the CPU has all of
+ *         <param>features</param>, <tt>JAVACALL_FALSE</tt> otherwise
+ */
+javacall_bool javautil_cpu_has(unsigned int features) {
+    return (javautil_cpu_features() & features) == features ?
+        JAVACALL_TRUE : JAVACALL_FALSE;
+}
@@ -0,0 +1,327 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * Implementation of the decoded image cache.
+ */
+
+#include <string.h>
+#include "javacall_memory.h"
+#include "javautil_image_cache.h"
+
+/*
+ * Content hash.  64-bit multiply and rotate rounds on four independent
+ * lanes, in the manner of xxHash64; the value is only compared within
+ * the process, so words are read in native byte order.
+ */
+#define HASH_U64(hi, lo)    (((javacall_uint64)(hi) << 32) | (lo))
+#define HASH_P1             HASH_U64(0x9E3779B1, 0x85EBCA87)
+#define HASH_P2             HASH_U64(0xC2B2AE3D, 0x27D4EB4F)
+#define HASH_P3             HASH_U64(0x165667B1, 0x9E3779F9)
+#define HASH_P4             HASH_U64(0x85EBCA77, 0xC2B2AE63)
+#define HASH_P5             HASH_U64(0x27D4EB2F, 0x165667C5)
+
+#define ROTL64(v, r)        (((v) << (r)) | ((v) >> (64 - (r))))
+
+static javacall_uint64 hash_read64(const unsigned char* p) {
+    javacall_uint64 v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static javacall_uint64 hash_round(javacall_uint64 acc, javacall_uint64 v) {
+    acc += v * HASH_P2;
+    acc = ROTL64(acc, 31);
+    return acc * HASH_P1;
+}
+
+static javacall_uint64 hash_merge(javacall_uint64 h, javacall_uint64 v) {
+    h ^= hash_round(0, v);
+    return h * HASH_P1 + HASH_P4;
+}
+
+static javacall_uint64 content_hash(const unsigned char* p, long len) {
+    const unsigned char* end = p + len;
+    javacall_uint64 h;
+
+    if (len >= 32) {
+        javacall_uint64 v1 = HASH_P1 + HASH_P2;
+        javacall_uint64 v2 = HASH_P2;
+        javacall_uint64 v3 = 0;
+        javacall_uint64 v4 = 0 - HASH_P1;
+
+        do {
+            v1 = hash_round(v1, hash_read64(p));
+            v2 = hash_round(v2, hash_read64(p + 8));
+            v3 = hash_round(v3, hash_read64(p + 16));
+            v4 = hash_round(v4, hash_read64(p + 24));
+            p += 32;
+        } while (end - p >= 32);
+
+        h = ROTL64(v1, 1) + ROTL64(v2, 7) + ROTL64(v3, 12) + ROTL64(v4, 18);
+        h = hash_merge(h, v1);
+        h = hash_merge(h, v2);
+        h = hash_merge(h, v3);
+        h = hash_merge(h, v4);
+    } else {
+        h = HASH_P5;
+    }
+    h += (javacall_uint64)len;
+
+    for (; end - p >= 8; p += 8) {
+        h ^= hash_round(0, hash_read64(p));
+        h = ROTL64(h, 27) * HASH_P1 + HASH_P4;
+    }
+    for (; p < end; p++) {
+        h ^= *p * HASH_P5;
+        h = ROTL64(h, 11) * HASH_P1;
+    }
+
+    h ^= h >> 33;
+    h *= HASH_P2;
+    h ^= h >> 29;
+    h *= HASH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+/*
+ * Cache.  Each image is one allocation: the node followed by the pixels,
+ * the alpha and a copy of the encoded bytes.  Nodes are chained in hash
+ * buckets and in a list from the most to the least recently used.
+ */
+#define CACHE_BUCKETS   256
+
+typedef struct _cache_node {
+    javautil_image_cache_entry entry;   /* first, entries are nodes */
+    javautil_image_cache_key key;       /* source is the copy below */
+    long bytes;                         /* size of the allocation */
+    int refs;                           /* lookups not yet released */
+    struct _cache_node* hashNext;
+    struct _cache_node* lruPrev;        /* more recently used */
+    struct _cache_node* lruNext;        /* less recently used */
+} cache_node;
+
+static cache_node* cache_buckets[CACHE_BUCKETS];
+static cache_node* cache_lru_head = NULL;
+static cache_node* cache_lru_tail = NULL;
+static javautil_image_cache_stats cache_stats = {
+    0, 0, 0, 0, 0, JAVAUTIL_IMAGE_CACHE_DEFAULT_BUDGET
+};
+
+static cache_node** cache_bucket(const javautil_image_cache_key* key) {
+    return &cache_buckets[(unsigned int)key->hash & (CACHE_BUCKETS - 1)];
+}
+
+static cache_node* cache_find(const javautil_image_cache_key* key) {
+    cache_node* node;
+
+    for (node = *cache_bucket(key); node != NULL; node = node->hashNext) {
+        if (node->key.hash == key->hash &&
+            node->key.sourceSize == key->sourceSize &&
+            node->key.format == key->format &&
+            node->key.width == key->width &&
+            node->key.height == key->height &&
+            memcmp(node->key.source, key->source, key->sourceSize) == 0) {
+            /* the hash is public, only the bytes prove a match */
+            return node;
+        }
+    }
+    return NULL;
+}
+
+static void cache_lru_unlink(cache_node* node) {
+    if (node->lruPrev != NULL) {
+        node->lruPrev->lruNext = node->lruNext;
+    } else {
+        cache_lru_head = node->lruNext;
+    }
+    if (node->lruNext != NULL) {
+        node->lruNext->lruPrev = node->lruPrev;
+    } else {
+        cache_lru_tail = node->lruPrev;
+    }
+}
+
+static void cache_lru_push(cache_node* node) {
+    node->lruPrev = NULL;
+    node->lruNext = cache_lru_head;
+    if (cache_lru_head != NULL) {
+        cache_lru_head->lruPrev = node;
+    } else {
+        cache_lru_tail = node;
+    }
+    cache_lru_head = node;
+}
+
+static void cache_remove(cache_node* node) {
+    cache_node** link = cache_bucket(&node->key);
+
+    while (*link != node) {
+        link = &(*link)->hashNext;
+    }
+    *link = node->hashNext;
+    cache_lru_unlink(node);
+    cache_stats.entries--;
+    cache_stats.bytes -= node->bytes;
+    javacall_free(node);
+}
+
+/* Evict images not in use, least recently used first, down to limit */
+static void cache_evict(long limit) {
+    cache_node* node = cache_lru_tail;
+
+    while (node != NULL && cache_stats.bytes > limit) {
+        cache_node* prev = node->lruPrev;
+        if (node->refs == 0) {
+            cache_remove(node);
+            cache_stats.evictions++;
+        }
+        node = prev;
+    }
+}
+
+void javautil_image_cache_key_init(javautil_image_cache_key* key,
+                                   const void* source, long sourceSize,
+                                   int format, long width, long height) {
+    key->hash = content_hash((const unsigned char*)source, sourceSize);
+    key->source = source;
+    key->sourceSize = sourceSize;
+    key->format = format;
+    key->width = width;
+    key->height = height;
+}
+
+const javautil_image_cache_entry* javautil_image_cache_lookup(
+        const javautil_image_cache_key* key) {
+    cache_node* node = cache_find(key);
+
+    if (node == NULL) {
+        cache_stats.misses++;
+        return NULL;
+    }
+    cache_stats.hits++;
+    node->refs++;
+    if (node != cache_lru_head) {
+        cache_lru_unlink(node);
+        cache_lru_push(node);
+    }
+    return &node->entry;
+}
+
+void javautil_image_cache_release(const javautil_image_cache_entry* entry) {
+    cache_node* node = (cache_node*)entry;
+
+    if (node == NULL) {
+        return;
+    }
+    node->refs--;
+    if (node->refs == 0 && cache_stats.bytes > cache_stats.budget) {
+        cache_evict(cache_stats.budget);
+    }
+}
+
+javacall_result javautil_image_cache_insert(
+        const javautil_image_cache_key* key,
+        const void* pixels, long pixelsSize,
+        const unsigned char* alpha, long alphaSize) {
+    cache_node* node;
+    cache_node** bucket;
+    unsigned char* data;
+    long bytes;
+    long i;
+
+    if (cache_find(key) != NULL) {
+        return JAVACALL_OK;
+    }
+
+    /* keep no alpha for opaque images */
+    i = 0;
+    if (alpha != NULL) {
+        while (i < alphaSize && alpha[i] == 0xFF) {
+            i++;
+        }
+    }
+    if (alpha == NULL || i == alphaSize) {
+        alpha = NULL;
+        alphaSize = 0;
+    }
+
+    bytes = (long)sizeof(cache_node) + pixelsSize + alphaSize +
+            key->sourceSize;
+    if (bytes > cache_stats.budget) {
+        return JAVACALL_FAIL;
+    }
+    cache_evict(cache_stats.budget - bytes);
+    if (cache_stats.bytes + bytes > cache_stats.budget) {
+        return JAVACALL_FAIL;
+    }
+    node = (cache_node*)javacall_malloc(bytes);
+    if (node == NULL) {
+        return JAVACALL_FAIL;
+    }
+
+    data = (unsigned char*)(node + 1);
+    memcpy(data, pixels, pixelsSize);
+    node->entry.pixels = data;
+    node->entry.pixelsSize = pixelsSize;
+    if (alpha != NULL) {
+        memcpy(data + pixelsSize, alpha, alphaSize);
+        node->entry.alpha = data + pixelsSize;
+    } else {
+        node->entry.alpha = NULL;
+    }
+    node->entry.alphaSize = alphaSize;
+    node->key = *key;
+    node->key.source = data + pixelsSize + alphaSize;
+    memcpy(data + pixelsSize + alphaSize, key->source, key->sourceSize);
+    node->bytes = bytes;
+    node->refs = 0;
+
+    bucket = cache_bucket(key);
+    node->hashNext = *bucket;
+    *bucket = node;
+    cache_lru_push(node);
+    cache_stats.entries++;
+    cache_stats.bytes += bytes;
+    return JAVACALL_OK;
+}
+
+void javautil_image_cache_set_budget(long bytes) {
+    cache_stats.budget = bytes > 0 ? bytes : 0;
+    cache_evict(cache_stats.budget);
+}
+
+void javautil_image_cache_clear(void) {
+    cache_evict(-1);
+    cache_stats.hits = 0;
+    cache_stats.misses = 0;
+    cache_stats.evictions = 0;
+}
+
+void javautil_image_cache_get_stats(javautil_image_cache_stats* stats) {
+    *stats = cache_stats;
+}
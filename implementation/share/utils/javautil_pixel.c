@@ -0,0 +1,1132 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * Implementation of pixel format conversions.
+ */
+
+#include <string.h>
+#include "javautil_cpu.h"
+#include "javautil_pixel.h"
+#include "javautil_pixel_kernels.h"
+
+/*
+ * SSE2 and NEON kernels are compiled where they are part of the target,
+ * the AVX2 ones in javautil_pixel_avx2.c.  The kernels of the best
+ * implementation the CPU supports are installed in a table by
+ * javautil_pixel_init; see javautil_pixel_kernels.h.
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXEL_SSE2
+#include <emmintrin.h>
+#endif
+
+/* javautil_pixel_avx2.c has kernels if the build targets it for AVX2 */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PIXEL_AVX2
+#endif
+
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(__ARM_BIG_ENDIAN)
+#define PIXEL_NEON
+#include <arm_neon.h>
+#endif
+
+#define PIXEL_IMPL_UNKNOWN  -1
+
+static int pixel_impl = PIXEL_IMPL_UNKNOWN;
+static javautil_pixel_kernels pixel_kernels;
+
+/* 255 / alpha in 16.16 fixed point */
+static unsigned int unpremultiply_table[256];
+
+#define RGB565_R(p)     ((((p) >> 8) & 0xf8) | (((p) >> 13) & 0x07))
+#define RGB565_G(p)     ((((p) >> 3) & 0xfc) | (((p) >> 9) & 0x03))
+#define RGB565_B(p)     ((((p) << 3) & 0xf8) | (((p) >> 2) & 0x07))
+
+#define RGB_TO_565(r, g, b) \
+    ((unsigned short)((((r) & 0xf8) << 8) | (((g) & 0xfc) << 3) | ((b) >> 3)))
+
+#define ARGB_TO_565(p) \
+    ((unsigned short)((((p) >> 8) & 0xf800) | (((p) >> 5) & 0x07e0) | \
+                      (((p) >> 3) & 0x001f)))
+
+static unsigned int premultiply(unsigned int p) {
+    unsigned int a = p >> 24;
+    /* c * a / 255 rounded, for red and blue then green */
+    unsigned int rb = (p & 0x00ff00ff) * a + 0x00800080;
+    unsigned int g = (p & 0x0000ff00) * a + 0x00008000;
+
+    rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+    g = ((g + ((g >> 8) & 0x0000ff00)) >> 8) & 0x0000ff00;
+    return (a << 24) | rb | g;
+}
+
+/* t / 255 rounded, for t up to 255 * 255 */
+static unsigned int div255(unsigned int t) {
+    t += 0x80;
+    return (t + (t >> 8)) >> 8;
+}
+
+static unsigned int unpremultiply(unsigned int p) {
+    unsigned int a = p >> 24;
+    unsigned int m, r, g, b;
+
+    if (a == 0xff) {
+        return p;
+    }
+    if (a == 0) {
+        return 0;
+    }
+    m = unpremultiply_table[a];
+    r = (((p >> 16) & 0xff) * m + 0x8000) >> 16;
+    g = (((p >> 8) & 0xff) * m + 0x8000) >> 16;
+    b = ((p & 0xff) * m + 0x8000) >> 16;
+    return (a << 24) | ((r > 0xff ? 0xff : r) << 16) |
+           ((g > 0xff ? 0xff : g) << 8) | (b > 0xff ? 0xff : b);
+}
+
+#ifdef PIXEL_SSE2
+
+#define LOAD(p)     _mm_loadu_si128((const __m128i*)(p))
+#define STORE(p, v) _mm_storeu_si128((__m128i*)(p), v)
+
+/* 
+ * 8 RGB565 pixels widened to 8-bit components in 16-bit lanes
+ */
+static void expand565_sse2(__m128i v, __m128i* r, __m128i* g, __m128i* b) {
+    const __m128i m5 = _mm_set1_epi16(0x1f);
+    const __m128i m6 = _mm_set1_epi16(0x3f);
+    __m128i t;
+
+    t = _mm_srli_epi16(v, 11);
+    *r = _mm_or_si128(_mm_slli_epi16(t, 3), _mm_srli_epi16(t, 2));
+    t = _mm_and_si128(_mm_srli_epi16(v, 5), m6);
+    *g = _mm_or_si128(_mm_slli_epi16(t, 2), _mm_srli_epi16(t, 4));
+    t = _mm_and_si128(v, m5);
+    *b = _mm_or_si128(_mm_slli_epi16(t, 3), _mm_srli_epi16(t, 2));
+}
+
+/* 4 ARGB8888 pixels to RGB565, sign extended in 32-bit lanes for packing */
+static __m128i pack565_sse2(__m128i p) {
+    __m128i v = _mm_or_si128(
+        _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xf800)),
+                     _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x07e0))),
+        _mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x001f)));
+    return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+static int rgb565_to_argb8888_sse2(const unsigned short* src,
+                                   const unsigned char* alpha,
+                                   unsigned int* dst, int i, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = _mm_set1_epi16(0xff);
+    __m128i r, g, b, lo, hi;
+
+    for (; i + 8 <= count; i += 8) {
+        expand565_sse2(LOAD(src + i), &r, &g, &b);
+        if (alpha != NULL) {
+            a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(alpha + i)),
+                                  zero);
+        }
+        /* each 32-bit pixel is G:B in its low and A:R in its high half */
+        lo = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+        hi = _mm_or_si128(_mm_slli_epi16(a, 8), r);
+        STORE(dst + i, _mm_unpacklo_epi16(lo, hi));
+        STORE(dst + i + 4, _mm_unpackhi_epi16(lo, hi));
+    }
+    return i;
+}
+
+static int argb8888_to_rgb565_sse2(const unsigned int* src,
+                                   unsigned short* dst,
+                                   unsigned char* alpha, int i, int count) {
+    __m128i p0, p1, a;
+
+    for (; i + 8 <= count; i += 8) {
+        p0 = LOAD(src + i);
+        p1 = LOAD(src + i + 4);
+        STORE(dst + i, _mm_packs_epi32(pack565_sse2(p0), pack565_sse2(p1)));
+        if (alpha != NULL) {
+            a = _mm_packs_epi32(_mm_srli_epi32(p0, 24), _mm_srli_epi32(p1, 24));
+            _mm_storel_epi64((__m128i*)(alpha + i), _mm_packus_epi16(a, a));
+        }
+    }
+    return i;
+}
+
+static int argb8888_to_alpha_sse2(const unsigned int* src,
+                                  unsigned char* alpha, int i, int count) {
+    __m128i a0, a1;
+
+    for (; i + 16 <= count; i += 16) {
+        a0 = _mm_packs_epi32(_mm_srli_epi32(LOAD(src + i), 24),
+                             _mm_srli_epi32(LOAD(src + i + 4), 24));
+        a1 = _mm_packs_epi32(_mm_srli_epi32(LOAD(src + i + 8), 24),
+                             _mm_srli_epi32(LOAD(src + i + 12), 24));
+        STORE(alpha + i, _mm_packus_epi16(a0, a1));
+    }
+    return i;
+}
+
+/* 2 pixels in 16-bit lanes; alpha is multiplied by 255 to keep it */
+static __m128i premultiply2_sse2(__m128i p) {
+    const __m128i keep = _mm_set_epi16(0xff, 0, 0, 0, 0xff, 0, 0, 0);
+    const __m128i colors = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, 0xff), 0xff);
+
+    a = _mm_or_si128(_mm_and_si128(a, colors), keep);
+    p = _mm_add_epi16(_mm_mullo_epi16(p, a), _mm_set1_epi16(0x80));
+    return _mm_srli_epi16(_mm_add_epi16(p, _mm_srli_epi16(p, 8)), 8);
+}
+
+static int premultiply_sse2(const unsigned int* src, unsigned int* dst,
+                            int i, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i p;
+
+    for (; i + 4 <= count; i += 4) {
+        p = LOAD(src + i);
+        STORE(dst + i, 
+              _mm_packus_epi16(premultiply2_sse2(_mm_unpacklo_epi8(p, zero)),
+                               premultiply2_sse2(_mm_unpackhi_epi8(p, zero))));
+    }
+    return i;
+}
+
+static int byteswap16_sse2(unsigned char* data, int i, int count) {
+    __m128i v;
+
+    for (; i + 8 <= count; i += 8) {
+        v = LOAD(data + 2 * i);
+        STORE(data + 2 * i, _mm_or_si128(_mm_slli_epi16(v, 8), 
+                                         _mm_srli_epi16(v, 8)));
+    }
+    return i;
+}
+
+static int byteswap32_sse2(unsigned char* data, int i, int count) {
+    __m128i v;
+
+    for (; i + 4 <= count; i += 4) {
+        v = LOAD(data + 4 * i);
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xb1), 0xb1);
+        STORE(data + 4 * i, _mm_or_si128(_mm_slli_epi16(v, 8), 
+                                         _mm_srli_epi16(v, 8)));
+    }
+    return i;
+}
+
+static int key_mask16_sse2(const unsigned short* src, unsigned char* mask,
+                           int i, int count, unsigned short key) {
+    const __m128i k = _mm_set1_epi16((short)key);
+
+    for (; i + 16 <= count; i += 16) {
+        STORE(mask + i, _mm_packs_epi16(_mm_cmpeq_epi16(LOAD(src + i), k),
+                                        _mm_cmpeq_epi16(LOAD(src + i + 8), k)));
+    }
+    return i;
+}
+
+static int key_mask32_sse2(const unsigned int* src, unsigned char* mask,
+                           int i, int count, unsigned int key) {
+    const __m128i k = _mm_set1_epi32((int)key);
+    __m128i m0, m1;
+
+    for (; i + 16 <= count; i += 16) {
+        m0 = _mm_packs_epi32(_mm_cmpeq_epi32(LOAD(src + i), k),
+                             _mm_cmpeq_epi32(LOAD(src + i + 4), k));
+        m1 = _mm_packs_epi32(_mm_cmpeq_epi32(LOAD(src + i + 8), k),
+                             _mm_cmpeq_epi32(LOAD(src + i + 12), k));
+        STORE(mask + i, _mm_packs_epi16(m0, m1));
+    }
+    return i;
+}
+
+static int copy_masked16_sse2(const unsigned short* src,
+                              const unsigned char* mask,
+                              unsigned short* dst, int i, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i m;
+
+    for (; i + 8 <= count; i += 8) {
+        /* all ones where the mask byte is 0, i.e. where dst stays */
+        m = _mm_cmpeq_epi8(_mm_loadl_epi64((const __m128i*)(mask + i)), zero);
+        m = _mm_unpacklo_epi8(m, m);
+        STORE(dst + i, _mm_or_si128(_mm_and_si128(m, LOAD(dst + i)),
+                                    _mm_andnot_si128(m, LOAD(src + i))));
+    }
+    return i;
+}
+
+static int copy_masked32_sse2(const unsigned int* src,
+                              const unsigned char* mask,
+                              unsigned int* dst, int i, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i m;
+    int bits;
+
+    for (; i + 4 <= count; i += 4) {
+        memcpy(&bits, mask + i, 4);
+        m = _mm_cmpeq_epi8(_mm_cvtsi32_si128(bits), zero);
+        m = _mm_unpacklo_epi8(m, m);
+        m = _mm_unpacklo_epi16(m, m);
+        STORE(dst + i, _mm_or_si128(_mm_and_si128(m, LOAD(dst + i)),
+                                    _mm_andnot_si128(m, LOAD(src + i))));
+    }
+    return i;
+}
+
+static int fill16_sse2(unsigned short* dst, int i, int count, 
+                       unsigned short color) {
+    const __m128i v = _mm_set1_epi16((short)color);
+
+    for (; i + 8 <= count; i += 8) {
+        STORE(dst + i, v);
+    }
+    return i;
+}
+
+static int fill32_sse2(unsigned int* dst, int i, int count, 
+                       unsigned int color) {
+    const __m128i v = _mm_set1_epi32((int)color);
+
+    for (; i + 4 <= count; i += 4) {
+        STORE(dst + i, v);
+    }
+    return i;
+}
+
+/* (s * a + d * na) / 255 rounded on 16-bit lanes, na being 255 - a */
+static __m128i blend_sse2(__m128i s, __m128i d, __m128i a, __m128i na) {
+    __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a),
+                                            _mm_mullo_epi16(d, na)),
+                              _mm_set1_epi16(0x80));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static int blend_argb8888_to_rgb565_sse2(const unsigned int* src,
+                                         unsigned short* dst,
+                                         int i, int count) {
+    const __m128i m8 = _mm_set1_epi32(0xff);
+    const __m128i k255 = _mm_set1_epi16(0xff);
+    __m128i s0, s1, a, na, r, g, b, dr, dg, db;
+
+    for (; i + 8 <= count; i += 8) {
+        s0 = LOAD(src + i);
+        s1 = LOAD(src + i + 4);
+        a = _mm_packs_epi32(_mm_srli_epi32(s0, 24), _mm_srli_epi32(s1, 24));
+        r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(s0, 16), m8),
+                            _mm_and_si128(_mm_srli_epi32(s1, 16), m8));
+        g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(s0, 8), m8),
+                            _mm_and_si128(_mm_srli_epi32(s1, 8), m8));
+        b = _mm_packs_epi32(_mm_and_si128(s0, m8), _mm_and_si128(s1, m8));
+        na = _mm_sub_epi16(k255, a);
+        expand565_sse2(LOAD(dst + i), &dr, &dg, &db);
+        r = blend_sse2(r, dr, a, na);
+        g = blend_sse2(g, dg, a, na);
+        b = blend_sse2(b, db, a, na);
+        STORE(dst + i, _mm_or_si128(
+            _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(r, 3), 11),
+                         _mm_slli_epi16(_mm_srli_epi16(g, 2), 5)),
+            _mm_srli_epi16(b, 3)));
+    }
+    return i;
+}
+
+static int blend_argb8888_to_argb8888_sse2(const unsigned int* src,
+                                           unsigned int* dst,
+                                           int i, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i k255 = _mm_set1_epi16(0xff);
+    /* the alpha lanes, blended as a source component of 255 */
+    const __m128i alpha = _mm_set_epi16(0xff, 0, 0, 0, 0xff, 0, 0, 0);
+    __m128i s, d, a, lo, hi;
+
+    for (; i + 4 <= count; i += 4) {
+        s = LOAD(src + i);
+        d = LOAD(dst + i);
+        lo = _mm_unpacklo_epi8(s, zero);
+        a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xff), 0xff);
+        lo = blend_sse2(_mm_or_si128(lo, alpha), _mm_unpacklo_epi8(d, zero),
+                        a, _mm_sub_epi16(k255, a));
+        hi = _mm_unpackhi_epi8(s, zero);
+        a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xff), 0xff);
+        hi = blend_sse2(_mm_or_si128(hi, alpha), _mm_unpackhi_epi8(d, zero),
+                        a, _mm_sub_epi16(k255, a));
+        STORE(dst + i, _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+/* Transpose 8 rows of 8 16-bit pixels into 8 columns */
+static void transpose8x8_sse2(__m128i* r) {
+    __m128i a0, a1, a2, a3, a4, a5, a6, a7;
+    __m128i b0, b1, b2, b3, b4, b5, b6, b7;
+
+    a0 = _mm_unpacklo_epi16(r[0], r[1]);
+    a1 = _mm_unpackhi_epi16(r[0], r[1]);
+    a2 = _mm_unpacklo_epi16(r[2], r[3]);
+    a3 = _mm_unpackhi_epi16(r[2], r[3]);
+    a4 = _mm_unpacklo_epi16(r[4], r[5]);
+    a5 = _mm_unpackhi_epi16(r[4], r[5]);
+    a6 = _mm_unpacklo_epi16(r[6], r[7]);
+    a7 = _mm_unpackhi_epi16(r[6], r[7]);
+    b0 = _mm_unpacklo_epi32(a0, a2);
+    b1 = _mm_unpackhi_epi32(a0, a2);
+    b2 = _mm_unpacklo_epi32(a1, a3);
+    b3 = _mm_unpackhi_epi32(a1, a3);
+    b4 = _mm_unpacklo_epi32(a4, a6);
+    b5 = _mm_unpackhi_epi32(a4, a6);
+    b6 = _mm_unpacklo_epi32(a5, a7);
+    b7 = _mm_unpackhi_epi32(a5, a7);
+    r[0] = _mm_unpacklo_epi64(b0, b4);
+    r[1] = _mm_unpackhi_epi64(b0, b4);
+    r[2] = _mm_unpacklo_epi64(b1, b5);
+    r[3] = _mm_unpackhi_epi64(b1, b5);
+    r[4] = _mm_unpacklo_epi64(b2, b6);
+    r[5] = _mm_unpackhi_epi64(b2, b6);
+    r[6] = _mm_unpacklo_epi64(b3, b7);
+    r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+/*
+ * Rotate 8x8 tiles.  For 90 degrees the rows are loaded bottom up so
+ * that the transposed columns come out reversed as they must.
+ */
+static int rotate16_sse2(const unsigned short* src, int srcStride,
+                         unsigned short* dst, int dstStride,
+                         int i, int count, int angle) {
+    __m128i r[8], v;
+    int j;
+
+    for (; i + 8 <= count; i += 8) {
+        switch (angle) {
+        case JAVAUTIL_PIXEL_ROTATE_90:
+            for (j = 0; j < 8; j++) {
+                r[j] = LOAD(src + (7 - j) * srcStride + i);
+            }
+            transpose8x8_sse2(r);
+            for (j = 0; j < 8; j++) {
+                STORE(dst + (i + j) * dstStride - 7, r[j]);
+            }
+            break;
+        case JAVAUTIL_PIXEL_ROTATE_270:
+            for (j = 0; j < 8; j++) {
+                r[j] = LOAD(src + j * srcStride + i);
+            }
+            transpose8x8_sse2(r);
+            for (j = 0; j < 8; j++) {
+                STORE(dst - (i + j) * dstStride, r[j]);
+            }
+            break;
+        case JAVAUTIL_PIXEL_ROTATE_180:
+            for (j = 0; j < 8; j++) {
+                v = LOAD(src + j * srcStride + i);
+                v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0x1b), 0x1b);
+                STORE(dst - j * dstStride - i - 7, _mm_shuffle_epi32(v, 0x4e));
+            }
+            break;
+        default:
+            return i;
+        }
+    }
+    return i;
+}
+
+/* Transpose 4 rows of 4 32-bit pixels into 4 columns */
+static void transpose4x4_sse2(__m128i* r) {
+    __m128i a0, a1, a2, a3;
+
+    a0 = _mm_unpacklo_epi32(r[0], r[1]);
+    a1 = _mm_unpackhi_epi32(r[0], r[1]);
+    a2 = _mm_unpacklo_epi32(r[2], r[3]);
+    a3 = _mm_unpackhi_epi32(r[2], r[3]);
+    r[0] = _mm_unpacklo_epi64(a0, a2);
+    r[1] = _mm_unpackhi_epi64(a0, a2);
+    r[2] = _mm_unpacklo_epi64(a1, a3);
+    r[3] = _mm_unpackhi_epi64(a1, a3);
+}
+
+static int rotate32_sse2(const unsigned int* src, int srcStride,
+                         unsigned int* dst, int dstStride,
+                         int i, int count, int angle) {
+    __m128i r[4];
+    int j;
+
+    for (; i + 4 <= count; i += 4) {
+        switch (angle) {
+        case JAVAUTIL_PIXEL_ROTATE_90:
+            for (j = 0; j < 4; j++) {
+                r[j] = LOAD(src + (3 - j) * srcStride + i);
+            }
+            transpose4x4_sse2(r);
+            for (j = 0; j < 4; j++) {
+                STORE(dst + (i + j) * dstStride - 3, r[j]);
+            }
+            break;
+        case JAVAUTIL_PIXEL_ROTATE_270:
+            for (j = 0; j < 4; j++) {
+                r[j] = LOAD(src + j * srcStride + i);
+            }
+            transpose4x4_sse2(r);
+            for (j = 0; j < 4; j++) {
+                STORE(dst - (i + j) * dstStride, r[j]);
+            }
+            break;
+        case JAVAUTIL_PIXEL_ROTATE_180:
+            for (j = 0; j < 4; j++) {
+                STORE(dst - j * dstStride - i - 3, 
+                      _mm_shuffle_epi32(LOAD(src + j * srcStride + i), 0x1b));
+            }
+            break;
+        default:
+            return i;
+        }
+    }
+    return i;
+}
+
+#endif /* PIXEL_SSE2 */
+
+#ifdef PIXEL_NEON
+
+static int rgb888_to_rgb565_neon(const unsigned char* src,
+                                 unsigned short* dst, int i, int count) {
+    uint8x8x3_t v;
+
+    for (; i + 8 <= count; i += 8) {
+        v = vld3_u8(src + 3 * i);
+        vst1q_u16(dst + i, vorrq_u16(vorrq_u16(
+            vshlq_n_u16(vmovl_u8(vand_u8(v.val[0], vdup_n_u8(0xf8))), 8),
+            vshlq_n_u16(vmovl_u8(vand_u8(v.val[1], vdup_n_u8(0xfc))), 3)),
+            vmovl_u8(vshr_n_u8(v.val[2], 3))));
+    }
+    return i;
+}
+
+static int rgb888_to_xrgb8888_neon(const unsigned char* src,
+                                   unsigned int* dst, int i, int count) {
+    uint8x8x3_t v;
+    uint8x8x4_t w;
+
+    w.val[3] = vdup_n_u8(0);
+    for (; i + 8 <= count; i += 8) {
+        v = vld3_u8(src + 3 * i);
+        w.val[0] = v.val[2];
+        w.val[1] = v.val[1];
+        w.val[2] = v.val[0];
+        vst4_u8((unsigned char*)(dst + i), w);
+    }
+    return i;
+}
+
+static int xrgb8888_to_rgb888_neon(const unsigned int* src,
+                                   unsigned char* dst, int i, int count) {
+    uint8x8x4_t w;
+    uint8x8x3_t v;
+
+    for (; i + 8 <= count; i += 8) {
+        w = vld4_u8((const unsigned char*)(src + i));
+        v.val[0] = w.val[2];
+        v.val[1] = w.val[1];
+        v.val[2] = w.val[0];
+        vst3_u8(dst + 3 * i, v);
+    }
+    return i;
+}
+
+/* 8 RGB565 pixels widened to 8-bit R, G, B */
+static uint8x8x3_t expand565_neon(uint16x8_t p) {
+    uint8x8x3_t v;
+    uint8x8_t t;
+
+    t = vmovn_u16(vshrq_n_u16(p, 11));
+    v.val[0] = vorr_u8(vshl_n_u8(t, 3), vshr_n_u8(t, 2));
+    t = vand_u8(vmovn_u16(vshrq_n_u16(p, 5)), vdup_n_u8(0x3f));
+    v.val[1] = vorr_u8(vshl_n_u8(t, 2), vshr_n_u8(t, 4));
+    t = vand_u8(vmovn_u16(p), vdup_n_u8(0x1f));
+    v.val[2] = vorr_u8(vshl_n_u8(t, 3), vshr_n_u8(t, 2));
+    return v;
+}
+
+static int rgb565_to_rgb888_neon(const unsigned short* src,
+                                 unsigned char* dst, int i, int count) {
+    for (; i + 8 <= count; i += 8) {
+        vst3_u8(dst + 3 * i, expand565_neon(vld1q_u16(src + i)));
+    }
+    return i;
+}
+
+static int rgb565_to_argb8888_neon(const unsigned short* src,
+                                   const unsigned char* alpha,
+                                   unsigned int* dst, int i, int count) {
+    uint8x8x3_t v;
+    uint8x8x4_t w;
+
+    w.val[3] = vdup_n_u8(0xff);
+    for (; i + 8 <= count; i += 8) {
+        v = expand565_neon(vld1q_u16(src + i));
+        w.val[0] = v.val[2];
+        w.val[1] = v.val[1];
+        w.val[2] = v.val[0];
+        if (alpha != NULL) {
+            w.val[3] = vld1_u8(alpha + i);
+        }
+        vst4_u8((unsigned char*)(dst + i), w);
+    }
+    return i;
+}
+
+static int argb8888_to_rgb565_neon(const unsigned int* src,
+                                   unsigned short* dst,
+                                   unsigned char* alpha, int i, int count) {
+    uint8x8x4_t w;
+
+    for (; i + 8 <= count; i += 8) {
+        w = vld4_u8((const unsigned char*)(src + i));
+        vst1q_u16(dst + i, vorrq_u16(vorrq_u16(
+            vshlq_n_u16(vmovl_u8(vand_u8(w.val[2], vdup_n_u8(0xf8))), 8),
+            vshlq_n_u16(vmovl_u8(vand_u8(w.val[1], vdup_n_u8(0xfc))), 3)),
+            vmovl_u8(vshr_n_u8(w.val[0], 3))));
+        if (alpha != NULL) {
+            vst1_u8(alpha + i, w.val[3]);
+        }
+    }
+    return i;
+}
+
+static int key_mask16_neon(const unsigned short* src, unsigned char* mask,
+                           int i, int count, unsigned short key) {
+    const uint16x8_t k = vdupq_n_u16(key);
+
+    for (; i + 8 <= count; i += 8) {
+        vst1_u8(mask + i, vmovn_u16(vceqq_u16(vld1q_u16(src + i), k)));
+    }
+    return i;
+}
+
+#endif /* PIXEL_NEON */
+
+/* Install the kernels of impl, return 0 if the build or CPU lacks it */
+static int pixel_install(int impl) {
+    javautil_pixel_kernels k;
+    int ok = impl == JAVAUTIL_PIXEL_IMPL_C;
+
+    memset(&k, 0, sizeof(k));
+#ifdef PIXEL_SSE2
+    /* AVX2 keeps the SSE2 kernels of what has no AVX2 version */
+    if ((impl == JAVAUTIL_PIXEL_IMPL_SSE2 || 
+         impl == JAVAUTIL_PIXEL_IMPL_AVX2) &&
+        javautil_cpu_has(JAVAUTIL_CPU_SSE2)) {
+        k.rgb565_to_argb8888 = rgb565_to_argb8888_sse2;
+        k.argb8888_to_rgb565 = argb8888_to_rgb565_sse2;
+        k.argb8888_to_alpha = argb8888_to_alpha_sse2;
+        k.premultiply = premultiply_sse2;
+        k.byteswap16 = byteswap16_sse2;
+        k.byteswap32 = byteswap32_sse2;
+        k.key_mask16 = key_mask16_sse2;
+        k.key_mask32 = key_mask32_sse2;
+        k.copy_masked16 = copy_masked16_sse2;
+        k.copy_masked32 = copy_masked32_sse2;
+        k.fill16 = fill16_sse2;
+        k.fill32 = fill32_sse2;
+        k.blend_argb8888_to_rgb565 = blend_argb8888_to_rgb565_sse2;
+        k.blend_argb8888_to_argb8888 = blend_argb8888_to_argb8888_sse2;
+        k.rotate16 = rotate16_sse2;
+        k.rotate32 = rotate32_sse2;
+        ok = impl == JAVAUTIL_PIXEL_IMPL_SSE2;
+    }
+#endif
+#ifdef PIXEL_AVX2
+    if (impl == JAVAUTIL_PIXEL_IMPL_AVX2 && 
+        javautil_cpu_has(JAVAUTIL_CPU_AVX2)) {
+        ok = javautil_pixel_avx2_kernels(&k);
+    }
+#endif
+#ifdef PIXEL_NEON
+    if (impl == JAVAUTIL_PIXEL_IMPL_NEON && 
+        javautil_cpu_has(JAVAUTIL_CPU_NEON)) {
+        k.rgb888_to_rgb565 = rgb888_to_rgb565_neon;
+        k.rgb888_to_xrgb8888 = rgb888_to_xrgb8888_neon;
+        k.xrgb8888_to_rgb888 = xrgb8888_to_rgb888_neon;
+        k.rgb565_to_rgb888 = rgb565_to_rgb888_neon;
+        k.rgb565_to_argb8888 = rgb565_to_argb8888_neon;
+        k.argb8888_to_rgb565 = argb8888_to_rgb565_neon;
+        k.key_mask16 = key_mask16_neon;
+        ok = 1;
+    }
+#endif
+    if (ok) {
+        pixel_kernels = k;
+        pixel_impl = impl;
+    }
+    return ok;
+}
+
+void javautil_pixel_init(void) {
+    int n;
+
+    for (n = 1; n < 256; n++) {
+        unpremultiply_table[n] = ((255 << 16) + n / 2) / n;
+    }
+    if (!pixel_install(JAVAUTIL_PIXEL_IMPL_AVX2) &&
+        !pixel_install(JAVAUTIL_PIXEL_IMPL_SSE2) &&
+        !pixel_install(JAVAUTIL_PIXEL_IMPL_NEON)) {
+        pixel_install(JAVAUTIL_PIXEL_IMPL_C);
+    }
+}
+
+/* Programs that skip javacall_os_initialize select on first use */
+static const javautil_pixel_kernels* pixel_select(void) {
+    javautil_pixel_init();
+    return &pixel_kernels;
+}
+
+#define PIXEL_KERNELS() \
+    (pixel_impl != PIXEL_IMPL_UNKNOWN ? &pixel_kernels : pixel_select())
+
+int javautil_pixel_get_impl(void) {
+    (void)PIXEL_KERNELS();
+    return pixel_impl;
+}
+
+int javautil_pixel_set_impl(int impl) {
+    (void)PIXEL_KERNELS();
+    pixel_install(impl);
+    return pixel_impl;
+}
+
+void javautil_pixel_rgb888_to_rgb565(const unsigned char* src,
+                                     unsigned short* dst, int count) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+
+    if (k->rgb888_to_rgb565 != NULL) {
+        i = k->rgb888_to_rgb565(src, dst, i, count);
+    }
+    for (src += 3 * i; i < count; i++, src += 3) {
+        dst[i] = RGB_TO_565(src[0], src[1], src[2]);
+    }
+}
+
+void javautil_pixel_rgb888_to_xrgb8888(const unsigned char* src,
+                                       unsigned int* dst, int count) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+
+    if (k->rgb888_to_xrgb8888 != NULL) {
+        i = k->rgb888_to_xrgb8888(src, dst, i, count);
+    }
+    for (src += 3 * i; i < count; i++, src += 3) {
+        dst[i] = ((unsigned int)src[0] << 16) | 
+                 ((unsigned int)src[1] << 8) | src[2];
+    }
+}
+
+void javautil_pixel_xrgb8888_to_rgb888(const unsigned int* src,
+                                       unsigned char* dst, int count) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+    unsigned int p;
+
+    if (k->xrgb8888_to_rgb888 != NULL) {
+        i = k->xrgb8888_to_rgb888(src, dst, i, count);
+    }
+    for (dst += 3 * i; i < count; i++, dst += 3) {
+        p = src[i];
+        dst[0] = (unsigned char)(p >> 16);
+        dst[1] = (unsigned char)(p >> 8);
+        dst[2] = (unsigned char)p;
+    }
+}
+
+void javautil_pixel_rgb565_to_rgb888(const unsigned short* src,
+                                     unsigned char* dst, int count) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+    unsigned int p;
+
+    if (k->rgb565_to_rgb888 != NULL) {
+        i = k->rgb565_to_rgb888(src, dst, i, count);
+    }
+    for (dst += 3 * i; i < count; i++, dst += 3) {
+        p = src[i];
+        dst[0] = (unsigned char)RGB565_R(p);
+        dst[1] = (unsigned char)RGB565_G(p);
+        dst[2] = (unsigned char)RGB565_B(p);
+    }
+}
+
+void javautil_pixel_rgb565_to_argb8888(const unsigned short* src,
+                                       const unsigned char* alpha,
+                                       unsigned int* dst, int count) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+    unsigned int p;
+
+    if (k->rgb565_to_argb8888 != NULL) {
+        i = k->rgb565_to_argb8888(src, alpha, dst, i, count);
+    }
+    for (; i < count; i++) {
+        p = src[i];
+        dst[i] = ((alpha != NULL ? (unsigned int)alpha[i] : 0xff) << 24) |
+                 (RGB565_R(p) << 16) | (RGB565_G(p) << 8) | RGB565_B(p);
+    }
+}
+
+void javautil_pixel_argb8888_to_rgb565(const unsigned int* src,
+                                       unsigned short* dst,
+                                       unsigned char* alpha, int count) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+
+    if (k->argb8888_to_rgb565 != NULL) {
+        i = k->argb8888_to_rgb565(src, dst, alpha, i, count);
+    }
+    for (; i < count; i++) {
+        dst[i] = ARGB_TO_565(src[i]);
+        if (alpha != NULL) {
+            alpha[i] = (unsigned char)(src[i] >> 24);
+        }
+    }
+}
+
+void javautil_pixel_argb8888_to_alpha(const unsigned int* src,
+                                      unsigned char* alpha, int count) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+
+    if (k->argb8888_to_alpha != NULL) {
+        i = k->argb8888_to_alpha(src, alpha, i, count);
+    }
+    for (; i < count; i++) {
+        alpha[i] = (unsigned char)(src[i] >> 24);
+    }
+}
+
+void javautil_pixel_premultiply(const unsigned int* src,
+                                unsigned int* dst, int count) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+
+    if (k->premultiply != NULL) {
+        i = k->premultiply(src, dst, i, count);
+    }
+    for (; i < count; i++) {
+        dst[i] = premultiply(src[i]);
+    }
+}
+
+void javautil_pixel_unpremultiply(const unsigned int* src,
+                                  unsigned int* dst, int count) {
+    int i;
+
+    (void)PIXEL_KERNELS();
+    for (i = 0; i < count; i++) {
+        dst[i] = unpremultiply(src[i]);
+    }
+}
+
+void javautil_pixel_byteswap16(void* data, int count) {
+    unsigned char* p = (unsigned char*)data;
+    unsigned char t;
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+
+    if (k->byteswap16 != NULL) {
+        i = k->byteswap16(p, i, count);
+    }
+    for (p += 2 * i; i < count; i++, p += 2) {
+        t = p[0];
+        p[0] = p[1];
+        p[1] = t;
+    }
+}
+
+void javautil_pixel_byteswap32(void* data, int count) {
+    unsigned char* p = (unsigned char*)data;
+    unsigned char t;
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+
+    if (k->byteswap32 != NULL) {
+        i = k->byteswap32(p, i, count);
+    }
+    for (p += 4 * i; i < count; i++, p += 4) {
+        t = p[0];
+        p[0] = p[3];
+        p[3] = t;
+        t = p[1];
+        p[1] = p[2];
+        p[2] = t;
+    }
+}
+
+void javautil_pixel_key_mask16(const unsigned short* src,
+                               unsigned char* mask, int count,
+                               unsigned short key) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+
+    if (k->key_mask16 != NULL) {
+        i = k->key_mask16(src, mask, i, count, key);
+    }
+    for (; i < count; i++) {
+        mask[i] = (unsigned char)(src[i] == key ? 0xff : 0);
+    }
+}
+
+void javautil_pixel_key_mask32(const unsigned int* src,
+                               unsigned char* mask, int count,
+                               unsigned int key) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+
+    if (k->key_mask32 != NULL) {
+        i = k->key_mask32(src, mask, i, count, key);
+    }
+    for (; i < count; i++) {
+        mask[i] = (unsigned char)(src[i] == key ? 0xff : 0);
+    }
+}
+
+void javautil_pixel_copy_masked16(const unsigned short* src,
+                                  const unsigned char* mask,
+                                  unsigned short* dst, int count) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+
+    if (k->copy_masked16 != NULL) {
+        i = k->copy_masked16(src, mask, dst, i, count);
+    }
+    for (; i < count; i++) {
+        if (mask[i] != 0) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+void javautil_pixel_copy_masked32(const unsigned int* src,
+                                  const unsigned char* mask,
+                                  unsigned int* dst, int count) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+
+    if (k->copy_masked32 != NULL) {
+        i = k->copy_masked32(src, mask, dst, i, count);
+    }
+    for (; i < count; i++) {
+        if (mask[i] != 0) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+void javautil_pixel_fill16(unsigned short* dst, int count,
+                           unsigned short color) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+
+    if (k->fill16 != NULL) {
+        i = k->fill16(dst, i, count, color);
+    }
+    for (; i < count; i++) {
+        dst[i] = color;
+    }
+}
+
+void javautil_pixel_fill32(unsigned int* dst, int count, unsigned int color) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+
+    if (k->fill32 != NULL) {
+        i = k->fill32(dst, i, count, color);
+    }
+    for (; i < count; i++) {
+        dst[i] = color;
+    }
+}
+
+void javautil_pixel_blend_argb8888_to_rgb565(const unsigned int* src,
+                                             unsigned short* dst, int count) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+    unsigned int s, d, a, na;
+
+    if (k->blend_argb8888_to_rgb565 != NULL) {
+        i = k->blend_argb8888_to_rgb565(src, dst, i, count);
+    }
+    for (; i < count; i++) {
+        s = src[i];
+        a = s >> 24;
+        if (a == 0xff) {
+            dst[i] = ARGB_TO_565(s);
+        } else if (a != 0) {
+            d = dst[i];
+            na = 0xff - a;
+            dst[i] = RGB_TO_565(div255(((s >> 16) & 0xff) * a + RGB565_R(d) * na),
+                                div255(((s >> 8) & 0xff) * a + RGB565_G(d) * na),
+                                div255((s & 0xff) * a + RGB565_B(d) * na));
+        }
+    }
+}
+
+void javautil_pixel_blend_argb8888_to_argb8888(const unsigned int* src,
+                                               unsigned int* dst, int count) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int i = 0;
+    unsigned int s, d, a, na;
+
+    if (k->blend_argb8888_to_argb8888 != NULL) {
+        i = k->blend_argb8888_to_argb8888(src, dst, i, count);
+    }
+    for (; i < count; i++) {
+        s = src[i];
+        a = s >> 24;
+        if (a == 0xff) {
+            dst[i] = s;
+        } else if (a != 0) {
+            d = dst[i];
+            na = 0xff - a;
+            dst[i] = (div255(0xff * a + (d >> 24) * na) << 24) |
+                     (div255(((s >> 16) & 0xff) * a + ((d >> 16) & 0xff) * na) << 16) |
+                     (div255(((s >> 8) & 0xff) * a + ((d >> 8) & 0xff) * na) << 8) |
+                     div255((s & 0xff) * a + (d & 0xff) * na);
+        }
+    }
+}
+
+/* Rotation tiles are one 64 byte cache line of pixels square */
+#define ROTATE16_TILE   32
+#define ROTATE32_TILE   16
+
+/*
+ * Offset in dst of where pixel (0, 0) of the rectangle goes, and the
+ * steps in dst of the next pixel of a row and of the next row
+ */
+static int rotate_origin(int dstStride, int width, int height, int angle,
+                         int* xstep, int* ystep) {
+    switch (angle) {
+    case JAVAUTIL_PIXEL_ROTATE_90:
+        *xstep = dstStride;
+        *ystep = -1;
+        return height - 1;
+    case JAVAUTIL_PIXEL_ROTATE_180:
+        *xstep = -1;
+        *ystep = -dstStride;
+        return (height - 1) * dstStride + width - 1;
+    case JAVAUTIL_PIXEL_ROTATE_270:
+        *xstep = -dstStride;
+        *ystep = 1;
+        return (width - 1) * dstStride;
+    default:
+        *xstep = 1;
+        *ystep = dstStride;
+        return 0;
+    }
+}
+
+static void rotate16_c(const unsigned short* src, int srcStride,
+                       unsigned short* dst, int xstep, int ystep,
+                       int x, int count, int rows) {
+    int i, j;
+
+    for (j = 0; j < rows; j++, src += srcStride, dst += ystep) {
+        for (i = x; i < count; i++) {
+            dst[i * xstep] = src[i];
+        }
+    }
+}
+
+static void rotate32_c(const unsigned int* src, int srcStride,
+                       unsigned int* dst, int xstep, int ystep,
+                       int x, int count, int rows) {
+    int i, j;
+
+    for (j = 0; j < rows; j++, src += srcStride, dst += ystep) {
+        for (i = x; i < count; i++) {
+            dst[i * xstep] = src[i];
+        }
+    }
+}
+
+void javautil_pixel_rotate16(const unsigned short* src, int srcStride,
+                             unsigned short* dst, int dstStride,
+                             int width, int height, int angle) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int xstep, ystep, x, y, y0, y1, count, i;
+
+    dst += rotate_origin(dstStride, width, height, angle, &xstep, &ystep);
+    for (y0 = 0; y0 < height; y0 = y1) {
+        y1 = y0 + ROTATE16_TILE < height ? y0 + ROTATE16_TILE : height;
+        for (x = 0; x < width; x = count) {
+            count = x + ROTATE16_TILE < width ? x + ROTATE16_TILE : width;
+            y = y0;
+            if (k->rotate16 != NULL) {
+                for (; y + PIXEL_ROTATE16_BAND <= y1; 
+                     y += PIXEL_ROTATE16_BAND) {
+                    i = k->rotate16(src + y * srcStride, srcStride, 
+                                    dst + y * ystep, dstStride, 
+                                    x, count, angle);
+                    rotate16_c(src + y * srcStride, srcStride, 
+                               dst + y * ystep, xstep, ystep, 
+                               i, count, PIXEL_ROTATE16_BAND);
+                }
+            }
+            rotate16_c(src + y * srcStride, srcStride, dst + y * ystep, 
+                       xstep, ystep, x, count, y1 - y);
+        }
+    }
+}
+
+void javautil_pixel_rotate32(const unsigned int* src, int srcStride,
+                             unsigned int* dst, int dstStride,
+                             int width, int height, int angle) {
+    const javautil_pixel_kernels* k = PIXEL_KERNELS();
+    int xstep, ystep, x, y, y0, y1, count, i;
+
+    dst += rotate_origin(dstStride, width, height, angle, &xstep, &ystep);
+    for (y0 = 0; y0 < height; y0 = y1) {
+        y1 = y0 + ROTATE32_TILE < height ? y0 + ROTATE32_TILE : height;
+        for (x = 0; x < width; x = count) {
+            count = x + ROTATE32_TILE < width ? x + ROTATE32_TILE : width;
+            y = y0;
+            if (k->rotate32 != NULL) {
+                for (; y + PIXEL_ROTATE32_BAND <= y1; 
+                     y += PIXEL_ROTATE32_BAND) {
+                    i = k->rotate32(src + y * srcStride, srcStride, 
+                                    dst + y * ystep, dstStride, 
+                                    x, count, angle);
+                    rotate32_c(src + y * srcStride, srcStride, 
+                               dst + y * ystep, xstep, ystep, 
+                               i, count, PIXEL_ROTATE32_BAND);
+                }
+            }
+            rotate32_c(src + y * srcStride, srcStride, dst + y * ystep, 
+                       xstep, ystep, x, count, y1 - y);
+        }
+    }
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * AVX2 kernels of the pixel format conversions.  The build compiles
+ * this file, and only this file, for AVX2; javautil_pixel.c installs
+ * the kernels when javautil_cpu_has reports AVX2.
+ */
+
+#include <string.h>
+#include "javautil_pixel_kernels.h"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+#define LOAD256(p)      _mm256_loadu_si256((const __m256i*)(p))
+#define STORE256(p, v)  _mm256_storeu_si256((__m256i*)(p), v)
+
+/*
+ * RGB888 is handled 4 pixels per 128-bit lane, so 8 pixels take 24
+ * bytes but the loads and stores cover 28; the kernels stop while 10
+ * pixels are left.
+ */
+
+/* 8 RGB888 pixels to XRGB8888 */
+static __m256i load_rgb888_avx2(const unsigned char* src) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128,
+        2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128);
+    __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)src)),
+        _mm_loadu_si128((const __m128i*)(src + 12)), 1);
+    return _mm256_shuffle_epi8(v, shuffle);
+}
+
+/* 8 XRGB8888 pixels to RGB888 */
+static void store_rgb888_avx2(unsigned char* dst, __m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -128, -128, -128, -128,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -128, -128, -128, -128);
+    v = _mm256_shuffle_epi8(v, shuffle);
+    _mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(v));
+    _mm_storeu_si128((__m128i*)(dst + 12), _mm256_extracti128_si256(v, 1));
+}
+
+/* 8 XRGB8888 pixels to RGB565 in 32-bit lanes */
+static __m256i pack565_avx2(__m256i p) {
+    return _mm256_or_si256(
+        _mm256_or_si256(
+            _mm256_and_si256(_mm256_srli_epi32(p, 8), _mm256_set1_epi32(0xf800)),
+            _mm256_and_si256(_mm256_srli_epi32(p, 5), _mm256_set1_epi32(0x07e0))),
+        _mm256_and_si256(_mm256_srli_epi32(p, 3), _mm256_set1_epi32(0x001f)));
+}
+
+/* 8 RGB565 pixels in 32-bit lanes to XRGB8888 */
+static __m256i expand565_avx2(__m256i v) {
+    __m256i r = _mm256_srli_epi32(v, 11);
+    __m256i g = _mm256_and_si256(_mm256_srli_epi32(v, 5), _mm256_set1_epi32(0x3f));
+    __m256i b = _mm256_and_si256(v, _mm256_set1_epi32(0x1f));
+
+    r = _mm256_or_si256(_mm256_slli_epi32(r, 3), _mm256_srli_epi32(r, 2));
+    g = _mm256_or_si256(_mm256_slli_epi32(g, 2), _mm256_srli_epi32(g, 4));
+    b = _mm256_or_si256(_mm256_slli_epi32(b, 3), _mm256_srli_epi32(b, 2));
+    return _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(r, 16),
+                                           _mm256_slli_epi32(g, 8)), b);
+}
+
+static int rgb888_to_rgb565_avx2(const unsigned char* src,
+                                 unsigned short* dst, int i, int count) {
+    __m256i v;
+
+    for (; i + 10 <= count; i += 8) {
+        v = pack565_avx2(load_rgb888_avx2(src + 3 * i));
+        v = _mm256_permute4x64_epi64(_mm256_packus_epi32(v, v), 0x08);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm256_castsi256_si128(v));
+    }
+    return i;
+}
+
+static int rgb888_to_xrgb8888_avx2(const unsigned char* src,
+                                   unsigned int* dst, int i, int count) {
+    for (; i + 10 <= count; i += 8) {
+        STORE256(dst + i, load_rgb888_avx2(src + 3 * i));
+    }
+    return i;
+}
+
+static int xrgb8888_to_rgb888_avx2(const unsigned int* src,
+                                   unsigned char* dst, int i, int count) {
+    for (; i + 10 <= count; i += 8) {
+        store_rgb888_avx2(dst + 3 * i, LOAD256(src + i));
+    }
+    return i;
+}
+
+static int rgb565_to_rgb888_avx2(const unsigned short* src,
+                                 unsigned char* dst, int i, int count) {
+    __m256i v;
+
+    for (; i + 10 <= count; i += 8) {
+        v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        store_rgb888_avx2(dst + 3 * i, expand565_avx2(v));
+    }
+    return i;
+}
+
+static int rgb565_to_argb8888_avx2(const unsigned short* src,
+                                   const unsigned char* alpha,
+                                   unsigned int* dst, int i, int count) {
+    __m256i a = _mm256_set1_epi32((int)0xff000000);
+    __m256i v;
+
+    for (; i + 8 <= count; i += 8) {
+        v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        if (alpha != NULL) {
+            a = _mm256_slli_epi32(_mm256_cvtepu8_epi32(
+                    _mm_loadl_epi64((const __m128i*)(alpha + i))), 24);
+        }
+        STORE256(dst + i, _mm256_or_si256(expand565_avx2(v), a));
+    }
+    return i;
+}
+
+static int argb8888_to_rgb565_avx2(const unsigned int* src,
+                                   unsigned short* dst,
+                                   unsigned char* alpha, int i, int count) {
+    __m256i p0, p1, v;
+
+    for (; i + 16 <= count; i += 16) {
+        p0 = LOAD256(src + i);
+        p1 = LOAD256(src + i + 8);
+        /* packs interleave the lanes, the permute restores the order */
+        v = _mm256_packus_epi32(pack565_avx2(p0), pack565_avx2(p1));
+        STORE256(dst + i, _mm256_permute4x64_epi64(v, 0xd8));
+        if (alpha != NULL) {
+            v = _mm256_packus_epi32(_mm256_srli_epi32(p0, 24), 
+                                    _mm256_srli_epi32(p1, 24));
+            v = _mm256_permute4x64_epi64(v, 0xd8);
+            v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08);
+            _mm_storeu_si128((__m128i*)(alpha + i), _mm256_castsi256_si128(v));
+        }
+    }
+    return i;
+}
+
+static int premultiply_avx2(const unsigned int* src, unsigned int* dst,
+                            int i, int count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i keep = _mm256_set_epi16(0xff, 0, 0, 0, 0xff, 0, 0, 0,
+                                          0xff, 0, 0, 0, 0xff, 0, 0, 0);
+    const __m256i round = _mm256_set1_epi16(0x80);
+    __m256i p, lo, hi, a;
+
+    for (; i + 8 <= count; i += 8) {
+        p = LOAD256(src + i);
+        lo = _mm256_unpacklo_epi8(p, zero);
+        hi = _mm256_unpackhi_epi8(p, zero);
+        /* alpha in every lane of its pixel, 255 in the alpha lane */
+        a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo, 0xff), 0xff);
+        a = _mm256_blend_epi16(a, keep, 0x88);
+        lo = _mm256_add_epi16(_mm256_mullo_epi16(lo, a), round);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi, 0xff), 0xff);
+        a = _mm256_blend_epi16(a, keep, 0x88);
+        hi = _mm256_add_epi16(_mm256_mullo_epi16(hi, a), round);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+        STORE256(dst + i, _mm256_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+static int key_mask16_avx2(const unsigned short* src, unsigned char* mask,
+                           int i, int count, unsigned short key) {
+    const __m256i k = _mm256_set1_epi16((short)key);
+    __m256i m;
+
+    for (; i + 32 <= count; i += 32) {
+        m = _mm256_packs_epi16(_mm256_cmpeq_epi16(LOAD256(src + i), k),
+                               _mm256_cmpeq_epi16(LOAD256(src + i + 16), k));
+        STORE256(mask + i, _mm256_permute4x64_epi64(m, 0xd8));
+    }
+    return i;
+}
+
+static int copy_masked16_avx2(const unsigned short* src,
+                              const unsigned char* mask,
+                              unsigned short* dst, int i, int count) {
+    __m256i m;
+
+    for (; i + 16 <= count; i += 16) {
+        m = _mm256_cvtepi8_epi16(_mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i*)(mask + i)), 
+                _mm_setzero_si128()));
+        STORE256(dst + i, _mm256_blendv_epi8(LOAD256(src + i), 
+                                             LOAD256(dst + i), m));
+    }
+    return i;
+}
+
+int javautil_pixel_avx2_kernels(javautil_pixel_kernels* k) {
+    k->rgb888_to_rgb565 = rgb888_to_rgb565_avx2;
+    k->rgb888_to_xrgb8888 = rgb888_to_xrgb8888_avx2;
+    k->xrgb8888_to_rgb888 = xrgb8888_to_rgb888_avx2;
+    k->rgb565_to_rgb888 = rgb565_to_rgb888_avx2;
+    k->rgb565_to_argb8888 = rgb565_to_argb8888_avx2;
+    k->argb8888_to_rgb565 = argb8888_to_rgb565_avx2;
+    k->premultiply = premultiply_avx2;
+    k->key_mask16 = key_mask16_avx2;
+    k->copy_masked16 = copy_masked16_avx2;
+    return 1;
+}
+
+#else /* !__AVX2__ */
+
+int javautil_pixel_avx2_kernels(javautil_pixel_kernels* k) {
+    (void)k;
+    return 0;
+}
+
+#endif /* __AVX2__ */
@@ -0,0 +1,97 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * Kernel table of the pixel format conversions, shared by the sources
+ * built for different instruction sets.
+ *
+ * A kernel starts at pixel i, converts what it can in whole blocks and
+ * returns the first pixel it left for the C loop.  Entries are NULL
+ * where there is no kernel.
+ *
+ * The rotation kernels work the same way on columns i to count of a
+ * band of PIXEL_ROTATE16_BAND or PIXEL_ROTATE32_BAND rows, and store
+ * pixel 0 of the first row of the band at dst.
+ */
+
+#ifndef _JAVAUTIL_PIXEL_KERNELS_H_
+#define _JAVAUTIL_PIXEL_KERNELS_H_
+
+#define PIXEL_ROTATE16_BAND     8
+#define PIXEL_ROTATE32_BAND     4
+
+typedef struct {
+    int (*rgb888_to_rgb565)(const unsigned char* src, unsigned short* dst,
+                            int i, int count);
+    int (*rgb888_to_xrgb8888)(const unsigned char* src, unsigned int* dst,
+                              int i, int count);
+    int (*xrgb8888_to_rgb888)(const unsigned int* src, unsigned char* dst,
+                              int i, int count);
+    int (*rgb565_to_rgb888)(const unsigned short* src, unsigned char* dst,
+                            int i, int count);
+    int (*rgb565_to_argb8888)(const unsigned short* src,
+                              const unsigned char* alpha,
+                              unsigned int* dst, int i, int count);
+    int (*argb8888_to_rgb565)(const unsigned int* src, unsigned short* dst,
+                              unsigned char* alpha, int i, int count);
+    int (*argb8888_to_alpha)(const unsigned int* src, unsigned char* alpha,
+                             int i, int count);
+    int (*premultiply)(const unsigned int* src, unsigned int* dst,
+                       int i, int count);
+    int (*byteswap16)(unsigned char* data, int i, int count);
+    int (*byteswap32)(unsigned char* data, int i, int count);
+    int (*key_mask16)(const unsigned short* src, unsigned char* mask,
+                      int i, int count, unsigned short key);
+    int (*key_mask32)(const unsigned int* src, unsigned char* mask,
+                      int i, int count, unsigned int key);
+    int (*copy_masked16)(const unsigned short* src, const unsigned char* mask,
+                         unsigned short* dst, int i, int count);
+    int (*copy_masked32)(const unsigned int* src, const unsigned char* mask,
+                         unsigned int* dst, int i, int count);
+    int (*fill16)(unsigned short* dst, int i, int count, unsigned short color);
+    int (*fill32)(unsigned int* dst, int i, int count, unsigned int color);
+    int (*blend_argb8888_to_rgb565)(const unsigned int* src,
+                                    unsigned short* dst, int i, int count);
+    int (*blend_argb8888_to_argb8888)(const unsigned int* src,
+                                      unsigned int* dst, int i, int count);
+    int (*rotate16)(const unsigned short* src, int srcStride,
+                    unsigned short* dst, int dstStride,
+                    int i, int count, int angle);
+    int (*rotate32)(const unsigned int* src, int srcStride,
+                    unsigned int* dst, int dstStride,
+                    int i, int count, int angle);
+} javautil_pixel_kernels;
+
+/**
+ * Replaces the kernels that have AVX2 versions.  The caller checks
+ * that the CPU supports AVX2.
+ *
+ * @param k kernel table to update
+ * @return non-zero if the AVX2 kernels are part of this build
+ */
+int javautil_pixel_avx2_kernels(javautil_pixel_kernels* k);
+
+#endif /* _JAVAUTIL_PIXEL_KERNELS_H_ */
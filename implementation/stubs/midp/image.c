@@ -36,6 +36,9 @@
  */
 
 #include "javacall_image.h"
+#ifdef ENABLE_IMAGE_DECODER
+#include "javautil_image.h"
+#endif
 
 /**
  * Get image information
@@ -52,7 +55,11 @@
 javacall_result javacall_image_get_info(const void* source, long sourceSize,
                                         /*OUT*/ javacall_image_info* imageInfo)
 {
+#ifdef ENABLE_IMAGE_DECODER
+    return javautil_image_get_info(source, sourceSize, imageInfo);
+#else
     return JAVACALL_FAIL;
+#endif
 }
 
 /**
@@ -85,7 +92,13 @@ javacall_result javacall_image_decode_start(const void* source,
                                             long width, 
                                             long height,
                                             /*OUT*/ javacall_handle* handle){
+#ifdef ENABLE_IMAGE_DECODER
+    /* decoding is synchronous, the source stays valid until finish */
+    return javautil_image_decode_start(source, sourceSize, width, height,
+                                       JAVAUTIL_IMAGE_BORROW_SOURCE, handle);
+#else
     return JAVACALL_FAIL;
+#endif
 }
 
 /**
@@ -112,6 +125,11 @@ javacall_result javacall_image_decode_finish(javacall_handle handle,
                                              /*OUT*/ javacall_pixel* decodeBuf, long decodeBufSize,
                                              /*OUT*/ char* alphaBuf, long alphaBufSize)
 {
+#ifdef ENABLE_IMAGE_DECODER
+    return javautil_image_decode_finish(handle, decodeBuf, decodeBufSize,
+                                        alphaBuf, alphaBufSize);
+#else
     return JAVACALL_FAIL;
+#endif
 }
 
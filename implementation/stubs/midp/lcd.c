@@ -147,6 +147,53 @@ javacall_result javacall_lcd_flush_partial(int hardwareId, int ystart, int yend)
     (void)hardwareId;
     return JAVACALL_FAIL;
 }
+
+/**
+ * Fill pixels of the screen raster with a color. Not supported.
+ *
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_set_pixels(int offsetInVram, int numberOfPixels, 
+                                        javacall_pixel color) {
+    return JAVACALL_FAIL;
+}
+
+/**
+ * Copy an image to the screen raster. Not supported.
+ *
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_bitblit(javacall_pixel* destScreenPtr, 
+                                     javacall_pixel* srcImage, 
+                                     int imageWidth, int imageHeight, 
+                                     int x, int y) {
+    return JAVACALL_FAIL;
+}
+
+/**
+ * Draw an image on the screen raster. Not supported.
+ *
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_blit(int hardwareId, const void* src, 
+                                  int srcStride, 
+                                  javacall_lcd_blit_format format,
+                                  int width, int height, int x, int y) {
+    (void)hardwareId;
+    return JAVACALL_FAIL;
+}
+
+/**
+ * Move an area of the screen raster. Not supported.
+ *
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_copy_area(int hardwareId, int x, int y, 
+                                       int width, int height, 
+                                       int dx, int dy) {
+    (void)hardwareId;
+    return JAVACALL_FAIL;
+}
     
 javacall_bool javacall_lcd_reverse_orientation(int hardwareId) {
     (void)hardwareId;
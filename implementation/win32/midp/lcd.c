@@ -41,6 +41,7 @@
 #include "javacall_socket.h"
 #include "javacall_datagram.h"
 #include "javacall_lifecycle.h"
+#include "javautil_pixel.h"
 
 
 #include "lcd.h"
@@ -381,6 +382,53 @@ javacall_result /*OPTIONAL*/ javacall_lcd_flush_partial(int hardwareId, int ysta
     return JAVACALL_OK;
 }
 
+/**
+ * Fill pixels of the screen raster with a color. Not supported.
+ *
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_set_pixels(int offsetInVram, int numberOfPixels, 
+                                        javacall_pixel color) {
+    return JAVACALL_FAIL;
+}
+
+/**
+ * Copy an image to the screen raster. Not supported.
+ *
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_bitblit(javacall_pixel* destScreenPtr, 
+                                     javacall_pixel* srcImage, 
+                                     int imageWidth, int imageHeight, 
+                                     int x, int y) {
+    return JAVACALL_FAIL;
+}
+
+/**
+ * Draw an image on the screen raster. Not supported.
+ *
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_blit(int hardwareId, const void* src, 
+                                  int srcStride, 
+                                  javacall_lcd_blit_format format,
+                                  int width, int height, int x, int y) {
+    (void)hardwareId;
+    return JAVACALL_FAIL;
+}
+
+/**
+ * Move an area of the screen raster. Not supported.
+ *
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_copy_area(int hardwareId, int x, int y, 
+                                       int width, int height, 
+                                       int dx, int dy) {
+    (void)hardwareId;
+    return JAVACALL_FAIL;
+}
+
 HWND midpGetWindowHandle() {
     if(hMainWindow == NULL) {
         if(hPhantomWindow == NULL) {
@@ -1336,14 +1384,8 @@ static void RefreshScreen(int x1, int y1, int x2, int y2) {
     int y;
     int width;
     int height;
-    int i;
     int j;
-    javacall_pixel pixel;
-    int r;
-    int g;
-    int b;
     unsigned char *destBits;
-    unsigned char *destPtr;
 
     HDC        hdcMem;
     HBITMAP    destHBmp;
@@ -1403,19 +1445,11 @@ static void RefreshScreen(int x1, int y1, int x2, int y2) {
         oobj = SelectObject(hdcMem, destHBmp);
         SelectObject(hdcMem, oobj);
 
+        /* a 32-bit DIB pixel is B, G, R, X in memory, which is xRGB */
         for(j = 0; j < height; j++) {
-            for(i = 0; i < width; i++) {
-                pixel = screenBuffer[((y + j) *screenWidth) + x + i];
-                r = GET_RED_FROM_PIXEL(pixel);
-                g = GET_GREEN_FROM_PIXEL(pixel);
-                b = GET_BLUE_FROM_PIXEL(pixel);
-
-                destPtr = destBits + ((j * width + i) * sizeof (long));
-
-                *destPtr++ = b;
-                *destPtr++ = g;
-                *destPtr++ = r;
-            }
+            javautil_pixel_rgb565_to_argb8888(
+                screenBuffer + ((y + j) * screenWidth) + x, NULL,
+                (unsigned int *)destBits + (j * width), width);
         }
 
         SetDIBitsToDevice(hdc, x, y, width, height, 0, 0, 0,
@@ -33,6 +33,8 @@ extern "C" {
 #include <malloc.h>
 #include <assert.h>
 #include "javacall_os.h"
+#include "javautil_cpu.h"
+#include "javautil_pixel.h"
 
 
 /*
@@ -43,7 +45,9 @@ extern "C" {
  *
 */
 void javacall_os_initialize(void){
-    return;
+    /* probe the CPU and select the kernels before threads use them */
+    javautil_cpu_init();
+    javautil_pixel_init();
 }
 
 
@@ -24,6 +24,7 @@
 
 #include "multimedia.h"
 #include "pcm_out.h"
+#include "javautil_pixel.h"
 
 //=============================================================================
 
@@ -368,9 +369,7 @@ static javacall_result rtp_do_buffering(javacall_handle handle,
                                         javacall_bool *need_more_data, 
                                         long *next_chunk_size)
 {
-    int i;
     rtp_player* p = (rtp_player*)handle;
-    BYTE t;
     BYTE* bb = (BYTE*)buffer;
 
     if( NULL != buffer && 0 != *length )
@@ -378,12 +377,7 @@ static javacall_result rtp_do_buffering(javacall_handle handle,
         assert( p->buf->data == buffer );
 
         // data is in network byte order (i.e., big endian)
-        for( i = 0; i < *length; i+= 2 )
-        {
-            t           = bb[ i ];
-            bb[ i ]     = bb[ i + 1 ];
-            bb[ i + 1 ] = t;
-        }
+        javautil_pixel_byteswap16( bb, *length / 2 );
 
         EnterCriticalSection( &(p->cs) );
         {
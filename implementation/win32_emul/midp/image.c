@@ -24,125 +24,12 @@
 
 
  /**
-  * Win32 implementation supports the following image formats: jpeg,png
+  * Win32 implementation supports the following image formats: jpeg,png,gif,
+  * decoded by the shared implementation in javautil_image.c
  */
 
-#include <stdio.h>
-#include <windows.h>
 #include "javacall_image.h"
-#include <jpegdecoder.h>
-
-    /**
-     * PNG Header Data
-     */
-    unsigned char pngHeader[] ={
-         (unsigned char)0x89, (unsigned char)0x50, (unsigned char)0x4e, (unsigned char)0x47,
-         (unsigned char)0x0d, (unsigned char)0x0a, (unsigned char)0x1a, (unsigned char)0x0a,
-         (unsigned char)0x00, (unsigned char)0x00, (unsigned char)0x00, (unsigned char)0x0d,
-         (unsigned char)0x49, (unsigned char)0x48, (unsigned char)0x44, (unsigned char)0x52
-    };
-    int pngHeaderSize = 16;
-    /**
-     * JPEG Header Data
-     */
-    unsigned char jpegHeader[] ={
-         (unsigned char)0xff, (unsigned char)0xd8, (unsigned char)0xff, (unsigned char)0xe0
-    };
-    int jpegHeaderSize = 4;
-
-    /**
-     * RAW Header Data
-     */
-    unsigned char rawHeader[] = {
-         (unsigned char)0x89, (unsigned char)0x53, (unsigned char)0x55, (unsigned char)0x4E
-    };
-
-    int rawHeaderSize = 4;
-
-    typedef struct _imageData{
-        int width;
-        int height;
-        char* pixelData;
-        int pixelDataSize;
-    }imageData;
-
-/**
- * Function to compare byte data to the given header
- */
-javacall_result headerMatch(unsigned char* header,int headerSize,
-                                unsigned char* imageData,
-                                int imageLength) {
-    int i=0;
-    if (imageLength < headerSize) {
-        return JAVACALL_FAIL;
-    }
-    for (i = 0; i < headerSize; i++) {
-        if (imageData[i] != header[i]) {
-            return JAVACALL_FAIL;
-        }
-    }
-    return JAVACALL_OK;
-}
-javacall_result initPNGImageInfo(unsigned char* source,long sourceSize,javacall_image_info* imageInfo){
-    int width = ((source[16] & 0x0ff) << 24) +
-                    ((source[17] & 0x0ff) << 16) +
-                    ((source[18] & 0x0ff) <<  8) +
-                    (source[19] & 0x0ff);
-
-    int height = ((source[20] & 0x0ff) << 24) +
-                     ((source[21] & 0x0ff) << 16) +
-                     ((source[22] & 0x0ff) <<  8) +
-                     (source[23] & 0x0ff);
-
-        if (width <= 0 || height <= 0) {
-            return JAVACALL_FAIL;
-        }
-        imageInfo->width = width;
-        imageInfo->height = height;
-        return JAVACALL_OK;
-
-}
-
-
-javacall_result initJPEGImageInfo(unsigned char* source,long sourceSize,javacall_image_info* imageInfo){
-        int width = 0;
-        int height = 0;
-        int field_len = 0;
-        int idx = 2;
-        unsigned char code;
-
-        while (idx + 8 <sourceSize) {
-            if (source[idx] != (unsigned char)0xff) {
-                break;
-            }
-
-            if ((unsigned char) (source[idx + 1] & 0xf0) == (unsigned char) 0xc0) {
-                code = source[idx + 1];
-
-                if (code != (unsigned char) 0xc4 || code != (unsigned char) 0xcc) {
-                    /* Big endian */
-                    height = ((source[idx + 5] & 0xff) << 8) +
-                            (source[idx + 6] & 0xff);
-                    width = ((source[idx + 7] & 0xff) << 8) +
-                            (source[idx + 8] & 0xff);
-                    break;
-                }
-            }
-
-            /* Go to the next marker */
-            field_len = ((source[idx + 2] & 0xff) << 8) +
-                    (source[idx + 3] & 0xff);
-            idx += field_len + 2;
-        }
-
-        if (width <= 0 || height <= 0) {
-            return JAVACALL_FAIL;
-        }
-        imageInfo->width = width;
-        imageInfo->height = height;
-        return JAVACALL_OK;
-
-}
+#include <javautil_image.h>
 
 /**
  * Get image information
@@ -159,18 +46,7 @@ javacall_result initJPEGImageInfo(unsigned char* source,long sourceSize,javacall
 javacall_result javacall_image_get_info(const void* source,
                                         long sourceSize,
                                         /*OUT*/ javacall_image_info* imageInfo){
-    javacall_result res= JAVACALL_FAIL;
-    //check what is the image format
-    if (headerMatch(pngHeader,pngHeaderSize,(unsigned char*)source,sourceSize)==JAVACALL_OK){
-        res = initPNGImageInfo((unsigned char*)source,sourceSize,imageInfo);
-        res = JAVACALL_FAIL;// currently supporting only jpeg via native image decoder
-
-    }else if(headerMatch(jpegHeader,jpegHeaderSize,(unsigned char*)source,sourceSize)==JAVACALL_OK){//JPEG
-        res = initJPEGImageInfo((unsigned char*)source,sourceSize,imageInfo);
-
-    }
-
-    return res;
+    return javautil_image_get_info(source, sourceSize, imageInfo);
 }
 
 /**
@@ -201,17 +77,9 @@ javacall_result javacall_image_decode_start(const void* source,
                                             long width,
                                             long height,
                                             /*OUT*/ javacall_handle* handle){
-    imageData* image= malloc(sizeof(imageData));
-    image->width = width;
-    image->height = height;
-    image->pixelDataSize = sourceSize;
-    image->pixelData =(char*) malloc(sourceSize*sizeof(char));
-    if (image->pixelData != NULL) {
-        memcpy(image->pixelData,source,sourceSize*sizeof(char));
-        *handle = (void*)image;
-        return JAVACALL_OK;
-    }
-    return JAVACALL_FAIL;
+    /* decoding is synchronous, the source stays valid until finish */
+    return javautil_image_decode_start(source, sourceSize, width, height,
+                                       JAVAUTIL_IMAGE_BORROW_SOURCE, handle);
 }
 
 /**
@@ -239,30 +107,6 @@ javacall_result javacall_image_decode_finish(javacall_handle handle,
                                              long decodeBufSize,
                                              /*OUT*/ char* alphaBuf,
                                              long alphaBufSize){
-
-    javacall_result result = JAVACALL_FAIL;
-    void *info ;
-    imageData* image = (imageData*)handle;
-
-    int i;
-    for (i=0;i<alphaBufSize;i++) {//initialize alpha buffer
-        alphaBuf[i]=(char)0xFF;
-    }
-    if (headerMatch(jpegHeader,jpegHeaderSize,image->pixelData,image->pixelDataSize)== JAVACALL_OK) {
-        info = JPEG_To_RGB_init();
-        if (info) {
-            int width, height;
-            if (JPEG_To_RGB_decodeHeader(info,image->pixelData, image->pixelDataSize,
-                &width, &height) != 0) {
-                if (JPEG_To_RGB_decodeData2(info,(char*)decodeBuf,
-                    sizeof(unsigned short), 0, 0, image->width, image->height) != 0) {
-                    result = JAVACALL_OK;
-                }
-            }
-            JPEG_To_RGB_free(info);
-        }
-    }else if (headerMatch(pngHeader,pngHeaderSize,image->pixelData,image->pixelDataSize)==JAVACALL_OK) {
-         result = JAVACALL_FAIL;
-    }
-    return result;
+    return javautil_image_decode_finish(handle, decodeBuf, decodeBufSize,
+                                        alphaBuf, alphaBufSize);
 }
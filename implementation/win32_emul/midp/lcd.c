@@ -29,9 +29,12 @@
 #include "stdlib.h"
 #include "javacall_penevent.h"
 #include "javacall_keypress.h"
+#include "javautil_pixel.h"
 
 #include <windows.h>
 
+#include "lcd.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -41,6 +44,11 @@ extern "C" {
 
 #define MAX_OVERLAYS          16
 
+/* Rectangles to output kept apart, more are merged */
+#define MAX_DIRTY_RECTS       8
+/* Pixels an output call costs on top of the pixels themselves */
+#define DIRTY_RECT_COST       2048
+
 /* if keying is used, video overrides only pixels of this color  */
 /* note that one single key color is shared by all overlays      */
 static javacall_pixel lcd_key_color; 
@@ -57,18 +65,30 @@ typedef struct _OVERLAY
     int              h;           /* video rectangle height (not clipped)                                        */
 } OVERLAY;
 
+typedef struct _LCD_RECT
+{
+    int x;
+    int y;
+    int w;
+    int h;
+} LCD_RECT;
+
 /* This is logical LCDUI putpixel screen buffer. */
 static struct {
     javacall_pixel*  hdc;         /* main offsreen buffer */
     javacall_pixel*  hdc_rotated; /* temporary buffer, used if emulator is rotated and/or updside down */
     char*            mask;        /* if video is output with keying, holds mask derived from hdc contents and key color */
     javacall_pixel*  composite;   /* temporary buffer for video compositing */
+    javacall_pixel*  packed;      /* rows of a rectangle output to the device */
     int              width;
     int              height;
     int              full_height; /* screen height in full screen mode */
     int              num_pixels;
     CRITICAL_SECTION cs;          /* used to synchronize video output with UI output */
     OVERLAY          overlay[ MAX_OVERLAYS ];
+    LCD_RECT         dirty[ MAX_DIRTY_RECTS ]; /* areas to output, in offscreen buffer coordinates */
+    int              num_dirty;
+    lcd_flush_stats  stats;
 } VRAM;
 
 static javacall_bool inFullScreenMode;
@@ -83,7 +103,7 @@ static javacall_bool top_down;
 static javacall_bool clamshell_opened;
 
 static void rotate_offscreen_buffer(javacall_pixel* dst, const javacall_pixel *src,
-                                    int src_width, int src_height);
+                                    int src_width, int src_height, LCD_RECT* rect);
 
 const static int MAIN_DISPLAY_ID = 0;
 const static int EXTE_DISPLAY_ID = 1;
@@ -176,6 +196,9 @@ javacall_result javacall_lcd_init(void) {
 
     VRAM.mask      = malloc(VRAM.num_pixels);
     VRAM.composite = (javacall_pixel*)malloc(VRAM.num_pixels * sizeof(javacall_pixel));
+    VRAM.packed    = (javacall_pixel*)malloc(VRAM.num_pixels * sizeof(javacall_pixel));
+    VRAM.num_dirty = 0;
+    memset( &VRAM.stats, 0, sizeof(VRAM.stats) );
 
     InitializeCriticalSection( &VRAM.cs );
 
@@ -208,6 +231,10 @@ javacall_result javacall_lcd_finalize(void){
             free(VRAM.composite);
             VRAM.composite = NULL;
         }
+        if( NULL != VRAM.packed ) {
+            free(VRAM.packed);
+            VRAM.packed = NULL;
+        }
         isLCDActive = JAVACALL_FALSE;
         DeleteCriticalSection( &VRAM.cs );
     }
@@ -264,54 +291,184 @@ javacall_pixel* javacall_lcd_get_screen(int hardwareId,
 }
 
 /**
- * Blends video frame from overlay channel into offscreen buffer
- * if keying is used, uses VRAM.mask to determine visible video pixels
- * VRAM.mask is generated in javacall_lcd_flush.
- * @param ovl_n         overlay channel number
- * @param buffer target offscreen buffer
+ * Gets the offscreen buffer area as the VM draws on it. Its width is
+ * the screen height if lcdui display is rotated.
+ * @param rect where to store the area
  */
-static void blend_video_into_buffer( int ovl_n, javacall_pixel* buffer ) {
-    int x, y;
-
-    int dst_x0 = VRAM.overlay[ ovl_n ].x;
-    int dst_y0 = VRAM.overlay[ ovl_n ].y;
-    int src_x0 = 0;
-    int src_y0 = 0;
-    int nx     = VRAM.overlay[ ovl_n ].w;
-    int ny     = VRAM.overlay[ ovl_n ].h;
-    int dstw   = (isLCDRotated ? VRAM.full_height : VRAM.width );
-    int dsth   = (isLCDRotated ? VRAM.width : VRAM.full_height );
-
-    if( dst_x0 < 0 ) {
-        nx -= -dst_x0;
-        src_x0 += -dst_x0;
-        dst_x0 = 0;
+static void get_buffer_rect( LCD_RECT* rect ) {
+    int rows = inFullScreenMode ? VRAM.full_height : VRAM.height;
+
+    rect->x = 0;
+    rect->y = 0;
+    rect->w = isLCDRotated ? rows : VRAM.width;
+    rect->h = isLCDRotated ? VRAM.width : rows;
+}
+
+static int rect_area( const LCD_RECT* r ) {
+    return r->w * r->h;
+}
+
+static void rect_union( const LCD_RECT* a, const LCD_RECT* b, LCD_RECT* u ) {
+    int x1 = max( a->x + a->w, b->x + b->w );
+    int y1 = max( a->y + a->h, b->y + b->h );
+
+    u->x = min( a->x, b->x );
+    u->y = min( a->y, b->y );
+    u->w = x1 - u->x;
+    u->h = y1 - u->y;
+}
+
+/**
+ * Pixels output needlessly if two rectangles are output as their union,
+ * negative if they overlap.
+ */
+static int merge_cost( const LCD_RECT* a, const LCD_RECT* b ) {
+    LCD_RECT u;
+
+    rect_union( a, b, &u );
+    return rect_area( &u ) - rect_area( a ) - rect_area( b );
+}
+
+/**
+ * Adds an area to output with the next flush_dirty_rects(). It is merged
+ * with the dirty rectangles that overlap it, or are near enough that one
+ * output call for their union costs less than two; if there are
+ * MAX_DIRTY_RECTS already, with the one that adds the fewest pixels.
+ * The area is clipped to the offscreen buffer.
+ */
+static void add_dirty_rect( int x, int y, int w, int h ) {
+    LCD_RECT screen;
+    LCD_RECT r;
+    int      i;
+    int      best;
+
+    get_buffer_rect( &screen );
+    r.x = max( x, 0 );
+    r.y = max( y, 0 );
+    r.w = min( x + w, screen.w ) - r.x;
+    r.h = min( y + h, screen.h ) - r.y;
+    if( r.w <= 0 || r.h <= 0 ) {
+        return;
     }
 
-    if( dst_y0 < 0 ) {
-        ny -= -dst_y0;
-        src_y0 += -dst_y0;
-        dst_y0 = 0;
+    for( i = 0; i < VRAM.num_dirty; ) {
+        if( merge_cost( &r, &VRAM.dirty[ i ] ) <= DIRTY_RECT_COST ) {
+            /* the union may reach rectangles already passed */
+            rect_union( &r, &VRAM.dirty[ i ], &r );
+            VRAM.dirty[ i ] = VRAM.dirty[ --VRAM.num_dirty ];
+            i = 0;
+        } else {
+            i++;
+        }
     }
 
-    if( dst_x0 + nx > dstw ) {
-        nx -= ( dst_x0 + nx - dstw );
+    if( VRAM.num_dirty == MAX_DIRTY_RECTS ) {
+        best = 0;
+        for( i = 1; i < VRAM.num_dirty; i++ ) {
+            if( merge_cost( &r, &VRAM.dirty[ i ] ) < merge_cost( &r, &VRAM.dirty[ best ] ) ) {
+                best = i;
+            }
+        }
+        rect_union( &r, &VRAM.dirty[ best ], &r );
+        VRAM.dirty[ best ] = VRAM.dirty[ --VRAM.num_dirty ];
     }
 
-    if( dst_y0 + ny > dsth ) {
-        ny -= ( dst_y0 + ny - dsth );
+    VRAM.dirty[ VRAM.num_dirty++ ] = r;
+}
+
+/**
+ * Gets the rectangle of an overlay channel clipped to the offscreen buffer.
+ * @return FALSE if none of it is on the screen
+ */
+static BOOL get_overlay_rect( int ovl_n, LCD_RECT* rect ) {
+    const OVERLAY* ovl = &VRAM.overlay[ ovl_n ];
+    LCD_RECT screen;
+
+    get_buffer_rect( &screen );
+    rect->x = max( ovl->x, 0 );
+    rect->y = max( ovl->y, 0 );
+    rect->w = min( ovl->x + ovl->w, screen.w ) - rect->x;
+    rect->h = min( ovl->y + ovl->h, screen.h ) - rect->y;
+    return rect->w > 0 && rect->h > 0;
+}
+
+/**
+ * Gets the bounding box of the video shown within an area of the
+ * offscreen buffer.
+ * @param area  area within the offscreen buffer
+ * @param video where to store the bounding box
+ * @return FALSE if no video is shown in the area
+ */
+static BOOL get_video_rect( const LCD_RECT* area, LCD_RECT* video ) {
+    LCD_RECT r;
+    BOOL     found = FALSE;
+    int      x1;
+    int      y1;
+    int      i;
+
+    for( i = 0; i < MAX_OVERLAYS; i++ ) {
+        if( NULL == VRAM.overlay[ i ].video || !get_overlay_rect( i, &r ) ) {
+            continue;
+        }
+        x1 = min( r.x + r.w, area->x + area->w );
+        y1 = min( r.y + r.h, area->y + area->h );
+        r.x = max( r.x, area->x );
+        r.y = max( r.y, area->y );
+        r.w = x1 - r.x;
+        r.h = y1 - r.y;
+        if( r.w <= 0 || r.h <= 0 ) {
+            continue;
+        }
+        if( found ) {
+            rect_union( video, &r, video );
+        } else {
+            *video = r;
+            found = TRUE;
+        }
+    }
+    return found;
+}
+
+/**
+ * Blends video frame from overlay channel into offscreen buffer
+ * if keying is used, uses VRAM.mask to determine visible video pixels
+ * VRAM.mask is generated in prepare_video_mask_and_composite.
+ * @param ovl_n  overlay channel number
+ * @param buffer target offscreen buffer
+ * @param clip   area of the buffer to blend into, within the buffer
+ */
+static void blend_video_into_buffer( int ovl_n, javacall_pixel* buffer,
+                                     const LCD_RECT* clip ) {
+    const OVERLAY* ovl = &VRAM.overlay[ ovl_n ];
+    LCD_RECT screen;
+    int      y;
+    int      dst_x0 = max( ovl->x, clip->x );
+    int      dst_y0 = max( ovl->y, clip->y );
+    int      dst_x1 = min( ovl->x + ovl->w, clip->x + clip->w );
+    int      dst_y1 = min( ovl->y + ovl->h, clip->y + clip->h );
+    int      nx     = dst_x1 - dst_x0;
+
+    if( nx <= 0 ) {
+        return;
     }
 
-    for( y = 0; y < ny; y++ ) {
-        for( x = 0; x < nx; x++ ) {
-            int dst_idx = dstw * ( dst_y0 + y ) + dst_x0 + x;
+    get_buffer_rect( &screen );
 
-            if( !VRAM.overlay[ ovl_n ].use_keying || VRAM.mask[ dst_idx ] ) {
-                buffer[ dst_idx ] =
-                    VRAM.overlay[ ovl_n ].video[ 
-                              VRAM.overlay[ ovl_n ].w * ( src_y0 + y ) 
-                            + src_x0 + x ];
-            }
+    for( y = dst_y0; y < dst_y1; y++ ) {
+        int dst_idx = screen.w * y + dst_x0;
+        const javacall_pixel* src = ovl->video
+            + ovl->w * ( y - ovl->y ) + ( dst_x0 - ovl->x );
+
+        if( !ovl->use_keying ) {
+            memcpy( buffer + dst_idx, src, nx * sizeof(javacall_pixel) );
+        } else if( sizeof(javacall_pixel) == 2 ) {
+            javautil_pixel_copy_masked16( (const unsigned short*)src,
+                (const unsigned char*)VRAM.mask + dst_idx,
+                (unsigned short*)buffer + dst_idx, nx );
+        } else {
+            javautil_pixel_copy_masked32( (const unsigned int*)src,
+                (const unsigned char*)VRAM.mask + dst_idx,
+                (unsigned int*)buffer + dst_idx, nx );
         }
     }
 }
@@ -319,30 +476,56 @@ static void blend_video_into_buffer( int ovl_n, javacall_pixel* buffer ) {
 /**
  * Checks colors of VRAM.hdc pixels and creates mask by comaring them with lcd_key_color.
  * also creates a copy of VRAM.hdc in VRAM.composite -- for blending video into it.
+ * The mask is only made while an overlay uses keying. VRAM.composite and
+ * VRAM.mask are only kept up to date within the overlay rectangles.
+ * @param rect area to prepare, within the offscreen buffer
  */
-static void prepare_video_mask_and_composite() {
+static void prepare_video_mask_and_composite( const LCD_RECT* rect ) {
+    LCD_RECT screen;
+    int      keying = 0;
+    int      i;
+    int      y;
 
-    int idx;
-
-    for( idx = 0; idx < VRAM.num_pixels; idx++ ) {
-        VRAM.mask[ idx ] = (lcd_key_color == VRAM.hdc[ idx ]);
+    for( i = 0; i < MAX_OVERLAYS; i++ ) {
+        keying |= VRAM.overlay[ i ].in_use && VRAM.overlay[ i ].use_keying;
     }
 
-    memcpy( VRAM.composite, VRAM.hdc, VRAM.num_pixels * sizeof(javacall_pixel) );
+    get_buffer_rect( &screen );
+
+    for( y = rect->y; y < rect->y + rect->h; y++ ) {
+        int idx = screen.w * y + rect->x;
+
+        if( !keying ) {
+            /* no mask needed */
+        } else if( sizeof(javacall_pixel) == 2 ) {
+            javautil_pixel_key_mask16( (const unsigned short*)VRAM.hdc + idx,
+                (unsigned char*)VRAM.mask + idx, rect->w,
+                (unsigned short)lcd_key_color );
+        } else {
+            javautil_pixel_key_mask32( (const unsigned int*)VRAM.hdc + idx,
+                (unsigned char*)VRAM.mask + idx, rect->w,
+                (unsigned int)lcd_key_color );
+        }
+
+        memcpy( VRAM.composite + idx, VRAM.hdc + idx, rect->w * sizeof(javacall_pixel) );
+    }
 }
 
 
 /**
- * Outputs offscreen buffer to device emulator screen.
+ * Outputs a rectangle of offscreen buffer to device emulator screen.
  * @param hardwareId unique hardware screen id
- * @param buffer     source offscreen buffer (already rotated)
+ * @param buffer     source offscreen buffer (not rotated yet)
+ * @param rect       area to output, in offscreen buffer coordinates
  */
-static void send_buffer_to_device( int hardwareId, javacall_pixel* buffer ) {
+static void send_rect_to_device( int hardwareId, javacall_pixel* buffer, LCD_RECT rect ) {
 
     static LimeFunction *f = NULL;
     static LimeFunction *f1 = NULL;
 
     javacall_pixel* hdc;
+    LCD_RECT        screen;
+    int             y;
 
     short clip[4] = {0,0,VRAM.width, VRAM.height};
 
@@ -353,34 +536,42 @@ static void send_buffer_to_device( int hardwareId, javacall_pixel* buffer ) {
     }
 
     if (isLCDRotated || top_down) {
-        rotate_offscreen_buffer(VRAM.hdc_rotated, buffer,
-                                inFullScreenMode ? VRAM.full_height : VRAM.height,
-                                VRAM.width);
+        /* rect becomes the area of the device screen */
+        get_buffer_rect( &screen );
+        rotate_offscreen_buffer(VRAM.hdc_rotated, buffer, screen.w, screen.h, &rect);
         hdc = VRAM.hdc_rotated;
     } else {
         hdc = buffer;
     }
 
+    /* rows across the whole screen are contiguous already */
+    if( rect.x == 0 && rect.w == VRAM.width ) {
+        hdc += rect.y * VRAM.width;
+    } else {
+        for( y = 0; y < rect.h; y++ ) {
+            memcpy( VRAM.packed + y * rect.w,
+                    hdc + ( rect.y + y ) * VRAM.width + rect.x,
+                    rect.w * sizeof(javacall_pixel) );
+        }
+        hdc = VRAM.packed;
+    }
+
+    VRAM.stats.rects++;
+    VRAM.stats.pixels += rect.w * rect.h;
+    VRAM.stats.last_pixels += rect.w * rect.h;
+
 #ifdef ENABLE_WTK
 
     f = NewLimeFunction(LIME_PACKAGE,
         LIME_GRAPHICS_CLASS,
         "drawRGB16");
 
-    if(inFullScreenMode) {
-        f->call(f, NULL, 0, 0, clip, 4, 0, hdc, (VRAM.width * VRAM.full_height) << 1, 0, 0, VRAM.width, VRAM.full_height);
-    } else {
-        f->call(f, NULL, 0, 0, clip, 4, 0, hdc, (VRAM.width * VRAM.height) << 1, 0, 0, VRAM.width, VRAM.height);
-    }
+    f->call(f, NULL, rect.x, rect.y, clip, 4, 0, hdc, (rect.w * rect.h) << 1, 0, 0, rect.w, rect.h);
 
     f1 = NewLimeFunction(LIME_PACKAGE,
         LIME_GRAPHICS_CLASS,
         "refresh");
-    if(inFullScreenMode) {
-        f1->call(f1, NULL, 0, 0, VRAM.width, VRAM.full_height);
-    } else {
-        f1->call(f1, NULL, 0, 0, VRAM.width, VRAM.height);
-    }
+    f1->call(f1, NULL, rect.x, rect.y, rect.w, rect.h);
 
 #else
 
@@ -390,21 +581,85 @@ static void send_buffer_to_device( int hardwareId, javacall_pixel* buffer ) {
         f1 = NewLimeFunction(LIME_PACKAGE, LIME_GRAPHICS_CLASS, "refreshDisplay");
     }
 
-    if(inFullScreenMode) {
-        f->call(f, NULL, currDisplayId, 0, 0, clip, 4, 0, hdc, 
-            (VRAM.width * VRAM.full_height) << 1, 0, 0, 
-            VRAM.width, VRAM.full_height);
-        f1->call(f1, NULL, currDisplayId, 0, 0, VRAM.width, VRAM.full_height);
-    } else {
-        f->call(f, NULL, currDisplayId, 0, 0, clip, 4, 0, hdc, 
-            (VRAM.width * VRAM.height) << 1, 0, 0, 
-            VRAM.width, VRAM.height);
-        f1->call(f1, NULL, currDisplayId, 0, 0, VRAM.width, VRAM.height);
-    }
+    f->call(f, NULL, currDisplayId, rect.x, rect.y, clip, 4, 0, hdc, 
+        (rect.w * rect.h) << 1, 0, 0, 
+        rect.w, rect.h);
+    f1->call(f1, NULL, currDisplayId, rect.x, rect.y, rect.w, rect.h);
 
 #endif
 }
 
+/**
+ * Outputs a dirty rectangle that shows video. Only the rows with the
+ * video are composited; the bands above and below go out from VRAM.hdc
+ * as they are, unless a band is too small to be worth an output call.
+ * Whole rows are kept together, as rows across the screen are output
+ * without packing them first.
+ * @param hardwareId unique hardware screen id
+ * @param rect       dirty rectangle, in offscreen buffer coordinates
+ * @param video      bounding box of the video within rect
+ */
+static void send_video_rect( int hardwareId, const LCD_RECT* rect, const LCD_RECT* video ) {
+    LCD_RECT above = *rect;
+    LCD_RECT below = *rect;
+    LCD_RECT band  = *rect;
+    int      i;
+
+    above.h = video->y - rect->y;
+    below.y = video->y + video->h;
+    below.h = rect->y + rect->h - below.y;
+    if( above.h * above.w <= DIRTY_RECT_COST ) {
+        above.h = 0;
+    }
+    if( below.h * below.w <= DIRTY_RECT_COST ) {
+        below.h = 0;
+    }
+    band.y = rect->y + above.h;
+    band.h = rect->h - above.h - below.h;
+
+    if( above.h > 0 ) {
+        send_rect_to_device( hardwareId, VRAM.hdc, above );
+    }
+    if( below.h > 0 ) {
+        send_rect_to_device( hardwareId, VRAM.hdc, below );
+    }
+
+    // javacall_lcd_flush() may be called again without VRAM.hdc being updated.
+    // if we blend video directly into VRAM.hdc, second call with unchanged
+    // VRAM.hdc will erase video mask. Hence separate VRAM.composite buffer.
+    prepare_video_mask_and_composite( &band );
+    for( i = 0; i < MAX_OVERLAYS; i++ ) {
+        if( NULL != VRAM.overlay[ i ].video ) {
+            blend_video_into_buffer( i, VRAM.composite, &band );
+        }
+    }
+    send_rect_to_device( hardwareId, VRAM.composite, band );
+}
+
+/**
+ * Outputs the dirty rectangles to device emulator screen and empties
+ * the list. Video overlays are composited where they show. Called with
+ * VRAM.cs held.
+ * @param hardwareId unique hardware screen id
+ */
+static void flush_dirty_rects( int hardwareId ) {
+    LCD_RECT video;
+    int      i;
+
+    VRAM.stats.frames++;
+    VRAM.stats.last_pixels = 0;
+
+    for( i = 0; i < VRAM.num_dirty; i++ ) {
+        if( get_video_rect( &VRAM.dirty[ i ], &video ) ) {
+            send_video_rect( hardwareId, &VRAM.dirty[ i ], &video );
+        } else {
+            send_rect_to_device( hardwareId, VRAM.hdc, VRAM.dirty[ i ] );
+        }
+    }
+
+    VRAM.num_dirty = 0;
+}
+
 /**
  * Used internally by MMAPI to allocate overlay channel.
  * @return number of allcoated channel for use in subsequent calls 
@@ -452,12 +707,16 @@ void lcd_close_overlay( int ovl_n )
  */
 void lcd_set_color_key( int ovl_n, javacall_bool use_keying, javacall_pixel key_color )
 {
+    LCD_RECT rect;
+
     EnterCriticalSection( &VRAM.cs );
     VRAM.overlay[ ovl_n ].use_keying = ( JAVACALL_TRUE == use_keying );
 
     if( VRAM.overlay[ ovl_n ].use_keying ) lcd_key_color  = key_color;
 
-    prepare_video_mask_and_composite();
+    if( get_overlay_rect( ovl_n, &rect ) ) {
+        prepare_video_mask_and_composite( &rect );
+    }
 
     LeaveCriticalSection( &VRAM.cs );
 }
@@ -473,11 +732,16 @@ void lcd_set_color_key( int ovl_n, javacall_bool use_keying, javacall_pixel key_
  */
 void lcd_set_video_rect( int ovl_n, int x, int y, int w, int h )
 {
+    LCD_RECT rect;
+
     EnterCriticalSection( &VRAM.cs );
     VRAM.overlay[ ovl_n ].x = x;
     VRAM.overlay[ ovl_n ].y = y;
     VRAM.overlay[ ovl_n ].w = w;
     VRAM.overlay[ ovl_n ].h = h;
+    if( get_overlay_rect( ovl_n, &rect ) ) {
+        prepare_video_mask_and_composite( &rect );
+    }
     LeaveCriticalSection( &VRAM.cs );
 }
 
@@ -491,19 +755,31 @@ void lcd_set_video_rect( int ovl_n, int x, int y, int w, int h )
  */
 void lcd_output_video_frame( int ovl_n, javacall_pixel* video ) {
 
-    int i;
+    int      i;
+    LCD_RECT rect;
 
     EnterCriticalSection( &VRAM.cs );
 
+    /* video starting here shows over the screen as it is now */
+    if( NULL == VRAM.overlay[ ovl_n ].video && get_overlay_rect( ovl_n, &rect ) ) {
+        prepare_video_mask_and_composite( &rect );
+    }
     VRAM.overlay[ ovl_n ].video = video;
 
+    /* only the video rectangles change, the rest of the screen is as sent */
     for( i = 0; i < MAX_OVERLAYS; i++ ) {
-        if( NULL != VRAM.overlay[ i ].video ) {
-            blend_video_into_buffer( i, VRAM.composite );
+        if( NULL != VRAM.overlay[ i ].video && get_overlay_rect( i, &rect ) ) {
+            blend_video_into_buffer( i, VRAM.composite, &rect );
         }
     }
 
-    send_buffer_to_device( javacall_lcd_get_current_hardwareId(), VRAM.composite );
+    VRAM.stats.frames++;
+    VRAM.stats.last_pixels = 0;
+    for( i = 0; i < MAX_OVERLAYS; i++ ) {
+        if( NULL != VRAM.overlay[ i ].video && get_overlay_rect( i, &rect ) ) {
+            send_rect_to_device( javacall_lcd_get_current_hardwareId(), VRAM.composite, rect );
+        }
+    }
 
     LeaveCriticalSection( &VRAM.cs );
 }
@@ -520,23 +796,13 @@ void lcd_output_video_frame( int ovl_n, javacall_pixel* video ) {
  */
 javacall_result javacall_lcd_flush(int hardwareId) {
 
-    javacall_pixel* hdc;
-    int             i;
+    LCD_RECT screen;
 
     EnterCriticalSection( &VRAM.cs );
-	 
-    // javacall_lcd_flush() may be called again without VRAM.hdc being updated.
-    // if we blend video directly into VRAM.hdc, second call with unchanged
-    // VRAM.hdc will erase video mask. Hence separate VRAM.composite buffer.
-    prepare_video_mask_and_composite();
-
-    for( i = 0; i < MAX_OVERLAYS; i++ ) {
-        if( NULL != VRAM.overlay[ i ].video ) {
-            blend_video_into_buffer( i, VRAM.composite );
-        }
-    }
 
-    send_buffer_to_device( hardwareId, VRAM.composite );
+    get_buffer_rect( &screen );
+    add_dirty_rect( screen.x, screen.y, screen.w, screen.h );
+    flush_dirty_rects( hardwareId );
 
     LeaveCriticalSection( &VRAM.cs );
 
@@ -544,61 +810,117 @@ javacall_result javacall_lcd_flush(int hardwareId) {
 }
 
 /**
- * Rotates offscreen buffer. Used if emulator is rotated and/or turned upside down
- * @param src        source buffer address
+ * Rotates a rectangle of offscreen buffer. Used if emulator is rotated and/or turned upside down
  * @param dst        destination buffer address
+ * @param src        source buffer address
  * @param src_width  source buffer width in pixels
- * @param src_height destination buffer width in pixels
+ * @param src_height source buffer height in pixels
+ * @param rect       area of the source to rotate, replaced by the area
+ *                   it covers in the destination
  */
 static void rotate_offscreen_buffer(javacall_pixel* dst, const javacall_pixel *src, 
-                                    int src_width, int src_height) {
-    int buffer_length = src_width*src_height;
+                                    int src_width, int src_height, LCD_RECT* rect) {
+    int      x1 = rect->x + rect->w;
+    int      y1 = rect->y + rect->h;
+    int      angle;
+    int      dst_width = src_width;
+    LCD_RECT out = *rect;
+
     if (isLCDRotated) {
+        /* destination rows are src_height pixels long */
+        dst_width = src_height;
+        out.w = rect->h;
+        out.h = rect->w;
         if (!top_down) {
-            const javacall_pixel *src_end = src + buffer_length;
-            javacall_pixel       *dst_end = dst + buffer_length;
-            dst += src_height - 1;
-            while (src < src_end) {
-                *dst = *(src++);
-                dst += src_height;
-                if (dst >= dst_end) {
-                    dst -= buffer_length + 1;
-                }
-            }
+            /* clockwise: (x, y) goes to (src_height - 1 - y, x) */
+            angle = JAVAUTIL_PIXEL_ROTATE_90;
+            out.x = src_height - y1;
+            out.y = rect->x;
         } else {
-            javacall_pixel *dst_end = dst + buffer_length;
-            const javacall_pixel *src_start = src;
-            dst += src_height - 1;
-            src += buffer_length - 1;
-            while (src >= src_start) {
-                *dst = *(src--);
-                dst += src_height;
-                if (dst >= dst_end) {
-                    dst -= buffer_length + 1;
-                }
-            }
+            /* counterclockwise: (x, y) goes to (y, src_width - 1 - x) */
+            angle = JAVAUTIL_PIXEL_ROTATE_270;
+            out.x = rect->y;
+            out.y = src_width - x1;
         }
+    } else if (top_down) {
+        /* upside down: (x, y) goes to (src_width - 1 - x, src_height - 1 - y) */
+        angle = JAVAUTIL_PIXEL_ROTATE_180;
+        out.x = src_width - x1;
+        out.y = src_height - y1;
     } else {
-        if (top_down) {
-            const javacall_pixel *src_end = src + buffer_length;
-            javacall_pixel       *dst_start = dst;
-            dst += buffer_length - 1;
-            while (src < src_end) {
-                *(dst--) = *(src++);
-                if (dst < dst_start) {
-                    dst += buffer_length - 1;
-                }
-            }
-        }
+        return;
+    }
+
+    src += rect->y * src_width + rect->x;
+    dst += out.y * dst_width + out.x;
+    if (sizeof(javacall_pixel) == 2) {
+        javautil_pixel_rotate16((const unsigned short*)src, src_width,
+                                (unsigned short*)dst, dst_width,
+                                rect->w, rect->h, angle);
+    } else {
+        javautil_pixel_rotate32((const unsigned int*)src, src_width,
+                                (unsigned int*)dst, dst_width,
+                                rect->w, rect->h, angle);
     }
+    *rect = out;
+}
+
+
+/**
+ * Clips an area of the offscreen buffer, as drawn at its x and y.
+ * @param rect  area to clip, replaced by the part within the buffer
+ * @param skipx where to store the number of columns clipped on the left
+ * @param skipy where to store the number of rows clipped at the top
+ * @return FALSE if none of the area is within the buffer
+ */
+static BOOL clip_to_buffer( LCD_RECT* rect, int* skipx, int* skipy ) {
+    LCD_RECT screen;
+    int      x1;
+    int      y1;
+
+    get_buffer_rect( &screen );
+    x1 = min( rect->x + rect->w, screen.w );
+    y1 = min( rect->y + rect->h, screen.h );
+    *skipx = max( -rect->x, 0 );
+    *skipy = max( -rect->y, 0 );
+    rect->x += *skipx;
+    rect->y += *skipy;
+    rect->w = x1 - rect->x;
+    rect->h = y1 - rect->y;
+    return rect->w > 0 && rect->h > 0;
 }
 
+/**
+ * Copies rows of pixels that may overlap, as when scrolling.
+ * @param dst       first pixel of the top destination row
+ * @param dstStride distance between destination rows in pixels
+ * @param src       first pixel of the top source row
+ * @param srcStride distance between source rows in pixels
+ * @param w         pixels per row
+ * @param h         number of rows
+ */
+static void move_rows( javacall_pixel* dst, int dstStride,
+                       const javacall_pixel* src, int srcStride, int w, int h ) {
+    int y;
+
+    if( dst > src ) {
+        /* a row copied down must not overwrite a row still to copy */
+        for( y = h - 1; y >= 0; y-- ) {
+            memmove( dst + y * dstStride, src + y * srcStride, w * sizeof(javacall_pixel) );
+        }
+    } else {
+        for( y = 0; y < h; y++ ) {
+            memmove( dst + y * dstStride, src + y * srcStride, w * sizeof(javacall_pixel) );
+        }
+    }
+}
 
 /**
  * The following native call implements an efficient bulk video memory erasure,
  * and should make use of existing hardware acceleration, either DMA copy or
  * graphics co-processor activation or misc acclerated assembly language
  * implementation
+ * The pixels are output with the next flush.
  * 
  * @param offsetInVram offset in number of pixels to start from
  * @param numberOfPixels number of Pixels to clear
@@ -608,7 +930,39 @@ static void rotate_offscreen_buffer(javacall_pixel* dst, const javacall_pixel *s
  * @retval JAVACALL_FAIL    fail
  */
 javacall_result javacall_lcd_set_pixels(int offsetInVram, int numberOfPixels, javacall_pixel color){
-    return JAVACALL_FAIL;
+    LCD_RECT screen;
+    int      end;
+    int      top;
+    int      bottom;
+
+    if( !isLCDActive || offsetInVram < 0 || numberOfPixels < 0 ) {
+        return JAVACALL_FAIL;
+    }
+
+    EnterCriticalSection( &VRAM.cs );
+
+    get_buffer_rect( &screen );
+    end = min( offsetInVram + numberOfPixels, screen.w * screen.h );
+    if( end > offsetInVram ) {
+        if( sizeof(javacall_pixel) == 2 ) {
+            javautil_pixel_fill16( (unsigned short*)VRAM.hdc + offsetInVram,
+                                   end - offsetInVram, (unsigned short)color );
+        } else {
+            javautil_pixel_fill32( (unsigned int*)VRAM.hdc + offsetInVram,
+                                   end - offsetInVram, (unsigned int)color );
+        }
+        top    = offsetInVram / screen.w;
+        bottom = ( end - 1 ) / screen.w;
+        if( top == bottom ) {
+            add_dirty_rect( offsetInVram - top * screen.w, top, end - offsetInVram, 1 );
+        } else {
+            add_dirty_rect( 0, top, screen.w, bottom - top + 1 );
+        }
+    }
+
+    LeaveCriticalSection( &VRAM.cs );
+
+    return JAVACALL_OK;
 }
 
 /**
@@ -616,6 +970,8 @@ javacall_result javacall_lcd_set_pixels(int offsetInVram, int numberOfPixels, ja
  * This sub section defines a API for blitting memory-mapped raster images to the
  * Video RAM (VRAM). This function should take advantage of Graphics coprocessor
  * and/or DMA to improve performance.
+ * The image is clipped to the screen and output with the next flush. It may be
+ * part of the screen itself.
  *
  * @param destScreenPtr a pointer to destination screen memory block 
  *                      (such asthe return value of javacall_lcd_get_screen() )
@@ -632,7 +988,152 @@ javacall_result javacall_lcd_set_pixels(int offsetInVram, int numberOfPixels, ja
  */
 javacall_result javacall_lcd_bitblit(javacall_pixel* destScreenPtr, 
                           javacall_pixel* srcImage, int imageWidth, int imageHeight, int x, int y){
-    return JAVACALL_FAIL;
+    LCD_RECT screen;
+    LCD_RECT rect;
+    int      skipx;
+    int      skipy;
+
+    if( !isLCDActive || destScreenPtr != VRAM.hdc || NULL == srcImage ) {
+        return JAVACALL_FAIL;
+    }
+
+    EnterCriticalSection( &VRAM.cs );
+
+    rect.x = x;
+    rect.y = y;
+    rect.w = imageWidth;
+    rect.h = imageHeight;
+    if( clip_to_buffer( &rect, &skipx, &skipy ) ) {
+        get_buffer_rect( &screen );
+        move_rows( VRAM.hdc + rect.y * screen.w + rect.x, screen.w,
+                   srcImage + skipy * imageWidth + skipx, imageWidth,
+                   rect.w, rect.h );
+        add_dirty_rect( rect.x, rect.y, rect.w, rect.h );
+    }
+
+    LeaveCriticalSection( &VRAM.cs );
+
+    return JAVACALL_OK;
+}
+
+/**
+ * Draws an image on the offscreen buffer, converting it to RGB565 and
+ * blending it if it has alpha. The image is clipped to the screen and
+ * output with the next flush.
+ *
+ * @param hardwareId unique hardware screen id
+ * @param src        top left pixel of the image
+ * @param srcStride  distance between the rows of src in bytes
+ * @param format     format of the image pixels
+ * @param width      image width in pixels
+ * @param height     image height in pixels
+ * @param x          x position on the screen to draw at
+ * @param y          y position on the screen to draw at
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_blit(int hardwareId, const void* src, 
+                                  int srcStride, 
+                                  javacall_lcd_blit_format format,
+                                  int width, int height, int x, int y) {
+    LCD_RECT             screen;
+    LCD_RECT             rect;
+    int                  skipx;
+    int                  skipy;
+    int                  row;
+    const unsigned char* s;
+    unsigned short*      d;
+
+    (void)hardwareId;
+    if( !isLCDActive || NULL == src || sizeof(javacall_pixel) != 2 ) {
+        return JAVACALL_FAIL;
+    }
+    if( format != JAVACALL_LCD_BLIT_RGB565 &&
+        format != JAVACALL_LCD_BLIT_XRGB8888 &&
+        format != JAVACALL_LCD_BLIT_ARGB8888 ) {
+        return JAVACALL_FAIL;
+    }
+
+    EnterCriticalSection( &VRAM.cs );
+
+    rect.x = x;
+    rect.y = y;
+    rect.w = width;
+    rect.h = height;
+    if( clip_to_buffer( &rect, &skipx, &skipy ) ) {
+        get_buffer_rect( &screen );
+        for( row = 0; row < rect.h; row++ ) {
+            s = (const unsigned char*)src + ( skipy + row ) * srcStride;
+            d = (unsigned short*)VRAM.hdc + ( rect.y + row ) * screen.w + rect.x;
+            if( format == JAVACALL_LCD_BLIT_RGB565 ) {
+                memcpy( d, s + skipx * 2, rect.w * 2 );
+            } else if( format == JAVACALL_LCD_BLIT_XRGB8888 ) {
+                javautil_pixel_argb8888_to_rgb565( (const unsigned int*)s + skipx,
+                                                   d, NULL, rect.w );
+            } else {
+                javautil_pixel_blend_argb8888_to_rgb565( (const unsigned int*)s + skipx,
+                                                         d, rect.w );
+            }
+        }
+        add_dirty_rect( rect.x, rect.y, rect.w, rect.h );
+    }
+
+    LeaveCriticalSection( &VRAM.cs );
+
+    return JAVACALL_OK;
+}
+
+/**
+ * Moves an area of the offscreen buffer, for example to scroll it. The
+ * part moved to is output with the next flush.
+ *
+ * @param hardwareId unique hardware screen id
+ * @param x          left side of the area
+ * @param y          top side of the area
+ * @param width      width of the area
+ * @param height     height of the area
+ * @param dx         horizontal distance to move the area by
+ * @param dy         vertical distance to move the area by
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_copy_area(int hardwareId, int x, int y, 
+                                       int width, int height, 
+                                       int dx, int dy) {
+    LCD_RECT screen;
+    LCD_RECT rect;
+    int      skipx;
+    int      skipy;
+
+    (void)hardwareId;
+    if( !isLCDActive ) {
+        return JAVACALL_FAIL;
+    }
+
+    EnterCriticalSection( &VRAM.cs );
+
+    /* the part of the area on the screen, then the part of that moved onto it */
+    rect.x = x;
+    rect.y = y;
+    rect.w = width;
+    rect.h = height;
+    if( clip_to_buffer( &rect, &skipx, &skipy ) ) {
+        rect.x += dx;
+        rect.y += dy;
+        if( clip_to_buffer( &rect, &skipx, &skipy ) ) {
+            get_buffer_rect( &screen );
+            move_rows( VRAM.hdc + rect.y * screen.w + rect.x, screen.w,
+                       VRAM.hdc + ( rect.y - dy ) * screen.w + rect.x - dx, screen.w,
+                       rect.w, rect.h );
+            add_dirty_rect( rect.x, rect.y, rect.w, rect.h );
+        }
+    }
+
+    LeaveCriticalSection( &VRAM.cs );
+
+    return JAVACALL_OK;
 }
     
 /**
@@ -651,8 +1152,28 @@ javacall_result javacall_lcd_bitblit(javacall_pixel* destScreenPtr,
  * @retval JAVACALL_FAIL    fail 
  */
 javacall_result /*OPTIONAL*/ javacall_lcd_flush_partial(int hardwareId, int ystart, int yend){
-	javacall_lcd_flush(hardwareId);
-    return JAVACALL_FAIL;
+    LCD_RECT screen;
+
+    EnterCriticalSection( &VRAM.cs );
+
+    get_buffer_rect( &screen );
+    add_dirty_rect( 0, ystart, screen.w, yend - ystart + 1 );
+    flush_dirty_rects( hardwareId );
+
+    LeaveCriticalSection( &VRAM.cs );
+
+    return JAVACALL_OK;
+}
+
+/**
+ * Used internally to report how many pixels the flushes output.
+ * @param stats where to store the counters
+ */
+void lcd_get_flush_stats( lcd_flush_stats* stats )
+{
+    EnterCriticalSection( &VRAM.cs );
+    *stats = VRAM.stats;
+    LeaveCriticalSection( &VRAM.cs );
 }
     
 
@@ -50,6 +50,22 @@
 
 extern HWND midpGetWindowHandle();
 
+/*
+ * Pixels output to the emulator screen by the LCD flushes, which only
+ * output the parts of the screen that changed.
+ */
+typedef struct {
+    unsigned long frames;       /* flushes and video frames output */
+    unsigned long rects;        /* rectangles output */
+    unsigned long pixels;       /* pixels output */
+    unsigned long last_pixels;  /* pixels output by the latest frame */
+} lcd_flush_stats;
+
+/*
+ *    The function gets the counters of the LCD output.
+ */
+void lcd_get_flush_stats(lcd_flush_stats* stats);
+
 /*
     Definitions to create the Lyfe Cycle of the Emulator Window
 */
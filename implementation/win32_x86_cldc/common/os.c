@@ -28,6 +28,8 @@ extern "C" {
 #endif
 
 #include "javacall_os.h"
+#include "javautil_cpu.h"
+#include "javautil_pixel.h"
 
 /*
  * Initialize the OS structure.
@@ -37,7 +39,9 @@ extern "C" {
  *
 */
 void javacall_os_initialize(void){
-    return;
+    /* probe the CPU and select the kernels before threads use them */
+    javautil_cpu_init();
+    javautil_pixel_init();
 }
 
 
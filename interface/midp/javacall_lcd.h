@@ -223,7 +223,11 @@ javacall_result javacall_lcd_finalize(void);
  *
  * This function is also used to get the screen raster pointer.
  * Subsequent calls to this function are required to return the same
- * address for a given LCD screen type.
+ * address for a given LCD screen type, except on implementations that
+ * flip between several screen buffers: there the raster may move with
+ * every javacall_lcd_flush() and javacall_lcd_flush_partial(), and the
+ * caller gets the screen again after each flush. The raster returned
+ * after a flush always holds the frame just flushed.
  *
  * If full screen mode is supported, the function should return the
  * screen size of the curently active mode, as set by the function
@@ -321,6 +325,101 @@ javacall_result javacall_lcd_flush_partial(int hardwareId, int ystart,
                                            int yend);
 #endif
 
+/**
+ * Fill pixels of the screen raster with a color. The pixels are drawn
+ * to the raster only; they reach the display with the next flush.
+ * Pixels past the end of the screen are ignored.
+ * Optional: implementations without it return <code>JAVACALL_FAIL</code>.
+ *
+ * @param offsetInVram offset in pixels from the top left pixel of the
+ *                     screen
+ * @param numberOfPixels number of pixels to fill
+ * @param color color to fill with
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_set_pixels(int offsetInVram, int numberOfPixels, 
+                                        javacall_pixel color);
+
+/**
+ * Copy an image to the screen raster, clipped to the screen. The image
+ * may be part of the raster itself, as when scrolling.
+ * Optional: implementations without it return <code>JAVACALL_FAIL</code>.
+ *
+ * @param destScreenPtr the screen raster, as returned by 
+ *                      javacall_lcd_get_screen()
+ * @param srcImage image of imageWidth * imageHeight pixels
+ * @param imageWidth image width in pixels
+ * @param imageHeight image height in pixels
+ * @param x x position on the screen to copy to
+ * @param y y position on the screen to copy to
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_bitblit(javacall_pixel* destScreenPtr, 
+                                     javacall_pixel* srcImage, 
+                                     int imageWidth, int imageHeight, 
+                                     int x, int y);
+
+/**
+ * @enum javacall_lcd_blit_format
+ * @brief Source pixel formats of javacall_lcd_blit()
+ */
+typedef enum {
+    /** 16-bit 5-6-5 pixels */
+    JAVACALL_LCD_BLIT_RGB565   = 0,
+    /** 32-bit 0xXXRRGGBB pixels, the top byte is ignored */
+    JAVACALL_LCD_BLIT_XRGB8888 = 1,
+    /** 32-bit 0xAARRGGBB pixels, not premultiplied, drawn source over */
+    JAVACALL_LCD_BLIT_ARGB8888 = 2
+} javacall_lcd_blit_format;
+
+/**
+ * Draw an image on the screen raster, clipped to the screen, converting
+ * it to the screen format and blending it if it has alpha. The image
+ * reaches the display with the next flush.
+ * Optional: implementations without it return <code>JAVACALL_FAIL</code>.
+ *
+ * @param hardwareId unique id of hardware display
+ * @param src top left pixel of the image
+ * @param srcStride distance between the rows of src in bytes
+ * @param format format of the image pixels
+ * @param width image width in pixels
+ * @param height image height in pixels
+ * @param x x position on the screen to draw at
+ * @param y y position on the screen to draw at
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail, or format not supported
+ */
+javacall_result javacall_lcd_blit(int hardwareId, const void* src, 
+                                  int srcStride, 
+                                  javacall_lcd_blit_format format,
+                                  int width, int height, int x, int y);
+
+/**
+ * Move an area of the screen raster, for example to scroll it. The 
+ * source and destination may overlap. Only the part of the area on the
+ * screen is moved, and only to where it is on the screen.
+ * Optional: implementations without it return <code>JAVACALL_FAIL</code>.
+ *
+ * @param hardwareId unique id of hardware display
+ * @param x left side of the area
+ * @param y top side of the area
+ * @param width width of the area
+ * @param height height of the area
+ * @param dx horizontal distance to move the area by
+ * @param dy vertical distance to move the area by
+ *
+ * @retval JAVACALL_OK      success
+ * @retval JAVACALL_FAIL    fail
+ */
+javacall_result javacall_lcd_copy_area(int hardwareId, int x, int y, 
+                                       int width, int height, 
+                                       int dx, int dy);
+
 /**
  * Reverse flag of rotation
  * @param hardwareId unique id of hardware display
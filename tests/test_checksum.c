@@ -0,0 +1,129 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * CRC-32 and Adler-32 against bit by bit and byte by byte references,
+ * at every alignment, for lengths around the block sizes of the fast
+ * paths and for data given in parts.
+ */
+
+#include "test_util.h"
+#include "javautil_checksum.h"
+
+#define MAX_LEN 20000
+
+static unsigned long crc32_ref(unsigned long crc, const unsigned char* buf,
+                               long len) {
+    long i;
+    int k;
+
+    crc = ~crc & 0xffffffffUL;
+    for (i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xedb88320UL & (0 - (crc & 1)));
+        }
+    }
+    return ~crc & 0xffffffffUL;
+}
+
+static unsigned long adler32_ref(unsigned long adler, const unsigned char* buf,
+                                 long len) {
+    unsigned long a = adler & 0xffff, b = adler >> 16;
+    long i;
+
+    for (i = 0; i < len; i++) {
+        a = (a + buf[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+int main(void) {
+    static const unsigned char check[] = "123456789";
+    unsigned char* data;
+    long len;
+    int k, off;
+
+    test_init();
+    data = test_alloc(MAX_LEN + 64);
+    for (k = 0; k < MAX_LEN + 64; k++) {
+        data[k] = (unsigned char)test_rand();
+    }
+
+    /* the check values of the standards */
+    CHECK(javautil_crc32(0, check, 9) == 0xcbf43926UL, ("crc32 check value"));
+    CHECK(javautil_adler32(1, check, 9) == 0x091e01deUL,
+          ("adler32 check value"));
+    CHECK(javautil_crc32(0, data, 0) == 0, ("crc32 of nothing"));
+    CHECK(javautil_adler32(1, data, 0) == 1, ("adler32 of nothing"));
+
+    /* every length up to a few blocks of the fast paths, every offset */
+    for (len = 0; len <= 300; len++) {
+        for (off = 0; off < 16; off++) {
+            CHECK(javautil_crc32(0, data + off, len)
+                  == crc32_ref(0, data + off, len),
+                  ("crc32 of %ld bytes at %d", len, off));
+            CHECK(javautil_adler32(1, data + off, len)
+                  == adler32_ref(1, data + off, len),
+                  ("adler32 of %ld bytes at %d", len, off));
+        }
+    }
+
+    /* long data, where the Adler-32 sums need reducing: all 0xff bytes */
+    memset(data, 0xff, MAX_LEN);
+    CHECK(javautil_adler32(1, data, MAX_LEN) == adler32_ref(1, data, MAX_LEN),
+          ("adler32 of 0xff bytes"));
+    CHECK(javautil_crc32(0, data, MAX_LEN) == crc32_ref(0, data, MAX_LEN),
+          ("crc32 of 0xff bytes"));
+
+    /* data given in parts, and combined Adler-32 of the parts */
+    for (k = 0; k < 200; k++) {
+        long n = test_rand() % MAX_LEN, split = n > 0 ? test_rand() % n : 0;
+        unsigned long crc, adler, adler2;
+
+        off = test_rand() % 64;
+        for (len = 0; len < n; len++) {
+            data[off + len] = (unsigned char)test_rand();
+        }
+        crc = javautil_crc32(javautil_crc32(0, data + off, split),
+                             data + off + split, n - split);
+        CHECK(crc == crc32_ref(0, data + off, n),
+              ("crc32 of %ld bytes in parts", n));
+        adler = javautil_adler32(javautil_adler32(1, data + off, split),
+                                 data + off + split, n - split);
+        CHECK(adler == adler32_ref(1, data + off, n),
+              ("adler32 of %ld bytes in parts", n));
+        adler2 = javautil_adler32_combine(
+            javautil_adler32(1, data + off, split),
+            javautil_adler32(1, data + off + split, n - split), n - split);
+        CHECK(adler2 == adler, ("adler32_combine of %ld and %ld bytes",
+                                split, n - split));
+    }
+
+    free(data);
+    return test_done("test_checksum");
+}
@@ -0,0 +1,516 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * GIF decoder.  The test writes animations with its own LZW encoder,
+ * with global and local color tables, transparency, interlacing,
+ * frames partly off the canvas and every disposal method, and
+ * compares the frames of the decoder with those of a plain
+ * compositor, in 32-bit and 16-bit canvases.
+ */
+
+#include "test_util.h"
+#include "gifdecoder.h"
+
+#define MAX_FRAMES  6
+
+typedef struct {
+    int x, y, width, height;
+    int disposal;
+    int delay;                  /* centiseconds */
+    int trans;                  /* transparent index, -1 for none */
+    int interlace;
+    int tableBits;              /* local table of 2^tableBits, 0 for none */
+    unsigned char table[3 * 256];
+    unsigned char* indices;     /* width * height, top to bottom */
+} test_frame;
+
+typedef struct {
+    int width, height;
+    int globalBits;             /* 0 for no global table */
+    unsigned char global[3 * 256];
+    int background;
+    int loop;                   /* -1 for no NETSCAPE2.0 extension */
+    int frameCount;
+    test_frame frames[MAX_FRAMES];
+} test_gif;
+
+/* Growing output buffer */
+typedef struct {
+    unsigned char* data;
+    long len;
+    long cap;
+} test_buf;
+
+static void buf_byte(test_buf* b, int v) {
+    if (b->len == b->cap) {
+        b->cap = 2 * b->cap + 256;
+        b->data = realloc(b->data, b->cap);
+        if (b->data == NULL) {
+            printf("out of memory\n");
+            exit(2);
+        }
+    }
+    b->data[b->len++] = (unsigned char)v;
+}
+
+static void buf_put(test_buf* b, const void* data, long len) {
+    long i;
+    for (i = 0; i < len; i++) {
+        buf_byte(b, ((const unsigned char*)data)[i]);
+    }
+}
+
+static void buf_put16(test_buf* b, int v) {
+    buf_byte(b, v & 0xff);
+    buf_byte(b, (v >> 8) & 0xff);
+}
+
+/* LZW code writer, least significant bit first */
+typedef struct {
+    test_buf out;
+    unsigned long bits;
+    int nbits;
+} test_codes;
+
+static void put_code(test_codes* c, int code, int size) {
+    c->bits |= (unsigned long)code << c->nbits;
+    c->nbits += size;
+    while (c->nbits >= 8) {
+        buf_byte(&c->out, (int)(c->bits & 0xff));
+        c->bits >>= 8;
+        c->nbits -= 8;
+    }
+}
+
+/*
+ * GIF LZW encoder with the usual code size increases and a clear code
+ * when the table is full.
+ */
+static void lzw_encode(test_buf* gif, const unsigned char* indices, long n,
+                       int minCode) {
+    static short next[4096][256];
+    int clear = 1 << minCode, size = minCode + 1, avail = clear + 2;
+    int prefix, sinceClear = 0;
+    test_codes c = { { NULL, 0, 0 }, 0, 0 };
+    long i, at;
+
+    memset(next, 0, sizeof(next));
+    put_code(&c, clear, size);
+    prefix = indices[0];
+    for (i = 1; i < n; i++) {
+        int k = indices[i];
+        if (next[prefix][k] != 0) {
+            prefix = next[prefix][k];
+            continue;
+        }
+        put_code(&c, prefix, size);
+        sinceClear++;
+        if (avail < 4096) {
+            next[prefix][k] = (short)avail++;
+            if (avail > (1 << size) && size < 12) {
+                size++;
+            }
+        } else {
+            put_code(&c, clear, size);
+            memset(next, 0, sizeof(next));
+            size = minCode + 1;
+            avail = clear + 2;
+            sinceClear = 0;
+        }
+        prefix = k;
+    }
+    put_code(&c, prefix, size);
+    /* the decoder adds an entry for the last code unless it follows clear */
+    if (sinceClear > 0 && avail == (1 << size) && size < 12) {
+        size++;
+    }
+    put_code(&c, clear + 1, size);
+    if (c.nbits > 0) {
+        buf_byte(&c.out, (int)c.bits);
+    }
+
+    buf_byte(gif, minCode);
+    for (at = 0; at < c.out.len; at += 255) {
+        long len = c.out.len - at < 255 ? c.out.len - at : 255;
+        buf_byte(gif, (int)len);
+        buf_put(gif, c.out.data + at, len);
+    }
+    buf_byte(gif, 0);
+    free(c.out.data);
+}
+
+/* Row of the frame stored at position r of an interlaced frame */
+static int interlaced_row(int r, int height) {
+    static const int start[4] = { 0, 4, 2, 1 };
+    static const int step[4] = { 8, 8, 4, 2 };
+    int pass, y;
+
+    for (pass = 0; pass < 4; pass++) {
+        for (y = start[pass]; y < height; y += step[pass]) {
+            if (r-- == 0) {
+                return y;
+            }
+        }
+    }
+    return -1;
+}
+
+static test_buf write_gif(const test_gif* g) {
+    test_buf b = { NULL, 0, 0 };
+    int f, r;
+
+    buf_put(&b, "GIF89a", 6);
+    buf_put16(&b, g->width);
+    buf_put16(&b, g->height);
+    buf_byte(&b, g->globalBits > 0 ? 0xf0 | (g->globalBits - 1) : 0);
+    buf_byte(&b, g->background);
+    buf_byte(&b, 0);
+    if (g->globalBits > 0) {
+        buf_put(&b, g->global, 3 << g->globalBits);
+    }
+    if (g->loop >= 0) {
+        buf_put(&b, "\x21\xff\x0bNETSCAPE2.0\x03\x01", 16);
+        buf_put16(&b, g->loop);
+        buf_byte(&b, 0);
+    }
+    for (f = 0; f < g->frameCount; f++) {
+        const test_frame* fr = &g->frames[f];
+        unsigned char* stored = test_alloc(fr->width * fr->height);
+        int bits = fr->tableBits > 0 ? fr->tableBits : g->globalBits;
+
+        buf_put(&b, "\x21\xf9\x04", 3);
+        buf_byte(&b, (fr->disposal << 2) | (fr->trans >= 0));
+        buf_put16(&b, fr->delay);
+        buf_byte(&b, fr->trans >= 0 ? fr->trans : 0);
+        buf_byte(&b, 0);
+        buf_byte(&b, 0x2c);
+        buf_put16(&b, fr->x);
+        buf_put16(&b, fr->y);
+        buf_put16(&b, fr->width);
+        buf_put16(&b, fr->height);
+        buf_byte(&b, (fr->tableBits > 0 ? 0x80 | (fr->tableBits - 1) : 0)
+                 | (fr->interlace ? 0x40 : 0));
+        if (fr->tableBits > 0) {
+            buf_put(&b, fr->table, 3 << fr->tableBits);
+        }
+        for (r = 0; r < fr->height; r++) {
+            int y = fr->interlace ? interlaced_row(r, fr->height) : r;
+            memcpy(stored + r * fr->width, fr->indices + y * fr->width,
+                   fr->width);
+        }
+        lzw_encode(&b, stored, (long)fr->width * fr->height,
+                   bits < 2 ? 2 : bits);
+        free(stored);
+    }
+    buf_byte(&b, 0x3b);
+    return b;
+}
+
+/*
+ * Plain compositor: the canvas starts transparent with the background
+ * color, and each frame is disposed of before the next one is drawn.
+ * @param canvas pixels 0xAARRGGBB, frame by frame
+ */
+static void composite(const test_gif* g, unsigned int* canvas) {
+    int n = g->width * g->height, f, x, y;
+    unsigned int bg = 0;
+    unsigned int* saved = test_alloc(4 * n);
+
+    if (g->globalBits > 0 && g->background < (1 << g->globalBits)) {
+        const unsigned char* c = g->global + 3 * g->background;
+        bg = (c[0] << 16) | (c[1] << 8) | c[2];
+    }
+    for (x = 0; x < n; x++) {
+        canvas[x] = bg;
+    }
+    for (f = 0; f < g->frameCount; f++) {
+        const test_frame* fr = &g->frames[f];
+        const unsigned char* table = fr->tableBits > 0 ? fr->table : g->global;
+        int size = 1 << (fr->tableBits > 0 ? fr->tableBits : g->globalBits);
+        unsigned int* cur = canvas + (long)f * n;
+
+        if (f > 0) {
+            const test_frame* prev = &g->frames[f - 1];
+            memcpy(cur, cur - n, 4 * n);
+            for (y = prev->y; y < prev->y + prev->height && y < g->height;
+                 y++) {
+                for (x = prev->x; x < prev->x + prev->width && x < g->width;
+                     x++) {
+                    if (prev->disposal == 2) {
+                        cur[y * g->width + x] = bg;
+                    } else if (prev->disposal == 3) {
+                        cur[y * g->width + x] = saved[y * g->width + x];
+                    }
+                }
+            }
+        }
+        memcpy(saved, cur, 4 * n);
+        for (y = 0; y < fr->height && fr->y + y < g->height; y++) {
+            for (x = 0; x < fr->width && fr->x + x < g->width; x++) {
+                int k = fr->indices[y * fr->width + x];
+                unsigned int* p = cur + (fr->y + y) * g->width + fr->x + x;
+                if (k == fr->trans) {
+                    continue;
+                }
+                *p = k < size
+                    ? 0xff000000U | (table[3 * k] << 16)
+                      | (table[3 * k + 1] << 8) | table[3 * k + 2]
+                    : 0xff000000U;
+            }
+        }
+    }
+    free(saved);
+}
+
+static void random_table(unsigned char* table, int bits) {
+    int i;
+    for (i = 0; i < 3 << bits; i++) {
+        table[i] = (unsigned char)test_rand();
+    }
+}
+
+static void make_gif(test_gif* g) {
+    int f, i;
+
+    memset(g, 0, sizeof(*g));
+    g->width = 1 + test_rand() % 60;
+    g->height = 1 + test_rand() % 60;
+    g->globalBits = test_rand() % 4 == 0 ? 0 : 1 + test_rand() % 8;
+    random_table(g->global, g->globalBits);
+    /* sometimes past the global table */
+    g->background = test_rand()
+        % (g->globalBits < 8 ? 2 << g->globalBits : 256);
+    g->loop = (int)(test_rand() % 4) - 1;
+    g->frameCount = 1 + test_rand() % MAX_FRAMES;
+    for (f = 0; f < g->frameCount; f++) {
+        test_frame* fr = &g->frames[f];
+        int size, runs = test_rand() % 3;
+
+        fr->x = test_rand() % g->width;
+        fr->y = test_rand() % g->height;
+        /* mostly on the canvas, sometimes past its edges */
+        fr->width = 1 + test_rand() % (g->width - fr->x + (test_rand() % 3));
+        fr->height = 1 + test_rand() % (g->height - fr->y + (test_rand() % 3));
+        if (f == 0 && test_rand() % 2) {
+            fr->x = fr->y = 0;
+            fr->width = g->width;
+            fr->height = g->height;
+        }
+        fr->disposal = test_rand() % 4;
+        fr->delay = test_rand() % 300;
+        fr->interlace = test_rand() % 3 == 0;
+        fr->tableBits = g->globalBits == 0 || test_rand() % 3 == 0
+            ? 1 + test_rand() % 8 : 0;
+        random_table(fr->table, fr->tableBits);
+        size = 1 << (fr->tableBits > 0 ? fr->tableBits : g->globalBits);
+        fr->trans = test_rand() % 2 ? (int)(test_rand() % size) : -1;
+        fr->indices = test_alloc(fr->width * fr->height);
+        for (i = 0; i < fr->width * fr->height; i++) {
+            /* runs and repeats for long codes, noise for short ones */
+            if (runs == 0 || (runs == 1 && i > 0 && test_rand() % 4 == 0)) {
+                fr->indices[i] = (unsigned char)(test_rand() % size);
+            } else {
+                fr->indices[i] = (unsigned char)
+                    ((i / (1 + runs * 3) + i / fr->width) % size);
+            }
+        }
+        /* with two colors the code size allows indices past the table */
+        if (size == 2 && fr->width * fr->height > 1) {
+            fr->indices[fr->width * fr->height / 2] = 3;
+        }
+    }
+}
+
+static unsigned short to565(unsigned int p) {
+    return (unsigned short)(((p >> 8) & 0xf800) | ((p >> 5) & 0x07e0)
+                            | ((p >> 3) & 0x001f));
+}
+
+static void check_gif(int k) {
+    test_gif g;
+    test_buf gif;
+    void* dec = GIF_To_RGB_init();
+    void* dec16 = GIF_To_RGB_init();
+    unsigned int *expected, *canvas;
+    unsigned short* canvas16;
+    unsigned char* alpha;
+    int w = 0, h = 0, n, f, i, delay, hasAlpha, pass;
+
+    make_gif(&g);
+    gif = write_gif(&g);
+    n = g.width * g.height;
+    expected = test_alloc(4 * n * g.frameCount);
+    canvas = test_alloc(4 * n);
+    canvas16 = test_alloc(2 * n);
+    alpha = test_alloc(n);
+    composite(&g, expected);
+
+    CHECK(GIF_To_RGB_decodeHeader(dec, (char*)gif.data, gif.len, &w, &h)
+          && w == g.width && h == g.height, ("gif %d: header", k));
+    CHECK(GIF_To_RGB_decodeHeader(dec16, (char*)gif.data, gif.len, &w, &h),
+          ("gif %d: header", k));
+    CHECK(GIF_To_RGB_getFrameCount(dec) == g.frameCount,
+          ("gif %d: %d frames, not %d", k, GIF_To_RGB_getFrameCount(dec),
+           g.frameCount));
+    CHECK(GIF_To_RGB_getLoopCount(dec) == g.loop, ("gif %d: loop count", k));
+    hasAlpha = 0;
+    for (f = 0; f < g.frameCount; f++) {
+        const test_frame* fr = &g.frames[f];
+        hasAlpha |= fr->trans >= 0 || fr->x != 0 || fr->y != 0
+            || fr->width < g.width || fr->height < g.height;
+    }
+    CHECK((GIF_To_RGB_hasAlpha(dec) != 0) == hasAlpha, ("gif %d: hasAlpha", k));
+
+    /* twice, the second time after rewinding */
+    for (pass = 0; pass < 2; pass++) {
+        for (f = 0; f < g.frameCount; f++) {
+            const unsigned int* e = expected + (long)f * n;
+            CHECK(GIF_To_RGB_nextFrame(dec, (char*)canvas, 4, (char*)alpha,
+                                       &delay) == 4 * n,
+                  ("gif %d frame %d: nextFrame", k, f));
+            CHECK(GIF_To_RGB_nextFrame(dec16, (char*)canvas16, 2, NULL, NULL)
+                  == 2 * n, ("gif %d frame %d: 16-bit nextFrame", k, f));
+            CHECK(delay == 10 * g.frames[f].delay, ("gif %d frame %d: delay",
+                                                    k, f));
+            for (i = 0; i < n; i++) {
+                if (canvas[i] != e[i] || alpha[i] != e[i] >> 24
+                    || canvas16[i] != to565(e[i])) {
+                    CHECK(0, ("gif %d %dx%d frame %d disposal %d: pixel %d,%d "
+                              "is %08x, not %08x", k, g.width, g.height, f,
+                              g.frames[f].disposal, i % g.width, i / g.width,
+                              canvas[i], e[i]));
+                    break;
+                }
+            }
+        }
+        CHECK(GIF_To_RGB_nextFrame(dec, (char*)canvas, 4, (char*)alpha,
+                                   NULL) == 0, ("gif %d: frame after last", k));
+        GIF_To_RGB_rewind(dec);
+        GIF_To_RGB_rewind(dec16);
+    }
+
+    /* the first frame of the still image decodes, in a rectangle */
+    {
+        int l = test_rand() % g.width, r = l + 1 + test_rand() % (g.width - l);
+        int t = test_rand() % g.height;
+        int b = t + 1 + test_rand() % (g.height - t);
+        int x, y;
+        unsigned char* rgb = test_alloc(3 * n);
+
+        CHECK(GIF_To_RGB_decodeData(dec, (char*)rgb) == 3 * n,
+              ("gif %d: decodeData", k));
+        for (i = 0; i < n; i++) {
+            if (rgb[3 * i] != ((expected[i] >> 16) & 0xff)
+                || rgb[3 * i + 1] != ((expected[i] >> 8) & 0xff)
+                || rgb[3 * i + 2] != (expected[i] & 0xff)) {
+                CHECK(0, ("gif %d: 24-bit pixel %d", k, i));
+                break;
+            }
+        }
+        CHECK(GIF_To_RGB_decodeDataAlpha(dec, (char*)canvas, 4, (char*)alpha,
+                                         l, t, r, b) == 4 * (r - l) * (b - t),
+              ("gif %d: decodeDataAlpha", k));
+        for (y = t; y < b; y++) {
+            for (x = l; x < r; x++) {
+                int o = (y - t) * (r - l) + x - l;
+                CHECK(canvas[o] == expected[y * g.width + x]
+                      && alpha[o] == expected[y * g.width + x] >> 24,
+                      ("gif %d: rectangle pixel %d,%d", k, x, y));
+            }
+        }
+        free(rgb);
+    }
+
+    GIF_To_RGB_free(dec);
+    GIF_To_RGB_free(dec16);
+    for (f = 0; f < g.frameCount; f++) {
+        free(g.frames[f].indices);
+    }
+    free(gif.data);
+    free(expected);
+    free(canvas);
+    free(canvas16);
+    free(alpha);
+}
+
+/* A frame large enough to fill the code table several times */
+static void check_large(void) {
+    test_gif g;
+    test_buf gif;
+    void* dec = GIF_To_RGB_init();
+    unsigned int *expected, *canvas;
+    int w, h, i, n;
+
+    memset(&g, 0, sizeof(g));
+    g.width = 300;
+    g.height = 200;
+    g.globalBits = 8;
+    random_table(g.global, 8);
+    g.loop = -1;
+    g.frameCount = 1;
+    g.frames[0].width = g.width;
+    g.frames[0].height = g.height;
+    g.frames[0].trans = -1;
+    n = g.width * g.height;
+    g.frames[0].indices = test_alloc(n);
+    for (i = 0; i < n; i++) {
+        g.frames[0].indices[i] = (unsigned char)(test_rand() % 7 == 0
+            ? test_rand()
+            : (unsigned int)((i % g.width) / 5 + (i / g.width) / 7));
+    }
+    gif = write_gif(&g);
+    expected = test_alloc(4 * n);
+    canvas = test_alloc(4 * n);
+    composite(&g, expected);
+    CHECK(GIF_To_RGB_decodeHeader(dec, (char*)gif.data, gif.len, &w, &h)
+          && GIF_To_RGB_nextFrame(dec, (char*)canvas, 4, NULL, NULL) == 4 * n
+          && memcmp(canvas, expected, 4 * n) == 0, ("large frame"));
+
+    /* cut short: what is there is drawn, the rest stays transparent */
+    CHECK(GIF_To_RGB_decodeHeader(dec, (char*)gif.data, gif.len / 2, &w, &h),
+          ("header of half an image"));
+    GIF_To_RGB_nextFrame(dec, (char*)canvas, 4, NULL, NULL);
+    CHECK(canvas[0] == expected[0] && (canvas[n - 1] >> 24) == 0,
+          ("half an image"));
+
+    GIF_To_RGB_free(dec);
+    free(g.frames[0].indices);
+    free(gif.data);
+    free(expected);
+    free(canvas);
+}
+
+int main(void) {
+    int k;
+
+    test_init();
+    for (k = 0; k < 400; k++) {
+        check_gif(k);
+    }
+    check_large();
+    return test_done("test_gif");
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * Decoded image cache against a model of an LRU cache with a byte
+ * budget: the same images are found, evicted in the same order, and
+ * counted the same.  Entries in use outlive eviction and clearing, and
+ * images whose keys agree but whose bytes differ are never confused.
+ */
+
+#include "test_util.h"
+#include "javautil_image_cache.h"
+
+#define IMAGES 60
+#define SOURCE_SIZE 64
+
+static unsigned char sources[IMAGES][SOURCE_SIZE];
+
+/* The model: images by recency, most recent first, and their bytes */
+static int order[IMAGES];
+static int cached;
+static long used;
+
+static void touch(int image) {
+    int i;
+
+    for (i = 0; i < cached && order[i] != image; i++) {
+    }
+    if (i == cached) {
+        cached++;
+    }
+    for (; i > 0; i--) {
+        order[i] = order[i - 1];
+    }
+    order[0] = image;
+}
+
+static int in_model(int image) {
+    int i;
+
+    for (i = 0; i < cached; i++) {
+        if (order[i] == image) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Image i is 100 to 1599 RGB565 pixels; odd images have alpha */
+static long pixel_count(int image) {
+    return 100 + (image * 37) % 1500;
+}
+
+static long image_bytes(int image, long overhead) {
+    long n = pixel_count(image);
+    return overhead + 2 * n + ((image & 1) ? n : 0);
+}
+
+static void make_key(javautil_image_cache_key* key, int image) {
+    javautil_image_cache_key_init(key, sources[image], SOURCE_SIZE,
+                                  JAVAUTIL_IMAGE_CACHE_RGB565,
+                                  pixel_count(image), 1);
+}
+
+/*
+ * Bytes the cache uses for an image besides its pixels and alpha,
+ * including its copy of the encoded bytes
+ */
+static long entry_overhead(void) {
+    static const unsigned short pixels[5] = { 0 };
+    javautil_image_cache_key key;
+    javautil_image_cache_stats stats;
+
+    javautil_image_cache_clear();
+    javautil_image_cache_key_init(&key, sources[0], SOURCE_SIZE,
+                                  JAVAUTIL_IMAGE_CACHE_RGB565, 5, 1);
+    javautil_image_cache_insert(&key, pixels, sizeof(pixels), NULL, 0);
+    javautil_image_cache_get_stats(&stats);
+    javautil_image_cache_clear();
+    return stats.bytes - (long)sizeof(pixels);
+}
+
+static void check_lru(void) {
+    unsigned short* pixels = test_alloc(2 * 1600);
+    unsigned char* alpha = test_alloc(1600);
+    long budget = 30000, overhead = entry_overhead();
+    unsigned long hits = 0, misses = 0;
+    javautil_image_cache_stats stats;
+    int k, i;
+
+    javautil_image_cache_set_budget(budget);
+    cached = 0;
+    used = 0;
+    for (k = 0; k < 100000; k++) {
+        int image = test_rand() % IMAGES;
+        long n = pixel_count(image);
+        javautil_image_cache_key key;
+        const javautil_image_cache_entry* e;
+
+        make_key(&key, image);
+        e = javautil_image_cache_lookup(&key);
+        CHECK((e != NULL) == in_model(image),
+              ("lookup %d of image %d", k, image));
+        if (e != NULL) {
+            const unsigned short* p = (const unsigned short*)e->pixels;
+            CHECK(e->pixelsSize == 2 * n && p[0] == image && p[n - 1] == image,
+                  ("pixels of image %d", image));
+            CHECK((image & 1) ? e->alpha != NULL && e->alphaSize == n
+                  && e->alpha[n - 1] == image : e->alpha == NULL,
+                  ("alpha of image %d", image));
+            javautil_image_cache_release(e);
+            touch(image);
+            hits++;
+            continue;
+        }
+        misses++;
+        for (i = 0; i < n; i++) {
+            pixels[i] = (unsigned short)image;
+            alpha[i] = (unsigned char)((image & 1) ? image : 0xff);
+        }
+        CHECK(javautil_image_cache_insert(&key, pixels, 2 * n, alpha, n)
+              == JAVACALL_OK, ("insert of image %d", image));
+        while (used + image_bytes(image, overhead) > budget) {
+            used -= image_bytes(order[--cached], overhead);
+        }
+        touch(image);
+        used += image_bytes(image, overhead);
+        javautil_image_cache_get_stats(&stats);
+        CHECK(stats.bytes == used && stats.entries == cached,
+              ("after insert %d: %ld bytes in %ld images, expected %ld in %d",
+               k, stats.bytes, stats.entries, used, cached));
+    }
+    javautil_image_cache_get_stats(&stats);
+    CHECK(stats.hits == hits && stats.misses == misses
+          && stats.budget == budget, ("counters"));
+    free(pixels);
+    free(alpha);
+}
+
+static void check_held(void) {
+    static char big[60000];
+    javautil_image_cache_key key;
+    const javautil_image_cache_entry* e;
+    javautil_image_cache_stats stats;
+
+    javautil_image_cache_clear();
+    javautil_image_cache_set_budget(100000);
+    javautil_image_cache_key_init(&key, "held", 4,
+                                  JAVAUTIL_IMAGE_CACHE_ARGB8888, 15000, 1);
+    CHECK(javautil_image_cache_insert(&key, big, sizeof(big), NULL, 0)
+          == JAVACALL_OK, ("insert"));
+    CHECK(javautil_image_cache_insert(&key, big, sizeof(big), NULL, 0)
+          == JAVACALL_OK, ("insert of a cached image"));
+    e = javautil_image_cache_lookup(&key);
+    CHECK(e != NULL, ("lookup"));
+
+    /* an entry in use outlives a smaller budget and a clear */
+    javautil_image_cache_set_budget(1000);
+    javautil_image_cache_clear();
+    CHECK(javautil_image_cache_lookup(&key) == e, ("held entry lost"));
+    javautil_image_cache_release(e);
+    javautil_image_cache_release(e);
+    javautil_image_cache_get_stats(&stats);
+    CHECK(stats.entries == 0 && stats.bytes == 0,
+          ("released entry over budget kept"));
+
+    /* an image larger than the budget is not cached */
+    CHECK(javautil_image_cache_insert(&key, big, sizeof(big), NULL, 0)
+          == JAVACALL_FAIL, ("insert over budget"));
+
+    /* a budget of 0 disables the cache */
+    javautil_image_cache_set_budget(0);
+    CHECK(javautil_image_cache_insert(&key, big, 10, NULL, 0)
+          == JAVACALL_FAIL, ("insert into a disabled cache"));
+    CHECK(javautil_image_cache_lookup(&key) == NULL,
+          ("lookup in a disabled cache"));
+}
+
+static void check_collisions(void) {
+    static const unsigned short pixels[4] = { 1, 2, 3, 4 };
+    unsigned char copy[SOURCE_SIZE];
+    javautil_image_cache_key key, other;
+    const javautil_image_cache_entry* e;
+
+    javautil_image_cache_clear();
+    javautil_image_cache_set_budget(JAVAUTIL_IMAGE_CACHE_DEFAULT_BUDGET);
+    javautil_image_cache_key_init(&key, sources[0], SOURCE_SIZE,
+                                  JAVAUTIL_IMAGE_CACHE_RGB565, 4, 1);
+    javautil_image_cache_insert(&key, pixels, sizeof(pixels), NULL, 0);
+
+    /* other bytes with the same hash, as a crafted collision */
+    other = key;
+    other.source = sources[1];
+    CHECK(javautil_image_cache_lookup(&other) == NULL,
+          ("lookup of other bytes with the same hash"));
+
+    /* identical bytes elsewhere find the image */
+    memcpy(copy, sources[0], SOURCE_SIZE);
+    javautil_image_cache_key_init(&other, copy, SOURCE_SIZE,
+                                  JAVAUTIL_IMAGE_CACHE_RGB565, 4, 1);
+    e = javautil_image_cache_lookup(&other);
+    CHECK(e != NULL && memcmp(e->pixels, pixels, sizeof(pixels)) == 0,
+          ("lookup of a copy of the bytes"));
+    javautil_image_cache_release(e);
+
+    /* the same bytes for another format or size are other images */
+    javautil_image_cache_key_init(&other, sources[0], SOURCE_SIZE,
+                                  JAVAUTIL_IMAGE_CACHE_ARGB8888, 2, 1);
+    CHECK(javautil_image_cache_lookup(&other) == NULL, ("other format"));
+    javautil_image_cache_key_init(&other, sources[0], SOURCE_SIZE,
+                                  JAVAUTIL_IMAGE_CACHE_RGB565, 2, 2);
+    CHECK(javautil_image_cache_lookup(&other) == NULL, ("other size"));
+    javautil_image_cache_key_init(&other, sources[0], SOURCE_SIZE - 1,
+                                  JAVAUTIL_IMAGE_CACHE_RGB565, 4, 1);
+    CHECK(javautil_image_cache_lookup(&other) == NULL, ("shorter bytes"));
+    javautil_image_cache_clear();
+}
+
+int main(void) {
+    int i, j;
+
+    test_init();
+    for (i = 0; i < IMAGES; i++) {
+        for (j = 0; j < SOURCE_SIZE; j++) {
+            sources[i][j] = (unsigned char)test_rand();
+        }
+    }
+    check_lru();
+    check_held();
+    check_collisions();
+    return test_done("test_image_cache");
+}
@@ -0,0 +1,375 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * JPEG encoder, decoder and coefficient transformations.  Encoded
+ * images decode close to their input, streamed encodes give the bytes
+ * of one-shot encodes, rotations and flips move the pixels where they
+ * belong and undo each other exactly, and fitting to a size stays
+ * within it.
+ */
+
+#include "test_util.h"
+#include "jpegencoder.h"
+#include "jpegdecoder.h"
+#include "jpegtransform.h"
+
+typedef struct {
+    char* data;
+    int len;
+    int cap;
+    int calls;
+    int abortAt;                /* call of the sink that fails, 0 for none */
+} test_sink;
+
+static int sink(void* sinkData, const char* data, int len) {
+    test_sink* s = (test_sink*)sinkData;
+
+    if (++s->calls == s->abortAt) {
+        return 0;
+    }
+    if (s->len + len > s->cap) {
+        s->cap = 2 * (s->len + len);
+        s->data = realloc(s->data, s->cap);
+        if (s->data == NULL) {
+            printf("out of memory\n");
+            exit(2);
+        }
+    }
+    memcpy(s->data + s->len, data, len);
+    s->len += len;
+    return 1;
+}
+
+/* Smooth RGB image with a little noise, as a photo */
+static unsigned char* make_image(int width, int height) {
+    unsigned char* rgb = test_alloc(3 * width * height);
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            unsigned char* p = rgb + 3 * (y * width + x);
+            p[0] = (unsigned char)(x * 255 / width);
+            p[1] = (unsigned char)(y * 255 / height);
+            p[2] = (unsigned char)(x * y * 252 / (width * height)
+                                   + (test_rand() & 3));
+        }
+    }
+    return rgb;
+}
+
+/* Decodes to 24-bit RGB, NULL on failure */
+static unsigned char* decode(char* jpeg, int len, int* width, int* height) {
+    void* info = JPEG_To_RGB_init();
+    unsigned char* rgb = NULL;
+
+    if (JPEG_To_RGB_decodeHeader(info, jpeg, len, width, height)) {
+        rgb = test_alloc(3 * *width * *height);
+        if (!JPEG_To_RGB_decodeData(info, (char*)rgb)) {
+            free(rgb);
+            rgb = NULL;
+        }
+    }
+    JPEG_To_RGB_free(info);
+    return rgb;
+}
+
+/* Mean squared difference of two images of n bytes */
+static double mse(const unsigned char* a, const unsigned char* b, int n) {
+    double e = 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        e += (double)(a[i] - b[i]) * (a[i] - b[i]);
+    }
+    return e / n;
+}
+
+static void check_round_trip(int width, int height) {
+    unsigned char* rgb = make_image(width, height);
+    char* jpeg = test_alloc(3 * width * height + 4096);
+    unsigned short* rgb565 = test_alloc(2 * width * height);
+    unsigned char* out;
+    int len, w = 0, h = 0, x, y, l, t, r, b;
+    void* info;
+
+    len = RGBToJPEG((char*)rgb, width, height, 90, jpeg,
+                    JPEG_ENCODER_COLOR_RGB);
+    CHECK(len > 0, ("encoding %dx%d", width, height));
+    out = decode(jpeg, len, &w, &h);
+    CHECK(out != NULL && w == width && h == height,
+          ("decoding %dx%d", width, height));
+    if (out == NULL) {
+        free(rgb);
+        free(jpeg);
+        free(rgb565);
+        return;
+    }
+    /* 30 dB */
+    CHECK(mse(rgb, out, 3 * width * height) < 65025.0 / 1000,
+          ("%dx%d at quality 90: mean squared error %.1f", width, height,
+           mse(rgb, out, 3 * width * height)));
+
+    /* 16-bit output of a rectangle is the 24-bit output truncated */
+    l = test_rand() % width;
+    r = l + 1 + test_rand() % (width - l);
+    t = test_rand() % height;
+    b = t + 1 + test_rand() % (height - t);
+    info = JPEG_To_RGB_init();
+    CHECK(JPEG_To_RGB_decodeHeader(info, jpeg, len, &w, &h)
+          && JPEG_To_RGB_decodeData2(info, (char*)rgb565, 2, l, t, r, b) != 0,
+          ("16-bit decode of %dx%d", width, height));
+    JPEG_To_RGB_free(info);
+    for (y = t; y < b; y++) {
+        for (x = l; x < r; x++) {
+            const unsigned char* p = out + 3 * (y * width + x);
+            unsigned short want = (unsigned short)(((p[0] & 0xf8) << 8)
+                | ((p[1] & 0xfc) << 3) | (p[2] >> 3));
+            CHECK(rgb565[(y - t) * (r - l) + x - l] == want,
+                  ("16-bit pixel %d,%d of %dx%d", x, y, width, height));
+        }
+    }
+    free(out);
+    free(rgb);
+    free(jpeg);
+    free(rgb565);
+}
+
+static void check_stream(void) {
+    static const JPEG_ENCODER_INPUT_COLOR_FORMAT formats[4] = {
+        JPEG_ENCODER_COLOR_RGB, JPEG_ENCODER_COLOR_BGR,
+        JPEG_ENCODER_COLOR_XRGB, JPEG_ENCODER_COLOR_BGRX
+    };
+    static const int pixelSize[4] = { 3, 3, 4, 4 };
+    int width = 123, height = 77, f, i, y, len;
+    unsigned char* input = test_alloc(4 * width * height);
+    char* jpeg = test_alloc(4 * width * height + 4096);
+    test_sink s;
+    void* enc;
+
+    for (i = 0; i < 4 * width * height; i++) {
+        input[i] = (unsigned char)((i * 13) ^ (i >> 9));
+    }
+    memset(&s, 0, sizeof(s));
+    for (f = 0; f < 4; f++) {
+        int stride = width * pixelSize[f];
+        len = RGBToJPEG((char*)input, width, height, 75, jpeg, formats[f]);
+        s.len = 0;
+        enc = RGB_To_JPEG_stream_init(width, height, 75, formats[f], sink, &s);
+        CHECK(enc != NULL && s.len > 0, ("stream init, format %d", formats[f]));
+        for (y = 0; y < height; ) {
+            int rows = 1 + test_rand() % 23;
+            if (rows > height - y) {
+                rows = height - y;
+            }
+            CHECK(RGB_To_JPEG_stream_write(enc, (char*)input + y * stride,
+                                           stride, rows), ("stream write"));
+            y += rows;
+        }
+        CHECK(RGB_To_JPEG_stream_finish(enc) == len && s.len == len
+              && memcmp(s.data, jpeg, len) == 0,
+              ("stream of format %d differs from one-shot encode", formats[f]));
+        RGB_To_JPEG_stream_free(enc);
+    }
+
+    /* a failing sink fails the encode */
+    s.len = 0;
+    s.calls = 0;
+    s.abortAt = 3;
+    enc = RGB_To_JPEG_stream_init(width, height, 75, JPEG_ENCODER_COLOR_RGB,
+                                  sink, &s);
+    CHECK(!RGB_To_JPEG_stream_write(enc, (char*)input, 3 * width, height)
+          || !RGB_To_JPEG_stream_finish(enc), ("encode with failing sink"));
+    RGB_To_JPEG_stream_free(enc);
+
+    /* so does finishing early */
+    s.abortAt = 0;
+    enc = RGB_To_JPEG_stream_init(width, height, 75, JPEG_ENCODER_COLOR_RGB,
+                                  sink, &s);
+    RGB_To_JPEG_stream_write(enc, (char*)input, 3 * width, height / 2);
+    CHECK(RGB_To_JPEG_stream_finish(enc) == 0, ("finish of half an image"));
+    RGB_To_JPEG_stream_free(enc);
+
+    free(s.data);
+    free(input);
+    free(jpeg);
+}
+
+/* Source pixel of output pixel (x, y) after a transform */
+static void source_of(int t, int x, int y, int sw, int sh, int* sx, int* sy) {
+    switch (t) {
+    case JPEG_TRANSFORM_FLIP_H:     *sx = sw - 1 - x; *sy = y;          break;
+    case JPEG_TRANSFORM_FLIP_V:     *sx = x;          *sy = sh - 1 - y; break;
+    case JPEG_TRANSFORM_TRANSPOSE:  *sx = y;          *sy = x;          break;
+    case JPEG_TRANSFORM_TRANSVERSE: *sx = sw - 1 - y; *sy = sh - 1 - x; break;
+    case JPEG_TRANSFORM_ROT_90:     *sx = y;          *sy = sh - 1 - x; break;
+    case JPEG_TRANSFORM_ROT_180:    *sx = sw - 1 - x; *sy = sh - 1 - y; break;
+    case JPEG_TRANSFORM_ROT_270:    *sx = sw - 1 - y; *sy = x;          break;
+    default:                        *sx = x;          *sy = y;          break;
+    }
+}
+
+static void check_transform(void) {
+    /* whole MCUs, so that nothing is dropped */
+    int width = 64, height = 48, t, len, n, w, h, x, y;
+    int size = 3 * width * height + 4096;
+    unsigned char* rgb = make_image(width, height);
+    char* jpeg = test_alloc(size);
+    char* out = test_alloc(size);
+    char* back = test_alloc(size);
+    unsigned char *ref, *pixels;
+
+    len = RGBToJPEG((char*)rgb, width, height, 90, jpeg,
+                    JPEG_ENCODER_COLOR_RGB);
+    ref = decode(jpeg, len, &w, &h);
+    for (t = JPEG_TRANSFORM_NONE; t <= JPEG_TRANSFORM_ROT_270; t++) {
+        int transposed = t == JPEG_TRANSFORM_TRANSPOSE
+            || t == JPEG_TRANSFORM_TRANSVERSE || t == JPEG_TRANSFORM_ROT_90
+            || t == JPEG_TRANSFORM_ROT_270;
+        static const JPEG_TRANSFORM_TYPE inverse[8] = {
+            JPEG_TRANSFORM_NONE, JPEG_TRANSFORM_FLIP_H, JPEG_TRANSFORM_FLIP_V,
+            JPEG_TRANSFORM_TRANSPOSE, JPEG_TRANSFORM_TRANSVERSE,
+            JPEG_TRANSFORM_ROT_270, JPEG_TRANSFORM_ROT_180,
+            JPEG_TRANSFORM_ROT_90
+        };
+        double err = 0;
+        unsigned char* again;
+
+        n = JPEG_Transform(jpeg, len, out, size, (JPEG_TRANSFORM_TYPE)t,
+                           &w, &h);
+        CHECK(n > 0 && w == (transposed ? height : width)
+              && h == (transposed ? width : height),
+              ("transform %d: %d bytes, %dx%d", t, n, w, h));
+        pixels = n > 0 ? decode(out, n, &w, &h) : NULL;
+        if (pixels == NULL) {
+            CHECK(0, ("decoding transform %d", t));
+            continue;
+        }
+        /* the IDCT rounds a little differently along rows and columns */
+        for (y = 0; y < h; y++) {
+            for (x = 0; x < w; x++) {
+                int sx, sy, c;
+                source_of(t, x, y, width, height, &sx, &sy);
+                for (c = 0; c < 3; c++) {
+                    err += abs(pixels[3 * (y * w + x) + c]
+                               - ref[3 * (sy * width + sx) + c]);
+                }
+            }
+        }
+        CHECK(err / (3 * w * h) < 1.0,
+              ("transform %d: mean error %.2f", t, err / (3 * w * h)));
+
+        /* the inverse transform restores the coefficients exactly */
+        n = JPEG_Transform(out, n, back, size, inverse[t], &w, &h);
+        again = n > 0 ? decode(back, n, &w, &h) : NULL;
+        CHECK(again != NULL && w == width && h == height
+              && memcmp(again, ref, 3 * width * height) == 0,
+              ("transform %d undone", t));
+        free(again);
+        free(pixels);
+    }
+
+    /* images of less than one MCU cannot be mirrored */
+    len = RGBToJPEG((char*)rgb, 7, 5, 90, jpeg, JPEG_ENCODER_COLOR_RGB);
+    CHECK(JPEG_Transform(jpeg, len, out, size, JPEG_TRANSFORM_FLIP_H,
+                         &w, &h) == 0, ("flip of 7x5"));
+    CHECK(JPEG_Transform(jpeg, len, out, 10, JPEG_TRANSFORM_NONE,
+                         &w, &h) == 0, ("transform to a small buffer"));
+    free(ref);
+    free(rgb);
+    free(jpeg);
+    free(out);
+    free(back);
+}
+
+static void check_fit(void) {
+    static const int flags[3] = {
+        0, JPEG_FIT_USE_ESTIMATOR,
+        JPEG_FIT_USE_ESTIMATOR | JPEG_FIT_ALLOW_DOWNSCALE
+    };
+    int width = 320, height = 240, len, n, f, k, w, h;
+    int size = 3 * width * height + 4096;
+    unsigned char* rgb = make_image(width, height);
+    char* jpeg = test_alloc(size);
+    char* out = test_alloc(size);
+    unsigned char* pixels;
+
+    len = RGBToJPEG((char*)rgb, width, height, 95, jpeg,
+                    JPEG_ENCODER_COLOR_RGB);
+
+    /* an image that fits is copied */
+    n = JPEG_FitToSize(jpeg, len, out, size, len, 5, 0, &w, &h);
+    CHECK(n == len && memcmp(out, jpeg, len) == 0 && w == width
+          && h == height, ("fit of an image that fits"));
+
+    for (f = 0; f < 3; f++) {
+        for (k = 20; k < 100; k += 10) {
+            int target = len * k / 100;
+            n = JPEG_FitToSize(jpeg, len, out, size, target, 5, flags[f],
+                               &w, &h);
+            CHECK(n > 0 && n <= target, ("fit to %d%%, flags %d: %d of %d "
+                                         "bytes", k, flags[f], n, target));
+            if (n <= 0) {
+                continue;
+            }
+            CHECK(w == width && h == height, ("fit to %d%% downscaled", k));
+            pixels = decode(out, n, &w, &h);
+            CHECK(pixels != NULL, ("decoding fit to %d%%", k));
+            free(pixels);
+        }
+    }
+
+    /* too small for any quality: fails, unless the image may shrink */
+    CHECK(JPEG_FitToSize(jpeg, len, out, size, len / 12, 20, 0, &w, &h) == 0,
+          ("fit to 1/12 at quality 20"));
+    n = JPEG_FitToSize(jpeg, len, out, size, len / 12, 20,
+                       JPEG_FIT_ALLOW_DOWNSCALE, &w, &h);
+    CHECK(n > 0 && n <= len / 12 && w < width && h < height
+          && (w == width / 2 || w == width / 4 || w == width / 8),
+          ("downscaled fit: %d bytes, %dx%d", n, w, h));
+    if (n > 0) {
+        int dw, dh;
+        pixels = decode(out, n, &dw, &dh);
+        CHECK(pixels != NULL && dw == w && dh == h,
+              ("decoding downscaled fit"));
+        free(pixels);
+    }
+    free(rgb);
+    free(jpeg);
+    free(out);
+}
+
+int main(void) {
+    test_init();
+    check_round_trip(64, 48);
+    check_round_trip(37, 29);
+    check_round_trip(1, 1);
+    check_round_trip(300, 7);
+    check_stream();
+    check_transform();
+    check_fit();
+    return test_done("test_jpeg");
+}
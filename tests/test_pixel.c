@@ -0,0 +1,475 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * Pixel conversions: the C implementation against the formulas of
+ * javautil_pixel.h, and every SIMD implementation this CPU supports
+ * against the C one, byte for byte, including the pixels past the end
+ * of each output.
+ */
+
+#include "test_util.h"
+
+/* Pixels of the inputs: every RGB565 value and every (color, alpha) */
+#define NPIXELS     (65536 + 37)
+#define GUARD       16
+#define GUARD_BYTE  0xAB
+
+static unsigned char* in_rgb;
+static unsigned short* in_16;
+static unsigned int* in_32;
+static unsigned char* in_alpha;
+static unsigned char* in_mask;
+
+static unsigned int widen5(unsigned int v) {
+    return (v << 3) | (v >> 2);
+}
+
+static unsigned int widen6(unsigned int v) {
+    return (v << 2) | (v >> 4);
+}
+
+static unsigned int narrow565(unsigned int r, unsigned int g, unsigned int b) {
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+/* t / 255 rounded to nearest, t up to 255 * 255 */
+static unsigned int div255(unsigned int t) {
+    return (2 * t + 255) / 510;
+}
+
+static void make_inputs(void) {
+    int i;
+
+    in_rgb = test_alloc(3 * NPIXELS);
+    in_16 = test_alloc(2 * NPIXELS);
+    in_32 = test_alloc(4 * NPIXELS);
+    in_alpha = test_alloc(NPIXELS);
+    in_mask = test_alloc(NPIXELS);
+    for (i = 0; i < 3 * NPIXELS; i++) {
+        in_rgb[i] = (unsigned char)test_rand();
+    }
+    for (i = 0; i < NPIXELS; i++) {
+        unsigned int c = i & 0xff, a = (i >> 8) & 0xff;
+        in_16[i] = (unsigned short)(i < 65536 ? (unsigned int)i : test_rand());
+        in_32[i] = i < 65536
+            ? (a << 24) | (c << 16) | (((c * 7) & 0xff) << 8) | (c ^ 0x5a)
+            : test_rand();
+        in_alpha[i] = (unsigned char)test_rand();
+        in_mask[i] = (test_rand() & 1) ? (unsigned char)(test_rand() | 1) : 0;
+    }
+}
+
+/* Output buffer of count elements followed by a guard */
+static void* guarded(void* buf, int bytes) {
+    memset(buf, GUARD_BYTE, bytes + GUARD);
+    return buf;
+}
+
+/*
+ * Runs every conversion on count pixels of the inputs from first and
+ * appends the outputs with their guards to trace.
+ * @return number of bytes appended
+ */
+static long run_conversions(int first, int count, unsigned char* trace) {
+    unsigned char* t = trace;
+    int n2 = 2 * count + GUARD, n3 = 3 * count + GUARD, n4 = 4 * count + GUARD;
+    int i;
+
+    javautil_pixel_rgb888_to_rgb565(in_rgb + 3 * first,
+        guarded(t, 2 * count), count);
+    t += n2;
+    javautil_pixel_rgb888_to_xrgb8888(in_rgb + 3 * first,
+        guarded(t, 4 * count), count);
+    t += n4;
+    javautil_pixel_xrgb8888_to_rgb888(in_32 + first,
+        guarded(t, 3 * count), count);
+    t += n3;
+    javautil_pixel_rgb565_to_rgb888(in_16 + first,
+        guarded(t, 3 * count), count);
+    t += n3;
+    javautil_pixel_rgb565_to_argb8888(in_16 + first, in_alpha + first,
+        guarded(t, 4 * count), count);
+    t += n4;
+    javautil_pixel_rgb565_to_argb8888(in_16 + first, NULL,
+        guarded(t, 4 * count), count);
+    t += n4;
+    javautil_pixel_argb8888_to_rgb565(in_32 + first, guarded(t, 2 * count),
+        guarded(t + n2, count), count);
+    t += n2 + count + GUARD;
+    javautil_pixel_argb8888_to_rgb565(in_32 + first, guarded(t, 2 * count),
+        NULL, count);
+    t += n2;
+    javautil_pixel_argb8888_to_alpha(in_32 + first, guarded(t, count), count);
+    t += count + GUARD;
+    javautil_pixel_premultiply(in_32 + first, guarded(t, 4 * count), count);
+    t += n4;
+    javautil_pixel_unpremultiply(in_32 + first, guarded(t, 4 * count), count);
+    t += n4;
+
+    /* in place: copy the input first */
+    memcpy(guarded(t, 4 * count), in_32 + first, 4 * count);
+    javautil_pixel_premultiply((unsigned int*)t, (unsigned int*)t, count);
+    t += n4;
+    memcpy(guarded(t, 2 * count), in_16 + first, 2 * count);
+    javautil_pixel_byteswap16(t, count);
+    t += n2;
+    /* an odd address, as the data need not be aligned */
+    memcpy((unsigned char*)guarded(t, 4 * count + 1) + 1, in_32 + first,
+           4 * count);
+    javautil_pixel_byteswap32(t + 1, count);
+    t += n4 + 1;
+
+    javautil_pixel_key_mask16(in_16 + first, guarded(t, count), count,
+                              in_16[first + count / 2]);
+    t += count + GUARD;
+    javautil_pixel_key_mask32(in_32 + first, guarded(t, count), count,
+                              in_32[first + count / 3]);
+    t += count + GUARD;
+    guarded(t, 2 * count);
+    for (i = 0; i < count; i++) {
+        ((unsigned short*)t)[i] = (unsigned short)~i;
+    }
+    javautil_pixel_copy_masked16(in_16 + first, in_mask + first,
+                                 (unsigned short*)t, count);
+    t += n2;
+    guarded(t, 4 * count);
+    for (i = 0; i < count; i++) {
+        ((unsigned int*)t)[i] = ~(unsigned int)i;
+    }
+    javautil_pixel_copy_masked32(in_32 + first, in_mask + first,
+                                 (unsigned int*)t, count);
+    t += n4;
+    javautil_pixel_fill16(guarded(t, 2 * count), count, 0x1234);
+    t += n2;
+    javautil_pixel_fill32(guarded(t, 4 * count), count, 0x89abcdefU);
+    t += n4;
+
+    /* draw over the inputs with reversed order of pixels */
+    guarded(t, 2 * count);
+    for (i = 0; i < count; i++) {
+        ((unsigned short*)t)[i] = in_16[NPIXELS - 1 - first - i];
+    }
+    javautil_pixel_blend_argb8888_to_rgb565(in_32 + first,
+                                            (unsigned short*)t, count);
+    t += n2;
+    guarded(t, 4 * count);
+    for (i = 0; i < count; i++) {
+        ((unsigned int*)t)[i] = in_32[NPIXELS - 1 - first - i];
+    }
+    javautil_pixel_blend_argb8888_to_argb8888(in_32 + first,
+                                              (unsigned int*)t, count);
+    t += n4;
+    return (long)(t - trace);
+}
+
+/* Largest trace of run_conversions for count pixels */
+static long trace_size(int count) {
+    return 72L * count + 32L * GUARD;
+}
+
+/* The C implementation on all inputs against the documented formulas */
+static void check_formulas(void) {
+    unsigned char* trace = test_alloc(trace_size(NPIXELS));
+    unsigned char* t = trace;
+    int n = NPIXELS, i;
+
+    run_conversions(0, n, trace);
+    for (i = 0; i < n; i++) {
+        const unsigned char* p = in_rgb + 3 * i;
+        unsigned short s;
+        memcpy(&s, t + 2 * i, 2);
+        CHECK(s == narrow565(p[0], p[1], p[2]), ("rgb888_to_rgb565 %d", i));
+    }
+    t += 2 * n + GUARD;
+    for (i = 0; i < n; i++) {
+        const unsigned char* p = in_rgb + 3 * i;
+        unsigned int w;
+        memcpy(&w, t + 4 * i, 4);
+        CHECK(w == ((unsigned int)p[0] << 16 | p[1] << 8 | p[2]),
+              ("rgb888_to_xrgb8888 %d", i));
+    }
+    t += 4 * n + GUARD;
+    for (i = 0; i < n; i++) {
+        unsigned int w = in_32[i];
+        CHECK(t[3 * i] == ((w >> 16) & 0xff)
+              && t[3 * i + 1] == ((w >> 8) & 0xff)
+              && t[3 * i + 2] == (w & 0xff), ("xrgb8888_to_rgb888 %d", i));
+    }
+    t += 3 * n + GUARD;
+    for (i = 0; i < n; i++) {
+        unsigned int s = in_16[i];
+        CHECK(t[3 * i] == widen5(s >> 11)
+              && t[3 * i + 1] == widen6((s >> 5) & 63)
+              && t[3 * i + 2] == widen5(s & 31), ("rgb565_to_rgb888 %04x", s));
+    }
+    t += 3 * n + GUARD;
+    for (i = 0; i < n; i++) {
+        unsigned int s = in_16[i], w, w2;
+        unsigned int rgb = widen5(s >> 11) << 16 | widen6((s >> 5) & 63) << 8
+            | widen5(s & 31);
+        memcpy(&w, t + 4 * i, 4);
+        memcpy(&w2, t + 4 * n + GUARD + 4 * i, 4);
+        CHECK(w == ((unsigned int)in_alpha[i] << 24 | rgb),
+              ("rgb565_to_argb8888 %04x", s));
+        CHECK(w2 == (0xff000000U | rgb), ("rgb565_to_argb8888 opaque %04x", s));
+    }
+    t += 2 * (4 * n + GUARD);
+    for (i = 0; i < n; i++) {
+        unsigned int w = in_32[i];
+        unsigned short s, s2;
+        memcpy(&s, t + 2 * i, 2);
+        memcpy(&s2, t + 3 * n + 2 * GUARD + 2 * i, 2);
+        CHECK(s == narrow565((w >> 16) & 0xff, (w >> 8) & 0xff, w & 0xff)
+              && s2 == s, ("argb8888_to_rgb565 %08x", w));
+        CHECK(t[2 * n + GUARD + i] == w >> 24, ("alpha of rgb565 %08x", w));
+    }
+    t += 2 * n + GUARD + n + GUARD + 2 * n + GUARD;
+    for (i = 0; i < n; i++) {
+        CHECK(t[i] == in_32[i] >> 24, ("argb8888_to_alpha %d", i));
+    }
+    t += n + GUARD;
+    for (i = 0; i < n; i++) {
+        unsigned int w = in_32[i], a = w >> 24, pre = a << 24, un = 0, got, s;
+        for (s = 0; s < 24; s += 8) {
+            unsigned int c = (w >> s) & 0xff;
+            pre |= div255(c * a) << s;
+            if (a != 0) {
+                /* c * 255 / a with a 16-bit reciprocal, limited */
+                unsigned int v = (c * (((255U << 16) + a / 2) / a) + 0x8000)
+                    >> 16;
+                un |= (v > 255 ? 255 : v) << s;
+            }
+        }
+        if (a == 255) {
+            un = w;
+        } else if (a != 0) {
+            un |= a << 24;
+        }
+        memcpy(&got, t + 4 * i, 4);
+        CHECK(got == pre, ("premultiply %08x: %08x, not %08x", w, got, pre));
+        memcpy(&got, t + 2 * (4 * n + GUARD) + 4 * i, 4);
+        CHECK(got == pre, ("premultiply in place %08x", w));
+        memcpy(&got, t + 4 * n + GUARD + 4 * i, 4);
+        CHECK(got == un, ("unpremultiply %08x: %08x, not %08x", w, got, un));
+    }
+    t += 3 * (4 * n + GUARD);
+    for (i = 0; i < n; i++) {
+        CHECK(t[2 * i] == (in_16[i] >> 8) && t[2 * i + 1] == (in_16[i] & 0xff),
+              ("byteswap16 %d", i));
+    }
+    t += 2 * n + GUARD;
+    for (i = 0; i < n; i++) {
+        unsigned int w = in_32[i];
+        const unsigned char* p = t + 1 + 4 * i;
+        CHECK(p[0] == (w >> 24) && p[1] == ((w >> 16) & 0xff)
+              && p[2] == ((w >> 8) & 0xff) && p[3] == (w & 0xff),
+              ("byteswap32 %d", i));
+    }
+    CHECK(t[0] == GUARD_BYTE, ("byteswap32 wrote before the data"));
+    t += 4 * n + GUARD + 1;
+    for (i = 0; i < n; i++) {
+        CHECK(t[i] == (in_16[i] == in_16[n / 2] ? 0xff : 0),
+              ("key_mask16 %d", i));
+    }
+    t += n + GUARD;
+    for (i = 0; i < n; i++) {
+        CHECK(t[i] == (in_32[i] == in_32[n / 3] ? 0xff : 0),
+              ("key_mask32 %d", i));
+    }
+    t += n + GUARD;
+    for (i = 0; i < n; i++) {
+        unsigned short s;
+        memcpy(&s, t + 2 * i, 2);
+        CHECK(s == (in_mask[i] ? in_16[i] : (unsigned short)~i),
+              ("copy_masked16 %d", i));
+    }
+    t += 2 * n + GUARD;
+    for (i = 0; i < n; i++) {
+        unsigned int w;
+        memcpy(&w, t + 4 * i, 4);
+        CHECK(w == (in_mask[i] ? in_32[i] : ~(unsigned int)i),
+              ("copy_masked32 %d", i));
+    }
+    t += 4 * n + GUARD;
+    for (i = 0; i < n; i++) {
+        unsigned short s;
+        unsigned int w;
+        memcpy(&s, t + 2 * i, 2);
+        memcpy(&w, t + 2 * n + GUARD + 4 * i, 4);
+        CHECK(s == 0x1234 && w == 0x89abcdefU, ("fill %d", i));
+    }
+    t += 2 * n + GUARD + 4 * n + GUARD;
+    for (i = 0; i < n; i++) {
+        unsigned int w = in_32[i], a = w >> 24, d = in_16[n - 1 - i], s;
+        unsigned int dc[3], out[3], c;
+        dc[0] = widen5(d >> 11);
+        dc[1] = widen6((d >> 5) & 63);
+        dc[2] = widen5(d & 31);
+        for (c = 0; c < 3; c++) {
+            out[c] = div255(((w >> (16 - 8 * c)) & 0xff) * a
+                            + dc[c] * (255 - a));
+        }
+        memcpy(&s, t + 2 * i, 2);
+        CHECK(s == narrow565(out[0], out[1], out[2]),
+              ("blend_argb8888_to_rgb565 %08x over %04x: %04x", w, d, s));
+    }
+    t += 2 * n + GUARD;
+    for (i = 0; i < n; i++) {
+        unsigned int w = in_32[i], a = w >> 24, d = in_32[n - 1 - i];
+        unsigned int want = (a + div255((d >> 24) * (255 - a))) << 24, got, c;
+        for (c = 0; c < 24; c += 8) {
+            want |= div255(((w >> c) & 0xff) * a
+                           + ((d >> c) & 0xff) * (255 - a)) << c;
+        }
+        memcpy(&got, t + 4 * i, 4);
+        CHECK(got == want, ("blend_argb8888_to_argb8888 %08x over %08x: %08x",
+                            w, d, got));
+    }
+    free(trace);
+}
+
+/* Location of source pixel (x, y) in a width by height rectangle rotated */
+static int rotated_offset(int x, int y, int width, int height, int angle,
+                          int stride) {
+    switch (angle) {
+    case JAVAUTIL_PIXEL_ROTATE_90:
+        return x * stride + (height - 1 - y);
+    case JAVAUTIL_PIXEL_ROTATE_180:
+        return (height - 1 - y) * stride + (width - 1 - x);
+    default:
+        return (width - 1 - x) * stride + y;
+    }
+}
+
+static void check_rotate(void) {
+    static const int angles[] = {
+        JAVAUTIL_PIXEL_ROTATE_90, JAVAUTIL_PIXEL_ROTATE_180,
+        JAVAUTIL_PIXEL_ROTATE_270
+    };
+    int k;
+
+    for (k = 0; k < 150; k++) {
+        int width = 1 + test_rand() % 70, height = 1 + test_rand() % 70;
+        int angle = angles[k % 3];
+        int srcStride = width + test_rand() % 5;
+        int dstWidth = angle == JAVAUTIL_PIXEL_ROTATE_180 ? width : height;
+        int dstHeight = angle == JAVAUTIL_PIXEL_ROTATE_180 ? height : width;
+        int dstStride = dstWidth + test_rand() % 5;
+        int size = dstStride * dstHeight;
+        unsigned short* d16 = test_alloc(2 * size);
+        unsigned int* d32 = test_alloc(4 * size);
+        int x, y;
+
+        memset(d16, GUARD_BYTE, 2 * size);
+        memset(d32, GUARD_BYTE, 4 * size);
+        javautil_pixel_rotate16(in_16, srcStride, d16, dstStride,
+                                width, height, angle);
+        javautil_pixel_rotate32(in_32, srcStride, d32, dstStride,
+                                width, height, angle);
+        for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x++) {
+                int o = rotated_offset(x, y, width, height, angle, dstStride);
+                CHECK(d16[o] == in_16[y * srcStride + x]
+                      && d32[o] == in_32[y * srcStride + x],
+                      ("rotate %d of %dx%d at %d,%d", angle, width, height,
+                       x, y));
+            }
+        }
+        for (y = 0; y < dstHeight; y++) {
+            for (x = dstWidth; x < dstStride; x++) {
+                CHECK(d16[y * dstStride + x] == 0xABAB
+                      && d32[y * dstStride + x] == 0xABABABABU,
+                      ("rotate %d wrote past the rectangle", angle));
+            }
+        }
+        free(d16);
+        free(d32);
+    }
+}
+
+int main(void) {
+    static const int impls[] = {
+        JAVAUTIL_PIXEL_IMPL_SSE2, JAVAUTIL_PIXEL_IMPL_AVX2,
+        JAVAUTIL_PIXEL_IMPL_NEON
+    };
+    static const char* names[] = { "c", "sse2", "avx2", "neon" };
+    /* short runs for the tails of the vector loops, at each alignment */
+    static const int counts[] = {
+        0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100
+    };
+    int ncounts = sizeof(counts) / sizeof(counts[0]);
+    int best, i, k, first;
+    long size = 0, len;
+    unsigned char *expected, *trace;
+
+    test_init();
+    best = javautil_pixel_get_impl();
+    make_inputs();
+    for (first = 0; first < 4; first++) {
+        for (i = 0; i < ncounts; i++) {
+            size += trace_size(counts[i]);
+        }
+        size += trace_size(NPIXELS - 4);
+    }
+    expected = test_alloc(size);
+    trace = test_alloc(size);
+
+    javautil_pixel_set_impl(JAVAUTIL_PIXEL_IMPL_C);
+    check_formulas();
+    check_rotate();
+    len = 0;
+    for (first = 0; first < 4; first++) {
+        for (i = 0; i < ncounts; i++) {
+            len += run_conversions(first, counts[i], expected + len);
+        }
+        len += run_conversions(first, NPIXELS - 4, expected + len);
+    }
+
+    for (k = 0; k < (int)(sizeof(impls) / sizeof(impls[0])); k++) {
+        long at = 0;
+        if (javautil_pixel_set_impl(impls[k]) != impls[k]) {
+            continue;
+        }
+        printf("checking %s\n", names[impls[k]]);
+        check_rotate();
+        for (first = 0; first < 4; first++) {
+            for (i = 0; i <= ncounts; i++) {
+                int count = i < ncounts ? counts[i] : NPIXELS - 4;
+                long n = run_conversions(first, count, trace + at);
+                CHECK(memcmp(expected + at, trace + at, n) == 0,
+                      ("%s differs from c for %d pixels at %d",
+                       names[impls[k]], count, first));
+                at += n;
+            }
+        }
+    }
+    javautil_pixel_set_impl(best);
+
+    free(expected);
+    free(trace);
+    return test_done("test_pixel");
+}
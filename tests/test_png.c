@@ -0,0 +1,720 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * PNG encoder and decoder.  Images of every input format, compression
+ * level and filter strategy, truecolor and indexed, one-shot and
+ * streamed, go through the encoder and back through the decoder
+ * unchanged.  The decoder also reads images that this test writes
+ * itself in all color types, bit depths and filters, interlaced or
+ * not and with tRNS, and refuses damaged ones.
+ */
+
+#include "test_util.h"
+#include "javautil_checksum.h"
+#include "pngencoder.h"
+#include "pngdecoder.h"
+
+/* Growing output buffer */
+typedef struct {
+    unsigned char* data;
+    long len;
+    long cap;
+} test_buf;
+
+static void buf_put(test_buf* b, const void* data, long len) {
+    if (b->len + len > b->cap) {
+        b->cap = 2 * (b->len + len) + 256;
+        b->data = realloc(b->data, b->cap);
+        if (b->data == NULL) {
+            printf("out of memory\n");
+            exit(2);
+        }
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+static void buf_put32(test_buf* b, unsigned long v) {
+    unsigned char p[4];
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+    buf_put(b, p, 4);
+}
+
+static unsigned long get32(const unsigned char* p) {
+    return ((unsigned long)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static int png_sink(void* sinkData, const unsigned char* data, int len) {
+    buf_put((test_buf*)sinkData, data, len);
+    return 1;
+}
+
+/*
+ * Decodes a PNG to 0xAARRGGBB pixels, and checks that the other
+ * outputs of the decoder agree with them.
+ * @return the pixels, NULL if decoding failed
+ */
+static unsigned int* decode_png(const unsigned char* png, long len,
+                                int width, int height, int* hasAlpha) {
+    void* info = PNG_To_RGB_init();
+    unsigned int* argb = test_alloc(4 * width * height);
+    unsigned char* rgb = test_alloc(3 * width * height);
+    unsigned short* rgb565 = test_alloc(2 * width * height);
+    unsigned char* alpha = test_alloc(width * height);
+    int w = 0, h = 0, ok, i, l, t, r, b, x, y;
+
+    ok = info != NULL
+        && PNG_To_RGB_decodeHeader(info, (char*)png, len, &w, &h)
+        && w == width && h == height
+        && PNG_To_RGB_decodeDataAlpha(info, (char*)argb, 4, NULL,
+                                      0, 0, width, height) != 0;
+    if (ok) {
+        *hasAlpha = PNG_To_RGB_hasAlpha(info);
+        CHECK(PNG_To_RGB_decodeData(info, (char*)rgb) == 3 * width * height,
+              ("decodeData size"));
+        for (i = 0; i < width * height; i++) {
+            CHECK(rgb[3 * i] == ((argb[i] >> 16) & 0xff)
+                  && rgb[3 * i + 1] == ((argb[i] >> 8) & 0xff)
+                  && rgb[3 * i + 2] == (argb[i] & 0xff),
+                  ("24-bit pixel %d of %dx%d", i, width, height));
+        }
+        l = test_rand() % width;
+        r = l + 1 + test_rand() % (width - l);
+        t = test_rand() % height;
+        b = t + 1 + test_rand() % (height - t);
+        CHECK(PNG_To_RGB_decodeDataAlpha(info, (char*)rgb565, 2, (char*)alpha,
+                                         l, t, r, b) == 2 * (r - l) * (b - t),
+              ("decodeDataAlpha size"));
+        for (y = t; y < b; y++) {
+            for (x = l; x < r; x++) {
+                unsigned int p = argb[y * width + x];
+                int o = (y - t) * (r - l) + (x - l);
+                CHECK(rgb565[o] == (((p >> 8) & 0xf800) | ((p >> 5) & 0x07e0)
+                                    | ((p >> 3) & 0x001f))
+                      && alpha[o] == p >> 24,
+                      ("16-bit pixel %d,%d of %dx%d", x, y, width, height));
+            }
+        }
+    }
+    if (info != NULL) {
+        PNG_To_RGB_free(info);
+    }
+    free(rgb);
+    free(rgb565);
+    free(alpha);
+    if (!ok) {
+        free(argb);
+        return NULL;
+    }
+    return argb;
+}
+
+static int little_endian(void) {
+    unsigned int one = 1;
+    return *(unsigned char*)&one;
+}
+
+/* Input pixels of the encoder in one of JAVAUTIL_PNG_FORMAT_* */
+static unsigned char* make_input(int width, int height, int format,
+                                 int colors, int stride) {
+    unsigned char* input = test_alloc(stride * height);
+    unsigned int palette[256];
+    int x, y;
+
+    for (x = 0; x < 256; x++) {
+        palette[x] = test_rand() & 0xffffff;
+    }
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            unsigned int c;
+            unsigned char* p = input + y * stride + x * format;
+            if (colors == 0) {
+                c = test_rand();
+            } else if (colors < 0) {
+                /* smooth, as photos: filters and matches both matter */
+                c = ((x * 255 / width) << 16) | ((y * 255 / height) << 8)
+                    | (((x + y) / 3 + (test_rand() & 3)) & 0xff);
+            } else {
+                c = palette[(x / 3 + y * 7 + (test_rand() & 1)) % colors];
+            }
+            if (format == JAVAUTIL_PNG_FORMAT_RGB888) {
+                /* the low three bytes of a native 32-bit pixel */
+                p[little_endian() ? 2 : 0] = (unsigned char)(c >> 16);
+                p[1] = (unsigned char)(c >> 8);
+                p[little_endian() ? 0 : 2] = (unsigned char)c;
+            } else if (format == JAVAUTIL_PNG_FORMAT_RGBX888) {
+                c |= test_rand() << 24;
+                memcpy(p, &c, 4);
+            } else {
+                unsigned short s = (unsigned short)(((c >> 8) & 0xf800)
+                    | ((c >> 5) & 0x07e0) | ((c >> 3) & 0x001f));
+                memcpy(p, &s, 2);
+            }
+        }
+    }
+    return input;
+}
+
+/* Opaque 0xffRRGGBB the decoder should return for an input pixel */
+static unsigned int input_pixel(const unsigned char* p, int format) {
+    if (format == JAVAUTIL_PNG_FORMAT_RGB888) {
+        return little_endian()
+            ? 0xff000000U | (p[2] << 16) | (p[1] << 8) | p[0]
+            : 0xff000000U | (p[0] << 16) | (p[1] << 8) | p[2];
+    } else if (format == JAVAUTIL_PNG_FORMAT_RGBX888) {
+        unsigned int c;
+        memcpy(&c, p, 4);
+        return 0xff000000U | c;
+    } else {
+        unsigned short s;
+        unsigned int r, g, b;
+        memcpy(&s, p, 2);
+        r = s >> 11;
+        g = (s >> 5) & 63;
+        b = s & 31;
+        return 0xff000000U | (((r << 3) | (r >> 2)) << 16)
+            | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+    }
+}
+
+static int compare_uint(const void* a, const void* b) {
+    unsigned int x = *(const unsigned int*)a, y = *(const unsigned int*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Number of distinct colors of an input image */
+static int count_colors(const unsigned char* input, int width, int height,
+                        int format) {
+    unsigned int* c = test_alloc(4 * width * height);
+    int i, n = 0;
+
+    for (i = 0; i < width * height; i++) {
+        c[i] = input_pixel(input + i * format, format);
+    }
+    qsort(c, width * height, 4, compare_uint);
+    for (i = 0; i < width * height; i++) {
+        n += i == 0 || c[i] != c[i - 1];
+    }
+    free(c);
+    return n;
+}
+
+static void compare_input(const unsigned int* argb, const unsigned char* input,
+                          int width, int height, int format, int stride,
+                          const char* what) {
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            unsigned int want = input_pixel(input + y * stride + x * format,
+                                            format);
+            if (argb[y * width + x] != want) {
+                CHECK(0, ("%s %dx%d format %d: pixel %d,%d is %08x, not %08x",
+                          what, width, height, format, x, y,
+                          argb[y * width + x], want));
+                return;
+            }
+        }
+    }
+}
+
+static int encode(unsigned char* input, unsigned char* out, int width,
+                  int height, int format, const javautil_png_params* params) {
+    if (format == JAVAUTIL_PNG_FORMAT_RGB888) {
+        return javautil_media_rgb_to_png_params(input, out, width, height,
+                                                params);
+    } else if (format == JAVAUTIL_PNG_FORMAT_RGBX888) {
+        return javautil_media_rgbX888_to_png_params(input, out, width, height,
+                                                    params);
+    }
+    return javautil_media_rgb565_to_png_params((unsigned short*)input, out,
+                                               width, height, params);
+}
+
+static void check_round_trip(int width, int height, int format, int colors,
+                             const javautil_png_params* params) {
+    unsigned char* input = make_input(width, height, format, colors,
+                                      width * format);
+    unsigned char* out = test_alloc(javautil_media_get_png_size(width, height));
+    int len = encode(input, out, width, height, format, params);
+    int indexed, hasAlpha = 1;
+    unsigned int* argb;
+
+    CHECK(len > 0, ("encoding %dx%d format %d failed", width, height, format));
+    if (len > 0) {
+        indexed = count_colors(input, width, height, format) <= 256
+            && !params->truecolor && params->level != JAVAUTIL_PNG_LEVEL_NONE;
+        CHECK(out[25] == (indexed ? 3 : 2),
+              ("color type %d for %d colors, level %d, truecolor %d",
+               out[25], colors, params->level, params->truecolor));
+        argb = decode_png(out, len, width, height, &hasAlpha);
+        CHECK(argb != NULL, ("decoding %dx%d format %d, level %d, filter %d "
+                             "failed", width, height, format, params->level,
+                             params->filter));
+        if (argb != NULL) {
+            CHECK(!hasAlpha, ("encoded image has alpha"));
+            compare_input(argb, input, width, height, format, width * format,
+                          "round trip");
+            free(argb);
+        }
+    }
+    free(input);
+    free(out);
+}
+
+static void check_stream(int width, int height, int format, int colors,
+                         const javautil_png_params* params, int chunkSize) {
+    int stride = width * format + 4 * (test_rand() % 3);
+    unsigned char* input = make_input(width, height, format, colors, stride);
+    test_buf out = { NULL, 0, 0 };
+    javautil_png_stream* stream = javautil_media_png_stream_init(
+        width, height, format, params, chunkSize, png_sink, &out);
+    int y = 0, len = 0, hasAlpha;
+    long at;
+
+    CHECK(stream != NULL, ("stream init %dx%d", width, height));
+    if (stream == NULL) {
+        free(input);
+        return;
+    }
+    while (y < height) {
+        int rows = 1 + test_rand() % 40;
+        if (rows > height - y) {
+            rows = height - y;
+        }
+        CHECK(javautil_media_png_stream_write(stream, input + y * stride,
+                                              stride, rows),
+              ("stream write"));
+        y += rows;
+    }
+    len = javautil_media_png_stream_finish(stream);
+    javautil_media_png_stream_free(stream);
+    CHECK(len > 0 && len == out.len, ("stream size %d of %ld", len, out.len));
+
+    /* all IDAT chunks but the last are chunkSize long */
+    for (at = 8; at + 12 <= out.len; at += 12 + get32(out.data + at)) {
+        long n = get32(out.data + at);
+        if (memcmp(out.data + at + 4, "IDAT", 4) == 0
+            && memcmp(out.data + at + 12 + n + 4, "IDAT", 4) == 0) {
+            CHECK(n == (chunkSize > 0 ? chunkSize : 8192),
+                  ("IDAT of %ld bytes", n));
+        }
+    }
+    if (len > 0) {
+        unsigned int* argb = decode_png(out.data, len, width, height,
+                                        &hasAlpha);
+        CHECK(argb != NULL, ("decoding stream %dx%d", width, height));
+        if (argb != NULL) {
+            compare_input(argb, input, width, height, format, stride, "stream");
+            free(argb);
+        }
+    }
+    free(out.data);
+    free(input);
+}
+
+/* The output must not depend on the number of compressor threads */
+static void check_threads(void) {
+    int width = 400, height = 300, len1, len4, hasAlpha;
+    unsigned char* input = make_input(width, height, 3, -1, width * 3);
+    int size = javautil_media_get_png_size(width, height);
+    unsigned char* out1 = test_alloc(size);
+    unsigned char* out4 = test_alloc(size);
+    javautil_png_params params = { JAVAUTIL_PNG_LEVEL_DEFAULT,
+                                   JAVAUTIL_PNG_FILTER_DEFAULT, 2, 0 };
+    unsigned int* argb;
+
+    len1 = javautil_media_rgb_to_png_params(input, out1, width, height,
+                                            &params);
+    params.threads = 4;
+    len4 = javautil_media_rgb_to_png_params(input, out4, width, height,
+                                            &params);
+    CHECK(len1 > 0 && len1 == len4 && memcmp(out1, out4, len1) == 0,
+          ("2 and 4 threads give different output"));
+    argb = decode_png(out4, len4, width, height, &hasAlpha);
+    CHECK(argb != NULL, ("decoding threaded output"));
+    if (argb != NULL) {
+        compare_input(argb, input, width, height, 3, width * 3, "threads");
+        free(argb);
+    }
+    free(input);
+    free(out1);
+    free(out4);
+}
+
+/* Damaged images must fail rather than decode */
+static void check_damaged(void) {
+    int width = 37, height = 23, len, hasAlpha, k;
+    unsigned char* input = make_input(width, height, 3, 0, width * 3);
+    unsigned char* out = test_alloc(javautil_media_get_png_size(width, height));
+    javautil_png_params params = { JAVAUTIL_PNG_LEVEL_DEFAULT,
+                                   JAVAUTIL_PNG_FILTER_DEFAULT, 0, 0 };
+
+    len = javautil_media_rgb_to_png_params(input, out, width, height, &params);
+    for (k = 0; k < 50; k++) {
+        /* any byte of a chunk, past the signature */
+        int at = 8 + test_rand() % (len - 8);
+        unsigned char bit = (unsigned char)(1 << (test_rand() % 8));
+        unsigned int* argb;
+        out[at] ^= bit;
+        argb = decode_png(out, len, width, height, &hasAlpha);
+        CHECK(argb == NULL, ("decoded with byte %d of %d changed", at, len));
+        free(argb);
+        out[at] ^= bit;
+    }
+    CHECK(decode_png(out, len / 2, width, height, &hasAlpha) == NULL,
+          ("decoded half of the image"));
+    free(input);
+    free(out);
+}
+
+/*
+ * PNG writer of the test: stored deflate blocks, the given filter type
+ * on each row or a random one, and the image data split over several
+ * IDAT chunks.
+ */
+
+typedef struct {
+    int width;
+    int height;
+    int colorType;
+    int depth;
+    int interlace;
+    int channels;
+    unsigned short* samples;    /* channels samples per pixel */
+    unsigned char palette[3 * 256];
+    int paletteSize;
+    int trns;                   /* number of tRNS entries, 0 for none */
+    unsigned char trnsAlpha[256];
+    unsigned short key[3];      /* transparent color of types 0 and 2 */
+} test_png;
+
+static void put_chunk(test_buf* b, const char* type, const unsigned char* data,
+                      long len) {
+    buf_put32(b, len);
+    buf_put(b, type, 4);
+    buf_put(b, data, len);
+    buf_put32(b, javautil_crc32(javautil_crc32(0, (const unsigned char*)type,
+                                               4), data, len));
+}
+
+static int paeth(int a, int b, int c) {
+    int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return a;
+    }
+    return pb <= pc ? b : c;
+}
+
+/* Appends the filtered rows of one pass to raw */
+static void put_pass(test_buf* raw, const test_png* img, int x0, int y0,
+                     int dx, int dy, int filter) {
+    int bits = img->depth * img->channels, bpp = bits < 8 ? 1 : bits / 8;
+    int pw = img->width > x0 ? (img->width - x0 + dx - 1) / dx : 0;
+    int rowBytes = (pw * bits + 7) / 8, x, y, c, i;
+    unsigned char* row = test_alloc(rowBytes + 1);
+    unsigned char* prior = test_alloc(rowBytes + 1);
+    unsigned char* out = test_alloc(rowBytes + 1);
+
+    if (pw == 0) {
+        free(row);
+        free(prior);
+        free(out);
+        return;
+    }
+    memset(prior, 0, rowBytes + 1);
+    for (y = y0; y < img->height; y += dy) {
+        int ft = filter >= 0 ? filter : (int)(test_rand() % 5);
+        memset(row, 0, rowBytes + 1);
+        for (x = 0; x < pw; x++) {
+            const unsigned short* s = img->samples
+                + ((y * img->width) + x0 + x * dx) * img->channels;
+            for (c = 0; c < img->channels; c++) {
+                int bit = (x * img->channels + c) * img->depth;
+                if (img->depth == 16) {
+                    row[bit / 8] = (unsigned char)(s[c] >> 8);
+                    row[bit / 8 + 1] = (unsigned char)s[c];
+                } else {
+                    row[bit / 8] |= (unsigned char)
+                        (s[c] << (8 - img->depth - bit % 8));
+                }
+            }
+        }
+        out[0] = (unsigned char)ft;
+        for (i = 0; i < rowBytes; i++) {
+            int a = i >= bpp ? row[i - bpp] : 0, b = prior[i];
+            int cc = i >= bpp ? prior[i - bpp] : 0;
+            int pred = ft == 0 ? 0 : ft == 1 ? a : ft == 2 ? b
+                : ft == 3 ? (a + b) / 2 : paeth(a, b, cc);
+            out[i + 1] = (unsigned char)(row[i] - pred);
+        }
+        buf_put(raw, out, rowBytes + 1);
+        memcpy(prior, row, rowBytes);
+    }
+    free(row);
+    free(prior);
+    free(out);
+}
+
+static test_buf write_png(const test_png* img, int filter) {
+    static const unsigned char signature[8] = {
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+    };
+    static const int x0[7] = { 0, 4, 0, 2, 0, 1, 0 };
+    static const int y0[7] = { 0, 0, 4, 0, 2, 0, 1 };
+    static const int dx[7] = { 8, 8, 4, 4, 2, 2, 1 };
+    static const int dy[7] = { 8, 8, 8, 4, 4, 2, 2 };
+    test_buf png = { NULL, 0, 0 }, raw = { NULL, 0, 0 }, z = { NULL, 0, 0 };
+    unsigned char hdr[13], trns[256];
+    long at;
+    int pass, i;
+
+    if (img->interlace) {
+        for (pass = 0; pass < 7; pass++) {
+            put_pass(&raw, img, x0[pass], y0[pass], dx[pass], dy[pass], filter);
+        }
+    } else {
+        put_pass(&raw, img, 0, 0, 1, 1, filter);
+    }
+
+    /* zlib stream of stored blocks */
+    buf_put(&z, "\x78\x01", 2);
+    for (at = 0; at < raw.len; ) {
+        long n = raw.len - at > 65535 ? 65535 : raw.len - at;
+        unsigned char b[5];
+        b[0] = (unsigned char)(at + n == raw.len);
+        b[1] = (unsigned char)n;
+        b[2] = (unsigned char)(n >> 8);
+        b[3] = (unsigned char)~n;
+        b[4] = (unsigned char)(~n >> 8);
+        buf_put(&z, b, 5);
+        buf_put(&z, raw.data + at, n);
+        at += n;
+    }
+    buf_put32(&z, javautil_adler32(1, raw.data, raw.len));
+
+    buf_put(&png, signature, 8);
+    hdr[0] = (unsigned char)(img->width >> 24);
+    hdr[1] = (unsigned char)(img->width >> 16);
+    hdr[2] = (unsigned char)(img->width >> 8);
+    hdr[3] = (unsigned char)img->width;
+    hdr[4] = (unsigned char)(img->height >> 24);
+    hdr[5] = (unsigned char)(img->height >> 16);
+    hdr[6] = (unsigned char)(img->height >> 8);
+    hdr[7] = (unsigned char)img->height;
+    hdr[8] = (unsigned char)img->depth;
+    hdr[9] = (unsigned char)img->colorType;
+    hdr[10] = 0;
+    hdr[11] = 0;
+    hdr[12] = (unsigned char)img->interlace;
+    put_chunk(&png, "IHDR", hdr, 13);
+    put_chunk(&png, "tEXt", (const unsigned char*)"Comment\0test", 12);
+    if (img->colorType == 3) {
+        put_chunk(&png, "PLTE", img->palette, 3 * img->paletteSize);
+    }
+    if (img->trns > 0) {
+        if (img->colorType == 3) {
+            put_chunk(&png, "tRNS", img->trnsAlpha, img->trns);
+        } else {
+            for (i = 0; i < img->channels; i++) {
+                trns[2 * i] = (unsigned char)(img->key[i] >> 8);
+                trns[2 * i + 1] = (unsigned char)img->key[i];
+            }
+            put_chunk(&png, "tRNS", trns, 2 * img->channels);
+        }
+    }
+    for (at = 0; at < z.len; ) {
+        long n = 1 + test_rand() % (z.len - at);
+        put_chunk(&png, "IDAT", z.data + at, n);
+        at += n;
+    }
+    put_chunk(&png, "IEND", hdr, 0);
+    free(raw.data);
+    free(z.data);
+    return png;
+}
+
+/* 8-bit value of a sample */
+static unsigned int sample8(unsigned int v, int depth) {
+    return depth == 16 ? v >> 8 : v * 255 / ((1 << depth) - 1);
+}
+
+static unsigned int expected_pixel(const test_png* img, int i) {
+    const unsigned short* s = img->samples + i * img->channels;
+    int d = img->depth;
+    unsigned int g, a = 255;
+
+    switch (img->colorType) {
+    case 0:
+        g = sample8(s[0], d);
+        if (img->trns > 0 && s[0] == img->key[0]) {
+            a = 0;
+        }
+        return (a << 24) | (g << 16) | (g << 8) | g;
+    case 2:
+        if (img->trns > 0 && s[0] == img->key[0] && s[1] == img->key[1]
+            && s[2] == img->key[2]) {
+            a = 0;
+        }
+        return (a << 24) | (sample8(s[0], d) << 16) | (sample8(s[1], d) << 8)
+            | sample8(s[2], d);
+    case 3:
+        if (s[0] < img->trns) {
+            a = img->trnsAlpha[s[0]];
+        }
+        return (a << 24) | (img->palette[3 * s[0]] << 16)
+            | (img->palette[3 * s[0] + 1] << 8) | img->palette[3 * s[0] + 2];
+    case 4:
+        g = sample8(s[0], d);
+        return (sample8(s[1], d) << 24) | (g << 16) | (g << 8) | g;
+    default:
+        return (sample8(s[3], d) << 24) | (sample8(s[0], d) << 16)
+            | (sample8(s[1], d) << 8) | sample8(s[2], d);
+    }
+}
+
+static void check_conformance(int colorType, int depth, int interlace,
+                              int trns, int filter) {
+    static const int channels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    test_png img;
+    test_buf png;
+    int n, i, hasAlpha = 0, max;
+    unsigned int* argb;
+
+    memset(&img, 0, sizeof(img));
+    img.width = 1 + test_rand() % 40;
+    img.height = 1 + test_rand() % 40;
+    img.colorType = colorType;
+    img.depth = depth;
+    img.interlace = interlace;
+    img.channels = channels[colorType];
+    n = img.width * img.height;
+    img.samples = test_alloc(2 * n * img.channels);
+    max = (1 << depth) - 1;
+    if (colorType == 3) {
+        img.paletteSize = 1 + test_rand() % (max + 1);
+        max = img.paletteSize - 1;
+        for (i = 0; i < 3 * img.paletteSize; i++) {
+            img.palette[i] = (unsigned char)test_rand();
+        }
+        if (trns) {
+            img.trns = 1 + test_rand() % img.paletteSize;
+            for (i = 0; i < img.trns; i++) {
+                img.trnsAlpha[i] = (unsigned char)test_rand();
+            }
+        }
+    }
+    for (i = 0; i < n * img.channels; i++) {
+        /* few distinct values, so that the tRNS color occurs */
+        img.samples[i] = (unsigned short)(test_rand() % 3 == 0
+                                          ? (unsigned int)max
+                                          : test_rand() % (max + 1));
+    }
+    if (trns && (colorType == 0 || colorType == 2)) {
+        img.trns = 1;
+        memcpy(img.key, img.samples + (test_rand() % n) * img.channels,
+               2 * img.channels);
+    }
+
+    png = write_png(&img, filter);
+    argb = decode_png(png.data, png.len, img.width, img.height, &hasAlpha);
+    CHECK(argb != NULL, ("decoding color type %d depth %d interlace %d "
+                         "filter %d", colorType, depth, interlace, filter));
+    if (argb != NULL) {
+        CHECK((hasAlpha != 0) == (colorType >= 4 || img.trns > 0),
+              ("hasAlpha of color type %d, tRNS %d", colorType, img.trns));
+        for (i = 0; i < n; i++) {
+            if (argb[i] != expected_pixel(&img, i)) {
+                CHECK(0, ("color type %d depth %d interlace %d tRNS %d "
+                          "%dx%d: pixel %d is %08x, not %08x", colorType,
+                          depth, interlace, img.trns, img.width, img.height,
+                          i, argb[i], expected_pixel(&img, i)));
+                break;
+            }
+        }
+        free(argb);
+    }
+    free(png.data);
+    free(img.samples);
+}
+
+int main(void) {
+    static const int formats[3] = {
+        JAVAUTIL_PNG_FORMAT_RGB565, JAVAUTIL_PNG_FORMAT_RGB888,
+        JAVAUTIL_PNG_FORMAT_RGBX888
+    };
+    /* 0 for noise, -1 for smooth, else the number of colors */
+    static const int colors[6] = { 0, -1, 2, 4, 16, 200 };
+    static const int depths[7][6] = {
+        { 1, 2, 4, 8, 16, 0 }, { 0 }, { 8, 16, 0 }, { 1, 2, 4, 8, 0 },
+        { 8, 16, 0 }, { 0 }, { 8, 16, 0 }
+    };
+    javautil_png_params params;
+    int level, filter, truecolor, f, c, type, d, k;
+
+    test_init();
+
+    for (level = JAVAUTIL_PNG_LEVEL_NONE; level <= JAVAUTIL_PNG_LEVEL_BEST;
+         level++) {
+        for (filter = JAVAUTIL_PNG_FILTER_DEFAULT;
+             filter <= JAVAUTIL_PNG_FILTER_ADAPTIVE; filter++) {
+            for (truecolor = 0; truecolor <= 1; truecolor++) {
+                params.level = level;
+                params.filter = filter;
+                params.threads = 0;
+                params.truecolor = truecolor;
+                for (f = 0; f < 3; f++) {
+                    for (c = 0; c < 6; c++) {
+                        check_round_trip(1 + test_rand() % 70,
+                                         1 + test_rand() % 70,
+                                         formats[f], colors[c], &params);
+                    }
+                }
+                check_stream(1 + test_rand() % 200, 1 + test_rand() % 200,
+                             formats[test_rand() % 3], -1, &params,
+                             test_rand() % 2 ? 0 : 1 + test_rand() % 500);
+            }
+        }
+    }
+    check_threads();
+    check_damaged();
+
+    for (type = 0; type <= 6; type++) {
+        for (d = 0; depths[type][d] != 0; d++) {
+            for (k = 0; k < 24; k++) {
+                /* each filter type on all rows, then random ones */
+                check_conformance(type, depths[type][d], k & 1,
+                                  (k >> 1) & 1, k < 20 ? (k >> 2) : -1);
+            }
+        }
+    }
+
+    return test_done("test_png");
+}
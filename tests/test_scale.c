@@ -0,0 +1,377 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * Image scaler against a floating point reference of the same filters,
+ * for random sizes, formats and strides.  Nearest neighbour must pick
+ * exactly the right pixels; the other filters may differ from the
+ * reference by rounding of their fixed point weights.  Downscales that
+ * first average blocks are only checked on smooth opaque images.
+ */
+
+#include "test_util.h"
+#include "javautil_scale.h"
+
+#define PI 3.14159265358979323846
+
+static double floor_of(double x) {
+    double i = (double)(long)x;
+    return i > x ? i - 1 : i;
+}
+
+static double abs_of(double x) {
+    return x < 0 ? -x : x;
+}
+
+static double sin_of(double x) {
+    double term, sum;
+    int k;
+
+    x -= 2 * PI * floor_of(x / (2 * PI) + 0.5);
+    term = sum = x;
+    for (k = 1; k < 15; k++) {
+        term *= -x * x / ((2 * k) * (2 * k + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+static double sinc(double x) {
+    return x == 0 ? 1 : sin_of(PI * x) / (PI * x);
+}
+
+/* Filter kernels and their support, as documented in javautil_scale.h */
+static const double support[4] = { 0, 1, 0.5, 3 };
+
+static double kernel(int filter, double x) {
+    x = abs_of(x);
+    switch (filter) {
+    case JAVAUTIL_SCALE_BILINEAR:
+        return x < 1 ? 1 - x : 0;
+    case JAVAUTIL_SCALE_BOX:
+        return x <= 0.5 ? 1 : 0;
+    default:
+        return x < 3 ? sinc(x) * sinc(x / 3) : 0;
+    }
+}
+
+/* Resamples n values, stride apart, to m */
+static void resample(const double* in, int n, int stride, double* out, int m,
+                     int outStride, int filter) {
+    double scale = (double)n / m, fs = scale < 1 ? 1 : scale;
+    double reach = support[filter] * fs;
+    int i, j;
+
+    for (i = 0; i < m; i++) {
+        double c = (i + 0.5) * scale, sum = 0, acc = 0;
+        int lo = (int)floor_of(c - reach + 0.5);
+        int hi = (int)floor_of(c + reach + 0.5);
+        if (lo < 0) {
+            lo = 0;
+        }
+        if (hi > n) {
+            hi = n;
+        }
+        for (j = lo; j < hi; j++) {
+            double w = kernel(filter, (j - c + 0.5) / fs);
+            sum += w;
+            acc += w * in[j * stride];
+        }
+        if (sum == 0) {
+            j = c < n ? (int)c : n - 1;
+            acc = in[j * stride];
+            sum = 1;
+        }
+        out[i * outStride] = acc / sum;
+    }
+}
+
+static double clamp255(double v) {
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+static int pixel_size(int format) {
+    return format == JAVAUTIL_SCALE_RGB565 ? 2
+        : format == JAVAUTIL_SCALE_ALPHA8 ? 1 : 4;
+}
+
+/* Channel c of a pixel as 8 bits, premultiplied; c is 0 for blue */
+static double channel(const unsigned char* p, int format, int c) {
+    unsigned short s;
+    unsigned int u;
+
+    switch (format) {
+    case JAVAUTIL_SCALE_ALPHA8:
+        return *p;
+    case JAVAUTIL_SCALE_RGB565:
+        memcpy(&s, p, 2);
+        switch (c) {
+        case 0:  return ((s & 31) << 3) | ((s & 31) >> 2);
+        case 1:  return (((s >> 5) & 63) << 2) | (((s >> 5) & 63) >> 4);
+        case 2:  return ((s >> 11) << 3) | ((s >> 11) >> 2);
+        default: return 255;
+        }
+    default:
+        memcpy(&u, p, 4);
+        if (format == JAVAUTIL_SCALE_ARGB8888 && c < 3) {
+            return ((u >> (8 * c)) & 255) * (double)(u >> 24) / 255;
+        }
+        return (u >> (8 * c)) & 255;
+    }
+}
+
+/*
+ * Fills the source: random bits, a smooth gradient, or a gradient with
+ * a checkerboard of transparent squares
+ */
+static void fill(unsigned char* src, int width, int height, int stride,
+                 int format, int kind) {
+    int x, y, size = pixel_size(format);
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            unsigned char* p = src + y * stride + x * size;
+            unsigned int r = x * 255 / (width > 1 ? width - 1 : 1);
+            unsigned int g = y * 255 / (height > 1 ? height - 1 : 1);
+            unsigned int b = (x + y) * 127 / (width + height);
+            unsigned int a = kind == 2 && ((x / 7 + y / 5) & 1) ? 0 : 255;
+            unsigned int v = kind == 0 ? (unsigned int)test_rand()
+                | ((unsigned int)test_rand() << 16)
+                : (a << 24) | (r << 16) | (g << 8) | b;
+            unsigned short s;
+
+            if (format == JAVAUTIL_SCALE_ARGB8888_PRE) {
+                a = v >> 24;
+                v = (a << 24) | ((((v >> 16) & 255) * a / 255) << 16)
+                    | ((((v >> 8) & 255) * a / 255) << 8)
+                    | ((v & 255) * a / 255);
+            }
+            switch (format) {
+            case JAVAUTIL_SCALE_ALPHA8:
+                *p = (unsigned char)(kind == 0 ? v : r);
+                break;
+            case JAVAUTIL_SCALE_RGB565:
+                s = (unsigned short)(kind == 0 ? v : ((r >> 3) << 11)
+                                     | ((g >> 2) << 5) | (b >> 3));
+                memcpy(p, &s, 2);
+                break;
+            default:
+                memcpy(p, &v, 4);
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Scales one random image and compares it with the reference.  Returns
+ * the largest and sets the mean difference per channel.
+ */
+static double check_one(int sw, int sh, int dw, int dh, int format,
+                        int filter, int kind, double* mean) {
+    int size = pixel_size(format);
+    int srcStride = sw * size + (test_rand() % 3) * 4;
+    int dstStride = dw * size + (test_rand() % 3) * 4;
+    int channels = format == JAVAUTIL_SCALE_ALPHA8 ? 1 : 4;
+    unsigned char* src = test_alloc(srcStride * sh);
+    unsigned char* dst = test_alloc(dstStride * dh);
+    double* plane = test_alloc(sizeof(double) * sw * sh);
+    double* rows = test_alloc(sizeof(double) * dw * sh);
+    double* want = test_alloc(sizeof(double) * 4 * dw * dh);
+    double worst = 0, total = 0;
+    int x, y, c;
+
+    fill(src, sw, sh, srcStride, format, kind);
+    CHECK(javautil_scale_image(src, sw, sh, srcStride, dst, dw, dh, dstStride,
+                               format, filter) == JAVACALL_OK,
+          ("%dx%d to %dx%d, format %d, filter %d", sw, sh, dw, dh, format,
+           filter));
+
+    if (filter == JAVAUTIL_SCALE_NEAREST) {
+        for (y = 0; y < dh; y++) {
+            for (x = 0; x < dw; x++) {
+                int sx = (int)((2L * x + 1) * sw / (2 * dw));
+                int sy = (int)((2L * y + 1) * sh / (2 * dh));
+                if (memcmp(dst + y * dstStride + x * size,
+                           src + sy * srcStride + sx * size, size) != 0) {
+                    worst = 255;
+                }
+            }
+        }
+        *mean = 0;
+        free(src);
+        free(dst);
+        free(plane);
+        free(rows);
+        free(want);
+        return worst;
+    }
+
+    /* rows first, rounded to bytes as the scaler stores them */
+    for (c = 0; c < channels; c++) {
+        double* out = want + c * dw * dh;
+        for (y = 0; y < sh; y++) {
+            for (x = 0; x < sw; x++) {
+                plane[y * sw + x] =
+                    channel(src + y * srcStride + x * size, format, c);
+            }
+            resample(plane + y * sw, sw, 1, rows + y * dw, dw, 1, filter);
+        }
+        for (y = 0; y < dw * sh; y++) {
+            rows[y] = clamp255(floor_of(rows[y] + 0.5));
+        }
+        for (x = 0; x < dw; x++) {
+            resample(rows + x, sh, dw, out + x, dh, dw, filter);
+        }
+        for (y = 0; y < dw * dh; y++) {
+            out[y] = clamp255(out[y]);
+        }
+    }
+    /* premultiplied colors cannot exceed their alpha */
+    if (format == JAVAUTIL_SCALE_ARGB8888) {
+        for (y = 0; y < dw * dh; y++) {
+            for (c = 0; c < 3; c++) {
+                if (want[c * dw * dh + y] > want[3 * dw * dh + y]) {
+                    want[c * dw * dh + y] = want[3 * dw * dh + y];
+                }
+            }
+        }
+    }
+
+    for (y = 0; y < dh; y++) {
+        for (x = 0; x < dw; x++) {
+            const unsigned char* p = dst + y * dstStride + x * size;
+            for (c = 0; c < channels; c++) {
+                double w = want[c * dw * dh + y * dw + x];
+                double e = abs_of(channel(p, format, c) - w);
+                if (format == JAVAUTIL_SCALE_RGB565) {
+                    /* the stored bits, against the reference truncated */
+                    double step = c == 1 ? 4 : 8;
+                    e = c == 3 ? 0 : abs_of(floor_of(channel(p, format, c)
+                                                     / step)
+                                            - floor_of(w / step)) * step;
+                }
+                if (e > worst) {
+                    worst = e;
+                }
+                total += e;
+            }
+        }
+    }
+    *mean = total / (dw * dh * channels);
+    free(src);
+    free(dst);
+    free(plane);
+    free(rows);
+    free(want);
+    return worst;
+}
+
+static void check_random(int count) {
+    int k;
+
+    for (k = 0; k < count; k++) {
+        int sw = 1 + test_rand() % 120, sh = 1 + test_rand() % 120;
+        int dw = 1 + test_rand() % 120, dh = 1 + test_rand() % 120;
+        int format = test_rand() % 4, filter = test_rand() % 4;
+        int kind = test_rand() % 3, reduced;
+        double mean, worst;
+
+        if (k % 4 == 0) {
+            sw = 1 + test_rand() % 1000;
+            dw = 1 + test_rand() % 40;
+        }
+        reduced = sw / dw >= 4 || sh / dh >= 4;
+        worst = check_one(sw, sh, dw, dh, format, filter, kind, &mean);
+        if (filter == JAVAUTIL_SCALE_NEAREST) {
+            CHECK(worst == 0, ("nearest %dx%d to %dx%d, format %d",
+                               sw, sh, dw, dh, format));
+        } else if (!reduced) {
+            /* straight alpha is rounded once more when it is restored */
+            CHECK(worst <= (format == JAVAUTIL_SCALE_RGB565 ? 10
+                            : format == JAVAUTIL_SCALE_ARGB8888 ? 3 : 2),
+                  ("%dx%d to %dx%d, format %d, filter %d: difference %.1f",
+                   sw, sh, dw, dh, format, filter, worst));
+        } else if (kind == 1 && dw >= 8 && dh >= 8) {
+            CHECK(mean <= 4, ("%dx%d to %dx%d, format %d, filter %d: mean "
+                              "difference %.2f", sw, sh, dw, dh, format,
+                              filter, mean));
+        }
+    }
+}
+
+static void check_api(void) {
+    static unsigned int src[16 * 16], dst[40 * 40], again[40 * 40];
+    javautil_scaler* s;
+    int i, filter;
+
+    for (i = 0; i < 16 * 16; i++) {
+        src[i] = 0x80402010;
+    }
+    /* a flat image stays flat with every filter, however it is scaled */
+    for (filter = 0; filter < 4; filter++) {
+        CHECK(javautil_scale_image(src, 16, 16, 64, dst, 40, 13, 160,
+                                   JAVAUTIL_SCALE_ARGB8888_PRE, filter)
+              == JAVACALL_OK, ("flat image, filter %d", filter));
+        for (i = 0; i < 40 * 13; i++) {
+            CHECK(dst[i] == 0x80402010, ("flat image, filter %d, pixel %d: "
+                                         "%08x", filter, i, dst[i]));
+        }
+    }
+
+    /* a scaler gives the same result every time it is run */
+    for (i = 0; i < 16 * 16; i++) {
+        src[i] = (unsigned int)test_rand() * 0x9e3779b9u;
+    }
+    s = javautil_scaler_create(16, 16, 40, 40, JAVAUTIL_SCALE_ARGB8888,
+                               JAVAUTIL_SCALE_LANCZOS3);
+    CHECK(s != NULL, ("create"));
+    if (s != NULL) {
+        CHECK(javautil_scaler_run(s, src, 64, dst, 160) == JAVACALL_OK
+              && javautil_scaler_run(s, src, 64, again, 160) == JAVACALL_OK
+              && memcmp(dst, again, sizeof(dst)) == 0, ("scaler run twice"));
+        CHECK(javautil_scaler_run(s, NULL, 64, dst, 160)
+              == JAVACALL_INVALID_ARGUMENT, ("run without source"));
+        CHECK(javautil_scaler_run(s, src, 64, NULL, 160)
+              == JAVACALL_INVALID_ARGUMENT, ("run without destination"));
+        javautil_scaler_destroy(s);
+    }
+
+    CHECK(javautil_scaler_create(0, 16, 4, 4, 0, 0) == NULL, ("width 0"));
+    CHECK(javautil_scaler_create(16, 16, 4, 32768, 0, 0) == NULL,
+          ("height 32768"));
+    CHECK(javautil_scaler_create(16, 16, 4, 4, 4, 0) == NULL, ("format 4"));
+    CHECK(javautil_scaler_create(16, 16, 4, 4, 0, 4) == NULL, ("filter 4"));
+    CHECK(javautil_scale_image(src, 16, 16, 64, dst, 4, 4, 16, 9, 0)
+          == JAVACALL_FAIL, ("scale with format 9"));
+}
+
+int main(void) {
+    test_init();
+    check_api();
+    check_random(600);
+    return test_done("test_scale");
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright  1990-2008 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ *
+ * Helpers shared by the self-checking tests.  Each test is a program
+ * that exits with 0 when all its checks pass; failed checks are
+ * printed, the first few of each test only.
+ */
+
+#ifndef _TEST_UTIL_H_
+#define _TEST_UTIL_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "javautil_cpu.h"
+#include "javautil_pixel.h"
+
+static int test_failures = 0;
+
+#define TEST_MAX_REPORTS 20
+
+/* Counts a failure if cond is false and prints the printf arguments */
+#define CHECK(cond, args) \
+    do { \
+        if (!(cond)) { \
+            if (test_failures++ < TEST_MAX_REPORTS) { \
+                printf("%s:%d: ", __FILE__, __LINE__); \
+                printf args; \
+                printf("\n"); \
+            } \
+        } \
+    } while (0)
+
+/* Selects the CPU features and kernels, as javacall_os_initialize does */
+static void test_init(void) {
+    javautil_cpu_init();
+    javautil_pixel_init();
+}
+
+/* Prints the result of the test; the exit status of main */
+static int test_done(const char* name) {
+    printf("%s: %s (%d failed)\n", name,
+           test_failures == 0 ? "ok" : "FAILED", test_failures);
+    return test_failures == 0 ? 0 : 1;
+}
+
+/* xorshift64, so that the inputs are the same on every run */
+static unsigned long long test_seed = 88172645463325252ULL;
+
+static unsigned int test_rand(void) {
+    test_seed ^= test_seed << 13;
+    test_seed ^= test_seed >> 7;
+    test_seed ^= test_seed << 17;
+    return (unsigned int)(test_seed >> 16);
+}
+
+static void* test_alloc(size_t size) {
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == NULL) {
+        printf("out of memory\n");
+        exit(2);
+    }
+    return p;
+}
+
+#endif /* _TEST_UTIL_H_ */